@@ -0,0 +1,1530 @@
+/*
+ * Copyright (c) 2016-2017, Marie Helene Kvello-Aune
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * thislist of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+
+/*
+ * Latency and system call cost of every public libifconfig function.
+ *
+ * Each case is run a number of times and timed call by call. One line of
+ * tab-separated values is printed per case, after a header line starting
+ * with '#':
+ *
+ *   case  iterations  errors  p50_ns  p99_ns  mean_ns  syscalls_per_op
+ *
+ * System calls are counted by interposing the libc wrappers libifconfig
+ * uses, so calls libc makes internally are not included.
+ *
+ * On Linux the benchmark moves itself into a new network namespace (and
+ * user namespace, if unprivileged) so that it can create and change
+ * interfaces freely. Elsewhere it works on interfaces it creates in the
+ * current one, and destroys them when done.
+ *
+ * With -S the handles are attached to a simulated kernel instead, which
+ * leaves the cost of the library itself. Its interface table can be
+ * filled with -n interfaces to see how costs grow with the system size.
+ *
+ * Usage: apibench [-N] [-S [-n interfaces]] [-i iterations] [case ...]
+ *   -N  Stay in the current network namespace.
+ *   -S  Use the simulated kernel.
+ */
+
+#if defined(__linux__)
+#define _GNU_SOURCE	/* unshare(2) */
+#endif
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#if !defined(__linux__)
+#include <sys/sysctl.h>
+#endif
+
+#include <net/if.h>
+#include <netinet/in.h>
+
+#include <dlfcn.h>
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <libifconfig.h>
+
+#ifndef __unused
+#define __unused	__attribute__((unused))
+#endif
+
+/* Interfaces destroyed per call by the bulk destroy case. */
+#define BULK_COUNT	16
+#define ADDR_COUNT	256
+
+/* Cloners tried in order for the interfaces the benchmark works on. */
+#if defined(__linux__)
+static const char *kinds[] = { "dummy", "bridge" };
+#else
+static const char *kinds[] = { "disc", "lo", "bridge" };
+#endif
+
+/* Cloner for the members of the bridge cases. */
+#if defined(__linux__)
+static const char *portkind = "veth";
+#else
+static const char *portkind = "epair";
+#endif
+
+static unsigned long syscalls;
+
+/*
+ * Counting wrappers for the system calls libifconfig makes. Being defined
+ * in the executable, they take precedence over the libc versions. The
+ * count is atomic, as asynchronous requests run on worker threads.
+ */
+#define NEXT(fn)							\
+	static __typeof__(fn) *next_##fn;				\
+	if (next_##fn == NULL &&					\
+	    (next_##fn = (__typeof__(fn) *)dlsym(RTLD_NEXT, #fn)) == NULL) { \
+		abort();						\
+	}								\
+	__atomic_fetch_add(&syscalls, 1, __ATOMIC_RELAXED)
+
+int
+ioctl(int fd, unsigned long request, ...)
+{
+	va_list ap;
+	void *arg;
+
+	NEXT(ioctl);
+	va_start(ap, request);
+	arg = va_arg(ap, void *);
+	va_end(ap);
+	return (next_ioctl(fd, request, arg));
+}
+
+int
+socket(int domain, int type, int protocol)
+{
+
+	NEXT(socket);
+	return (next_socket(domain, type, protocol));
+}
+
+int
+bind(int s, const struct sockaddr *addr, socklen_t addrlen)
+{
+
+	NEXT(bind);
+	return (next_bind(s, addr, addrlen));
+}
+
+int
+setsockopt(int s, int level, int optname, const void *optval,
+    socklen_t optlen)
+{
+
+	NEXT(setsockopt);
+	return (next_setsockopt(s, level, optname, optval, optlen));
+}
+
+ssize_t
+send(int s, const void *msg, size_t len, int flags)
+{
+
+	NEXT(send);
+	return (next_send(s, msg, len, flags));
+}
+
+ssize_t
+recv(int s, void *buf, size_t len, int flags)
+{
+
+	NEXT(recv);
+	return (next_recv(s, buf, len, flags));
+}
+
+ssize_t
+write(int fd, const void *buf, size_t len)
+{
+
+	NEXT(write);
+	return (next_write(fd, buf, len));
+}
+
+int
+close(int fd)
+{
+
+	NEXT(close);
+	return (next_close(fd));
+}
+
+#if !defined(__linux__)
+int
+sysctl(const int *name, u_int namelen, void *oldp, size_t *oldlenp,
+    const void *newp, size_t newlen)
+{
+
+	NEXT(sysctl);
+	return (next_sysctl(name, namelen, oldp, oldlenp, newp, newlen));
+}
+#endif
+
+struct ctx {
+	ifconfig_handle_t *lifh;
+	/* Simulated kernel the handles are attached to, or NULL. */
+	ifconfig_sim_t *sim;
+	/* Interface the getters and setters work on. */
+	char ifname[IFNAMSIZ];
+	/* Cloner for interfaces created and destroyed by the benchmark. */
+	const char *kind;
+	/* Interface created by a case's setup, or by the previous iteration. */
+	char tmpname[IFNAMSIZ];
+	ifconfig_snapshot_t *snap;
+	ifconfig_counters_t *counters;
+	ifconfig_sampler_t *sampler;
+	ifconfig_metrics_t *metrics;
+	/* Sink for ifconfig_metrics_write_fd(), or -1. */
+	int devnull;
+	ifconfig_watch_t *watch;
+	/* Handle with its attribute cache on. */
+	ifconfig_handle_t *cached;
+	/* Reference to ifname. */
+	ifconfig_iface_t *iface;
+	ifconfig_async_t *async;
+	/* Desired state of ifname as it is, so a run changes nothing. */
+	ifconfig_reconcile_t *reconcile;
+	/* Checkpoint file, or "" before the first save. */
+	char ckpt[32];
+	/* Empty simulator and its handle for a restore to fill. */
+	ifconfig_sim_t *restoresim;
+	ifconfig_handle_t *restoreh;
+	/* Interfaces made by ifconfig_create_vlans(), IFNAMSIZ apart. */
+	char *vlans;
+	size_t nvlans;
+	char bulk[BULK_COUNT][IFNAMSIZ];
+	/* Bridge and the interfaces the bridge cases attach, or "". */
+	char bridge[IFNAMSIZ];
+	char ports[BULK_COUNT][IFNAMSIZ];
+	int attached;
+};
+
+typedef int op_t(struct ctx *c, long i);
+
+struct benchcase {
+	const char *name;
+	/* Untimed, before each timed call. May be NULL. */
+	op_t *before;
+	op_t *op;
+	/* Untimed, after each timed call. May be NULL. */
+	op_t *after;
+	/* Run iterations / divisor times. For cases that change the system. */
+	int divisor;
+};
+
+static ifconfig_handle_t *
+bench_open(struct ctx *c, const int shared)
+{
+	ifconfig_handle_t *lifh;
+
+	lifh = shared ? ifconfig_open_shared() : ifconfig_open();
+	if (lifh != NULL && c->sim != NULL &&
+	    ifconfig_sim_attach(lifh, c->sim) != 0) {
+		ifconfig_close(lifh);
+		return (NULL);
+	}
+	return (lifh);
+}
+
+static int
+op_open_close(struct ctx *c, long i __unused)
+{
+	ifconfig_handle_t *lifh;
+
+	if ((lifh = bench_open(c, 0)) == NULL) {
+		return (-1);
+	}
+	ifconfig_close(lifh);
+	return (0);
+}
+
+static int
+op_open_shared_close(struct ctx *c, long i __unused)
+{
+	ifconfig_handle_t *lifh;
+
+	if ((lifh = bench_open(c, 1)) == NULL) {
+		return (-1);
+	}
+	ifconfig_close(lifh);
+	return (0);
+}
+
+static int
+op_open_get_mtu_close(struct ctx *c, long i __unused)
+{
+	ifconfig_handle_t *lifh;
+	int error, mtu;
+
+	if ((lifh = bench_open(c, 0)) == NULL) {
+		return (-1);
+	}
+	error = ifconfig_get_mtu(lifh, c->ifname, &mtu);
+	ifconfig_close(lifh);
+	return (error);
+}
+
+static int
+op_err_state(struct ctx *c, long i __unused)
+{
+
+	(void)ifconfig_err_errtype(c->lifh);
+	(void)ifconfig_err_errno(c->lifh);
+	(void)ifconfig_err_ioctlreq(c->lifh);
+	return (0);
+}
+
+static int
+op_cache_flush(struct ctx *c, long i __unused)
+{
+
+	ifconfig_cache_flush(c->lifh);
+	return (0);
+}
+
+static int
+op_stats_get(struct ctx *c, long i __unused)
+{
+	struct ifconfig_stat stats[32];
+
+	return (ifconfig_stats_get(c->lifh, stats, 32) < 0 ? -1 : 0);
+}
+
+static int
+op_stats_reset(struct ctx *c, long i __unused)
+{
+
+	ifconfig_stats_reset(c->lifh);
+	return (0);
+}
+
+static int
+op_get_mtu(struct ctx *c, long i __unused)
+{
+	int mtu;
+
+	return (ifconfig_get_mtu(c->lifh, c->ifname, &mtu));
+}
+
+/* Untimed. The first read fills the cache. */
+static int
+attrcache_on(struct ctx *c, long i __unused)
+{
+	int mtu;
+
+	if (c->cached != NULL) {
+		return (0);
+	}
+	if ((c->cached = bench_open(c, 0)) == NULL ||
+	    ifconfig_attrcache_enable(c->cached, 60000, 0) != 0) {
+		return (-1);
+	}
+	return (ifconfig_get_mtu(c->cached, c->ifname, &mtu));
+}
+
+static int
+op_get_mtu_cached(struct ctx *c, long i __unused)
+{
+	int mtu;
+
+	return (ifconfig_get_mtu(c->cached, c->ifname, &mtu));
+}
+
+static int
+op_get_metric(struct ctx *c, long i __unused)
+{
+	int metric;
+
+	return (ifconfig_get_metric(c->lifh, c->ifname, &metric));
+}
+
+static int
+op_get_capability(struct ctx *c, long i __unused)
+{
+	struct ifconfig_capabilities cap;
+
+	return (ifconfig_get_capability(c->lifh, c->ifname, &cap));
+}
+
+static int
+op_get_description(struct ctx *c, long i __unused)
+{
+	char *descr;
+
+	if (ifconfig_get_description(c->lifh, c->ifname, &descr) != 0) {
+		return (-1);
+	}
+	free(descr);
+	return (0);
+}
+
+static int
+op_get_description_r(struct ctx *c, long i __unused)
+{
+	char descr[64];
+
+	return (ifconfig_get_description_r(c->lifh, c->ifname, descr,
+	    sizeof(descr)));
+}
+
+static int
+op_get_orig_name(struct ctx *c, long i __unused)
+{
+	char *name;
+
+	if (ifconfig_get_orig_name(c->lifh, c->ifname, &name) != 0) {
+		return (-1);
+	}
+	free(name);
+	return (0);
+}
+
+static int
+op_get_orig_name_r(struct ctx *c, long i __unused)
+{
+	char name[IFNAMSIZ];
+
+	return (ifconfig_get_orig_name_r(c->lifh, c->ifname, name,
+	    sizeof(name)));
+}
+
+static int
+op_set_mtu(struct ctx *c, long i)
+{
+
+	return (ifconfig_set_mtu(c->lifh, c->ifname, 1400 + (i & 1)));
+}
+
+/* Untimed. */
+static int
+start_async(struct ctx *c, long i __unused)
+{
+
+	if (c->async != NULL) {
+		return (0);
+	}
+	return (ifconfig_async_new(c->lifh, 2, &c->async));
+}
+
+/* BULK_COUNT MTU changes in flight, then waits for all of them. */
+static int
+op_async_set_mtu(struct ctx *c, long i)
+{
+	struct ifconfig_completion comp[BULK_COUNT];
+	struct pollfd pfd;
+	size_t n;
+	int error;
+
+	for (size_t j = 0; j < BULK_COUNT; j++) {
+		if (ifconfig_submit_set_mtu(c->async, c->ifname,
+		    1400 + (i & 1), NULL) != 0) {
+			return (-1);
+		}
+	}
+	pfd.fd = ifconfig_async_fd(c->async);
+	pfd.events = POLLIN;
+	error = 0;
+	while (ifconfig_async_inflight(c->async) > 0) {
+		(void)poll(&pfd, 1, -1);
+		n = ifconfig_async_reap(c->async, comp, BULK_COUNT);
+		for (size_t j = 0; j < n; j++) {
+			error |= comp[j].error;
+		}
+	}
+	return (error);
+}
+
+/* Untimed. */
+static int
+reconcile_current(struct ctx *c, long i __unused)
+{
+	char *descr;
+	int mtu;
+
+	if (c->reconcile != NULL) {
+		return (0);
+	}
+	if ((c->reconcile = ifconfig_reconcile_new(c->lifh)) == NULL ||
+	    ifconfig_get_mtu(c->lifh, c->ifname, &mtu) != 0 ||
+	    ifconfig_reconcile_set_mtu(c->reconcile, c->ifname, mtu) != 0) {
+		return (-1);
+	}
+	descr = NULL;
+	if (ifconfig_get_description(c->lifh, c->ifname, &descr) != 0 &&
+	    ifconfig_err_errno(c->lifh) != 0) {
+		return (-1);
+	}
+	if (ifconfig_reconcile_set_description(c->reconcile, c->ifname,
+	    descr != NULL ? descr : "") != 0) {
+		free(descr);
+		return (-1);
+	}
+	free(descr);
+	return (0);
+}
+
+/* The periodic run of a configuration agent when nothing changed. */
+static int
+op_reconcile_unchanged(struct ctx *c, long i __unused)
+{
+
+	if (ifconfig_reconcile_run(c->reconcile, 0) != 0) {
+		return (-1);
+	}
+	return (ifconfig_reconcile_count(c->reconcile) == 0 ? 0 : -1);
+}
+
+/* Untimed. */
+static int
+iface_lookup(struct ctx *c, long i __unused)
+{
+
+	if (c->iface != NULL) {
+		return (0);
+	}
+	return (ifconfig_iface_lookup(c->lifh, c->ifname, &c->iface));
+}
+
+static int
+op_get_mtu_by_ref(struct ctx *c, long i __unused)
+{
+	int mtu;
+
+	return (ifconfig_get_mtu_by_ref(c->lifh, c->iface, &mtu));
+}
+
+static int
+op_get_description_r_by_ref(struct ctx *c, long i __unused)
+{
+	char descr[64];
+
+	return (ifconfig_get_description_r_by_ref(c->lifh, c->iface, descr,
+	    sizeof(descr)));
+}
+
+static int
+op_get_orig_name_r_by_ref(struct ctx *c, long i __unused)
+{
+	char name[IFNAMSIZ];
+
+	return (ifconfig_get_orig_name_r_by_ref(c->lifh, c->iface, name,
+	    sizeof(name)));
+}
+
+static int
+op_set_mtu_by_ref(struct ctx *c, long i)
+{
+
+	return (ifconfig_set_mtu_by_ref(c->lifh, c->iface, 1400 + (i & 1)));
+}
+
+static int
+op_set_metric(struct ctx *c, long i)
+{
+
+	return (ifconfig_set_metric(c->lifh, c->ifname, (int)(i & 1)));
+}
+
+static int
+op_set_capability(struct ctx *c, long i __unused)
+{
+	struct ifconfig_capabilities cap;
+
+	if (ifconfig_get_capability(c->lifh, c->ifname, &cap) != 0) {
+		return (-1);
+	}
+	return (ifconfig_set_capability(c->lifh, c->ifname, cap.curcap));
+}
+
+/* Alternates LRO, so every call changes something. */
+static int
+op_set_capabilities(struct ctx *c, long i)
+{
+	int lro;
+
+	lro = ifconfig_capability_mask("lro");
+	return (ifconfig_set_capabilities(c->lifh, c->ifname,
+	    (i & 1) ? lro : 0, (i & 1) ? 0 : lro));
+}
+
+static int
+op_set_capabilities_bulk(struct ctx *c, long i)
+{
+	const char *names[BULK_COUNT];
+	int lro;
+
+	for (size_t j = 0; j < BULK_COUNT; j++) {
+		names[j] = c->ifname;
+	}
+	lro = ifconfig_capability_mask("lro");
+	return (ifconfig_set_capabilities_bulk(c->lifh, names, BULK_COUNT,
+	    (i & 1) ? lro : 0, (i & 1) ? 0 : lro, NULL));
+}
+
+static int
+op_set_description(struct ctx *c, long i)
+{
+
+	return (ifconfig_set_description(c->lifh, c->ifname,
+	    (i & 1) ? "apibench odd" : "apibench even"));
+}
+
+static int
+op_unset_description(struct ctx *c, long i __unused)
+{
+
+	return (ifconfig_unset_description(c->lifh, c->ifname));
+}
+
+static int
+op_set_name(struct ctx *c, long i)
+{
+	char from[IFNAMSIZ], to[IFNAMSIZ];
+
+	/* Rename back and forth, ending on the original name. */
+	(void)snprintf(from, sizeof(from), "%s%s", c->ifname,
+	    (i & 1) ? "b" : "");
+	(void)snprintf(to, sizeof(to), "%s%s", c->ifname, (i & 1) ? "" : "b");
+	return (ifconfig_set_name(c->lifh, from, to));
+}
+
+static int
+op_set_vlantag(struct ctx *c, long i)
+{
+
+	return (ifconfig_set_vlantag(c->lifh, c->tmpname, c->ifname,
+	    (unsigned short)(10 + (i & 1))));
+}
+
+static int
+create_tmp(struct ctx *c, long i __unused)
+{
+
+	return (ifconfig_create_interface_r(c->lifh, c->kind, c->tmpname,
+	    sizeof(c->tmpname)));
+}
+
+static int
+destroy_tmp(struct ctx *c, long i __unused)
+{
+
+	if (c->tmpname[0] == '\0') {
+		return (0);
+	}
+	(void)ifconfig_destroy_interface(c->lifh, c->tmpname);
+	c->tmpname[0] = '\0';
+	return (0);
+}
+
+static int
+op_create_interface(struct ctx *c, long i __unused)
+{
+	char *name;
+
+	if (ifconfig_create_interface(c->lifh, c->kind, &name) != 0) {
+		return (-1);
+	}
+	(void)snprintf(c->tmpname, sizeof(c->tmpname), "%s", name);
+	free(name);
+	return (0);
+}
+
+static int
+op_create_interface_vlan(struct ctx *c, long i __unused)
+{
+	char *name;
+
+	if (ifconfig_create_interface_vlan(c->lifh, "vlan", &name, c->ifname,
+	    100) != 0) {
+		return (-1);
+	}
+	(void)snprintf(c->tmpname, sizeof(c->tmpname), "%s", name);
+	free(name);
+	return (0);
+}
+
+static int
+op_create_interface_vlan_r(struct ctx *c, long i __unused)
+{
+
+	return (ifconfig_create_interface_vlan_r(c->lifh, "vlan", c->tmpname,
+	    sizeof(c->tmpname), c->ifname, 100));
+}
+
+static int
+create_vlan_tmp(struct ctx *c, long i)
+{
+
+	return (op_create_interface_vlan_r(c, i));
+}
+
+static int
+op_create_vlans(struct ctx *c, long i __unused)
+{
+	const struct ifconfig_vlan_range range = { 100, 355 };
+
+	return (ifconfig_create_vlans(c->lifh, c->ifname, &range, 1, 1400,
+	    "apibench", &c->vlans, &c->nvlans));
+}
+
+static int
+destroy_vlans(struct ctx *c, long i __unused)
+{
+
+	for (size_t j = 0; j < c->nvlans; j++) {
+		(void)ifconfig_destroy_interface(c->lifh,
+		    c->vlans + j * IFNAMSIZ);
+	}
+	free(c->vlans);
+	c->vlans = NULL;
+	c->nvlans = 0;
+	return (0);
+}
+
+static int
+create_bulk(struct ctx *c, long i __unused)
+{
+
+	for (size_t j = 0; j < BULK_COUNT; j++) {
+		if (ifconfig_create_interface_r(c->lifh, c->kind, c->bulk[j],
+		    sizeof(c->bulk[j])) != 0) {
+			return (-1);
+		}
+	}
+	return (0);
+}
+
+static int
+op_destroy_interfaces(struct ctx *c, long i __unused)
+{
+	const char *names[BULK_COUNT];
+
+	for (size_t j = 0; j < BULK_COUNT; j++) {
+		names[j] = c->bulk[j];
+	}
+	return (ifconfig_destroy_interfaces(c->lifh, names, BULK_COUNT, 0,
+	    NULL));
+}
+
+static int
+op_destroy_interface(struct ctx *c, long i __unused)
+{
+	int error;
+
+	error = ifconfig_destroy_interface(c->lifh, c->tmpname);
+	if (error == 0) {
+		c->tmpname[0] = '\0';
+	}
+	return (error);
+}
+
+static int
+op_snapshot_take(struct ctx *c, long i __unused)
+{
+	ifconfig_snapshot_t *snap;
+
+	if (ifconfig_snapshot_take(c->lifh, 0, &snap) != 0) {
+		return (-1);
+	}
+	ifconfig_snapshot_free(snap);
+	return (0);
+}
+
+static int
+op_snapshot_take_all(struct ctx *c, long i __unused)
+{
+	ifconfig_snapshot_t *snap;
+
+	if (ifconfig_snapshot_take(c->lifh, IFCONFIG_SNAP_ALL, &snap) != 0) {
+		return (-1);
+	}
+	ifconfig_snapshot_free(snap);
+	return (0);
+}
+
+/* Every accessor, on the interface found by name. */
+static int
+op_snapshot_read(struct ctx *c, long i __unused)
+{
+	struct ifconfig_capabilities cap;
+	const ifconfig_snapshot_iface_t *iface;
+	volatile uintptr_t sink;
+
+	if (c->snap == NULL && ifconfig_snapshot_take(c->lifh,
+	    IFCONFIG_SNAP_ALL, &c->snap) != 0) {
+		return (-1);
+	}
+	if (ifconfig_snapshot_count(c->snap) == 0 ||
+	    ifconfig_snapshot_at(c->snap, 0) == NULL ||
+	    (iface = ifconfig_snapshot_find(c->snap, c->ifname)) == NULL) {
+		return (-1);
+	}
+	sink = (uintptr_t)ifconfig_snapshot_iface_name(iface);
+	sink = ifconfig_snapshot_iface_index(iface);
+	sink = ifconfig_snapshot_iface_flags(iface);
+	sink = ifconfig_snapshot_iface_mtu(iface);
+	sink = ifconfig_snapshot_iface_metric(iface);
+	sink = ifconfig_snapshot_iface_capability(iface, &cap);
+	sink = (uintptr_t)ifconfig_snapshot_iface_description(iface);
+	sink = (uintptr_t)ifconfig_snapshot_iface_orig_name(iface);
+	(void)sink;
+	return (0);
+}
+
+/* After the first iteration, a steady-state read into the same object. */
+static int
+op_counters_read(struct ctx *c, long i __unused)
+{
+
+	if (c->counters == NULL &&
+	    (c->counters = ifconfig_counters_new()) == NULL) {
+		return (-1);
+	}
+	if (ifconfig_counters_read(c->lifh, c->counters) != 0 ||
+	    ifconfig_counters_find(c->counters, c->ifname) == NULL) {
+		return (-1);
+	}
+	return (0);
+}
+
+/*
+ * Untimed. The sampler reads once when it starts and then waits out its
+ * interval, so its own system calls stay out of the reader's count.
+ */
+static int
+start_sampler(struct ctx *c, long i __unused)
+{
+	const ifconfig_sample_t *smp;
+	ifconfig_handle_t *lifh;
+	uint64_t seq;
+
+	if (c->sampler != NULL) {
+		return (0);
+	}
+	if ((lifh = bench_open(c, 0)) == NULL ||
+	    ifconfig_sampler_start(lifh, 60000, &c->sampler) != 0) {
+		return (-1);
+	}
+	do {
+		(void)usleep(1000);
+		smp = ifconfig_sampler_acquire(c->sampler);
+		seq = ifconfig_sample_seq(smp);
+		ifconfig_sampler_release(c->sampler, smp);
+	} while (seq == 0 && ifconfig_sampler_failures(c->sampler) == 0);
+	return (0);
+}
+
+static int
+op_sampler_acquire(struct ctx *c, long i __unused)
+{
+	const ifconfig_sample_t *smp;
+	const double *rates;
+	volatile double sum;
+
+	smp = ifconfig_sampler_acquire(c->sampler);
+	rates = ifconfig_sample_rates(smp, IFCONFIG_COUNTER_IBYTES);
+	sum = 0;
+	for (size_t j = 0; j < ifconfig_sample_count(smp); j++) {
+		sum += rates[j];
+	}
+	ifconfig_sampler_release(c->sampler, smp);
+	return (0);
+}
+
+/* Untimed. Everything the exposition can show, from one read. */
+static int
+metrics_sources(struct ctx *c, long i __unused)
+{
+
+	if (c->metrics != NULL) {
+		return (0);
+	}
+	if ((c->snap == NULL && ifconfig_snapshot_take(c->lifh,
+	    IFCONFIG_SNAP_ALL, &c->snap) != 0) ||
+	    (c->counters == NULL &&
+	    (c->counters = ifconfig_counters_new()) == NULL) ||
+	    ifconfig_counters_read(c->lifh, c->counters) != 0 ||
+	    (c->devnull = open("/dev/null", O_WRONLY)) == -1 ||
+	    (c->metrics = ifconfig_metrics_new()) == NULL) {
+		return (-1);
+	}
+	return (0);
+}
+
+/* The whole exposition, through a 64 KiB buffer. */
+static int
+op_metrics_write(struct ctx *c, long i __unused)
+{
+	static char buf[65536];
+
+	if (ifconfig_metrics_begin(c->metrics, c->snap, c->counters) != 0) {
+		return (-1);
+	}
+	while (ifconfig_metrics_write(c->metrics, buf, sizeof(buf)) > 0) {
+		continue;
+	}
+	return (0);
+}
+
+static int
+op_metrics_write_fd(struct ctx *c, long i __unused)
+{
+
+	if (ifconfig_metrics_begin(c->metrics, c->snap, c->counters) != 0 ||
+	    ifconfig_metrics_write_fd(c->metrics, c->devnull) != 0) {
+		return (-1);
+	}
+	return (0);
+}
+
+static int
+batch_submit(struct ctx *c, const long i, const int n)
+{
+	ifconfig_batch_t *b;
+	int error;
+
+	if ((b = ifconfig_batch_new(c->lifh)) == NULL) {
+		return (-1);
+	}
+	for (int j = 0; j < n; j++) {
+		(void)ifconfig_batch_set_mtu(b, c->ifname,
+		    1400 + ((i + j) & 1));
+	}
+	error = ifconfig_batch_submit(b, 0);
+	for (size_t j = 0; j < ifconfig_batch_count(b); j++) {
+		if (ifconfig_batch_result(b, j) != IFCONFIG_BATCH_DONE) {
+			error = -1;
+			(void)ifconfig_batch_err_errtype(b, j);
+			(void)ifconfig_batch_err_errno(b, j);
+			(void)ifconfig_batch_err_ioctlreq(b, j);
+		}
+	}
+	ifconfig_batch_free(b);
+	return (error);
+}
+
+static int
+op_batch_1(struct ctx *c, long i)
+{
+
+	return (batch_submit(c, i, 1));
+}
+
+static int
+op_batch_64(struct ctx *c, long i)
+{
+
+	return (batch_submit(c, i, 64));
+}
+
+static int
+op_batch_mixed(struct ctx *c, long i)
+{
+	ifconfig_batch_t *b;
+	int error;
+
+	if ((b = ifconfig_batch_new(c->lifh)) == NULL) {
+		return (-1);
+	}
+	(void)ifconfig_batch_set_mtu(b, c->ifname, 1400 + (i & 1));
+	(void)ifconfig_batch_set_description(b, c->ifname, "apibench");
+	(void)ifconfig_batch_set_name(b, c->ifname, "apibench0");
+	(void)ifconfig_batch_set_name(b, "apibench0", c->ifname);
+	error = ifconfig_batch_submit(b, IFCONFIG_BATCH_ROLLBACK);
+	ifconfig_batch_free(b);
+	return (error);
+}
+
+static int
+op_batch_capability(struct ctx *c, long i __unused)
+{
+	ifconfig_batch_t *b;
+	int error;
+
+	if ((b = ifconfig_batch_new(c->lifh)) == NULL) {
+		return (-1);
+	}
+	(void)ifconfig_batch_set_capability(b, c->ifname, 0);
+	error = ifconfig_batch_submit(b, 0);
+	ifconfig_batch_free(b);
+	return (error);
+}
+
+/* 10.100.0.0/16, one address per iteration. */
+static void
+bench_addr(struct ifconfig_addr *addr, const long i)
+{
+
+	memset(addr, 0, sizeof(*addr));
+	addr->family = AF_INET;
+	addr->prefixlen = 32;
+	addr->addr.in.s_addr = htonl(0x0a640000 | (i & 0xffff));
+}
+
+static int
+op_add_addr(struct ctx *c, long i)
+{
+	struct ifconfig_addr addr;
+
+	bench_addr(&addr, i);
+	return (ifconfig_add_addr(c->lifh, c->ifname, &addr));
+}
+
+static int
+op_delete_addr(struct ctx *c, long i)
+{
+	struct ifconfig_addr addr;
+
+	bench_addr(&addr, i);
+	return (ifconfig_delete_addr(c->lifh, c->ifname, &addr));
+}
+
+static int
+op_get_addrs(struct ctx *c, long i __unused)
+{
+	struct ifconfig_addr *addrs;
+	size_t count;
+
+	if (ifconfig_get_addrs(c->lifh, c->ifname, &addrs, &count) != 0) {
+		return (-1);
+	}
+	free(addrs);
+	return (0);
+}
+
+static int
+batch_addrs(struct ctx *c, const int add)
+{
+	struct ifconfig_addr addr;
+	ifconfig_batch_t *b;
+	int error;
+
+	if ((b = ifconfig_batch_new(c->lifh)) == NULL) {
+		return (-1);
+	}
+	for (long j = 0; j < ADDR_COUNT; j++) {
+		bench_addr(&addr, j);
+		if (add) {
+			(void)ifconfig_batch_add_addr(b, c->ifname, &addr);
+		} else {
+			(void)ifconfig_batch_delete_addr(b, c->ifname, &addr);
+		}
+	}
+	error = ifconfig_batch_submit(b, 0);
+	ifconfig_batch_free(b);
+	return (error);
+}
+
+static int
+op_batch_add_addrs(struct ctx *c, long i __unused)
+{
+
+	return (batch_addrs(c, 1));
+}
+
+static int
+delete_addrs(struct ctx *c, long i __unused)
+{
+
+	return (batch_addrs(c, 0));
+}
+
+static int
+op_watch_open_close(struct ctx *c, long i __unused)
+{
+	ifconfig_watch_t *w;
+
+	if (ifconfig_watch_open(c->lifh, &w) != 0) {
+		return (-1);
+	}
+	ifconfig_watch_close(w);
+	return (0);
+}
+
+static int
+watch_cb(const struct ifconfig_event *event __unused, void *udata __unused)
+{
+
+	return (0);
+}
+
+/* Dispatch with nothing pending: the cost of a spurious wakeup. */
+static int
+op_watch_dispatch(struct ctx *c, long i __unused)
+{
+
+	if (c->watch == NULL && ifconfig_watch_open(c->lifh, &c->watch) != 0) {
+		return (-1);
+	}
+	(void)ifconfig_watch_fd(c->watch);
+	return (ifconfig_watch_dispatch(c->watch, watch_cb, NULL) < 0 ? -1 : 0);
+}
+
+/* Interface changes between two dispatches, as seen by the watcher. */
+static int
+watch_change(struct ctx *c, long i)
+{
+
+	if (c->watch == NULL && ifconfig_watch_open(c->lifh, &c->watch) != 0) {
+		return (-1);
+	}
+	return (op_set_mtu(c, i));
+}
+
+static int
+op_checkpoint_save(struct ctx *c, long i __unused)
+{
+	int fd;
+
+	if (c->ckpt[0] == '\0') {
+		(void)snprintf(c->ckpt, sizeof(c->ckpt),
+		    "/tmp/apibench.XXXXXX");
+		if ((fd = mkstemp(c->ckpt)) == -1) {
+			c->ckpt[0] = '\0';
+			return (-1);
+		}
+		(void)close(fd);
+	}
+	return (ifconfig_checkpoint_save(c->lifh, c->ckpt));
+}
+
+/*
+ * Untimed. With the simulator, the restore goes to an empty one, so every
+ * interface is created; the kernel already has them all.
+ */
+static int
+restore_target(struct ctx *c, long i)
+{
+
+	if (c->ckpt[0] == '\0' && op_checkpoint_save(c, i) != 0) {
+		return (-1);
+	}
+	if (c->sim == NULL) {
+		c->restoreh = c->lifh;
+		return (0);
+	}
+	if ((c->restoresim = ifconfig_sim_new()) == NULL ||
+	    (c->restoreh = ifconfig_open()) == NULL) {
+		return (-1);
+	}
+	return (ifconfig_sim_attach(c->restoreh, c->restoresim));
+}
+
+static int
+op_checkpoint_restore(struct ctx *c, long i __unused)
+{
+
+	return (ifconfig_checkpoint_restore(c->restoreh, c->ckpt));
+}
+
+static int
+restore_teardown(struct ctx *c, long i __unused)
+{
+
+	if (c->restoresim != NULL) {
+		ifconfig_close(c->restoreh);
+		ifconfig_sim_free(c->restoresim);
+	}
+	c->restoreh = NULL;
+	c->restoresim = NULL;
+	return (0);
+}
+
+/* Untimed. The bridge and its would-be members, made once. */
+static int
+bridge_setup(struct ctx *c, long i __unused)
+{
+
+	if (c->bridge[0] != '\0') {
+		return (0);
+	}
+	if (ifconfig_create_interface_r(c->lifh, "bridge", c->bridge,
+	    sizeof(c->bridge)) != 0) {
+		c->bridge[0] = '\0';
+		return (-1);
+	}
+	for (size_t j = 0; j < BULK_COUNT; j++) {
+		if (ifconfig_create_interface_r(c->lifh, portkind, c->ports[j],
+		    sizeof(c->ports[j])) != 0) {
+			return (-1);
+		}
+	}
+	return (0);
+}
+
+static void
+bridge_ports(struct ctx *c, const char **names)
+{
+
+	for (size_t j = 0; j < BULK_COUNT; j++) {
+		names[j] = c->ports[j];
+	}
+}
+
+/* Attaches every port and reads the member list back. */
+static int
+op_bridge_add_members(struct ctx *c, long i __unused)
+{
+	const char *names[BULK_COUNT];
+	char members[BULK_COUNT][IFNAMSIZ];
+	size_t count;
+
+	bridge_ports(c, names);
+	if (ifconfig_bridge_add_members(c->lifh, c->bridge, names, BULK_COUNT,
+	    NULL, members[0], BULK_COUNT, &count) != 0) {
+		return (-1);
+	}
+	c->attached = 1;
+	return (count == BULK_COUNT ? 0 : -1);
+}
+
+static int
+bridge_detach(struct ctx *c, long i __unused)
+{
+	const char *names[BULK_COUNT];
+
+	if (!c->attached) {
+		return (0);
+	}
+	bridge_ports(c, names);
+	c->attached = 0;
+	return (ifconfig_bridge_delete_members(c->lifh, c->bridge, names,
+	    BULK_COUNT, NULL));
+}
+
+static int
+bridge_attach(struct ctx *c, long i)
+{
+
+	if (bridge_setup(c, i) != 0) {
+		return (-1);
+	}
+	return (c->attached ? 0 : op_bridge_add_members(c, i));
+}
+
+static int
+op_bridge_get_members(struct ctx *c, long i __unused)
+{
+	char members[BULK_COUNT][IFNAMSIZ];
+	size_t count;
+
+	if (ifconfig_bridge_get_members(c->lifh, c->bridge, members[0],
+	    BULK_COUNT, &count) != 0) {
+		return (-1);
+	}
+	return (count == BULK_COUNT ? 0 : -1);
+}
+
+static const struct benchcase cases[] = {
+	{ "open_close", NULL, op_open_close, NULL, 1 },
+	{ "open_shared_close", NULL, op_open_shared_close, NULL, 1 },
+	{ "open_get_mtu_close", NULL, op_open_get_mtu_close, NULL, 1 },
+	{ "err_state", NULL, op_err_state, NULL, 1 },
+	{ "cache_flush", NULL, op_cache_flush, NULL, 1 },
+	{ "stats_get", NULL, op_stats_get, NULL, 1 },
+	{ "stats_reset", NULL, op_stats_reset, NULL, 1 },
+	{ "get_mtu", NULL, op_get_mtu, NULL, 1 },
+	{ "get_mtu_cached", attrcache_on, op_get_mtu_cached, NULL, 1 },
+	{ "get_metric", NULL, op_get_metric, NULL, 1 },
+	{ "get_capability", NULL, op_get_capability, NULL, 1 },
+	{ "get_description", NULL, op_get_description, NULL, 1 },
+	{ "get_description_r", NULL, op_get_description_r, NULL, 1 },
+	{ "get_orig_name", NULL, op_get_orig_name, NULL, 1 },
+	{ "get_orig_name_r", NULL, op_get_orig_name_r, NULL, 1 },
+	{ "get_mtu_by_ref", iface_lookup, op_get_mtu_by_ref, NULL, 1 },
+	{ "get_description_r_by_ref", iface_lookup,
+	    op_get_description_r_by_ref, NULL, 1 },
+	{ "get_orig_name_r_by_ref", iface_lookup, op_get_orig_name_r_by_ref,
+	    NULL, 1 },
+	{ "set_mtu", NULL, op_set_mtu, NULL, 1 },
+	{ "set_mtu_by_ref", iface_lookup, op_set_mtu_by_ref, NULL, 1 },
+	{ "async_set_mtu_16", start_async, op_async_set_mtu, NULL,
+	    BULK_COUNT },
+	{ "reconcile_unchanged", reconcile_current, op_reconcile_unchanged,
+	    NULL, 1 },
+	{ "set_metric", NULL, op_set_metric, NULL, 1 },
+	{ "set_capability", NULL, op_set_capability, NULL, 1 },
+	{ "set_capabilities", NULL, op_set_capabilities, NULL, 1 },
+	{ "set_capabilities_bulk_16", NULL, op_set_capabilities_bulk, NULL,
+	    1 },
+	{ "set_description", NULL, op_set_description, NULL, 1 },
+	{ "unset_description", NULL, op_unset_description, NULL, 1 },
+	{ "set_name", NULL, op_set_name, NULL, 1 },
+	{ "create_interface", NULL, op_create_interface, destroy_tmp, 100 },
+	{ "create_interface_r", NULL, create_tmp, destroy_tmp, 100 },
+	{ "destroy_interface", create_tmp, op_destroy_interface, destroy_tmp,
+	    100 },
+	{ "create_interface_vlan", NULL, op_create_interface_vlan, destroy_tmp,
+	    100 },
+	{ "create_interface_vlan_r", NULL, op_create_interface_vlan_r,
+	    destroy_tmp, 100 },
+	{ "set_vlantag", create_vlan_tmp, op_set_vlantag, destroy_tmp,
+	    100 },
+	{ "create_vlans_256", NULL, op_create_vlans, destroy_vlans, 100 },
+	{ "destroy_interfaces_16", create_bulk, op_destroy_interfaces, NULL,
+	    100 },
+	{ "snapshot_take", NULL, op_snapshot_take, NULL, 1 },
+	{ "snapshot_take_all", NULL, op_snapshot_take_all, NULL, 1 },
+	{ "snapshot_read", NULL, op_snapshot_read, NULL, 1 },
+	{ "checkpoint_save", NULL, op_checkpoint_save, NULL, 100 },
+	{ "checkpoint_restore", restore_target, op_checkpoint_restore,
+	    restore_teardown, 100 },
+	{ "bridge_add_members_16", bridge_setup, op_bridge_add_members,
+	    bridge_detach, 10 },
+	{ "bridge_get_members", bridge_attach, op_bridge_get_members, NULL, 1 },
+	{ "counters_read", NULL, op_counters_read, NULL, 1 },
+	{ "sampler_acquire", start_sampler, op_sampler_acquire, NULL, 1 },
+	{ "metrics_write", metrics_sources, op_metrics_write, NULL, 10 },
+	{ "metrics_write_fd", metrics_sources, op_metrics_write_fd, NULL, 10 },
+	{ "batch_1", NULL, op_batch_1, NULL, 1 },
+	{ "batch_64", NULL, op_batch_64, NULL, 10 },
+	{ "batch_mixed", NULL, op_batch_mixed, NULL, 1 },
+	{ "batch_capability", NULL, op_batch_capability, NULL, 1 },
+	{ "add_addr", NULL, op_add_addr, op_delete_addr, 10 },
+	{ "delete_addr", op_add_addr, op_delete_addr, NULL, 10 },
+	{ "get_addrs", NULL, op_get_addrs, NULL, 1 },
+	{ "batch_add_addrs_256", NULL, op_batch_add_addrs, delete_addrs, 100 },
+	{ "watch_open_close", NULL, op_watch_open_close, NULL, 1 },
+	{ "watch_dispatch", NULL, op_watch_dispatch, NULL, 1 },
+	{ "watch_dispatch_change", watch_change, op_watch_dispatch, NULL, 1 },
+};
+
+static int
+cmp_u64(const void *a, const void *b)
+{
+	const uint64_t *x = a, *y = b;
+
+	return ((*x > *y) - (*x < *y));
+}
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+static void
+run(struct ctx *c, const struct benchcase *bc, const long iterations,
+    uint64_t *samples)
+{
+	unsigned long before, ncalls;
+	uint64_t start, total;
+	long errors, n;
+
+	n = iterations / bc->divisor;
+	if (n < 1) {
+		n = 1;
+	}
+	errors = 0;
+	ncalls = 0;
+	total = 0;
+	for (long i = 0; i < n; i++) {
+		if (bc->before != NULL && bc->before(c, i) != 0) {
+			errors++;
+		}
+		before = syscalls;
+		start = now_ns();
+		if (bc->op(c, i) != 0) {
+			errors++;
+		}
+		samples[i] = now_ns() - start;
+		ncalls += syscalls - before;
+		total += samples[i];
+		if (bc->after != NULL) {
+			(void)bc->after(c, i);
+		}
+	}
+
+	qsort(samples, n, sizeof(*samples), cmp_u64);
+	printf("%s\t%ld\t%ld\t%ju\t%ju\t%.0f\t%.2f\n", bc->name, n, errors,
+	    (uintmax_t)samples[n / 2], (uintmax_t)samples[n * 99 / 100],
+	    (double)total / n, (double)ncalls / n);
+	fflush(stdout);
+}
+
+static void
+enter_netns(void)
+{
+
+#if defined(__linux__)
+	if (unshare(CLONE_NEWNET) != 0 &&
+	    unshare(CLONE_NEWUSER | CLONE_NEWNET) != 0) {
+		err(1, "Failed to create a network namespace");
+	}
+#endif
+}
+
+static int
+selected(const char *name, char *argv[], const int argc)
+{
+
+	if (argc == 0) {
+		return (1);
+	}
+	for (int i = 0; i < argc; i++) {
+		if (strcmp(argv[i], name) == 0) {
+			return (1);
+		}
+	}
+	return (0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct ctx c;
+	uint64_t *samples;
+	long iterations, ninterfaces;
+	int ch, netns, sim;
+
+	iterations = 10000;
+	ninterfaces = 0;
+	netns = 1;
+	sim = 0;
+	while ((ch = getopt(argc, argv, "NSi:n:")) != -1) {
+		switch (ch) {
+		case 'N':
+			netns = 0;
+			break;
+		case 'S':
+			sim = 1;
+			break;
+		case 'n':
+			ninterfaces = strtol(optarg, NULL, 10);
+			break;
+		case 'i':
+			iterations = strtol(optarg, NULL, 10);
+			break;
+		default:
+			fprintf(stderr,
+			    "usage: apibench [-N] [-S [-n interfaces]] "
+			    "[-i iterations] [case ...]\n");
+			return (1);
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (iterations < 1) {
+		errx(1, "Invalid iteration count.");
+	}
+
+	memset(&c, 0, sizeof(c));
+	c.devnull = -1;
+	if (sim) {
+		if ((c.sim = ifconfig_sim_new()) == NULL ||
+		    ifconfig_sim_populate(c.sim, "ix", ninterfaces) != 0) {
+			errx(ENOMEM, "Failed to set up the simulated kernel.");
+		}
+	} else if (netns) {
+		enter_netns();
+	}
+
+	if ((c.lifh = bench_open(&c, 0)) == NULL) {
+		errx(ENOMEM, "Failed to open libifconfig handle.");
+	}
+	samples = calloc(iterations, sizeof(*samples));
+	if (samples == NULL) {
+		errx(ENOMEM, "Out of memory.");
+	}
+
+	/* The interface to work on, and how to make more of them. */
+	for (size_t i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++) {
+		if (ifconfig_create_interface_r(c.lifh, kinds[i], c.ifname,
+		    sizeof(c.ifname)) == 0) {
+			c.kind = kinds[i];
+			break;
+		}
+	}
+	if (c.kind == NULL) {
+		errx(1, "Failed to create an interface to benchmark with. "
+		    "Error code: %i.", ifconfig_err_errno(c.lifh));
+	}
+	(void)ifconfig_set_description(c.lifh, c.ifname, "apibench");
+
+	printf("# interface=%s kind=%s backend=%s\n", c.ifname, c.kind,
+	    sim ? "sim" : "kernel");
+	printf("#case\titerations\terrors\tp50_ns\tp99_ns\tmean_ns\t"
+	    "syscalls_per_op\n");
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		if (selected(cases[i].name, argv, argc)) {
+			run(&c, &cases[i], iterations, samples);
+		}
+	}
+
+	if (c.watch != NULL) {
+		ifconfig_watch_close(c.watch);
+	}
+	if (c.cached != NULL) {
+		ifconfig_close(c.cached);
+	}
+	ifconfig_iface_free(c.iface);
+	ifconfig_async_free(c.async);
+	ifconfig_reconcile_free(c.reconcile);
+	if (c.ckpt[0] != '\0') {
+		(void)unlink(c.ckpt);
+	}
+	ifconfig_snapshot_free(c.snap);
+	ifconfig_counters_free(c.counters);
+	ifconfig_sampler_stop(c.sampler);
+	ifconfig_metrics_free(c.metrics);
+	if (c.devnull != -1) {
+		(void)close(c.devnull);
+	}
+	(void)destroy_tmp(&c, 0);
+	if (c.bridge[0] != '\0') {
+		(void)ifconfig_destroy_interface(c.lifh, c.bridge);
+		for (size_t i = 0; i < BULK_COUNT; i++) {
+			if (c.ports[i][0] != '\0') {
+				(void)ifconfig_destroy_interface(c.lifh,
+				    c.ports[i]);
+			}
+		}
+	}
+	(void)ifconfig_destroy_interface(c.lifh, c.ifname);
+	ifconfig_close(c.lifh);
+	ifconfig_sim_free(c.sim);
+	free(samples);
+	return (0);
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2016-2017, Marie Helene Kvello-Aune
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * thislist of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+
+/*
+ * Per-request handle benchmark: the cost of an ifconfig_open(), one
+ * getter and ifconfig_close(), next to the same getter on a handle that
+ * is kept open.
+ *
+ * Usage: openclose [interface [iterations]]
+ */
+
+#include <err.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <libifconfig.h>
+
+#if defined(__linux__)
+#define DEFAULT_IFNAME	"lo"
+#else
+#define DEFAULT_IFNAME	"lo0"
+#endif
+
+static const char *ifname = DEFAULT_IFNAME;
+
+static void
+getmtu(ifconfig_handle_t *lifh)
+{
+	int mtu;
+
+	if (ifconfig_get_mtu(lifh, ifname, &mtu) != 0) {
+		errx(EIO, "Request failed. Error code: %i.",
+		    ifconfig_err_errno(lifh));
+	}
+}
+
+static ifconfig_handle_t *
+open_handle(void)
+{
+	ifconfig_handle_t *lifh;
+
+	lifh = ifconfig_open();
+	if (lifh == NULL) {
+		errx(ENOMEM, "Failed to open libifconfig handle.");
+	}
+	return (lifh);
+}
+
+static double
+elapsed_ns(const struct timespec *start, const struct timespec *end)
+{
+
+	return ((end->tv_sec - start->tv_sec) * 1e9 +
+	    (end->tv_nsec - start->tv_nsec));
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct timespec start, end;
+	ifconfig_handle_t *lifh;
+	long iterations;
+
+	if (argc > 1) {
+		ifname = argv[1];
+	}
+	iterations = (argc > 2) ? strtol(argv[2], NULL, 10) : 100000;
+
+	/* Warm up whatever is shared between handles. */
+	lifh = open_handle();
+	getmtu(lifh);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (long i = 0; i < iterations; i++) {
+		ifconfig_close(open_handle());
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("%-20s %10.0f ns/op\n", "open/close",
+	    elapsed_ns(&start, &end) / iterations);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (long i = 0; i < iterations; i++) {
+		ifconfig_handle_t *tmp;
+
+		tmp = open_handle();
+		getmtu(tmp);
+		ifconfig_close(tmp);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("%-20s %10.0f ns/op\n", "open/get_mtu/close",
+	    elapsed_ns(&start, &end) / iterations);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (long i = 0; i < iterations; i++) {
+		getmtu(lifh);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("%-20s %10.0f ns/op\n", "get_mtu (kept open)",
+	    elapsed_ns(&start, &end) / iterations);
+
+	ifconfig_close(lifh);
+	return (0);
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2016-2017, Marie Helene Kvello-Aune
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * thislist of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * Contention benchmark: N threads hammer one getter, either each on its
+ * own state object or all on one from ifconfig_open_shared().
+ *
+ * Usage: sharedhandle [interface [seconds [mtu|metric]]]
+ */
+
+#include <err.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <libifconfig.h>
+
+#if defined(__linux__)
+#define DEFAULT_IFNAME	"lo"
+#else
+#define DEFAULT_IFNAME	"lo0"
+#endif
+
+struct worker {
+	pthread_t thread;
+	ifconfig_handle_t *lifh;
+	unsigned long ops;
+};
+
+static const char *ifname = DEFAULT_IFNAME;
+static int usemetric;
+static volatile int stop;
+
+static void *
+work(void *arg)
+{
+	struct worker *w;
+	int value;
+
+	w = arg;
+	while (!stop) {
+		if ((usemetric ? ifconfig_get_metric(w->lifh, ifname, &value) :
+		    ifconfig_get_mtu(w->lifh, ifname, &value)) != 0) {
+			errx(EIO, "Request failed. Error code: %i.",
+			    ifconfig_err_errno(w->lifh));
+		}
+		w->ops++;
+	}
+	return (NULL);
+}
+
+static double
+run(const int nthreads, const int shared, const double seconds)
+{
+	struct worker *workers;
+	struct timespec start, end;
+	ifconfig_handle_t *sharedh;
+	unsigned long ops;
+	double elapsed;
+
+	workers = calloc(nthreads, sizeof(*workers));
+	if (workers == NULL) {
+		errx(ENOMEM, "Out of memory.");
+	}
+
+	sharedh = shared ? ifconfig_open_shared() : NULL;
+	for (int i = 0; i < nthreads; i++) {
+		workers[i].lifh = shared ? sharedh : ifconfig_open();
+		if (workers[i].lifh == NULL) {
+			errx(ENOMEM, "Failed to open libifconfig handle.");
+		}
+	}
+
+	stop = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < nthreads; i++) {
+		pthread_create(&workers[i].thread, NULL, work, &workers[i]);
+	}
+	nanosleep(&(struct timespec){ (time_t)seconds,
+	    (long)((seconds - (time_t)seconds) * 1e9) }, NULL);
+	stop = 1;
+
+	ops = 0;
+	for (int i = 0; i < nthreads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		ops += workers[i].ops;
+		if (!shared) {
+			ifconfig_close(workers[i].lifh);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if (shared) {
+		ifconfig_close(sharedh);
+	}
+	free(workers);
+
+	elapsed = (end.tv_sec - start.tv_sec) +
+	    (end.tv_nsec - start.tv_nsec) / 1e9;
+	return (ops / elapsed);
+}
+
+int
+main(int argc, char *argv[])
+{
+	double seconds;
+
+	if (argc > 1) {
+		ifname = argv[1];
+	}
+	seconds = (argc > 2) ? strtod(argv[2], NULL) : 1.0;
+	usemetric = (argc > 3) && strcmp(argv[3], "metric") == 0;
+
+	printf("%-8s %8s %14s %14s\n", "threads", "op", "per-thread/s",
+	    "shared/s");
+	for (int n = 1; n <= 32; n *= 2) {
+		printf("%-8d %8s %14.0f %14.0f\n", n,
+		    usemetric ? "metric" : "mtu", run(n, 0, seconds),
+		    run(n, 1, seconds));
+		fflush(stdout);
+	}
+	return (0);
+}
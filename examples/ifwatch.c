@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2016-2017, Marie Helene Kvello-Aune
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * thislist of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#include <err.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <libifconfig.h>
+
+
+static int
+print_event(const struct ifconfig_event *ev, void *udata)
+{
+
+	(void)udata;
+	printf("%s (index %u):", ev->name, ev->index);
+	if (ev->events & IFCONFIG_EVENT_ADD) {
+		printf(" added");
+	}
+	if (ev->events & IFCONFIG_EVENT_REMOVE) {
+		printf(" removed");
+	}
+	if (ev->events & IFCONFIG_EVENT_RENAME) {
+		printf(" renamed from %s", ev->oldname);
+	}
+	if (ev->events & IFCONFIG_EVENT_MTU) {
+		printf(" mtu %d", ev->mtu);
+	}
+	if (ev->events & IFCONFIG_EVENT_FLAGS) {
+		printf(" flags %#x", ev->flags);
+	}
+	printf("\n");
+	return (0);
+}
+
+int
+main(void)
+{
+	ifconfig_handle_t *lifh;
+	ifconfig_watch_t *watch;
+	struct pollfd pfd;
+	int error;
+
+	lifh = ifconfig_open();
+	if (lifh == NULL) {
+		errx(ENOMEM, "Failed to open libifconfig handle.");
+		return (-1);
+	}
+
+	if (ifconfig_watch_open(lifh, &watch) != 0) {
+		error = ifconfig_err_errno(lifh);
+		ifconfig_close(lifh);
+		errx(error, "Failed to start watching.");
+	}
+
+	pfd.fd = ifconfig_watch_fd(watch);
+	pfd.events = POLLIN;
+	while (poll(&pfd, 1, -1) > 0) {
+		if (ifconfig_watch_dispatch(watch, print_event, NULL) < 0) {
+			warnx("Failed to read interface changes. Error code: %i.",
+			    ifconfig_err_errno(lifh));
+			break;
+		}
+		fflush(stdout);
+	}
+
+	ifconfig_watch_close(watch);
+	ifconfig_close(lifh);
+	return (-1);
+}
@@ -20,6 +20,23 @@ DEFINES += QT_DEPRECATED_WARNINGS
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 # Input
-HEADERS += src/libifconfig.h src/libifconfig_internal.h
+HEADERS += src/libifconfig.h src/libifconfig.hpp src/libifconfig_internal.h
 SOURCES += src/libifconfig.c \
-           src/libifconfig_internal.c
+           src/libifconfig_internal.c \
+           src/libifconfig_snapshot.c \
+           src/libifconfig_batch.c \
+           src/libifconfig_destroy.c \
+           src/libifconfig_async.c \
+           src/libifconfig_reconcile.c \
+           src/libifconfig_checkpoint.c \
+           src/libifconfig_bridge.c \
+           src/libifconfig_counters.c \
+           src/libifconfig_sampler.c \
+           src/libifconfig_metrics.c \
+           src/libifconfig_capability.c \
+           src/libifconfig_cache.c \
+           src/libifconfig_watch.c \
+           src/libifconfig_stats.c \
+           src/libifconfig_sim.c \
+           src/libifconfig_freebsd.c \
+           src/libifconfig_linux.c
@@ -32,21 +32,19 @@
 
 #include <sys/types.h>
 #include <sys/ioctl.h>
-#include <sys/sysctl.h>
+#include <sys/socket.h>
 
 #include <net/if.h>
-#include <net/if_mib.h>
 
 #include <err.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
-#include <net/if_vlan_var.h>
-
 #include "libifconfig.h"
 #include "libifconfig_internal.h"
 
@@ -62,10 +60,25 @@ ifconfig_open(void)
 	if (h == NULL) {
 		return (NULL);
 	}
-	for (int i = 0; i <= AF_MAX; i++) {
-		h->sockets[i] = -1;
-	}
+	h->backend = IFCONFIG_DEFAULT_BACKEND;
+	h->privsock = -1;
+	ifconfig_sockpool_ref();
+	ifconfig_cache_init(h);
+	(void)pthread_mutex_init(&h->lock, NULL);
+	(void)pthread_mutex_init(&h->cachelock, NULL);
+
+	return (h);
+}
+
+ifconfig_handle_t *
+ifconfig_open_shared(void)
+{
+	ifconfig_handle_t *h;
 
+	h = ifconfig_open();
+	if (h != NULL) {
+		h->shared = 1;
+	}
 	return (h);
 }
 
@@ -73,11 +86,10 @@ void
 ifconfig_close(ifconfig_handle_t *h)
 {
 
-	for (int i = 0; i <= AF_MAX; i++) {
-		if (h->sockets[i] != -1) {
-			(void)close(h->sockets[i]);
-		}
-	}
+	ifconfig_sockpool_unref(h);
+	ifconfig_cache_fini(h);
+	(void)pthread_mutex_destroy(&h->lock);
+	(void)pthread_mutex_destroy(&h->cachelock);
 	free(h);
 }
 
@@ -85,83 +97,165 @@ ifconfig_errtype
 ifconfig_err_errtype(ifconfig_handle_t *h)
 {
 
-	return (h->error.errtype);
+	return (ifconfig_errstate(h)->errtype);
 }
 
 int
 ifconfig_err_errno(ifconfig_handle_t *h)
 {
 
-	return (h->error.errcode);
+	return (ifconfig_errstate(h)->errcode);
 }
 
 unsigned long
 ifconfig_err_ioctlreq(ifconfig_handle_t *h)
 {
 
-	return (h->error.ioctl_request);
+	return (ifconfig_errstate(h)->ioctl_request);
 }
 
-int
-ifconfig_get_description(ifconfig_handle_t *h, const char *name,
-    char **description)
+/* Starts a request for the interface called name. */
+static void
+req_init(struct ifconfig_req *req, const char *name)
 {
-	struct ifreq ifr;
-	char *descr;
-	size_t descrlen;
 
-	descr = NULL;
-	descrlen = 64;
-	memset(&ifr, 0, sizeof(ifr));
-	(void)strlcpy(ifr.ifr_name, name, sizeof(ifr.ifr_name));
+	memset(req, 0, sizeof(*req));
+	(void)strlcpy(req->ifcr_name, name, sizeof(req->ifcr_name));
+}
 
-	for (;;) {
-		if ((descr = reallocf(descr, descrlen)) == NULL) {
-			h->error.errtype = OTHER;
-			h->error.errcode = ENOMEM;
-			return (-1);
+/*
+ * Reads the description of the interface req is for into buf. If it
+ * doesn't fit, fails with ERANGE and sets *needed to the size the kernel
+ * asked for. Only req's buffer is changed, so it can be reused.
+ */
+static int
+get_description(ifconfig_handle_t *h, struct ifconfig_req *req,
+    char *buf, size_t len, size_t *needed)
+{
+
+	req->ifcr_buffer.buffer = buf;
+	req->ifcr_buffer.length = len;
+	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCGIFDESCR, req) != 0) {
+		/* FreeBSD's way of saying there is no description. */
+		if (ifconfig_errstate(h)->errcode == ENOMSG) {
+			goto none;
 		}
+		return (-1);
+	}
 
-		ifr.ifr_buffer.buffer = descr;
-		ifr.ifr_buffer.length = descrlen;
-		if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCGIFDESCR, &ifr) != 0) {
-			free(descr);
-			return (-1);
+	if (req->ifcr_buffer.buffer == buf) {
+		if (len > 0 && buf[0] != '\0') {
+			return (0);
 		}
+	} else if (req->ifcr_buffer.length > len) {
+		*needed = req->ifcr_buffer.length;
+		ifconfig_errstate(h)->errtype = OTHER;
+		ifconfig_errstate(h)->errcode = ERANGE;
+		return (-1);
+	}
 
-		if (ifr.ifr_buffer.buffer == descr) {
-			if (strlen(descr) > 0) {
-				*description = strdup(descr);
-				free(descr);
+none:
+	/* No description set. */
+	ifconfig_errstate(h)->errtype = OTHER;
+	ifconfig_errstate(h)->errcode = 0;
+	return (-1);
+}
 
-				if (description == NULL) {
-					h->error.errtype = OTHER;
-					h->error.errcode = ENOMEM;
-					return (-1);
-				}
+int
+ifconfig_get_description(ifconfig_handle_t *h, const char *name,
+    char **description)
+{
+	struct ifconfig_req req;
+	char buf[128], *descr;
+	size_t descrlen;
+	int error;
 
+	req_init(&req, name);
+	descrlen = sizeof(buf);
+	if (get_description(h, &req, buf, sizeof(buf), &descrlen) == 0) {
+		descr = buf;
+	} else if (ifconfig_errstate(h)->errcode != ERANGE) {
+		return (-1);
+	} else {
+		/* Rare: longer than the stack buffer. */
+		for (descr = NULL;;) {
+			if ((descr = reallocf(descr, descrlen)) == NULL) {
+				ifconfig_errstate(h)->errtype = OTHER;
+				ifconfig_errstate(h)->errcode = ENOMEM;
+				return (-1);
+			}
+			error = get_description(h, &req, descr, descrlen,
+			    &descrlen);
+			if (error == 0) {
+				*description = descr;
 				return (0);
 			}
-		} else if (ifr.ifr_buffer.length > descrlen) {
-			descrlen = ifr.ifr_buffer.length;
-			continue;
+			if (ifconfig_errstate(h)->errcode != ERANGE) {
+				free(descr);
+				return (-1);
+			}
 		}
-		break;
 	}
-	free(descr);
-	h->error.errtype = OTHER;
-	h->error.errcode = 0;
-	return (-1);
+
+	*description = strdup(descr);
+	if (*description == NULL) {
+		ifconfig_errstate(h)->errtype = OTHER;
+		ifconfig_errstate(h)->errcode = ENOMEM;
+		return (-1);
+	}
+	return (0);
 }
 
 int
-ifconfig_set_description(ifconfig_handle_t *h, const char *name,
+ifconfig_get_description_r(ifconfig_handle_t *h, const char *name, char *buf,
+    size_t len)
+{
+	struct ifconfig_req req;
+	size_t needed;
+
+	req_init(&req, name);
+	return (get_description(h, &req, buf, len, &needed));
+}
+
+int
+ifconfig_read_description(ifconfig_handle_t *h, const char *name, char *buf,
+    size_t len, char **alloc, const char **descr)
+{
+
+	*alloc = NULL;
+	*descr = NULL;
+	if (ifconfig_get_description_r(h, name, buf, len) == 0) {
+		*descr = buf;
+		return (0);
+	}
+	if (ifconfig_errstate(h)->errcode == ERANGE &&
+	    ifconfig_get_description(h, name, alloc) == 0) {
+		*descr = *alloc;
+		return (0);
+	}
+	/* The getters fail with errno 0 if there is no description. */
+	return (ifconfig_errstate(h)->errcode == 0 ? 0 : -1);
+}
+
+static int
+unset_description(ifconfig_handle_t *h, struct ifconfig_req *req)
+{
+
+	req->ifcr_buffer.length = 0;
+	req->ifcr_buffer.buffer = NULL;
+
+	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCSIFDESCR, req) < 0) {
+		return (-1);
+	}
+	return (0);
+}
+
+static int
+set_description(ifconfig_handle_t *h, struct ifconfig_req *req,
     const char *newdescription)
 {
-	struct ifreq ifr;
 	int desclen;
 
-	memset(&ifr, 0, sizeof(ifr));
 	desclen = strlen(newdescription);
 
 	/*
@@ -169,237 +263,447 @@ ifconfig_set_description(ifconfig_handle_t *h, const char *name,
 	 * TODO: Decide whether this should be an error condition instead.
 	 */
 	if (desclen == 0) {
-		return (ifconfig_unset_description(h, name));
+		return (unset_description(h, req));
 	}
 
-	(void)strlcpy(ifr.ifr_name, name, sizeof(ifr.ifr_name));
-	ifr.ifr_buffer.length = desclen + 1;
-	ifr.ifr_buffer.buffer = strdup(newdescription);
+	req->ifcr_buffer.length = desclen + 1;
+	/* Only read by SIOCSIFDESCR. */
+	req->ifcr_buffer.buffer = (char *)(uintptr_t)newdescription;
 
-	if (ifr.ifr_buffer.buffer == NULL) {
-		h->error.errtype = OTHER;
-		h->error.errcode = ENOMEM;
+	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCSIFDESCR, req) != 0) {
 		return (-1);
 	}
+	return (0);
+}
 
-	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCSIFDESCR, &ifr) != 0) {
-		free(ifr.ifr_buffer.buffer);
-		return (-1);
-	}
+int
+ifconfig_set_description(ifconfig_handle_t *h, const char *name,
+    const char *newdescription)
+{
+	struct ifconfig_req req;
 
-	free(ifr.ifr_buffer.buffer);
-	return (0);
+	req_init(&req, name);
+	return (set_description(h, &req, newdescription));
 }
 
 int
 ifconfig_unset_description(ifconfig_handle_t *h, const char *name)
 {
-	struct ifreq ifr;
+	struct ifconfig_req req;
 
-	memset(&ifr, 0, sizeof(ifr));
-	(void)strlcpy(ifr.ifr_name, name, sizeof(ifr.ifr_name));
-	ifr.ifr_buffer.length = 0;
-	ifr.ifr_buffer.buffer = NULL;
+	req_init(&req, name);
+	return (unset_description(h, &req));
+}
 
-	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCSIFDESCR, &ifr) < 0) {
+int
+ifconfig_set_name(ifconfig_handle_t *h, const char *name, const char *newname)
+{
+	struct ifconfig_req req;
+
+	req_init(&req, name);
+	(void)strlcpy(req.ifcr_newname, newname, sizeof(req.ifcr_newname));
+	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCSIFNAME, &req) != 0) {
 		return (-1);
 	}
 	return (0);
 }
 
 int
-ifconfig_set_name(ifconfig_handle_t *h, const char *name, const char *newname)
+ifconfig_get_orig_name(ifconfig_handle_t *h, const char *ifname,
+    char **orig_name)
 {
-	struct ifreq ifr;
-	char *tmpname;
+	char buf[IFCONFIG_DRIVERNAMSIZ];
 
-	memset(&ifr, 0, sizeof(ifr));
-	tmpname = strdup(newname);
-	if (tmpname == NULL) {
-		h->error.errtype = OTHER;
-		h->error.errcode = ENOMEM;
+	if (ifconfig_get_orig_name_r(h, ifname, buf, sizeof(buf)) != 0) {
 		return (-1);
 	}
 
-	(void)strlcpy(ifr.ifr_name, name, sizeof(ifr.ifr_name));
-	ifr.ifr_data = tmpname;
-	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCSIFNAME, &ifr) != 0) {
-		free(tmpname);
+	*orig_name = strdup(buf);
+	if (*orig_name == NULL) {
+		ifconfig_errstate(h)->errtype = OTHER;
+		ifconfig_errstate(h)->errcode = ENOMEM;
 		return (-1);
 	}
-
-	free(tmpname);
 	return (0);
 }
 
 int
-ifconfig_get_orig_name(ifconfig_handle_t *h, const char *ifname,
-    char **orig_name)
+ifconfig_get_orig_name_r(ifconfig_handle_t *h, const char *ifname, char *buf,
+    size_t len)
 {
-	size_t len;
 	unsigned int ifindex;
-	int name[6];
 
-	ifindex = if_nametoindex(ifname);
-	if (ifindex == 0)
-		goto fail;
-
-	name[0] = CTL_NET;
-	name[1] = PF_LINK;
-	name[2] = NETLINK_GENERIC;
-	name[3] = IFMIB_IFDATA;
-	name[4] = ifindex;
-	name[5] = IFDATA_DRIVERNAME;
+	if (ifconfig_nametoindex(h, ifname, &ifindex) != 0) {
+		return (-1);
+	}
 
-	len = 0;
-	if (sysctl(name, 6, NULL, &len, 0, 0) < 0)
-		goto fail;
+	return (ifconfig_get_drivername(h, ifindex, buf, len));
+}
 
-	*orig_name = malloc(len);
-	if (*orig_name == NULL)
-		goto fail;
+static int
+set_mtu(ifconfig_handle_t *h, struct ifconfig_req *req, const int mtu)
+{
 
-	if (sysctl(name, 6, *orig_name, &len, 0, 0) < 0) {
-		free(*orig_name);
-		*orig_name = NULL;
-		goto fail;
+	req->ifcr_mtu = mtu;
+	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCSIFMTU, req) < 0) {
+		return (-1);
 	}
-
 	return (0);
-
-fail:
-	h->error.errtype = OTHER;
-	h->error.errcode = (errno != 0) ? errno : ENOENT;
-	return (-1);
 }
 
 int
 ifconfig_set_mtu(ifconfig_handle_t *h, const char *name, const int mtu)
 {
-	struct ifreq ifr;
+	struct ifconfig_req req;
 
-	memset(&ifr, 0, sizeof(ifr));
-	(void)strlcpy(ifr.ifr_name, name, sizeof(ifr.ifr_name));
-	ifr.ifr_mtu = mtu;
+	req_init(&req, name);
+	return (set_mtu(h, &req, mtu));
+}
+
+static int
+get_mtu(ifconfig_handle_t *h, struct ifconfig_req *req, int *mtu)
+{
 
-	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCSIFMTU, &ifr) < 0) {
+	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCGIFMTU, req) == -1) {
 		return (-1);
 	}
-
+	*mtu = req->ifcr_mtu;
 	return (0);
 }
 
 int
 ifconfig_get_mtu(ifconfig_handle_t *h, const char *name, int *mtu)
 {
-	struct ifreq ifr;
+	struct ifconfig_req req;
 
-	memset(&ifr, 0, sizeof(ifr));
-	(void)strlcpy(ifr.ifr_name, name, sizeof(ifr.ifr_name));
+	req_init(&req, name);
+	return (get_mtu(h, &req, mtu));
+}
+
+static int
+set_metric(ifconfig_handle_t *h, struct ifconfig_req *req, const int metric)
+{
 
-	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCGIFMTU, &ifr) == -1) {
+	req->ifcr_metric = metric;
+	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCSIFMETRIC, req) < 0) {
 		return (-1);
 	}
-
-	*mtu = ifr.ifr_mtu;
 	return (0);
 }
 
 int
 ifconfig_set_metric(ifconfig_handle_t *h, const char *name, const int mtu)
 {
-	struct ifreq ifr;
+	struct ifconfig_req req;
 
-	memset(&ifr, 0, sizeof(ifr));
-	(void)strlcpy(ifr.ifr_name, name, sizeof(ifr.ifr_name));
-	ifr.ifr_mtu = mtu;
+	req_init(&req, name);
+	return (set_metric(h, &req, mtu));
+}
 
-	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCSIFMETRIC, &ifr) < 0) {
+static int
+get_metric(ifconfig_handle_t *h, struct ifconfig_req *req, int *metric)
+{
+
+	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCGIFMETRIC, req) == -1) {
 		return (-1);
 	}
-
+	*metric = req->ifcr_metric;
 	return (0);
 }
 
 int
 ifconfig_get_metric(ifconfig_handle_t *h, const char *name, int *metric)
 {
-	struct ifreq ifr;
-
-	memset(&ifr, 0, sizeof(ifr));
-	(void)strlcpy(ifr.ifr_name, name, sizeof(ifr.ifr_name));
+	struct ifconfig_req req;
 
-	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCGIFMETRIC, &ifr) == -1) {
-		return (-1);
-	}
-
-	*metric = ifr.ifr_metric;
-	return (0);
+	req_init(&req, name);
+	return (get_metric(h, &req, metric));
 }
 
 int
 ifconfig_set_capability(ifconfig_handle_t *h, const char *name,
     const int capability)
 {
-	struct ifreq ifr;
-	struct ifconfig_capabilities ifcap;
-	int flags, value;
 
-	memset(&ifr, 0, sizeof(ifr));
+	if (capability < 0) {
+		return (ifconfig_set_capabilities(h, name, 0, -capability));
+	}
+	return (ifconfig_set_capabilities(h, name, capability, 0));
+}
+
+static int
+get_capability(ifconfig_handle_t *h, struct ifconfig_req *req,
+    struct ifconfig_capabilities *capability)
+{
 
-	if (ifconfig_get_capability(h, name, &ifcap) != 0) {
+	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCGIFCAP, req) < 0) {
 		return (-1);
 	}
+	capability->curcap = req->ifcr_curcap;
+	capability->reqcap = req->ifcr_reqcap;
+	return (0);
+}
 
-	value = capability;
-	flags = ifcap.curcap;
-	if (value < 0) {
-		value = -value;
-		flags &= ~value;
-	} else {
-		flags |= value;
+static int
+set_capabilities(ifconfig_handle_t *h, struct ifconfig_req *req,
+    const int set, const int clear)
+{
+	struct ifconfig_capabilities ifcap;
+	int flags;
+
+	if (get_capability(h, req, &ifcap) != 0) {
+		return (-1);
 	}
-	flags &= ifcap.reqcap;
 
-	(void)strlcpy(ifr.ifr_name, name, sizeof(ifr.ifr_name));
+	flags = ifconfig_capmerge(&ifcap, set, clear);
+	if (flags == ifcap.curcap) {
+		return (0);
+	}
 
 	/*
-	 * TODO: Verify that it's safe to not have ifr.ifr_curcap
-	 * set for this request.
+	 * SIOCSIFCAP only reads ifr_reqcap, which drivers compare against
+	 * their enabled capabilities; ifr_curcap is ignored.
 	 */
-	ifr.ifr_reqcap = flags;
-	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCSIFCAP, &ifr) < 0) {
+	req->ifcr_reqcap = flags;
+	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCSIFCAP, req) < 0) {
 		return (-1);
 	}
 	return (0);
 }
 
+int
+ifconfig_set_capabilities(ifconfig_handle_t *h, const char *name,
+    const int set, const int clear)
+{
+	struct ifconfig_req req;
+
+	req_init(&req, name);
+	return (set_capabilities(h, &req, set, clear));
+}
+
 int
 ifconfig_get_capability(ifconfig_handle_t *h, const char *name,
     struct ifconfig_capabilities *capability)
 {
-	struct ifreq ifr;
+	struct ifconfig_req req;
 
-	memset(&ifr, 0, sizeof(ifr));
-	(void)strlcpy(ifr.ifr_name, name, sizeof(ifr.ifr_name));
+	req_init(&req, name);
+	return (get_capability(h, &req, capability));
+}
+
+/*
+ * A reference is the request every call on the interface starts from,
+ * with the name and index filled in.
+ */
+struct ifconfig_iface {
+	struct ifconfig_req req;
+};
 
-	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCGIFCAP, &ifr) < 0) {
+static int
+iface_new(ifconfig_handle_t *h, const char *name, const unsigned int ifindex,
+    ifconfig_iface_t **ifp)
+{
+	struct ifconfig_iface *iface;
+
+	if ((iface = malloc(sizeof(*iface))) == NULL) {
+		ifconfig_errstate(h)->errtype = OTHER;
+		ifconfig_errstate(h)->errcode = ENOMEM;
 		return (-1);
 	}
-	capability->curcap = ifr.ifr_curcap;
-	capability->reqcap = ifr.ifr_reqcap;
+	req_init(&iface->req, name);
+	iface->req.ifcr_index = ifindex;
+	*ifp = iface;
 	return (0);
 }
 
+int
+ifconfig_iface_lookup(ifconfig_handle_t *h, const char *name,
+    ifconfig_iface_t **ifp)
+{
+	unsigned int ifindex;
+
+	if (strlen(name) >= IFNAMSIZ) {
+		ifconfig_errstate(h)->errtype = OTHER;
+		ifconfig_errstate(h)->errcode = ENAMETOOLONG;
+		return (-1);
+	}
+	if (ifconfig_nametoindex(h, name, &ifindex) != 0) {
+		return (-1);
+	}
+	return (iface_new(h, name, ifindex, ifp));
+}
+
+int
+ifconfig_iface_lookup_index(ifconfig_handle_t *h, const unsigned int ifindex,
+    ifconfig_iface_t **ifp)
+{
+	char name[IFNAMSIZ];
+
+	if (ifconfig_indextoname(h, ifindex, name) != 0) {
+		return (-1);
+	}
+	return (iface_new(h, name, ifindex, ifp));
+}
+
+void
+ifconfig_iface_free(ifconfig_iface_t *ifp)
+{
+
+	free(ifp);
+}
+
+const char *
+ifconfig_iface_name(const ifconfig_iface_t *ifp)
+{
+
+	return (ifp->req.ifcr_name);
+}
+
+unsigned int
+ifconfig_iface_index(const ifconfig_iface_t *ifp)
+{
+
+	return (ifp->req.ifcr_index);
+}
+
+int
+ifconfig_get_mtu_by_ref(ifconfig_handle_t *h, const ifconfig_iface_t *ifp,
+    int *mtu)
+{
+	struct ifconfig_req req;
+
+	req = ifp->req;
+	return (get_mtu(h, &req, mtu));
+}
+
+int
+ifconfig_set_mtu_by_ref(ifconfig_handle_t *h, const ifconfig_iface_t *ifp,
+    const int mtu)
+{
+	struct ifconfig_req req;
+
+	req = ifp->req;
+	return (set_mtu(h, &req, mtu));
+}
+
+int
+ifconfig_get_metric_by_ref(ifconfig_handle_t *h, const ifconfig_iface_t *ifp,
+    int *metric)
+{
+	struct ifconfig_req req;
+
+	req = ifp->req;
+	return (get_metric(h, &req, metric));
+}
+
+int
+ifconfig_set_metric_by_ref(ifconfig_handle_t *h, const ifconfig_iface_t *ifp,
+    const int metric)
+{
+	struct ifconfig_req req;
+
+	req = ifp->req;
+	return (set_metric(h, &req, metric));
+}
+
+int
+ifconfig_get_capability_by_ref(ifconfig_handle_t *h,
+    const ifconfig_iface_t *ifp, struct ifconfig_capabilities *capability)
+{
+	struct ifconfig_req req;
+
+	req = ifp->req;
+	return (get_capability(h, &req, capability));
+}
+
+int
+ifconfig_set_capabilities_by_ref(ifconfig_handle_t *h,
+    const ifconfig_iface_t *ifp, const int set, const int clear)
+{
+	struct ifconfig_req req;
+
+	req = ifp->req;
+	return (set_capabilities(h, &req, set, clear));
+}
+
+int
+ifconfig_get_description_r_by_ref(ifconfig_handle_t *h,
+    const ifconfig_iface_t *ifp, char *buf, size_t len)
+{
+	struct ifconfig_req req;
+	size_t needed;
+
+	req = ifp->req;
+	return (get_description(h, &req, buf, len, &needed));
+}
+
+int
+ifconfig_set_description_by_ref(ifconfig_handle_t *h,
+    const ifconfig_iface_t *ifp, const char *newdescription)
+{
+	struct ifconfig_req req;
+
+	req = ifp->req;
+	return (set_description(h, &req, newdescription));
+}
+
+int
+ifconfig_unset_description_by_ref(ifconfig_handle_t *h,
+    const ifconfig_iface_t *ifp)
+{
+	struct ifconfig_req req;
+
+	req = ifp->req;
+	return (unset_description(h, &req));
+}
+
+int
+ifconfig_get_orig_name_r_by_ref(ifconfig_handle_t *h,
+    const ifconfig_iface_t *ifp, char *buf, size_t len)
+{
+
+	return (ifconfig_get_drivername(h, ifp->req.ifcr_index, buf, len));
+}
+
 int
 ifconfig_destroy_interface(ifconfig_handle_t *h, const char *name)
 {
-	struct ifreq ifr;
+	struct ifconfig_req req;
+
+	memset(&req, 0, sizeof(req));
+	(void)strlcpy(req.ifcr_name, name, sizeof(req.ifcr_name));
+
+	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCIFDESTROY, &req) < 0) {
+		return (-1);
+	}
+	return (0);
+}
 
-	memset(&ifr, 0, sizeof(ifr));
-	(void)strlcpy(ifr.ifr_name, name, sizeof(ifr.ifr_name));
+/*
+ * Copies the name the kernel picked into the caller's buffer. The
+ * interface exists at this point even if the name doesn't fit.
+ */
+static int
+copy_ifname(ifconfig_handle_t *h, const struct ifconfig_req *req,
+    char *ifname, size_t len)
+{
 
-	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCIFDESTROY, &ifr) < 0) {
+	if (strlcpy(ifname, req->ifcr_name, len) >= len) {
+		ifconfig_errstate(h)->errtype = OTHER;
+		ifconfig_errstate(h)->errcode = ERANGE;
+		return (-1);
+	}
+	return (0);
+}
+
+static int
+dup_ifname(ifconfig_handle_t *h, const char *buf, char **ifname)
+{
+
+	*ifname = strdup(buf);
+	if (*ifname == NULL) {
+		ifconfig_errstate(h)->errtype = OTHER;
+		ifconfig_errstate(h)->errcode = ENOMEM;
 		return (-1);
 	}
 	return (0);
@@ -408,11 +712,23 @@ ifconfig_destroy_interface(ifconfig_handle_t *h, const char *name)
 int
 ifconfig_create_interface(ifconfig_handle_t *h, const char *name, char **ifname)
 {
-	struct ifreq ifr;
+	char buf[IFNAMSIZ];
 
-	memset(&ifr, 0, sizeof(ifr));
+	if (ifconfig_create_interface_r(h, name, buf, sizeof(buf)) != 0) {
+		return (-1);
+	}
+	return (dup_ifname(h, buf, ifname));
+}
 
-	(void)strlcpy(ifr.ifr_name, name, sizeof(ifr.ifr_name));
+int
+ifconfig_create_interface_r(ifconfig_handle_t *h, const char *name,
+    char *ifname, size_t len)
+{
+	struct ifconfig_req req;
+
+	memset(&req, 0, sizeof(req));
+
+	(void)strlcpy(req.ifcr_name, name, sizeof(req.ifcr_name));
 
 	/*
 	 * TODO:
@@ -425,68 +741,147 @@ ifconfig_create_interface(ifconfig_handle_t *h, const char *name, char **ifname)
 	    strlen("vlan")) == 0) ||
 	    (strncmp(name, "vxlan",
 	    strlen("vxlan")) == 0)) {
-		h->error.errtype = OTHER;
-		h->error.errcode = ENOSYS;
+		ifconfig_errstate(h)->errtype = OTHER;
+		ifconfig_errstate(h)->errcode = ENOSYS;
 		return (-1);
 	}
 
 	/* No special handling for this interface type. */
-	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCIFCREATE2, &ifr) < 0) {
+	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCIFCREATE2, &req) < 0) {
 		return (-1);
 	}
 
-	*ifname = strdup(ifr.ifr_name);
-	if (ifname == NULL) {
-		h->error.errtype = OTHER;
-		h->error.errcode = ENOMEM;
-		return (-1);
-	}
-
-	return (0);
+	return (copy_ifname(h, &req, ifname, len));
 }
 
 int
 ifconfig_create_interface_vlan(ifconfig_handle_t *h, const char *name,
     char **ifname, const char *vlandev, const unsigned short vlantag)
 {
-	struct ifreq ifr;
-	struct vlanreq params;
+	char buf[IFNAMSIZ];
+
+	if (ifconfig_create_interface_vlan_r(h, name, buf, sizeof(buf),
+	    vlandev, vlantag) != 0) {
+		return (-1);
+	}
+	return (dup_ifname(h, buf, ifname));
+}
+
+int
+ifconfig_create_interface_vlan_r(ifconfig_handle_t *h, const char *name,
+    char *ifname, size_t len, const char *vlandev,
+    const unsigned short vlantag)
+{
+	struct ifconfig_req req;
 
 	if ((vlantag == NOTAG) || (vlandev[0] == '\0')) {
-		// TODO: Add proper error tracking here
+		ifconfig_errstate(h)->errtype = OTHER;
+		ifconfig_errstate(h)->errcode = EINVAL;
 		return (-1);
 	}
 
-	bzero(&params, sizeof(params));
-	(void)strlcpy(ifr.ifr_name, name, sizeof(ifr.ifr_name));
-	params.vlr_tag = vlantag;
-	(void)strlcpy(params.vlr_parent, vlandev, sizeof(params.vlr_parent));
-	ifr.ifr_data = (caddr_t)&params;
+	req_init(&req, name);
+	req.ifcr_vlantag = vlantag;
+	(void)strlcpy(req.ifcr_vlanparent, vlandev,
+	    sizeof(req.ifcr_vlanparent));
 
-	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCIFCREATE2, &ifr) < 0) {
-		// TODO: Add proper error tracking here
+	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCIFCREATE2, &req) < 0) {
 		return (-1);
 	}
 
-	*ifname = strdup(ifr.ifr_name);
-	return (0);
+	return (copy_ifname(h, &req, ifname, len));
 }
 
 int
 ifconfig_set_vlantag(ifconfig_handle_t *h, const char *name,
     const char *vlandev, const unsigned short vlantag)
 {
-	struct ifreq ifr;
-	struct vlanreq params;
+	struct ifconfig_req req;
+
+	memset(&req, 0, sizeof(req));
+	req.ifcr_vlantag = vlantag;
+	(void)strlcpy(req.ifcr_vlanparent, vlandev,
+	    sizeof(req.ifcr_vlanparent));
+	(void)strlcpy(req.ifcr_name, name, sizeof(req.ifcr_name));
+	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCSETVLAN, &req) == -1) {
+		return (-1);
+	}
+	return (0);
+}
+
+int
+ifconfig_add_addr(ifconfig_handle_t *h, const char *name,
+    const struct ifconfig_addr *addr)
+{
+	struct ifconfig_req req;
+	unsigned long request;
+
+	if (ifconfig_addrreq(h, name, addr, 1, &req, &request) != 0) {
+		return (-1);
+	}
+	return (ifconfig_ioctlwrap(h, addr->family, request, &req));
+}
 
-	bzero(&params, sizeof(params));
-	params.vlr_tag = vlantag;
-	strlcpy(params.vlr_parent, vlandev, sizeof(params.vlr_parent));
+int
+ifconfig_delete_addr(ifconfig_handle_t *h, const char *name,
+    const struct ifconfig_addr *addr)
+{
+	struct ifconfig_req req;
+	unsigned long request;
+
+	if (ifconfig_addrreq(h, name, addr, 0, &req, &request) != 0) {
+		return (-1);
+	}
+	return (ifconfig_ioctlwrap(h, addr->family, request, &req));
+}
+
+struct addr_list {
+	struct ifconfig_addr *addrs;
+	size_t count;
+	size_t size;
+};
+
+static int
+get_addrs_cb(ifconfig_handle_t *h, const struct ifconfig_addr *addr,
+    void *udata)
+{
+	struct addr_list *list;
+	struct ifconfig_addr *addrs;
+	size_t newsize;
+
+	list = udata;
+	if (list->count == list->size) {
+		newsize = (list->size == 0) ? 16 : list->size * 2;
+		addrs = reallocarray(list->addrs, newsize, sizeof(*addrs));
+		if (addrs == NULL) {
+			ifconfig_errstate(h)->errtype = OTHER;
+			ifconfig_errstate(h)->errcode = ENOMEM;
+			return (-1);
+		}
+		list->addrs = addrs;
+		list->size = newsize;
+	}
+	list->addrs[list->count++] = *addr;
+	return (0);
+}
+
+int
+ifconfig_get_addrs(ifconfig_handle_t *h, const char *name,
+    struct ifconfig_addr **addrs, size_t *count)
+{
+	struct addr_list list;
+	unsigned int ifindex;
+
+	if (ifconfig_nametoindex(h, name, &ifindex) != 0) {
+		return (-1);
+	}
 
-	ifr.ifr_data = (caddr_t)&params;
-	(void)strlcpy(ifr.ifr_name, name, sizeof(ifr.ifr_name));
-	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCSETVLAN, &ifr) == -1) {
+	memset(&list, 0, sizeof(list));
+	if (ifconfig_addrlist(h, ifindex, get_addrs_cb, &list) != 0) {
+		free(list.addrs);
 		return (-1);
 	}
+	*addrs = list.addrs;
+	*count = list.count;
 	return (0);
 }
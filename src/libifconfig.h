@@ -28,6 +28,17 @@
 
 #pragma once
 
+#include <sys/cdefs.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <net/if.h>
+#include <netinet/in.h>
+
+#include <stdint.h>
+
+__BEGIN_DECLS
+
 typedef enum {
 	OTHER, IOCTL, SOCKET
 } ifconfig_errtype;
@@ -65,12 +76,53 @@ struct ifconfig_capabilities {
  */
 ifconfig_handle_t *ifconfig_open(void);
 
+/** Retrieves a new state object that several threads may use at once.
+ * Sockets are created on first use without locking. Error state is kept
+ * per thread, so ifconfig_err_*() report the calling thread's last error
+ * on any shared state object. Exchanges that need a reply matched to a
+ * request (rtnetlink) and the interface name cache are serialized.
+ * Close it only once no other thread uses it any more.
+ */
+ifconfig_handle_t *ifconfig_open_shared(void);
+
 /** Frees resources held in the provided state object.
  * @param h The state object to close.
  * @see #ifconfig_open(void)
  */
 void ifconfig_close(ifconfig_handle_t *h);
 
+/** Drops the handle's cached interface name <-> index mapping.
+ * The cache follows kernel link notifications on its own; this is for
+ * callers that need a lookup to reflect a change made an instant ago by
+ * someone else, before its notification could have been read.
+ */
+void ifconfig_cache_flush(ifconfig_handle_t *h);
+
+/** Invalidate cached attributes when the kernel announces a link change. */
+#define IFCONFIG_ATTRCACHE_NOTIFY    0x1
+
+/** Caches the values of ifconfig_get_mtu(), ifconfig_get_metric(),
+ * ifconfig_get_capability() and the description getters on h. A fresh
+ * value is returned without a system call. Setters made through h update
+ * the cache, so a read after a write sees the value written.
+ *
+ * Values are fresh for ttl_ms milliseconds, 0 meaning until invalidated.
+ * With IFCONFIG_ATTRCACHE_NOTIFY, a thread also drops all of them on any
+ * link notification. Changes made elsewhere that the kernel doesn't
+ * announce, like a metric on Linux, are only seen once the TTL expires.
+ * ifconfig_cache_flush() drops everything at once.
+ * @param h An open state object
+ * @param ttl_ms Lifetime of a value; required without notifications
+ * @param flags 0 or IFCONFIG_ATTRCACHE_NOTIFY
+ * @return 0 on success, -1 with EINVAL if the cache is on already or
+ *	there'd be no way to invalidate it.
+ */
+int ifconfig_attrcache_enable(ifconfig_handle_t *h, const unsigned int ttl_ms,
+    const int flags);
+
+/** Turns the attribute cache of h off and frees it. */
+void ifconfig_attrcache_disable(ifconfig_handle_t *h);
+
 /** Identifies what kind of error occured. */
 ifconfig_errtype ifconfig_err_errtype(ifconfig_handle_t *h);
 
@@ -88,6 +140,17 @@ int ifconfig_set_name(ifconfig_handle_t *h, const char *name,
     const char *newname);
 int ifconfig_get_orig_name(ifconfig_handle_t *h, const char *ifname,
     char **orig_name);
+
+/*
+ * Variants of the getters above that write into a caller-provided buffer
+ * of len bytes instead of allocating. If the result doesn't fit they fail
+ * with errtype OTHER and errno ERANGE.
+ */
+int ifconfig_get_description_r(ifconfig_handle_t *h, const char *name,
+    char *buf, size_t len);
+int ifconfig_get_orig_name_r(ifconfig_handle_t *h, const char *ifname,
+    char *buf, size_t len);
+
 int ifconfig_set_mtu(ifconfig_handle_t *h, const char *name, const int mtu);
 int ifconfig_get_mtu(ifconfig_handle_t *h, const char *name, int *mtu);
 int ifconfig_set_metric(ifconfig_handle_t *h, const char *name,
@@ -98,11 +161,103 @@ int ifconfig_set_capability(ifconfig_handle_t *h, const char *name,
 int ifconfig_get_capability(ifconfig_handle_t *h, const char *name,
     struct ifconfig_capabilities *capability);
 
+/** Turns the capabilities in set on and those in clear off, with one read
+ * and at most one write. Capabilities the interface doesn't support are
+ * ignored, and nothing is written if none would change.
+ */
+int ifconfig_set_capabilities(ifconfig_handle_t *h, const char *name,
+    const int set, const int clear);
+
+/** Does ifconfig_set_capabilities() on n interfaces.
+ * @param errors If not NULL, n entries that are set to 0 or the errno of
+ *     the failure on the interface at the same position.
+ * @return 0 if every interface was changed, -1 otherwise. The error state
+ *     then describes the first failure in list order.
+ */
+int ifconfig_set_capabilities_bulk(ifconfig_handle_t *h,
+    const char *const *names, const size_t n, const int set,
+    const int clear, int *errors);
+
+/** Capabilities by the names ifconfig(8) uses. "tso" is both TSO bits.
+ * @return The capability bits, or 0 if the name is unknown.
+ */
+int ifconfig_capability_mask(const char *name);
+
+/** Name of a single capability bit, or NULL if it has none. */
+const char *ifconfig_capability_name(const int bit);
+
+/** Parses a comma-separated list like "tso,-lro,vlanhwtag" into the masks
+ * for ifconfig_set_capabilities(). A leading '-' clears a capability.
+ * @return 0 on success, or -1 with errno set to EINVAL if a name is
+ *     unknown. set and clear are then unchanged.
+ */
+int ifconfig_capabilities_parse(const char *str, int *set, int *clear);
+
+/*
+ * A reference to an interface, resolved once for calls in a loop. The
+ * _by_ref variants below behave like the functions of the same name but
+ * start from the request the reference holds, and skip copying the name
+ * and looking up the index. A reference is stale once the interface is
+ * renamed or destroyed; look it up again then.
+ */
+typedef struct ifconfig_iface ifconfig_iface_t;
+
+/** Looks up the interface called name.
+ * @param ifp Set to the reference, to be freed with ifconfig_iface_free().
+ */
+int ifconfig_iface_lookup(ifconfig_handle_t *h, const char *name,
+    ifconfig_iface_t **ifp);
+
+/** Looks up the interface with index ifindex. */
+int ifconfig_iface_lookup_index(ifconfig_handle_t *h,
+    const unsigned int ifindex, ifconfig_iface_t **ifp);
+
+void ifconfig_iface_free(ifconfig_iface_t *ifp);
+
+const char *ifconfig_iface_name(const ifconfig_iface_t *ifp);
+unsigned int ifconfig_iface_index(const ifconfig_iface_t *ifp);
+
+int ifconfig_get_mtu_by_ref(ifconfig_handle_t *h, const ifconfig_iface_t *ifp,
+    int *mtu);
+int ifconfig_set_mtu_by_ref(ifconfig_handle_t *h, const ifconfig_iface_t *ifp,
+    const int mtu);
+int ifconfig_get_metric_by_ref(ifconfig_handle_t *h,
+    const ifconfig_iface_t *ifp, int *metric);
+int ifconfig_set_metric_by_ref(ifconfig_handle_t *h,
+    const ifconfig_iface_t *ifp, const int metric);
+int ifconfig_get_capability_by_ref(ifconfig_handle_t *h,
+    const ifconfig_iface_t *ifp, struct ifconfig_capabilities *capability);
+int ifconfig_set_capabilities_by_ref(ifconfig_handle_t *h,
+    const ifconfig_iface_t *ifp, const int set, const int clear);
+int ifconfig_get_description_r_by_ref(ifconfig_handle_t *h,
+    const ifconfig_iface_t *ifp, char *buf, size_t len);
+int ifconfig_set_description_by_ref(ifconfig_handle_t *h,
+    const ifconfig_iface_t *ifp, const char *newdescription);
+int ifconfig_unset_description_by_ref(ifconfig_handle_t *h,
+    const ifconfig_iface_t *ifp);
+int ifconfig_get_orig_name_r_by_ref(ifconfig_handle_t *h,
+    const ifconfig_iface_t *ifp, char *buf, size_t len);
+
 /** Destroy a virtual interface
  * @param name Interface to destroy
  */
 int ifconfig_destroy_interface(ifconfig_handle_t *h, const char *name);
 
+/** Destroys n interfaces, spread over up to nthreads threads.
+ * Interfaces in the list that are stacked on others in it, like VLANs on
+ * their parent, are destroyed first. One that disappears because an
+ * earlier one took it along, like the other end of an epair, counts as
+ * destroyed.
+ * @param nthreads Number of threads to use, or 0 for one per online CPU.
+ * @param errors If not NULL, n entries that are set to 0 or the errno of
+ *     the failed destroy of the interface at the same position.
+ * @return 0 if every interface was destroyed, -1 otherwise. The error
+ *     state then describes the first failure in list order.
+ */
+int ifconfig_destroy_interfaces(ifconfig_handle_t *h,
+    const char *const *names, const size_t n, unsigned int nthreads,
+    int *errors);
+
 /** Creates a (virtual) interface
  * @param name Name of interface to create. Example: bridge or bridge42
  * @param name ifname Is set to actual name of created interface
@@ -119,5 +274,864 @@ int ifconfig_create_interface(ifconfig_handle_t *h, const char *name,
 int ifconfig_create_interface_vlan(ifconfig_handle_t *h, const char *name,
     char **ifname, const char *vlandev, const unsigned short vlantag);
 
+/*
+ * Variants of the above that write the name of the new interface into
+ * ifname, which holds len bytes. IFNAMSIZ is always enough. On ERANGE the
+ * interface has been created but its name is unknown to the caller.
+ */
+int ifconfig_create_interface_r(ifconfig_handle_t *h, const char *name,
+    char *ifname, size_t len);
+int ifconfig_create_interface_vlan_r(ifconfig_handle_t *h, const char *name,
+    char *ifname, size_t len, const char *vlandev,
+    const unsigned short vlantag);
+
+/** Moves a VLAN interface to another parent and tag
+ * Fails with EINVAL if name is not a VLAN. Linux can't retag a VLAN, so
+ * there the interface is destroyed and created again under the same
+ * name: it keeps its MTU, up and promiscuous flags, bridge and
+ * description, but gets a new index and loses its addresses. If the new
+ * VLAN can't be set up, the old one is put back.
+ * @param name Name of the VLAN interface
+ * @param vlandev Name of the new parent interface
+ * @param vlantag New VLAN ID/Tag. Must not be 0.
+ */
 int ifconfig_set_vlantag(ifconfig_handle_t *h, const char *name,
     const char *vlandev, const unsigned short vlantag);
+
+/*
+ * Bridge members, as ifconfig(8)'s addm and deletem: BRDGADD and BRDGDEL
+ * on FreeBSD, the member's IFLA_MASTER on Linux. Both report EEXIST for
+ * a member already in the bridge, EBUSY for one in another bridge, and
+ * ENOENT for deleting a member that is not in the bridge.
+ */
+
+int ifconfig_bridge_add_member(ifconfig_handle_t *h, const char *bridge,
+    const char *member);
+int ifconfig_bridge_delete_member(ifconfig_handle_t *h, const char *bridge,
+    const char *member);
+
+/** Reads the names of the bridge's members into names, IFNAMSIZ bytes
+ * apart.
+ * @param n Number of names that fit into names.
+ * @param count If not NULL, set to the number of members, also when they
+ *     don't all fit.
+ * @return 0, or -1 with errtype OTHER and ERANGE if there are more than
+ *     n members. names then holds the first n.
+ */
+int ifconfig_bridge_get_members(ifconfig_handle_t *h, const char *bridge,
+    char *names, const size_t n, size_t *count);
+
+/** Attaches n members to the bridge, with pipelined requests where the
+ * backend supports them, then reads the member list as
+ * ifconfig_bridge_get_members() does if names or count isn't NULL.
+ * Nothing is allocated.
+ * @param errors If not NULL, n entries that are set to 0 or the errno of
+ *     the failure on the member at the same position.
+ * @param size Number of names that fit into names.
+ * @return 0 on success, -1 otherwise. The error state then describes the
+ *     first failed attach in list order, or else the failed read. The
+ *     list is read even if attaches failed.
+ */
+int ifconfig_bridge_add_members(ifconfig_handle_t *h, const char *bridge,
+    const char *const *members, const size_t n, int *errors, char *names,
+    const size_t size, size_t *count);
+
+/** Detaches n members from the bridge, like
+ * ifconfig_bridge_add_members() attaches them.
+ */
+int ifconfig_bridge_delete_members(ifconfig_handle_t *h, const char *bridge,
+    const char *const *members, const size_t n, int *errors);
+
+/** An IPv4 or IPv6 interface address. */
+struct ifconfig_addr {
+	/** AF_INET or AF_INET6. */
+	int family;
+	/** Length of the network prefix: up to 32 or 128. */
+	unsigned int prefixlen;
+	union {
+		struct in_addr in;
+		struct in6_addr in6;
+	} addr;
+};
+
+/** Adds an address to an interface. Adding one the interface already has
+ * updates its prefix length.
+ */
+int ifconfig_add_addr(ifconfig_handle_t *h, const char *name,
+    const struct ifconfig_addr *addr);
+
+/** Removes an address from an interface. The prefix length is ignored,
+ * except for IPv6 on Linux, where it has to match.
+ */
+int ifconfig_delete_addr(ifconfig_handle_t *h, const char *name,
+    const struct ifconfig_addr *addr);
+
+/** Retrieves every IPv4 and IPv6 address of an interface.
+ * @param addrs Set to an array of count addresses, to be freed with
+ *     free(). NULL if there are none.
+ */
+int ifconfig_get_addrs(ifconfig_handle_t *h, const char *name,
+    struct ifconfig_addr **addrs, size_t *count);
+
+/*
+ * Snapshot of all interfaces on the system, gathered from a single dump of
+ * the kernel interface list.
+ */
+struct ifconfig_snapshot;
+typedef struct ifconfig_snapshot ifconfig_snapshot_t;
+
+struct ifconfig_snapshot_iface;
+typedef struct ifconfig_snapshot_iface ifconfig_snapshot_iface_t;
+
+/*
+ * Optional attributes for ifconfig_snapshot_take(). The kernel interface
+ * list only carries name, index, flags, MTU and metric, so each of these
+ * costs one extra request per interface.
+ */
+#define IFCONFIG_SNAP_CAPABILITY	0x0001
+#define IFCONFIG_SNAP_DESCRIPTION	0x0002
+#define IFCONFIG_SNAP_ORIG_NAME		0x0004
+#define IFCONFIG_SNAP_ALL		(IFCONFIG_SNAP_CAPABILITY | \
+	IFCONFIG_SNAP_DESCRIPTION | IFCONFIG_SNAP_ORIG_NAME)
+
+/** Takes a snapshot of every interface on the system.
+ * Example usage:
+ *{@code
+ * ifconfig_snapshot_t *snap;
+ * const ifconfig_snapshot_iface_t *iface;
+ *
+ * if (ifconfig_snapshot_take(lifh, IFCONFIG_SNAP_DESCRIPTION, &snap) != 0) {
+ *     // Handle error
+ * }
+ * for (size_t i = 0; i < ifconfig_snapshot_count(snap); i++) {
+ *     iface = ifconfig_snapshot_at(snap, i);
+ *     printf("%s mtu %d\n", ifconfig_snapshot_iface_name(iface),
+ *         ifconfig_snapshot_iface_mtu(iface));
+ * }
+ * ifconfig_snapshot_free(snap);
+ *}
+ * @param flags Bitmask of IFCONFIG_SNAP_* attributes to gather in addition
+ *     to the ones contained in the interface list.
+ * @param snap Is set to the new snapshot. Free with ifconfig_snapshot_free().
+ * @return 0 on success, -1 on failure.
+ */
+int ifconfig_snapshot_take(ifconfig_handle_t *h, const int flags,
+    ifconfig_snapshot_t **snap);
+
+/** Frees a snapshot and all interface entries in it. */
+void ifconfig_snapshot_free(ifconfig_snapshot_t *snap);
+
+/** Number of interfaces in the snapshot. */
+size_t ifconfig_snapshot_count(const ifconfig_snapshot_t *snap);
+
+/** Returns the interface at position <paramref name="i">, or NULL. */
+const ifconfig_snapshot_iface_t *ifconfig_snapshot_at(
+    const ifconfig_snapshot_t *snap, size_t i);
+
+/** Looks up an interface by name, or returns NULL if it isn't present. */
+const ifconfig_snapshot_iface_t *ifconfig_snapshot_find(
+    const ifconfig_snapshot_t *snap, const char *name);
+
+const char *ifconfig_snapshot_iface_name(
+    const ifconfig_snapshot_iface_t *iface);
+unsigned int ifconfig_snapshot_iface_index(
+    const ifconfig_snapshot_iface_t *iface);
+int ifconfig_snapshot_iface_flags(const ifconfig_snapshot_iface_t *iface);
+int ifconfig_snapshot_iface_mtu(const ifconfig_snapshot_iface_t *iface);
+int ifconfig_snapshot_iface_metric(const ifconfig_snapshot_iface_t *iface);
+
+/** Retrieves the capabilities recorded in the snapshot.
+ * @return 0 on success, -1 if the snapshot was taken without
+ *     IFCONFIG_SNAP_CAPABILITY or the request failed for this interface.
+ */
+int ifconfig_snapshot_iface_capability(const ifconfig_snapshot_iface_t *iface,
+    struct ifconfig_capabilities *capability);
+
+/** Description of the interface, or NULL if it has none or wasn't gathered. */
+const char *ifconfig_snapshot_iface_description(
+    const ifconfig_snapshot_iface_t *iface);
+
+/** Original (driver) name of the interface, or NULL if it wasn't gathered. */
+const char *ifconfig_snapshot_iface_orig_name(
+    const ifconfig_snapshot_iface_t *iface);
+
+/*
+ * Traffic counters of every interface, read from a single dump of the
+ * kernel interface list. The object is meant to be kept and read again:
+ * once it has room for every interface, reading allocates nothing.
+ */
+typedef struct ifconfig_counters ifconfig_counters_t;
+
+/** Counters of one interface. Those a kernel doesn't keep are 0. */
+struct ifconfig_ifcounters {
+	unsigned int index;
+	char name[IFNAMSIZ];
+	uint64_t ipackets;
+	uint64_t ierrors;
+	uint64_t iqdrops;
+	uint64_t ibytes;
+	uint64_t imcasts;
+	uint64_t opackets;
+	uint64_t oerrors;
+	uint64_t oqdrops;
+	uint64_t obytes;
+	uint64_t omcasts;
+	uint64_t collisions;
+	/** Received for a protocol the system doesn't handle. */
+	uint64_t noproto;
+};
+
+/** Creates an empty counters object, or returns NULL with errno set. */
+ifconfig_counters_t *ifconfig_counters_new(void);
+
+void ifconfig_counters_free(ifconfig_counters_t *c);
+
+/** Replaces the contents of c with the current counters.
+ * Example usage:
+ *{@code
+ * ifconfig_counters_t *c = ifconfig_counters_new();
+ * const struct ifconfig_ifcounters *ifc;
+ *
+ * for (;;) {
+ *     if (ifconfig_counters_read(lifh, c) == 0) {
+ *         for (size_t i = 0; i < ifconfig_counters_count(c); i++) {
+ *             ifc = ifconfig_counters_at(c, i);
+ *             printf("%s %ju\n", ifc->name, (uintmax_t)ifc->ibytes);
+ *         }
+ *     }
+ *     sleep(10);
+ * }
+ *}
+ * @return 0 on success, -1 on failure. c is empty after a failure.
+ */
+int ifconfig_counters_read(ifconfig_handle_t *h, ifconfig_counters_t *c);
+
+/** Number of interfaces in c. */
+size_t ifconfig_counters_count(const ifconfig_counters_t *c);
+
+/** Returns the interface at position <paramref name="i">, or NULL. */
+const struct ifconfig_ifcounters *ifconfig_counters_at(
+    const ifconfig_counters_t *c, size_t i);
+
+/** Looks up an interface by name, or returns NULL if it isn't present. */
+const struct ifconfig_ifcounters *ifconfig_counters_find(
+    const ifconfig_counters_t *c, const char *name);
+
+/*
+ * Background sampler. A thread reads the counters of every interface at a
+ * fixed interval and computes per-second rates from consecutive reads.
+ * Results are kept as one array per counter, in the same interface order,
+ * and are handed to readers without locks: a reader never waits for the
+ * sampler, and the sampler skips a round rather than wait for a reader.
+ */
+typedef struct ifconfig_sampler ifconfig_sampler_t;
+typedef struct ifconfig_sample ifconfig_sample_t;
+
+/** Counters of struct ifconfig_ifcounters, as array selectors. */
+enum ifconfig_counter {
+	IFCONFIG_COUNTER_IPACKETS,
+	IFCONFIG_COUNTER_IERRORS,
+	IFCONFIG_COUNTER_IQDROPS,
+	IFCONFIG_COUNTER_IBYTES,
+	IFCONFIG_COUNTER_IMCASTS,
+	IFCONFIG_COUNTER_OPACKETS,
+	IFCONFIG_COUNTER_OERRORS,
+	IFCONFIG_COUNTER_OQDROPS,
+	IFCONFIG_COUNTER_OBYTES,
+	IFCONFIG_COUNTER_OMCASTS,
+	IFCONFIG_COUNTER_COLLISIONS,
+	IFCONFIG_COUNTER_NOPROTO,
+	IFCONFIG_COUNTER_MAX
+};
+
+/** Starts sampling every interval_ms milliseconds.
+ * Example usage:
+ *{@code
+ * ifconfig_sampler_t *s;
+ * const ifconfig_sample_t *smp;
+ * const double *ibytes;
+ *
+ * if (ifconfig_sampler_start(ifconfig_open(), 1000, &s) != 0) {
+ *     // Handle error
+ * }
+ * // Later, from any thread
+ * smp = ifconfig_sampler_acquire(s);
+ * ibytes = ifconfig_sample_rates(smp, IFCONFIG_COUNTER_IBYTES);
+ * for (size_t i = 0; i < ifconfig_sample_count(smp); i++) {
+ *     printf("%s %.0f bit/s\n", ifconfig_sample_name(smp, i),
+ *         ibytes[i] * 8);
+ * }
+ * ifconfig_sampler_release(s, smp);
+ *}
+ * @param h State object from ifconfig_open(). The sampler thread owns it
+ *     from now on and closes it when stopped, also if starting fails.
+ * @return 0 on success, or -1 with errno set.
+ */
+int ifconfig_sampler_start(ifconfig_handle_t *h, const unsigned int interval_ms,
+    ifconfig_sampler_t **s);
+
+/** Stops the thread and frees the sampler. No sample may be held. */
+void ifconfig_sampler_stop(ifconfig_sampler_t *s);
+
+/** Number of counter reads that failed. The last good sample stays. */
+uint64_t ifconfig_sampler_failures(const ifconfig_sampler_t *s);
+
+/** Returns the latest sample, which stays valid until released. Hold it
+ * briefly: while it is held the sampler can publish at most one newer one.
+ */
+const ifconfig_sample_t *ifconfig_sampler_acquire(ifconfig_sampler_t *s);
+
+void ifconfig_sampler_release(ifconfig_sampler_t *s,
+    const ifconfig_sample_t *sample);
+
+/** Number of reads that went into this sample; 0 before the first one. */
+uint64_t ifconfig_sample_seq(const ifconfig_sample_t *sample);
+
+/** Time between this sample and the one its rates are relative to. */
+uint64_t ifconfig_sample_interval_ns(const ifconfig_sample_t *sample);
+
+/** Number of interfaces, the length of every array of the sample. */
+size_t ifconfig_sample_count(const ifconfig_sample_t *sample);
+
+const unsigned int *ifconfig_sample_indexes(const ifconfig_sample_t *sample);
+const char *ifconfig_sample_name(const ifconfig_sample_t *sample, size_t i);
+
+/** Raw counter values. */
+const uint64_t *ifconfig_sample_counters(const ifconfig_sample_t *sample,
+    const enum ifconfig_counter counter);
+
+/** Increase per second since the previous sample. 0 for interfaces that
+ * weren't in it. Counters that go back are taken to have wrapped if they
+ * were below 2^32, and to have been reset otherwise.
+ */
+const double *ifconfig_sample_rates(const ifconfig_sample_t *sample,
+    const enum ifconfig_counter counter);
+
+/*
+ * OpenMetrics (Prometheus) text exposition of a snapshot and counters.
+ * The writer formats straight into the caller's buffer and keeps a cursor,
+ * so output can be produced in pieces of any size. It allocates only when
+ * a longer description than before needs a larger line buffer.
+ */
+typedef struct ifconfig_metrics ifconfig_metrics_t;
+
+/** Creates a writer, or returns NULL with errno set. */
+ifconfig_metrics_t *ifconfig_metrics_new(void);
+
+void ifconfig_metrics_free(ifconfig_metrics_t *m);
+
+/** Starts a new exposition, dropping whatever of the last one is unwritten.
+ * Example usage:
+ *{@code
+ * char buf[16384];
+ * size_t n;
+ *
+ * if (ifconfig_metrics_begin(m, snap, counters) != 0) {
+ *     // Handle error
+ * }
+ * while ((n = ifconfig_metrics_write(m, buf, sizeof(buf))) > 0) {
+ *     send(sock, buf, n, 0);
+ * }
+ *}
+ * @param snap Source of the info (interface and description labels), MTU,
+ *     metric and capability families, or NULL. Capabilities are only
+ *     written for snapshots taken with IFCONFIG_SNAP_CAPABILITY.
+ * @param counters Source of the counter families, or NULL.
+ * Both must stay unchanged until the exposition is written.
+ * @return 0 on success, or -1 with errno set.
+ */
+int ifconfig_metrics_begin(ifconfig_metrics_t *m,
+    const ifconfig_snapshot_t *snap, const ifconfig_counters_t *counters);
+
+/** Writes the next len bytes or less of the exposition into buf. A line
+ * that doesn't fit is split, and continued by the next call.
+ * @return Number of bytes written; 0 once the exposition is complete.
+ */
+size_t ifconfig_metrics_write(ifconfig_metrics_t *m, char *buf,
+    const size_t len);
+
+/** Writes the rest of the exposition to fd.
+ * @return 0 once everything was written, or -1 with errno set. With a
+ *     non-blocking fd, EAGAIN means to call again when it is writable;
+ *     output continues where it stopped.
+ */
+int ifconfig_metrics_write_fd(ifconfig_metrics_t *m, const int fd);
+
+/*
+ * Batch of interface changes that are submitted together. Backends that
+ * can (rtnetlink) pipeline them; otherwise they run one after another.
+ */
+struct ifconfig_batch;
+typedef struct ifconfig_batch ifconfig_batch_t;
+
+typedef enum {
+	IFCONFIG_BATCH_PENDING,
+	IFCONFIG_BATCH_DONE,
+	IFCONFIG_BATCH_FAILED,
+	/** The operation succeeded, but was undone after another failed. */
+	IFCONFIG_BATCH_ROLLEDBACK
+} ifconfig_batch_status;
+
+/** Flag for ifconfig_batch_submit(): undo completed operations on failure. */
+#define IFCONFIG_BATCH_ROLLBACK		0x0001
+
+/** Creates an empty batch for use with the given state object.
+ * Example usage:
+ *{@code
+ * ifconfig_batch_t *b;
+ *
+ * b = ifconfig_batch_new(lifh);
+ * ifconfig_batch_set_mtu(b, "em0", 9000);
+ * ifconfig_batch_set_description(b, "em0", "uplink");
+ * if (ifconfig_batch_submit(b, IFCONFIG_BATCH_ROLLBACK) != 0) {
+ *     for (size_t i = 0; i < ifconfig_batch_count(b); i++) {
+ *         if (ifconfig_batch_result(b, i) == IFCONFIG_BATCH_FAILED) {
+ *             // Inspect ifconfig_batch_err_errno(b, i)
+ *         }
+ *     }
+ * }
+ * ifconfig_batch_free(b);
+ *}
+ * @return The new batch, or NULL if memory couldn't be allocated.
+ */
+ifconfig_batch_t *ifconfig_batch_new(ifconfig_handle_t *h);
+
+/** Frees a batch. The state object it was created with is not closed. */
+void ifconfig_batch_free(ifconfig_batch_t *b);
+
+/*
+ * Queue an operation. Nothing reaches the kernel until the batch is
+ * submitted. These only fail if memory couldn't be allocated, or with
+ * EINVAL for an address that isn't IPv4 or IPv6 or has too long a prefix.
+ */
+int ifconfig_batch_set_mtu(ifconfig_batch_t *b, const char *name,
+    const int mtu);
+int ifconfig_batch_set_description(ifconfig_batch_t *b, const char *name,
+    const char *newdescription);
+int ifconfig_batch_set_name(ifconfig_batch_t *b, const char *name,
+    const char *newname);
+int ifconfig_batch_set_capability(ifconfig_batch_t *b, const char *name,
+    const int capability);
+int ifconfig_batch_set_capabilities(ifconfig_batch_t *b, const char *name,
+    const int set, const int clear);
+int ifconfig_batch_add_addr(ifconfig_batch_t *b, const char *name,
+    const struct ifconfig_addr *addr);
+int ifconfig_batch_delete_addr(ifconfig_batch_t *b, const char *name,
+    const struct ifconfig_addr *addr);
+
+/** Submits every queued operation, in the order they were queued.
+ * @param flags 0 or IFCONFIG_BATCH_ROLLBACK. Rollback is best effort: the
+ *     previous values are read before submitting, and operations that
+ *     completed are reverted in reverse order if any operation failed.
+ *     Reverting an address add removes the address, even if the
+ *     interface had it before.
+ * @return 0 if every operation succeeded, -1 otherwise. The handle's
+ *     error state then describes the first failure.
+ */
+int ifconfig_batch_submit(ifconfig_batch_t *b, const int flags);
+
+/** Number of queued operations. */
+size_t ifconfig_batch_count(const ifconfig_batch_t *b);
+
+/** Outcome of the operation queued at position <paramref name="i">. */
+ifconfig_batch_status ifconfig_batch_result(const ifconfig_batch_t *b,
+    size_t i);
+
+/* Error state of a FAILED operation, as for the ifconfig_err_* functions. */
+ifconfig_errtype ifconfig_batch_err_errtype(const ifconfig_batch_t *b,
+    size_t i);
+int ifconfig_batch_err_errno(const ifconfig_batch_t *b, size_t i);
+unsigned long ifconfig_batch_err_ioctlreq(const ifconfig_batch_t *b,
+    size_t i);
+
+/** Inclusive range of VLAN tags for ifconfig_create_vlans(). */
+struct ifconfig_vlan_range {
+	unsigned short first;
+	unsigned short last;
+};
+
+/** Creates one VLAN interface on parent for every tag in ranges.
+ * The interfaces are named parent.tag, and created and configured with
+ * pipelined requests where the backend supports it. Either all of them
+ * are created or, on failure, the ones that were are destroyed again.
+ * @param mtu MTU to set on every new interface, or 0 to keep the default.
+ * @param description Description to set on every new interface, or NULL.
+ * @param names If not NULL, set to one allocation holding the names of the
+ *     new interfaces, IFNAMSIZ bytes each, in the order of ranges. Free it
+ *     with free().
+ * @param count If not NULL, set to the number of interfaces created.
+ * @return 0 on success, -1 with the error state of the first failure.
+ */
+int ifconfig_create_vlans(ifconfig_handle_t *h, const char *parent,
+    const struct ifconfig_vlan_range *ranges, const size_t nranges,
+    const int mtu, const char *description, char **names, size_t *count);
+
+/*
+ * Asynchronous requests, for event loops that mustn't block. Operations
+ * are queued with ifconfig_submit_*() and run by a few worker threads,
+ * which take up to 64 at a time and submit them like a batch. Results
+ * are collected with ifconfig_async_reap() once the descriptor from
+ * ifconfig_async_fd() is readable.
+ *
+ * Operations may run in any order and at the same time, so one that
+ * depends on another should be submitted after the other completed.
+ * Submitting and reaping are for one thread at a time, like the state
+ * object; errors in submitting are reported in its error state.
+ */
+struct ifconfig_async;
+typedef struct ifconfig_async ifconfig_async_t;
+
+/** Identifies a submitted operation. Never 0. */
+typedef uint64_t ifconfig_ticket_t;
+
+struct ifconfig_completion {
+	ifconfig_ticket_t ticket;
+	/** 0 on success, -1 on failure. */
+	int error;
+	/** Why it failed, as ifconfig_err_errtype() etc. would tell. */
+	ifconfig_errtype errtype;
+	int errcode;
+	unsigned long ioctlreq;
+	/** The interface, with the name the kernel picked for a create. */
+	char name[IFNAMSIZ];
+};
+
+/** Starts the worker threads for asynchronous requests on h.
+ * @param h State object that submits. It must outlive the async object.
+ * @param nthreads Number of workers, or 0 for one per online CPU.
+ */
+int ifconfig_async_new(ifconfig_handle_t *h, const unsigned int nthreads,
+    ifconfig_async_t **ap);
+
+/** Stops the workers. Operations already running are waited for, queued
+ * ones are dropped, and completions not reaped are discarded.
+ */
+void ifconfig_async_free(ifconfig_async_t *a);
+
+/** A descriptor that is readable while completions are waiting. */
+int ifconfig_async_fd(const ifconfig_async_t *a);
+
+/** Number of operations submitted and not reaped yet. */
+size_t ifconfig_async_inflight(const ifconfig_async_t *a);
+
+/** Collects up to n completions, oldest first, without blocking.
+ * @return The number stored in c.
+ */
+size_t ifconfig_async_reap(ifconfig_async_t *a, struct ifconfig_completion *c,
+    const size_t n);
+
+/*
+ * Queue the request of the synchronous function of the same name. ticket,
+ * if not NULL, is set to the operation's ticket.
+ */
+int ifconfig_submit_set_mtu(ifconfig_async_t *a, const char *name,
+    const int mtu, ifconfig_ticket_t *ticket);
+int ifconfig_submit_set_metric(ifconfig_async_t *a, const char *name,
+    const int metric, ifconfig_ticket_t *ticket);
+int ifconfig_submit_set_description(ifconfig_async_t *a, const char *name,
+    const char *newdescription, ifconfig_ticket_t *ticket);
+int ifconfig_submit_set_name(ifconfig_async_t *a, const char *name,
+    const char *newname, ifconfig_ticket_t *ticket);
+int ifconfig_submit_create_interface(ifconfig_async_t *a, const char *name,
+    ifconfig_ticket_t *ticket);
+int ifconfig_submit_create_interface_vlan(ifconfig_async_t *a,
+    const char *name, const char *vlandev, const unsigned short vlantag,
+    ifconfig_ticket_t *ticket);
+int ifconfig_submit_destroy_interface(ifconfig_async_t *a, const char *name,
+    ifconfig_ticket_t *ticket);
+int ifconfig_submit_set_vlantag(ifconfig_async_t *a, const char *name,
+    const char *vlandev, const unsigned short vlantag,
+    ifconfig_ticket_t *ticket);
+int ifconfig_submit_add_addr(ifconfig_async_t *a, const char *name,
+    const struct ifconfig_addr *addr, ifconfig_ticket_t *ticket);
+int ifconfig_submit_delete_addr(ifconfig_async_t *a, const char *name,
+    const struct ifconfig_addr *addr, ifconfig_ticket_t *ticket);
+
+/*
+ * Desired-state reconciliation. The caller states the MTU, description,
+ * capabilities and VLAN it wants on a set of interfaces, and
+ * ifconfig_reconcile_run() compares them with one interface list dump and
+ * changes only what differs. Attributes the dump doesn't carry are read
+ * only for the interfaces that want them. The desired state is kept, so
+ * an agent can run the same object again and again.
+ *
+ * ifconfig_reconcile_t *r = ifconfig_reconcile_new(lifh);
+ *
+ * ifconfig_reconcile_set_mtu(r, "vlan100", 9000);
+ * ifconfig_reconcile_set_description(r, "vlan100", "storage");
+ * if (ifconfig_reconcile_run(r, 0) != 0) {
+ *     // ifconfig_reconcile_change(r, i)->errcode says which failed
+ * }
+ */
+struct ifconfig_reconcile;
+typedef struct ifconfig_reconcile ifconfig_reconcile_t;
+
+typedef enum {
+	IFCONFIG_CHANGE_VLAN,
+	IFCONFIG_CHANGE_MTU,
+	IFCONFIG_CHANGE_CAPABILITIES,
+	IFCONFIG_CHANGE_DESCRIPTION,
+} ifconfig_change_attr;
+
+/** One entry of the change plan. */
+struct ifconfig_change {
+	const char *name;
+	ifconfig_change_attr attr;
+	/** Current and wanted VLAN tag, MTU or enabled capabilities. */
+	int from;
+	int to;
+	/** Current and wanted VLAN parent or description, NULL for none. */
+	const char *from_str;
+	const char *to_str;
+	/**
+	 * 0 if the change was made (or would be, in a dry run), ENXIO if
+	 * there's no such interface, ECANCELED if it wasn't tried because
+	 * a change it depends on failed, or the errno it failed with.
+	 */
+	int errcode;
+};
+
+/** Only compute the change plan; change nothing. */
+#define IFCONFIG_RECONCILE_DRYRUN	0x1
+
+/** Returns a new object without any desired state, or NULL on error. */
+ifconfig_reconcile_t *ifconfig_reconcile_new(ifconfig_handle_t *h);
+void ifconfig_reconcile_free(ifconfig_reconcile_t *r);
+
+/** Forgets the desired state and plan, keeping the memory for reuse. */
+void ifconfig_reconcile_clear(ifconfig_reconcile_t *r);
+
+/*
+ * Add to the desired state of interface name. Later calls for the same
+ * attribute replace earlier ones, except that capabilities accumulate.
+ * An empty description means none.
+ */
+int ifconfig_reconcile_set_mtu(ifconfig_reconcile_t *r, const char *name,
+    const int mtu);
+int ifconfig_reconcile_set_description(ifconfig_reconcile_t *r,
+    const char *name, const char *description);
+int ifconfig_reconcile_set_capabilities(ifconfig_reconcile_t *r,
+    const char *name, const int set, const int clear);
+int ifconfig_reconcile_set_vlan(ifconfig_reconcile_t *r, const char *name,
+    const char *vlandev, const unsigned short vlantag);
+
+/** Reads the current state and makes the plan, then applies it unless
+ * flags has IFCONFIG_RECONCILE_DRYRUN. Changes are made VLANs first, then
+ * MTUs (lowering VLANs' before their parents' change and raising them
+ * after), capabilities and descriptions; once a step has failures, the
+ * later steps are cancelled.
+ * @return 0 if every change was made, -1 with the error state of the
+ *     first that failed or couldn't be planned.
+ */
+int ifconfig_reconcile_run(ifconfig_reconcile_t *r, const int flags);
+
+/** Number of changes in the plan of the last run. */
+size_t ifconfig_reconcile_count(const ifconfig_reconcile_t *r);
+
+/** The i'th change of the plan, in the order they are made, or NULL. The
+ * strings stay valid until r is next changed, run, cleared or freed.
+ */
+const struct ifconfig_change *ifconfig_reconcile_change(
+    const ifconfig_reconcile_t *r, size_t i);
+
+/*
+ * Checkpoints: the cloned interfaces and their MTU, description,
+ * capabilities and VLAN, in a compact binary file for recovery after a
+ * reboot or failover. The file is versioned and in the byte order of the
+ * machine that wrote it; other files are rejected.
+ */
+
+/** Saves the cloned interfaces to path, replacing it atomically. On
+ * FreeBSD, whose interface list doesn't tell cloned interfaces apart,
+ * those whose driver is one of the system's cloners are saved.
+ */
+int ifconfig_checkpoint_save(ifconfig_handle_t *h, const char *path);
+
+/** Recreates the interfaces saved in path that don't exist, parents
+ * before VLANs and with pipelined requests where the backend supports
+ * them, then gives every one its saved attributes with
+ * ifconfig_reconcile_run(). Interfaces that exist keep theirs where they
+ * match already. The file is mapped, not read.
+ * @return 0 on success, -1 with the error state of the first failure.
+ *     Interfaces that could be restored are, even then.
+ */
+int ifconfig_checkpoint_restore(ifconfig_handle_t *h, const char *path);
+
+/*
+ * Watches the kernel for interface changes. The watcher exposes a file
+ * descriptor that becomes readable when something changed, so it fits
+ * into poll()/kqueue() loops instead of polling the getters.
+ */
+struct ifconfig_watch;
+typedef struct ifconfig_watch ifconfig_watch_t;
+
+#define IFCONFIG_EVENT_ADD	0x0001
+#define IFCONFIG_EVENT_REMOVE	0x0002
+#define IFCONFIG_EVENT_RENAME	0x0004
+#define IFCONFIG_EVENT_MTU	0x0008
+#define IFCONFIG_EVENT_FLAGS	0x0010
+
+struct ifconfig_event {
+	/**
+	 * IFCONFIG_EVENT_* bits. All changes to one interface seen by a
+	 * single ifconfig_watch_dispatch() call are reported together.
+	 */
+	int events;
+	unsigned int index;
+	const char *name;
+	/** Name before the first rename, if IFCONFIG_EVENT_RENAME is set. */
+	const char *oldname;
+	int mtu;
+	int flags;
+};
+
+/** Called once per changed interface. Strings are only valid during the
+ * call. A non-zero return stops the dispatch and is passed on.
+ */
+typedef int ifconfig_watch_cb_t(const struct ifconfig_event *event,
+    void *udata);
+
+/** Starts watching for interface changes.
+ * Example usage:
+ *{@code
+ * ifconfig_watch_t *w;
+ * struct pollfd pfd;
+ *
+ * if (ifconfig_watch_open(lifh, &w) != 0) {
+ *     // Handle error
+ * }
+ * pfd.fd = ifconfig_watch_fd(w);
+ * pfd.events = POLLIN;
+ * while (poll(&pfd, 1, -1) > 0) {
+ *     ifconfig_watch_dispatch(w, mycallback, NULL);
+ * }
+ * ifconfig_watch_close(w);
+ *}
+ * The watcher uses the state object for requests and error reporting,
+ * so it must not be closed before the watcher.
+ */
+int ifconfig_watch_open(ifconfig_handle_t *h, ifconfig_watch_t **w);
+
+/** Stops watching and frees the watcher. */
+void ifconfig_watch_close(ifconfig_watch_t *w);
+
+/** File descriptor to poll for readability. Don't read from it. */
+int ifconfig_watch_fd(const ifconfig_watch_t *w);
+
+/** Reads all pending notifications without blocking and invokes cb once
+ * for every interface that changed.
+ * @return Number of events delivered, -1 on failure, or the callback's
+ *     return value if it stopped the dispatch.
+ */
+int ifconfig_watch_dispatch(ifconfig_watch_t *w, ifconfig_watch_cb_t *cb,
+    void *udata);
+
+/*
+ * Per-handle statistics: how often each kernel request was made, how often
+ * it failed and how long it took. Requests are keyed by their SIOC* code.
+ * Work that isn't a single request has one of the IFCONFIG_STAT_* codes.
+ *
+ * Statistics are kept unless the library was built with IFCONFIG_STATS
+ * defined to 0, in which case ifconfig_stats_get() fails with EOPNOTSUPP.
+ */
+
+/** Creating a kernel socket. */
+#define IFCONFIG_STAT_SOCKET		((unsigned long)-1)
+/** Dumping the interface list (snapshots, name cache, watchers). */
+#define IFCONFIG_STAT_IFLIST		((unsigned long)-2)
+/** Looking up a driver name. */
+#define IFCONFIG_STAT_DRIVERNAME	((unsigned long)-3)
+/** Submitting a batch the backend runs as a whole. Errors counts batches
+ * in which at least one operation failed. */
+#define IFCONFIG_STAT_BATCH		((unsigned long)-4)
+/** Dumping the addresses of an interface. */
+#define IFCONFIG_STAT_ADDRLIST		((unsigned long)-5)
+/** Reading the traffic counters of all interfaces. */
+#define IFCONFIG_STAT_COUNTERS		((unsigned long)-6)
+
+struct ifconfig_stat {
+	/** SIOC* code or IFCONFIG_STAT_* */
+	unsigned long request;
+	uint64_t calls;
+	uint64_t errors;
+	/** Latency, in nanoseconds. */
+	uint64_t total_ns;
+	uint64_t max_ns;
+};
+
+/** Copies the statistics of up to n request codes into stats.
+ * Example usage:
+ *{@code
+ * struct ifconfig_stat stats[32];
+ * int n;
+ *
+ * n = ifconfig_stats_get(lifh, stats, 32);
+ * for (int i = 0; i < n && i < 32; i++) {
+ *     printf("%#lx: %ju calls, %ju ns max\n", stats[i].request,
+ *         (uintmax_t)stats[i].calls, (uintmax_t)stats[i].max_ns);
+ * }
+ *}
+ * @return Number of request codes with statistics, which may exceed n,
+ *     or -1 on failure.
+ */
+int ifconfig_stats_get(ifconfig_handle_t *h, struct ifconfig_stat *stats,
+    size_t n);
+
+/** Clears the statistics of a handle. */
+void ifconfig_stats_reset(ifconfig_handle_t *h);
+
+/*
+ * Simulated kernel: an interface table in memory that a handle can be
+ * attached to instead of the real kernel. Every request code the library
+ * uses is implemented, as are interface lists, driver names (the cloner
+ * name) and link notifications. Latency and failures can be injected, so
+ * the library's own costs can be measured apart from the kernel's, and
+ * error paths tested, at any scale.
+ *
+ * A new simulator has one interface, "lo0". One simulator may serve any
+ * number of handles and threads.
+ */
+typedef struct ifconfig_sim ifconfig_sim_t;
+
+ifconfig_sim_t *ifconfig_sim_new(void);
+
+/** Frees the simulator. Handles attached to it must be closed first. */
+void ifconfig_sim_free(ifconfig_sim_t *sim);
+
+/** Makes h talk to sim instead of the kernel. Call right after
+ * ifconfig_open() or ifconfig_open_shared().
+ */
+int ifconfig_sim_attach(ifconfig_handle_t *h, ifconfig_sim_t *sim);
+
+/** Creates n interfaces named after kind, as if with
+ * ifconfig_create_interface(). Fails with errno set.
+ */
+int ifconfig_sim_populate(ifconfig_sim_t *sim, const char *kind, size_t n);
+
+/** Number of interfaces in the simulator. */
+size_t ifconfig_sim_count(ifconfig_sim_t *sim);
+
+/** Sets the traffic counters of an interface; index and name are ignored.
+ * Fails with errno ENXIO if there's no such interface.
+ */
+int ifconfig_sim_set_counters(ifconfig_sim_t *sim, const char *name,
+    const struct ifconfig_ifcounters *counters);
+
+/** Time every request takes. Waits of 50us and more sleep, shorter ones
+ * spin. Requests from different threads wait concurrently. 0 to disable.
+ */
+void ifconfig_sim_set_latency(ifconfig_sim_t *sim, const uint64_t ns);
+
+/** Makes every nth request with the given code fail with errcode.
+ * @param request SIOC* code, IFCONFIG_STAT_IFLIST,
+ *     IFCONFIG_STAT_DRIVERNAME, IFCONFIG_STAT_ADDRLIST,
+ *     IFCONFIG_STAT_COUNTERS, or 0 for any request.
+ * @return 0, or -1 with errno set if the rule table is full.
+ */
+int ifconfig_sim_add_fault(ifconfig_sim_t *sim, const unsigned long request,
+    const int errcode, const unsigned int every);
+
+/** Removes all fault rules. */
+void ifconfig_sim_clear_faults(ifconfig_sim_t *sim);
+
+__END_DECLS
@@ -0,0 +1,517 @@
+/*
+ * Copyright (c) 2016-2017, Marie Helene Kvello-Aune
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * thislist of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+
+/*
+ * C++17 interface to libifconfig, in this header only.
+ *
+ * A Handle owns a state object and closes it when destroyed. Its methods
+ * take names as std::string_view and return a Result: the value, or the
+ * Error the state object recorded. Strings come back as views into a
+ * buffer the Handle keeps and reuses, so once it has grown to fit, calls
+ * allocate nothing the C functions don't.
+ */
+
+#pragma once
+
+#include <cerrno>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "libifconfig.h"
+
+namespace ifconfig {
+
+/** A failure, as reported by ifconfig_err_errtype() and friends. */
+struct Error {
+	ifconfig_errtype type;
+	int errcode;
+	/** The request that failed, if type is IOCTL. */
+	unsigned long ioctlreq;
+
+	static Error
+	from(ifconfig_handle_t *h) noexcept
+	{
+
+		return (Error{ ifconfig_err_errtype(h), ifconfig_err_errno(h),
+		    ifconfig_err_ioctlreq(h) });
+	}
+};
+
+/**
+ * A value or the Error that prevented it, shaped like C++23's
+ * std::expected. Nothing is thrown: test it before dereferencing.
+ */
+template <typename T>
+class Result {
+public:
+	Result(const T &value) : v_(std::in_place_index<0>, value) {}
+	Result(T &&value) : v_(std::in_place_index<0>, std::move(value)) {}
+	Result(const Error &error) noexcept :
+	    v_(std::in_place_index<1>, error) {}
+
+	bool has_value() const noexcept { return (v_.index() == 0); }
+	explicit operator bool() const noexcept { return (has_value()); }
+
+	T &operator*() & noexcept { return (*std::get_if<0>(&v_)); }
+	const T &operator*() const & noexcept { return (*std::get_if<0>(&v_)); }
+	T &&operator*() && noexcept { return (std::move(**this)); }
+	T *operator->() noexcept { return (std::get_if<0>(&v_)); }
+	const T *operator->() const noexcept { return (std::get_if<0>(&v_)); }
+
+	template <typename U>
+	T
+	value_or(U &&other) const &
+	{
+
+		return (has_value() ? **this :
+		    static_cast<T>(std::forward<U>(other)));
+	}
+
+	/** Only valid if there is no value. */
+	const Error &error() const noexcept { return (*std::get_if<1>(&v_)); }
+
+private:
+	std::variant<T, Error> v_;
+};
+
+/** Outcome of a call that returns nothing. */
+template <>
+class Result<void> {
+public:
+	Result() noexcept : ok_(true), error_() {}
+	Result(const Error &error) noexcept : ok_(false), error_(error) {}
+
+	bool has_value() const noexcept { return (ok_); }
+	explicit operator bool() const noexcept { return (ok_); }
+	const Error &error() const noexcept { return (error_); }
+
+private:
+	bool ok_;
+	Error error_;
+};
+
+/**
+ * Owner of a state object from ifconfig_open(). Move-only. Like the state
+ * object, a Handle is for one thread at a time; views it returns stay
+ * valid until its next call.
+ */
+class Handle {
+public:
+	Handle() noexcept : h_(nullptr) {}
+	/** Takes ownership of h. */
+	explicit Handle(ifconfig_handle_t *h) noexcept : h_(h) {}
+	Handle(const Handle &) = delete;
+	Handle &operator=(const Handle &) = delete;
+
+	Handle(Handle &&other) noexcept :
+	    h_(std::exchange(other.h_, nullptr)),
+	    buf_(std::move(other.buf_)), str_(std::move(other.str_)) {}
+
+	Handle &
+	operator=(Handle &&other) noexcept
+	{
+
+		if (this != &other) {
+			reset(std::exchange(other.h_, nullptr));
+			buf_ = std::move(other.buf_);
+			str_ = std::move(other.str_);
+		}
+		return (*this);
+	}
+
+	~Handle() { reset(); }
+
+	static Result<Handle>
+	open()
+	{
+		ifconfig_handle_t *h;
+
+		if ((h = ifconfig_open()) == nullptr) {
+			return (Error{ OTHER, ENOMEM, 0 });
+		}
+		return (Handle(h));
+	}
+
+	ifconfig_handle_t *get() const noexcept { return (h_); }
+	explicit operator bool() const noexcept { return (h_ != nullptr); }
+
+	/** Gives up ownership of the state object without closing it. */
+	ifconfig_handle_t *
+	release() noexcept
+	{
+
+		return (std::exchange(h_, nullptr));
+	}
+
+	/** Closes the state object, if any, and takes ownership of h. */
+	void
+	reset(ifconfig_handle_t *h = nullptr) noexcept
+	{
+
+		if (h_ != nullptr) {
+			ifconfig_close(h_);
+		}
+		h_ = h;
+	}
+
+	Result<int>
+	mtu(std::string_view name)
+	{
+		Name n;
+		int mtu;
+
+		if (!n.set(name)) {
+			return (n.error());
+		}
+		if (ifconfig_get_mtu(h_, n, &mtu) != 0) {
+			return (fail());
+		}
+		return (mtu);
+	}
+
+	Result<void>
+	set_mtu(std::string_view name, const int mtu)
+	{
+		Name n;
+
+		if (!n.set(name)) {
+			return (n.error());
+		}
+		return (check(ifconfig_set_mtu(h_, n, mtu)));
+	}
+
+	Result<int>
+	metric(std::string_view name)
+	{
+		Name n;
+		int metric;
+
+		if (!n.set(name)) {
+			return (n.error());
+		}
+		if (ifconfig_get_metric(h_, n, &metric) != 0) {
+			return (fail());
+		}
+		return (metric);
+	}
+
+	Result<void>
+	set_metric(std::string_view name, const int metric)
+	{
+		Name n;
+
+		if (!n.set(name)) {
+			return (n.error());
+		}
+		return (check(ifconfig_set_metric(h_, n, metric)));
+	}
+
+	Result<ifconfig_capabilities>
+	capability(std::string_view name)
+	{
+		struct ifconfig_capabilities cap;
+		Name n;
+
+		if (!n.set(name)) {
+			return (n.error());
+		}
+		if (ifconfig_get_capability(h_, n, &cap) != 0) {
+			return (fail());
+		}
+		return (cap);
+	}
+
+	Result<void>
+	set_capability(std::string_view name, const int capability)
+	{
+		Name n;
+
+		if (!n.set(name)) {
+			return (n.error());
+		}
+		return (check(ifconfig_set_capability(h_, n, capability)));
+	}
+
+	Result<void>
+	set_capabilities(std::string_view name, const int set, const int clear)
+	{
+		Name n;
+
+		if (!n.set(name)) {
+			return (n.error());
+		}
+		return (check(ifconfig_set_capabilities(h_, n, set, clear)));
+	}
+
+	/** The description, or an empty view if there is none. */
+	Result<std::string_view>
+	description(std::string_view name)
+	{
+		Name n;
+
+		if (!n.set(name)) {
+			return (n.error());
+		}
+		return (into_buf([&] {
+			return (ifconfig_get_description_r(h_, n,
+			    buf_.data(), buf_.size()));
+		}));
+	}
+
+	/** An empty description unsets it. */
+	Result<void>
+	set_description(std::string_view name, std::string_view description)
+	{
+		Name n;
+
+		if (!n.set(name)) {
+			return (n.error());
+		}
+		str_.assign(description);
+		return (check(ifconfig_set_description(h_, n, str_.c_str())));
+	}
+
+	Result<void>
+	unset_description(std::string_view name)
+	{
+		Name n;
+
+		if (!n.set(name)) {
+			return (n.error());
+		}
+		return (check(ifconfig_unset_description(h_, n)));
+	}
+
+	Result<std::string_view>
+	orig_name(std::string_view name)
+	{
+		Name n;
+
+		if (!n.set(name)) {
+			return (n.error());
+		}
+		return (into_buf([&] {
+			return (ifconfig_get_orig_name_r(h_, n, buf_.data(),
+			    buf_.size()));
+		}));
+	}
+
+	Result<void>
+	set_name(std::string_view name, std::string_view newname)
+	{
+		Name n, nn;
+
+		if (!n.set(name)) {
+			return (n.error());
+		}
+		if (!nn.set(newname)) {
+			return (nn.error());
+		}
+		return (check(ifconfig_set_name(h_, n, nn)));
+	}
+
+	/** Creates an interface and returns the name it got. */
+	Result<std::string_view>
+	create_interface(std::string_view name)
+	{
+		Name n;
+
+		if (!n.set(name)) {
+			return (n.error());
+		}
+		return (into_buf([&] {
+			return (ifconfig_create_interface_r(h_, n,
+			    buf_.data(), buf_.size()));
+		}));
+	}
+
+	Result<std::string_view>
+	create_interface_vlan(std::string_view name, std::string_view vlandev,
+	    const unsigned short vlantag)
+	{
+		Name n, dev;
+
+		if (!n.set(name)) {
+			return (n.error());
+		}
+		if (!dev.set(vlandev)) {
+			return (dev.error());
+		}
+		return (into_buf([&] {
+			return (ifconfig_create_interface_vlan_r(h_, n,
+			    buf_.data(), buf_.size(), dev, vlantag));
+		}));
+	}
+
+	Result<void>
+	destroy_interface(std::string_view name)
+	{
+		Name n;
+
+		if (!n.set(name)) {
+			return (n.error());
+		}
+		return (check(ifconfig_destroy_interface(h_, n)));
+	}
+
+	Result<void>
+	set_vlantag(std::string_view name, std::string_view vlandev,
+	    const unsigned short vlantag)
+	{
+		Name n, dev;
+
+		if (!n.set(name)) {
+			return (n.error());
+		}
+		if (!dev.set(vlandev)) {
+			return (dev.error());
+		}
+		return (check(ifconfig_set_vlantag(h_, n, dev, vlantag)));
+	}
+
+	Result<void>
+	add_addr(std::string_view name, const struct ifconfig_addr &addr)
+	{
+		Name n;
+
+		if (!n.set(name)) {
+			return (n.error());
+		}
+		return (check(ifconfig_add_addr(h_, n, &addr)));
+	}
+
+	Result<void>
+	delete_addr(std::string_view name, const struct ifconfig_addr &addr)
+	{
+		Name n;
+
+		if (!n.set(name)) {
+			return (n.error());
+		}
+		return (check(ifconfig_delete_addr(h_, n, &addr)));
+	}
+
+	void cache_flush() noexcept { ifconfig_cache_flush(h_); }
+
+	Result<void>
+	attrcache_enable(const unsigned int ttl_ms,
+	    const int flags = 0) noexcept
+	{
+
+		return (check(ifconfig_attrcache_enable(h_, ttl_ms, flags)));
+	}
+
+	void attrcache_disable() noexcept { ifconfig_attrcache_disable(h_); }
+
+private:
+	/*
+	 * Interface name, NUL-terminated on the stack. Too long a name is
+	 * refused rather than truncated into another interface's.
+	 */
+	class Name {
+	public:
+		bool
+		set(std::string_view name) noexcept
+		{
+
+			if (name.size() >= sizeof(buf_)) {
+				return (false);
+			}
+			name.copy(buf_, name.size());
+			buf_[name.size()] = '\0';
+			return (true);
+		}
+
+		static Error
+		error() noexcept
+		{
+
+			return (Error{ OTHER, ENAMETOOLONG, 0 });
+		}
+
+		operator const char *() const noexcept { return (buf_); }
+
+	private:
+		char buf_[IFNAMSIZ];
+	};
+
+	Error fail() const noexcept { return (Error::from(h_)); }
+
+	Result<void>
+	check(const int error) const noexcept
+	{
+
+		if (error != 0) {
+			return (fail());
+		}
+		return (Result<void>());
+	}
+
+	/*
+	 * Runs get, one of the _r functions, with buf_ until the result fits.
+	 * A getter failing with errno 0 found nothing, which is returned as
+	 * an empty view. The buffer always holds an interface name, so a
+	 * create is never repeated.
+	 */
+	template <typename F>
+	Result<std::string_view>
+	into_buf(F get)
+	{
+
+		if (buf_.empty()) {
+			buf_.resize(256);
+		}
+		while (get() != 0) {
+			if (ifconfig_err_errtype(h_) != OTHER) {
+				return (fail());
+			}
+			switch (ifconfig_err_errno(h_)) {
+			case 0:
+				return (std::string_view());
+			case ERANGE:
+				buf_.resize(buf_.size() * 2);
+				break;
+			default:
+				return (fail());
+			}
+		}
+		return (std::string_view(buf_.data()));
+	}
+
+	ifconfig_handle_t *h_;
+	/** Reused for every string returned. */
+	std::vector<char> buf_;
+	/** Reused for every string passed in that isn't a name. */
+	std::string str_;
+};
+
+} /* namespace ifconfig */
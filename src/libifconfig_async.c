@@ -0,0 +1,565 @@
+/*
+ * Copyright (c) 2016-2017, Marie Helene Kvello-Aune
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * thislist of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+
+#include <sys/types.h>
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+
+#include <net/if.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libifconfig.h"
+#include "libifconfig_internal.h"
+
+/* Operations a worker takes at once; one pipelined batch on Linux. */
+#define ASYNC_CHUNK          64
+#define ASYNC_THREADS_MAX    16
+
+struct async_op {
+	struct ifconfig_batchop op;
+	ifconfig_ticket_t ticket;
+	/** Owned copy of a description being set. */
+	char *descr;
+	struct async_op *next;
+};
+
+struct async_worker {
+	struct ifconfig_async *a;
+	ifconfig_handle_t *h;
+	pthread_t thread;
+};
+
+struct ifconfig_async {
+	/** The caller's handle, for errors and its attribute cache. */
+	ifconfig_handle_t *h;
+	ifconfig_ticket_t next;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int stop;
+	/** FIFOs of submitted and completed operations, and spares. */
+	struct async_op *pending, **pendtail;
+	struct async_op *done, **donetail;
+	struct async_op *spare;
+	/** Submitted and not reaped yet. */
+	size_t inflight;
+
+	/** Readable while done isn't empty; fd[0] == fd[1] for an eventfd. */
+	int fd[2];
+
+	struct async_worker *workers;
+	unsigned int nworkers;
+};
+
+/* Makes the fd readable. Called with the lock held. */
+static void
+async_signal(struct ifconfig_async *a)
+{
+#if defined(__linux__)
+	uint64_t one = 1;
+
+	(void)write(a->fd[1], &one, sizeof(one));
+#else
+	(void)write(a->fd[1], "", 1);
+#endif
+}
+
+/* Undoes async_signal(). Called with the lock held. */
+static void
+async_drain(struct ifconfig_async *a)
+{
+#if defined(__linux__)
+	uint64_t n;
+
+	(void)read(a->fd[0], &n, sizeof(n));
+#else
+	char buf[64];
+
+	while (read(a->fd[0], buf, sizeof(buf)) > 0) {
+		continue;
+	}
+#endif
+}
+
+static int
+async_openfd(struct ifconfig_async *a)
+{
+#if defined(__linux__)
+	if ((a->fd[0] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) == -1) {
+		return (-1);
+	}
+	a->fd[1] = a->fd[0];
+	return (0);
+#else
+	if (pipe(a->fd) != 0) {
+		a->fd[0] = a->fd[1] = -1;
+		return (-1);
+	}
+	for (int i = 0; i < 2; i++) {
+		(void)fcntl(a->fd[i], F_SETFD, FD_CLOEXEC);
+		(void)fcntl(a->fd[i], F_SETFL, O_NONBLOCK);
+	}
+	return (0);
+#endif
+}
+
+static void
+async_oplist_free(struct async_op *op)
+{
+	struct async_op *next;
+
+	for (; op != NULL; op = next) {
+		next = op->next;
+		free(op->descr);
+		free(op);
+	}
+}
+
+/*
+ * Takes up to ASYNC_CHUNK operations off the queue at a time and runs
+ * them as one batch on the worker's handle, so that the backend can
+ * pipeline them.
+ */
+static void *
+async_main(void *arg)
+{
+	struct ifconfig_batchop ops[ASYNC_CHUNK];
+	struct async_op *taken[ASYNC_CHUNK];
+	struct async_worker *w;
+	struct ifconfig_async *a;
+	size_t n;
+
+	w = arg;
+	a = w->a;
+	(void)pthread_mutex_lock(&a->lock);
+	for (;;) {
+		while (a->pending == NULL && !a->stop) {
+			(void)pthread_cond_wait(&a->cond, &a->lock);
+		}
+		if (a->stop) {
+			break;
+		}
+		for (n = 0; n < ASYNC_CHUNK && a->pending != NULL; n++) {
+			taken[n] = a->pending;
+			a->pending = taken[n]->next;
+			ops[n] = taken[n]->op;
+		}
+		if (a->pending == NULL) {
+			a->pendtail = &a->pending;
+		}
+		(void)pthread_mutex_unlock(&a->lock);
+
+		ifconfig_batch_run(w->h, ops, n);
+
+		(void)pthread_mutex_lock(&a->lock);
+		if (a->done == NULL) {
+			async_signal(a);
+		}
+		for (size_t i = 0; i < n; i++) {
+			taken[i]->op = ops[i];
+			taken[i]->next = NULL;
+			*a->donetail = taken[i];
+			a->donetail = &taken[i]->next;
+		}
+	}
+	(void)pthread_mutex_unlock(&a->lock);
+	return (NULL);
+}
+
+static unsigned int
+async_nthreads(unsigned int nthreads)
+{
+	long ncpu;
+
+	if (nthreads == 0) {
+		ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = (ncpu > 0) ? ncpu : 1;
+	}
+	if (nthreads > ASYNC_THREADS_MAX) {
+		nthreads = ASYNC_THREADS_MAX;
+	}
+	return (nthreads);
+}
+
+int
+ifconfig_async_new(ifconfig_handle_t *h, const unsigned int nthreads,
+    ifconfig_async_t **ap)
+{
+	struct ifconfig_async *a;
+	struct async_worker *w;
+	unsigned int n;
+	int error;
+
+	if ((a = calloc(1, sizeof(*a))) == NULL) {
+		error = ENOMEM;
+		goto fail;
+	}
+	a->fd[0] = a->fd[1] = -1;
+	a->h = h;
+	a->pendtail = &a->pending;
+	a->donetail = &a->done;
+	(void)pthread_mutex_init(&a->lock, NULL);
+	(void)pthread_cond_init(&a->cond, NULL);
+	if (async_openfd(a) != 0) {
+		error = errno;
+		goto fail;
+	}
+
+	/* Private handles, as the workers run at the same time. */
+	n = async_nthreads(nthreads);
+	if ((a->workers = calloc(n, sizeof(*a->workers))) == NULL) {
+		error = ENOMEM;
+		goto fail;
+	}
+	for (; a->nworkers < n; a->nworkers++) {
+		w = &a->workers[a->nworkers];
+		w->a = a;
+		if ((w->h = ifconfig_open_worker(h)) == NULL) {
+			error = ENOMEM;
+			goto fail;
+		}
+		if ((error = pthread_create(&w->thread, NULL, async_main,
+		    w)) != 0) {
+			ifconfig_close(w->h);
+			goto fail;
+		}
+	}
+
+	*ap = a;
+	return (0);
+
+fail:
+	ifconfig_async_free(a);
+	ifconfig_errstate(h)->errtype = OTHER;
+	ifconfig_errstate(h)->errcode = error;
+	return (-1);
+}
+
+void
+ifconfig_async_free(ifconfig_async_t *a)
+{
+
+	if (a == NULL) {
+		return;
+	}
+	(void)pthread_mutex_lock(&a->lock);
+	a->stop = 1;
+	(void)pthread_cond_broadcast(&a->cond);
+	(void)pthread_mutex_unlock(&a->lock);
+	for (unsigned int i = 0; i < a->nworkers; i++) {
+		(void)pthread_join(a->workers[i].thread, NULL);
+		ifconfig_close(a->workers[i].h);
+	}
+	free(a->workers);
+
+	async_oplist_free(a->pending);
+	async_oplist_free(a->done);
+	async_oplist_free(a->spare);
+	if (a->fd[0] != -1) {
+		(void)close(a->fd[0]);
+	}
+	if (a->fd[1] != a->fd[0]) {
+		(void)close(a->fd[1]);
+	}
+	(void)pthread_cond_destroy(&a->cond);
+	(void)pthread_mutex_destroy(&a->lock);
+	free(a);
+}
+
+int
+ifconfig_async_fd(const ifconfig_async_t *a)
+{
+
+	return (a->fd[0]);
+}
+
+size_t
+ifconfig_async_inflight(const ifconfig_async_t *a)
+{
+
+	return (a->inflight);
+}
+
+/* A new operation on interface name, or NULL without memory. */
+static struct async_op *
+async_op(ifconfig_async_t *a, unsigned long request, const char *name)
+{
+	struct async_op *op;
+
+	(void)pthread_mutex_lock(&a->lock);
+	if ((op = a->spare) != NULL) {
+		a->spare = op->next;
+	}
+	(void)pthread_mutex_unlock(&a->lock);
+	if (op == NULL && (op = malloc(sizeof(*op))) == NULL) {
+		ifconfig_errstate(a->h)->errtype = OTHER;
+		ifconfig_errstate(a->h)->errcode = ENOMEM;
+		return (NULL);
+	}
+	memset(op, 0, sizeof(*op));
+	op->op.request = request;
+	op->op.status = IFCONFIG_BATCH_PENDING;
+	(void)strlcpy(op->op.req.ifcr_name, name, sizeof(op->op.req.ifcr_name));
+	return (op);
+}
+
+static int
+async_queue(ifconfig_async_t *a, struct async_op *op,
+    ifconfig_ticket_t *ticket)
+{
+
+	op->ticket = ++a->next;
+	if (ticket != NULL) {
+		*ticket = op->ticket;
+	}
+	a->inflight++;
+	(void)pthread_mutex_lock(&a->lock);
+	*a->pendtail = op;
+	a->pendtail = &op->next;
+	(void)pthread_cond_signal(&a->cond);
+	(void)pthread_mutex_unlock(&a->lock);
+	return (0);
+}
+
+size_t
+ifconfig_async_reap(ifconfig_async_t *a, struct ifconfig_completion *c,
+    const size_t n)
+{
+	struct async_op *op, *head, **tail;
+	size_t count;
+
+	(void)pthread_mutex_lock(&a->lock);
+	head = a->done;
+	tail = &a->done;
+	for (count = 0; count < n && *tail != NULL; count++) {
+		tail = &(*tail)->next;
+	}
+	a->done = *tail;
+	*tail = NULL;
+	if (a->done == NULL) {
+		a->donetail = &a->done;
+		async_drain(a);
+	}
+	(void)pthread_mutex_unlock(&a->lock);
+
+	op = head;
+	for (size_t i = 0; i < count; i++, op = op->next) {
+		c[i].ticket = op->ticket;
+		(void)strlcpy(c[i].name, op->op.req.ifcr_name,
+		    sizeof(c[i].name));
+		if (op->op.status == IFCONFIG_BATCH_DONE) {
+			c[i].error = 0;
+			c[i].errtype = OTHER;
+			c[i].errcode = 0;
+			c[i].ioctlreq = 0;
+		} else {
+			c[i].error = -1;
+			c[i].errtype = op->op.error.errtype;
+			c[i].errcode = op->op.error.errcode;
+			c[i].ioctlreq = op->op.error.ioctl_request;
+		}
+		if (__atomic_load_n(&a->h->attrcache.enabled,
+		    __ATOMIC_ACQUIRE)) {
+			ifconfig_attrcache_put(a->h, op->op.request,
+			    &op->op.req, c[i].error, 0);
+		}
+		free(op->descr);
+		op->descr = NULL;
+	}
+	a->inflight -= count;
+
+	/* Kept for reuse; tail is the last one's next pointer. */
+	if (count > 0) {
+		(void)pthread_mutex_lock(&a->lock);
+		*tail = a->spare;
+		a->spare = head;
+		(void)pthread_mutex_unlock(&a->lock);
+	}
+	return (count);
+}
+
+int
+ifconfig_submit_set_mtu(ifconfig_async_t *a, const char *name, const int mtu,
+    ifconfig_ticket_t *ticket)
+{
+	struct async_op *op;
+
+	if ((op = async_op(a, SIOCSIFMTU, name)) == NULL) {
+		return (-1);
+	}
+	op->op.req.ifcr_mtu = mtu;
+	return (async_queue(a, op, ticket));
+}
+
+int
+ifconfig_submit_set_metric(ifconfig_async_t *a, const char *name,
+    const int metric, ifconfig_ticket_t *ticket)
+{
+	struct async_op *op;
+
+	if ((op = async_op(a, SIOCSIFMETRIC, name)) == NULL) {
+		return (-1);
+	}
+	op->op.req.ifcr_metric = metric;
+	return (async_queue(a, op, ticket));
+}
+
+int
+ifconfig_submit_set_description(ifconfig_async_t *a, const char *name,
+    const char *newdescription, ifconfig_ticket_t *ticket)
+{
+	struct async_op *op;
+
+	if ((op = async_op(a, SIOCSIFDESCR, name)) == NULL) {
+		return (-1);
+	}
+	/* As with ifconfig_set_description(), empty means unset. */
+	if (newdescription[0] != '\0') {
+		if ((op->descr = strdup(newdescription)) == NULL) {
+			free(op);
+			ifconfig_errstate(a->h)->errtype = OTHER;
+			ifconfig_errstate(a->h)->errcode = ENOMEM;
+			return (-1);
+		}
+		op->op.req.ifcr_buffer.buffer = op->descr;
+		op->op.req.ifcr_buffer.length = strlen(op->descr) + 1;
+	}
+	return (async_queue(a, op, ticket));
+}
+
+int
+ifconfig_submit_set_name(ifconfig_async_t *a, const char *name,
+    const char *newname, ifconfig_ticket_t *ticket)
+{
+	struct async_op *op;
+
+	if ((op = async_op(a, SIOCSIFNAME, name)) == NULL) {
+		return (-1);
+	}
+	(void)strlcpy(op->op.req.ifcr_newname, newname,
+	    sizeof(op->op.req.ifcr_newname));
+	return (async_queue(a, op, ticket));
+}
+
+int
+ifconfig_submit_create_interface(ifconfig_async_t *a, const char *name,
+    ifconfig_ticket_t *ticket)
+{
+	struct async_op *op;
+
+	if ((op = async_op(a, SIOCIFCREATE2, name)) == NULL) {
+		return (-1);
+	}
+	return (async_queue(a, op, ticket));
+}
+
+int
+ifconfig_submit_create_interface_vlan(ifconfig_async_t *a, const char *name,
+    const char *vlandev, const unsigned short vlantag,
+    ifconfig_ticket_t *ticket)
+{
+	struct async_op *op;
+
+	if ((op = async_op(a, SIOCIFCREATE2, name)) == NULL) {
+		return (-1);
+	}
+	(void)strlcpy(op->op.req.ifcr_vlanparent, vlandev,
+	    sizeof(op->op.req.ifcr_vlanparent));
+	op->op.req.ifcr_vlantag = vlantag;
+	return (async_queue(a, op, ticket));
+}
+
+int
+ifconfig_submit_destroy_interface(ifconfig_async_t *a, const char *name,
+    ifconfig_ticket_t *ticket)
+{
+	struct async_op *op;
+
+	if ((op = async_op(a, SIOCIFDESTROY, name)) == NULL) {
+		return (-1);
+	}
+	return (async_queue(a, op, ticket));
+}
+
+int
+ifconfig_submit_set_vlantag(ifconfig_async_t *a, const char *name,
+    const char *vlandev, const unsigned short vlantag,
+    ifconfig_ticket_t *ticket)
+{
+	struct async_op *op;
+
+	if ((op = async_op(a, SIOCSETVLAN, name)) == NULL) {
+		return (-1);
+	}
+	(void)strlcpy(op->op.req.ifcr_vlanparent, vlandev,
+	    sizeof(op->op.req.ifcr_vlanparent));
+	op->op.req.ifcr_vlantag = vlantag;
+	return (async_queue(a, op, ticket));
+}
+
+static int
+async_addr(ifconfig_async_t *a, const char *name,
+    const struct ifconfig_addr *addr, const int add,
+    ifconfig_ticket_t *ticket)
+{
+	struct async_op *op;
+	struct ifconfig_req req;
+	unsigned long request;
+
+	if (ifconfig_addrreq(a->h, name, addr, add, &req, &request) != 0 ||
+	    (op = async_op(a, request, name)) == NULL) {
+		return (-1);
+	}
+	op->op.req = req;
+	return (async_queue(a, op, ticket));
+}
+
+int
+ifconfig_submit_add_addr(ifconfig_async_t *a, const char *name,
+    const struct ifconfig_addr *addr, ifconfig_ticket_t *ticket)
+{
+
+	return (async_addr(a, name, addr, 1, ticket));
+}
+
+int
+ifconfig_submit_delete_addr(ifconfig_async_t *a, const char *name,
+    const struct ifconfig_addr *addr, ifconfig_ticket_t *ticket)
+{
+
+	return (async_addr(a, name, addr, 0, ticket));
+}
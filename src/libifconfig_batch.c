@@ -0,0 +1,677 @@
+/*
+ * Copyright (c) 2016-2017, Marie Helene Kvello-Aune
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * thislist of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#include <sys/types.h>
+#include <sys/ioctl.h>
+
+#include <net/if.h>
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libifconfig.h"
+#include "libifconfig_internal.h"
+
+/* What it takes to revert one operation. request is 0 if nothing. */
+struct batch_undo {
+	unsigned long request;
+	struct ifconfig_req req;
+	char *descr;
+};
+
+/* Per-operation state the backends don't need to see. */
+struct batch_extra {
+	/* Owned copy of the queued description. */
+	char *descr;
+	/* Arguments to ifconfig_batch_set_capabilities(). */
+	int capset;
+	int capclear;
+	struct batch_undo undo;
+};
+
+struct ifconfig_batch {
+	ifconfig_handle_t *h;
+	struct ifconfig_batchop *ops;
+	struct batch_extra *extra;
+	size_t count;
+	size_t size;
+};
+
+ifconfig_batch_t *
+ifconfig_batch_new(ifconfig_handle_t *h)
+{
+	struct ifconfig_batch *b;
+
+	b = calloc(1, sizeof(*b));
+	if (b == NULL) {
+		ifconfig_errstate(h)->errtype = OTHER;
+		ifconfig_errstate(h)->errcode = ENOMEM;
+		return (NULL);
+	}
+	b->h = h;
+	return (b);
+}
+
+static void
+batch_clear_undo(struct batch_extra *extra)
+{
+
+	free(extra->undo.descr);
+	memset(&extra->undo, 0, sizeof(extra->undo));
+}
+
+void
+ifconfig_batch_free(ifconfig_batch_t *b)
+{
+
+	if (b == NULL) {
+		return;
+	}
+	for (size_t i = 0; i < b->count; i++) {
+		free(b->extra[i].descr);
+		batch_clear_undo(&b->extra[i]);
+	}
+	free(b->ops);
+	free(b->extra);
+	free(b);
+}
+
+static struct ifconfig_batchop *
+batch_add(ifconfig_batch_t *b, unsigned long request, const char *name)
+{
+	struct ifconfig_batchop *ops, *op;
+	struct batch_extra *extra;
+	size_t newsize;
+
+	if (b->count == b->size) {
+		newsize = (b->size == 0) ? 16 : b->size * 2;
+		ops = reallocarray(b->ops, newsize, sizeof(*b->ops));
+		if (ops == NULL) {
+			goto nomem;
+		}
+		b->ops = ops;
+		extra = reallocarray(b->extra, newsize, sizeof(*b->extra));
+		if (extra == NULL) {
+			goto nomem;
+		}
+		b->extra = extra;
+		b->size = newsize;
+	}
+
+	op = &b->ops[b->count];
+	memset(op, 0, sizeof(*op));
+	memset(&b->extra[b->count], 0, sizeof(b->extra[b->count]));
+	op->request = request;
+	(void)strlcpy(op->req.ifcr_name, name, sizeof(op->req.ifcr_name));
+	b->count++;
+	return (op);
+
+nomem:
+	ifconfig_errstate(b->h)->errtype = OTHER;
+	ifconfig_errstate(b->h)->errcode = ENOMEM;
+	return (NULL);
+}
+
+int
+ifconfig_batch_set_mtu(ifconfig_batch_t *b, const char *name, const int mtu)
+{
+	struct ifconfig_batchop *op;
+
+	if ((op = batch_add(b, SIOCSIFMTU, name)) == NULL) {
+		return (-1);
+	}
+	op->req.ifcr_mtu = mtu;
+	return (0);
+}
+
+int
+ifconfig_batch_set_description(ifconfig_batch_t *b, const char *name,
+    const char *newdescription)
+{
+	struct ifconfig_batchop *op;
+	char *descr;
+
+	/* As with ifconfig_set_description(), empty means unset. */
+	descr = NULL;
+	if (newdescription[0] != '\0' &&
+	    (descr = strdup(newdescription)) == NULL) {
+		ifconfig_errstate(b->h)->errtype = OTHER;
+		ifconfig_errstate(b->h)->errcode = ENOMEM;
+		return (-1);
+	}
+
+	if ((op = batch_add(b, SIOCSIFDESCR, name)) == NULL) {
+		free(descr);
+		return (-1);
+	}
+	b->extra[b->count - 1].descr = descr;
+	if (descr != NULL) {
+		op->req.ifcr_buffer.buffer = descr;
+		op->req.ifcr_buffer.length = strlen(descr) + 1;
+	}
+	return (0);
+}
+
+int
+ifconfig_batch_set_name(ifconfig_batch_t *b, const char *name,
+    const char *newname)
+{
+	struct ifconfig_batchop *op;
+
+	if ((op = batch_add(b, SIOCSIFNAME, name)) == NULL) {
+		return (-1);
+	}
+	(void)strlcpy(op->req.ifcr_newname, newname,
+	    sizeof(op->req.ifcr_newname));
+	return (0);
+}
+
+int
+ifconfig_batch_set_capability(ifconfig_batch_t *b, const char *name,
+    const int capability)
+{
+
+	if (capability < 0) {
+		return (ifconfig_batch_set_capabilities(b, name, 0,
+		    -capability));
+	}
+	return (ifconfig_batch_set_capabilities(b, name, capability, 0));
+}
+
+int
+ifconfig_batch_set_capabilities(ifconfig_batch_t *b, const char *name,
+    const int set, const int clear)
+{
+
+	if (batch_add(b, SIOCSIFCAP, name) == NULL) {
+		return (-1);
+	}
+	b->extra[b->count - 1].capset = set;
+	b->extra[b->count - 1].capclear = clear;
+	return (0);
+}
+
+static int
+batch_addr(ifconfig_batch_t *b, const char *name,
+    const struct ifconfig_addr *addr, const int add)
+{
+	struct ifconfig_batchop *op;
+	struct ifconfig_req req;
+	unsigned long request;
+
+	if (ifconfig_addrreq(b->h, name, addr, add, &req, &request) != 0 ||
+	    (op = batch_add(b, request, name)) == NULL) {
+		return (-1);
+	}
+	op->req = req;
+	return (0);
+}
+
+int
+ifconfig_batch_add_addr(ifconfig_batch_t *b, const char *name,
+    const struct ifconfig_addr *addr)
+{
+
+	return (batch_addr(b, name, addr, 1));
+}
+
+int
+ifconfig_batch_delete_addr(ifconfig_batch_t *b, const char *name,
+    const struct ifconfig_addr *addr)
+{
+
+	return (batch_addr(b, name, addr, 0));
+}
+
+void
+ifconfig_batch_run(ifconfig_handle_t *h, struct ifconfig_batchop *ops,
+    size_t nops)
+{
+	struct ifconfig_batchop *op;
+	uint64_t start;
+	unsigned int gen;
+	int error;
+
+	if (h->backend->submit != NULL) {
+		gen = __atomic_load_n(&h->attrcache.gen, __ATOMIC_ACQUIRE);
+		start = ifconfig_stats_start();
+		error = h->backend->submit(h, ops, nops);
+		for (size_t i = 0; i < nops; i++) {
+			if (ops[i].status == IFCONFIG_BATCH_FAILED) {
+				error = -1;
+			}
+		}
+		(void)ifconfig_stats_record(h, IFCONFIG_STAT_BATCH, start,
+		    error);
+		if (!__atomic_load_n(&h->attrcache.enabled, __ATOMIC_ACQUIRE)) {
+			return;
+		}
+		for (size_t i = 0; i < nops; i++) {
+			ifconfig_attrcache_put(h, ops[i].request, &ops[i].req,
+			    ops[i].status == IFCONFIG_BATCH_DONE ? 0 : -1, gen);
+		}
+		return;
+	}
+
+	for (size_t i = 0; i < nops; i++) {
+		op = &ops[i];
+		if (op->status != IFCONFIG_BATCH_PENDING) {
+			continue;
+		}
+		/* Address requests need a socket of the address's family. */
+		if (ifconfig_ioctlwrap(h, op->req.ifcr_addr.family != 0 ?
+		    op->req.ifcr_addr.family : AF_LOCAL, op->request,
+		    &op->req) == 0) {
+			op->status = IFCONFIG_BATCH_DONE;
+		} else {
+			op->status = IFCONFIG_BATCH_FAILED;
+			op->error = *ifconfig_errstate(h);
+		}
+	}
+}
+
+/*
+ * Capabilities are a read-modify-write, so the current value is read
+ * here and also serves as the value to roll back to. Operations that
+ * wouldn't change anything are completed without a request.
+ */
+static int
+batch_prepare_capability(ifconfig_batch_t *b, size_t i)
+{
+	struct ifconfig_batchop *op;
+	struct batch_extra *extra;
+	struct ifconfig_capabilities ifcap;
+
+	op = &b->ops[i];
+	extra = &b->extra[i];
+	if (ifconfig_get_capability(b->h, op->req.ifcr_name, &ifcap) != 0) {
+		return (-1);
+	}
+
+	op->req.ifcr_reqcap = ifconfig_capmerge(&ifcap, extra->capset,
+	    extra->capclear);
+	if (op->req.ifcr_reqcap == ifcap.curcap) {
+		op->status = IFCONFIG_BATCH_DONE;
+		return (0);
+	}
+
+	extra->undo.request = SIOCSIFCAP;
+	extra->undo.req = op->req;
+	extra->undo.req.ifcr_reqcap = ifcap.curcap;
+	return (0);
+}
+
+static int
+batch_save_undo(ifconfig_batch_t *b, size_t i)
+{
+	struct ifconfig_batchop *op;
+	struct batch_undo *undo;
+	char *descr;
+
+	op = &b->ops[i];
+	undo = &b->extra[i].undo;
+	memset(&undo->req, 0, sizeof(undo->req));
+
+	switch (op->request) {
+	case SIOCSIFMTU:
+		(void)strlcpy(undo->req.ifcr_name, op->req.ifcr_name,
+		    sizeof(undo->req.ifcr_name));
+		if (ifconfig_get_mtu(b->h, op->req.ifcr_name,
+		    &undo->req.ifcr_mtu) != 0) {
+			return (-1);
+		}
+		break;
+	case SIOCSIFDESCR:
+		(void)strlcpy(undo->req.ifcr_name, op->req.ifcr_name,
+		    sizeof(undo->req.ifcr_name));
+		if (ifconfig_get_description(b->h, op->req.ifcr_name,
+		    &descr) == 0) {
+			undo->descr = descr;
+			undo->req.ifcr_buffer.buffer = descr;
+			undo->req.ifcr_buffer.length = strlen(descr) + 1;
+		} else if (ifconfig_errstate(b->h)->errtype != OTHER ||
+		    ifconfig_errstate(b->h)->errcode != 0) {
+			return (-1);
+		}
+		/* Otherwise there was no description; undo unsets it. */
+		break;
+	case SIOCSIFNAME:
+		(void)strlcpy(undo->req.ifcr_name, op->req.ifcr_newname,
+		    sizeof(undo->req.ifcr_name));
+		(void)strlcpy(undo->req.ifcr_newname, op->req.ifcr_name,
+		    sizeof(undo->req.ifcr_newname));
+		break;
+	/* Address requests are undone by the opposite request. */
+	case SIOCAIFADDR:
+		undo->req = op->req;
+		undo->request = SIOCDIFADDR;
+		return (0);
+	case SIOCDIFADDR:
+		undo->req = op->req;
+		undo->request = SIOCAIFADDR;
+		return (0);
+	case SIOCAIFADDR_IN6:
+		undo->req = op->req;
+		undo->request = SIOCDIFADDR_IN6;
+		return (0);
+	case SIOCDIFADDR_IN6:
+		undo->req = op->req;
+		undo->request = SIOCAIFADDR_IN6;
+		return (0);
+	}
+	undo->request = op->request;
+	return (0);
+}
+
+/* Reverts completed operations, last one first. */
+static void
+batch_rollback(ifconfig_batch_t *b)
+{
+	struct ifconfig_batchop *undo;
+	size_t *index;
+	size_t i, n;
+
+	undo = calloc(b->count, sizeof(*undo));
+	index = calloc(b->count, sizeof(*index));
+	if (undo == NULL || index == NULL) {
+		goto out;
+	}
+
+	n = 0;
+	for (i = b->count; i-- > 0;) {
+		if (b->ops[i].status != IFCONFIG_BATCH_DONE ||
+		    b->extra[i].undo.request == 0) {
+			continue;
+		}
+		undo[n].request = b->extra[i].undo.request;
+		undo[n].req = b->extra[i].undo.req;
+		undo[n].status = IFCONFIG_BATCH_PENDING;
+		index[n++] = i;
+	}
+
+	ifconfig_batch_run(b->h, undo, n);
+	for (i = 0; i < n; i++) {
+		if (undo[i].status == IFCONFIG_BATCH_DONE) {
+			b->ops[index[i]].status = IFCONFIG_BATCH_ROLLEDBACK;
+		}
+	}
+
+out:
+	free(undo);
+	free(index);
+}
+
+int
+ifconfig_batch_submit(ifconfig_batch_t *b, const int flags)
+{
+	struct ifconfig_batchop *op;
+	size_t i;
+	int failed;
+
+	failed = 0;
+	for (i = 0; i < b->count; i++) {
+		op = &b->ops[i];
+		op->status = IFCONFIG_BATCH_PENDING;
+		batch_clear_undo(&b->extra[i]);
+
+		if (op->request == SIOCSIFCAP) {
+			if (batch_prepare_capability(b, i) != 0) {
+				goto preparefail;
+			}
+		} else if ((flags & IFCONFIG_BATCH_ROLLBACK) &&
+		    batch_save_undo(b, i) != 0) {
+			goto preparefail;
+		}
+		continue;
+
+preparefail:
+		op->status = IFCONFIG_BATCH_FAILED;
+		op->error = *ifconfig_errstate(b->h);
+		failed = 1;
+	}
+
+	/* With rollback, nothing is applied unless every undo is known. */
+	if (!failed || !(flags & IFCONFIG_BATCH_ROLLBACK)) {
+		ifconfig_batch_run(b->h, b->ops, b->count);
+	}
+
+	for (i = 0; i < b->count; i++) {
+		if (b->ops[i].status == IFCONFIG_BATCH_FAILED) {
+			break;
+		}
+	}
+	if (i == b->count) {
+		return (0);
+	}
+
+	*ifconfig_errstate(b->h) = b->ops[i].error;
+	if (flags & IFCONFIG_BATCH_ROLLBACK) {
+		batch_rollback(b);
+	}
+	return (-1);
+}
+
+size_t
+ifconfig_batch_count(const ifconfig_batch_t *b)
+{
+
+	return (b->count);
+}
+
+ifconfig_batch_status
+ifconfig_batch_result(const ifconfig_batch_t *b, size_t i)
+{
+
+	return (b->ops[i].status);
+}
+
+ifconfig_errtype
+ifconfig_batch_err_errtype(const ifconfig_batch_t *b, size_t i)
+{
+
+	return (b->ops[i].error.errtype);
+}
+
+int
+ifconfig_batch_err_errno(const ifconfig_batch_t *b, size_t i)
+{
+
+	return (b->ops[i].error.errcode);
+}
+
+unsigned long
+ifconfig_batch_err_ioctlreq(const ifconfig_batch_t *b, size_t i)
+{
+
+	return (b->ops[i].error.ioctl_request);
+}
+
+int
+ifconfig_set_capabilities_bulk(ifconfig_handle_t *h,
+    const char *const *names, const size_t n, const int set,
+    const int clear, int *errors)
+{
+	ifconfig_batch_t *b;
+	int error;
+
+	if ((b = ifconfig_batch_new(h)) == NULL) {
+		return (-1);
+	}
+	for (size_t i = 0; i < n; i++) {
+		if (ifconfig_batch_set_capabilities(b, names[i], set,
+		    clear) != 0) {
+			ifconfig_batch_free(b);
+			return (-1);
+		}
+	}
+
+	error = ifconfig_batch_submit(b, 0);
+	for (size_t i = 0; errors != NULL && i < n; i++) {
+		errors[i] = (b->ops[i].status == IFCONFIG_BATCH_DONE) ? 0 :
+		    b->ops[i].error.errcode;
+	}
+	ifconfig_batch_free(b);
+	return (error);
+}
+
+/* Destroys the VLANs whose create operation completed. */
+static void
+vlans_rollback(ifconfig_handle_t *h, struct ifconfig_batchop *ops,
+    const size_t per, const char *names, const size_t n)
+{
+	struct ifconfig_batchop *op;
+	size_t i, nundo;
+
+	/* Reuses ops; entry nundo is never past the one being read. */
+	nundo = 0;
+	for (i = 0; i < n; i++) {
+		if (ops[i * per].status != IFCONFIG_BATCH_DONE) {
+			continue;
+		}
+		op = &ops[nundo++];
+		memset(op, 0, sizeof(*op));
+		op->request = SIOCIFDESTROY;
+		op->status = IFCONFIG_BATCH_PENDING;
+		(void)strlcpy(op->req.ifcr_name, names + i * IFNAMSIZ,
+		    sizeof(op->req.ifcr_name));
+	}
+	ifconfig_batch_run(h, ops, nundo);
+}
+
+int
+ifconfig_create_vlans(ifconfig_handle_t *h, const char *parent,
+    const struct ifconfig_vlan_range *ranges, const size_t nranges,
+    const int mtu, const char *description, char **names, size_t *count)
+{
+	struct ifconfig_batchop *ops, *op;
+	struct errstate error;
+	char *buf, *name;
+	size_t i, n, per;
+	unsigned int tag;
+	int errcode;
+
+	n = 0;
+	for (i = 0; i < nranges; i++) {
+		if (ranges[i].first == 0 || ranges[i].first > ranges[i].last ||
+		    ranges[i].last >= 4095) {
+			errcode = EINVAL;
+			goto fail;
+		}
+		n += ranges[i].last - ranges[i].first + 1;
+	}
+	if (parent[0] == '\0' || n == 0) {
+		errcode = EINVAL;
+		goto fail;
+	}
+	if (description != NULL && description[0] == '\0') {
+		description = NULL;
+	}
+
+	/* The create, then each common attribute, for every VLAN. */
+	per = 1 + (mtu != 0) + (description != NULL);
+	buf = calloc(n, IFNAMSIZ);
+	ops = calloc(n * per, sizeof(*ops));
+	if (buf == NULL || ops == NULL) {
+		free(buf);
+		free(ops);
+		errcode = ENOMEM;
+		goto fail;
+	}
+
+	op = ops;
+	name = buf;
+	for (i = 0; i < nranges; i++) {
+		for (tag = ranges[i].first; tag <= ranges[i].last; tag++) {
+			if (snprintf(name, IFNAMSIZ, "%s.%u", parent, tag) >=
+			    IFNAMSIZ) {
+				free(buf);
+				free(ops);
+				errcode = ENAMETOOLONG;
+				goto fail;
+			}
+			for (size_t j = 0; j < per; j++) {
+				(void)strlcpy(op[j].req.ifcr_name, name,
+				    sizeof(op[j].req.ifcr_name));
+				op[j].status = IFCONFIG_BATCH_PENDING;
+			}
+			op->request = SIOCIFCREATE2;
+			(void)strlcpy(op->req.ifcr_vlanparent, parent,
+			    sizeof(op->req.ifcr_vlanparent));
+			op->req.ifcr_vlantag = tag;
+			op++;
+			if (mtu != 0) {
+				op->request = SIOCSIFMTU;
+				op->req.ifcr_mtu = mtu;
+				op++;
+			}
+			if (description != NULL) {
+				op->request = SIOCSIFDESCR;
+				op->req.ifcr_buffer.buffer =
+				    (void *)(uintptr_t)description;
+				op->req.ifcr_buffer.length =
+				    strlen(description) + 1;
+				op++;
+			}
+			name += IFNAMSIZ;
+		}
+	}
+
+	ifconfig_batch_run(h, ops, n * per);
+	for (i = 0; i < n * per; i++) {
+		if (ops[i].status == IFCONFIG_BATCH_FAILED) {
+			break;
+		}
+	}
+	if (i < n * per) {
+		error = ops[i].error;
+		vlans_rollback(h, ops, per, buf, n);
+		*ifconfig_errstate(h) = error;
+		free(ops);
+		free(buf);
+		return (-1);
+	}
+
+	free(ops);
+	if (count != NULL) {
+		*count = n;
+	}
+	if (names != NULL) {
+		*names = buf;
+	} else {
+		free(buf);
+	}
+	return (0);
+
+fail:
+	ifconfig_errstate(h)->errtype = OTHER;
+	ifconfig_errstate(h)->errcode = errcode;
+	return (-1);
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2016-2017, Marie Helene Kvello-Aune
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * thislist of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+
+/*
+ * Bridge members. The bulk calls run their requests as batches of
+ * operations kept on the stack, so that nothing is allocated however many
+ * members there are.
+ */
+
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+#include <net/if.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include "libifconfig.h"
+#include "libifconfig_internal.h"
+
+/* Operations run at once by the bulk calls. */
+#define BRIDGE_CHUNK    32
+
+static void
+bridge_req_init(struct ifconfig_req *req, const char *bridge,
+    const unsigned long cmd, const char *member)
+{
+
+	memset(req, 0, sizeof(*req));
+	(void)strlcpy(req->ifcr_name, bridge, sizeof(req->ifcr_name));
+	req->ifcr_drvcmd = cmd;
+	if (member != NULL) {
+		(void)strlcpy(req->ifcr_member, member,
+		    sizeof(req->ifcr_member));
+	}
+}
+
+static int
+bridge_member(ifconfig_handle_t *h, const char *bridge, const char *member,
+    const unsigned long cmd)
+{
+	struct ifconfig_req req;
+
+	bridge_req_init(&req, bridge, cmd, member);
+	return (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCSDRVSPEC, &req));
+}
+
+int
+ifconfig_bridge_add_member(ifconfig_handle_t *h, const char *bridge,
+    const char *member)
+{
+
+	return (bridge_member(h, bridge, member, BRDGADD));
+}
+
+int
+ifconfig_bridge_delete_member(ifconfig_handle_t *h, const char *bridge,
+    const char *member)
+{
+
+	return (bridge_member(h, bridge, member, BRDGDEL));
+}
+
+int
+ifconfig_bridge_get_members(ifconfig_handle_t *h, const char *bridge,
+    char *names, const size_t n, size_t *count)
+{
+	struct ifconfig_req req;
+	size_t total;
+
+	bridge_req_init(&req, bridge, BRDGGIFS, NULL);
+	req.ifcr_buffer.buffer = names;
+	req.ifcr_buffer.length = (names == NULL) ? 0 : n * IFNAMSIZ;
+	if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCGDRVSPEC, &req) != 0) {
+		return (-1);
+	}
+
+	total = req.ifcr_buffer.length / IFNAMSIZ;
+	if (count != NULL) {
+		*count = total;
+	}
+	if (total > n) {
+		ifconfig_errstate(h)->errtype = OTHER;
+		ifconfig_errstate(h)->errcode = ERANGE;
+		return (-1);
+	}
+	return (0);
+}
+
+/*
+ * Runs cmd for every member, BRIDGE_CHUNK at a time, and reports the
+ * first failure in list order.
+ */
+static int
+bridge_members(ifconfig_handle_t *h, const char *bridge,
+    const char *const *members, const size_t n, const unsigned long cmd,
+    int *errors)
+{
+	struct ifconfig_batchop ops[BRIDGE_CHUNK], *op;
+	struct errstate error;
+	size_t chunk;
+	int failed;
+
+	failed = 0;
+	for (size_t i = 0; i < n; i += chunk) {
+		chunk = (n - i < BRIDGE_CHUNK) ? n - i : BRIDGE_CHUNK;
+		for (size_t j = 0; j < chunk; j++) {
+			op = &ops[j];
+			memset(op, 0, sizeof(*op));
+			op->request = SIOCSDRVSPEC;
+			op->status = IFCONFIG_BATCH_PENDING;
+			bridge_req_init(&op->req, bridge, cmd, members[i + j]);
+		}
+		ifconfig_batch_run(h, ops, chunk);
+
+		for (size_t j = 0; j < chunk; j++) {
+			op = &ops[j];
+			if (errors != NULL) {
+				errors[i + j] = (op->status ==
+				    IFCONFIG_BATCH_DONE) ? 0 :
+				    op->error.errcode;
+			}
+			if (op->status != IFCONFIG_BATCH_DONE && !failed) {
+				error = op->error;
+				failed = 1;
+			}
+		}
+	}
+
+	if (failed) {
+		*ifconfig_errstate(h) = error;
+		return (-1);
+	}
+	return (0);
+}
+
+int
+ifconfig_bridge_add_members(ifconfig_handle_t *h, const char *bridge,
+    const char *const *members, const size_t n, int *errors, char *names,
+    const size_t size, size_t *count)
+{
+	struct errstate error;
+	int failed;
+
+	failed = bridge_members(h, bridge, members, n, BRDGADD, errors);
+	if (names == NULL && count == NULL) {
+		return (failed);
+	}
+	if (failed) {
+		/* The first failed attach is what the caller hears about. */
+		error = *ifconfig_errstate(h);
+		(void)ifconfig_bridge_get_members(h, bridge, names, size,
+		    count);
+		*ifconfig_errstate(h) = error;
+		return (-1);
+	}
+	return (ifconfig_bridge_get_members(h, bridge, names, size, count));
+}
+
+int
+ifconfig_bridge_delete_members(ifconfig_handle_t *h, const char *bridge,
+    const char *const *members, const size_t n, int *errors)
+{
+
+	return (bridge_members(h, bridge, members, n, BRDGDEL, errors));
+}
@@ -0,0 +1,910 @@
+/*
+ * Copyright (c) 2016-2017, Marie Helene Kvello-Aune
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * thislist of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#include <sys/types.h>
+
+#include <net/if.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libifconfig.h"
+#include "libifconfig_internal.h"
+
+static size_t
+cache_hashname(const char *name, size_t len)
+{
+	uint32_t hash;
+
+	/* FNV-1a */
+	hash = 2166136261u;
+	for (size_t i = 0; i < len; i++) {
+		hash ^= (unsigned char)name[i];
+		hash *= 16777619u;
+	}
+	return (hash);
+}
+
+static size_t
+cache_hashindex(const unsigned int ifindex)
+{
+
+	return ((uint32_t)ifindex * 2654435761u);
+}
+
+static struct ifcache_entry *
+cache_findname(const struct ifconfig_ifcache *c, const char *name,
+    size_t len)
+{
+	struct ifcache_entry *e;
+	size_t slot;
+
+	if (c->count == 0 || len >= IFNAMSIZ) {
+		return (NULL);
+	}
+	for (slot = cache_hashname(name, len) & c->mask;
+	    c->byname[slot] != 0; slot = (slot + 1) & c->mask) {
+		e = &c->entries[c->byname[slot] - 1];
+		if (strncmp(e->name, name, len) == 0 && e->name[len] == '\0') {
+			return (e);
+		}
+	}
+	return (NULL);
+}
+
+static struct ifcache_entry *
+cache_findindex(const struct ifconfig_ifcache *c, const unsigned int ifindex)
+{
+	struct ifcache_entry *e;
+	size_t slot;
+
+	if (c->count == 0) {
+		return (NULL);
+	}
+	for (slot = cache_hashindex(ifindex) & c->mask;
+	    c->byindex[slot] != 0; slot = (slot + 1) & c->mask) {
+		e = &c->entries[c->byindex[slot] - 1];
+		if (e->index == ifindex) {
+			return (e);
+		}
+	}
+	return (NULL);
+}
+
+static void
+cache_insert(struct ifconfig_ifcache *c, const unsigned int pos)
+{
+	struct ifcache_entry *e;
+	size_t slot;
+
+	e = &c->entries[pos];
+	slot = cache_hashname(e->name, strlen(e->name)) & c->mask;
+	while (c->byname[slot] != 0) {
+		slot = (slot + 1) & c->mask;
+	}
+	c->byname[slot] = pos + 1;
+
+	slot = cache_hashindex(e->index) & c->mask;
+	while (c->byindex[slot] != 0) {
+		slot = (slot + 1) & c->mask;
+	}
+	c->byindex[slot] = pos + 1;
+}
+
+/* Keeps the tables at most half full. */
+static int
+cache_grow(struct ifconfig_ifcache *c)
+{
+	struct ifcache_entry *entries;
+	unsigned int *byname, *byindex;
+	size_t size;
+
+	size = (c->size == 0) ? 64 : c->size * 2;
+	entries = reallocarray(c->entries, size, sizeof(*entries));
+	if (entries == NULL) {
+		return (-1);
+	}
+	c->entries = entries;
+
+	byname = calloc(size * 2, sizeof(*byname));
+	byindex = calloc(size * 2, sizeof(*byindex));
+	if (byname == NULL || byindex == NULL) {
+		free(byname);
+		free(byindex);
+		return (-1);
+	}
+	free(c->byname);
+	free(c->byindex);
+	c->byname = byname;
+	c->byindex = byindex;
+	c->size = size;
+	c->mask = size * 2 - 1;
+
+	for (size_t i = 0; i < c->count; i++) {
+		cache_insert(c, i);
+	}
+	return (0);
+}
+
+static int
+cache_add_link(ifconfig_handle_t *h, const struct ifconfig_link *link,
+    void *udata __unused)
+{
+	struct ifconfig_ifcache *c;
+	struct ifcache_entry *e;
+
+	c = &h->ifcache;
+	if (link->namelen >= IFNAMSIZ) {
+		return (0);
+	}
+	if (c->count == c->size && cache_grow(c) != 0) {
+		ifconfig_errstate(h)->errtype = OTHER;
+		ifconfig_errstate(h)->errcode = ENOMEM;
+		return (-1);
+	}
+
+	e = &c->entries[c->count];
+	e->index = link->index;
+	memcpy(e->name, link->name, link->namelen);
+	e->name[link->namelen] = '\0';
+	cache_insert(c, c->count++);
+	return (0);
+}
+
+static void
+cache_clear(struct ifconfig_ifcache *c)
+{
+
+	c->valid = 0;
+	c->count = 0;
+	if (c->size != 0) {
+		memset(c->byname, 0, (c->mask + 1) * sizeof(*c->byname));
+		memset(c->byindex, 0, (c->mask + 1) * sizeof(*c->byindex));
+	}
+}
+
+/*
+ * Only arrivals, departures and renames matter. Other changes to a
+ * known interface are reported with its current name, which still
+ * matches the cache.
+ */
+static int
+cache_linkev(ifconfig_handle_t *h, enum ifconfig_linkev_type type,
+    const struct ifconfig_link *link, void *udata __unused)
+{
+	struct ifcache_entry *e;
+
+	if (type == IFCONFIG_LINKEV_NEW &&
+	    (e = cache_findindex(&h->ifcache, link->index)) != NULL &&
+	    (link->name == NULL || (strncmp(e->name, link->name,
+	    link->namelen) == 0 && e->name[link->namelen] == '\0'))) {
+		return (0);
+	}
+	h->ifcache.valid = 0;
+	return (0);
+}
+
+/*
+ * Brings the cache up to date: applies pending notifications and, if
+ * they invalidated it, reloads it from one dump. The notification socket
+ * is opened before the first dump so that no change can slip in between.
+ */
+static int
+cache_sync(ifconfig_handle_t *h)
+{
+	struct ifconfig_ifcache *c;
+
+	c = &h->ifcache;
+	if (c->disabled) {
+		return (-1);
+	}
+	if (c->fd == -1) {
+		if (h->backend->linkev_open == NULL ||
+		    h->backend->linkev_open(h, &c->fd) != 0) {
+			c->disabled = 1;
+			return (-1);
+		}
+		c->valid = 0;
+	}
+
+	if (h->backend->linkev_read(h, c->fd, cache_linkev, NULL) != 0) {
+		(void)close(c->fd);
+		c->fd = -1;
+		cache_clear(c);
+		return (-1);
+	}
+	if (c->valid) {
+		return (0);
+	}
+
+	cache_clear(c);
+	if (ifconfig_iflist(h, cache_add_link, NULL) != 0) {
+		cache_clear(c);
+		return (-1);
+	}
+	c->valid = 1;
+	return (0);
+}
+
+static void
+attrcache_init(struct ifconfig_attrcache *ac)
+{
+
+	memset(ac, 0, sizeof(*ac));
+	ac->fd = -1;
+	ac->stopfd[0] = ac->stopfd[1] = -1;
+}
+
+static void
+attrcache_clear(struct ifconfig_attrcache *ac)
+{
+
+	for (size_t i = 0; i < ac->count; i++) {
+		free(ac->entries[i].descr);
+	}
+	ac->count = 0;
+	if (ac->size != 0) {
+		memset(ac->byname, 0, (ac->mask + 1) * sizeof(*ac->byname));
+	}
+}
+
+static void
+attrcache_fini(struct ifconfig_attrcache *ac)
+{
+
+	if (ac->notify) {
+		(void)write(ac->stopfd[1], "", 1);
+		(void)pthread_join(ac->thread, NULL);
+	}
+	if (ac->fd != -1) {
+		(void)close(ac->fd);
+	}
+	if (ac->stopfd[0] != -1) {
+		(void)close(ac->stopfd[0]);
+		(void)close(ac->stopfd[1]);
+	}
+	if (ac->nh != NULL) {
+		ifconfig_close(ac->nh);
+	}
+	attrcache_clear(ac);
+	free(ac->entries);
+	free(ac->byname);
+	attrcache_init(ac);
+}
+
+void
+ifconfig_cache_init(ifconfig_handle_t *h)
+{
+
+	memset(&h->ifcache, 0, sizeof(h->ifcache));
+	h->ifcache.fd = -1;
+	attrcache_init(&h->attrcache);
+}
+
+void
+ifconfig_cache_fini(ifconfig_handle_t *h)
+{
+	struct ifconfig_ifcache *c;
+
+	c = &h->ifcache;
+	if (c->fd != -1) {
+		(void)close(c->fd);
+	}
+	free(c->entries);
+	free(c->byname);
+	free(c->byindex);
+	attrcache_fini(&h->attrcache);
+	ifconfig_cache_init(h);
+}
+
+void
+ifconfig_cache_flush(ifconfig_handle_t *h)
+{
+
+	ifconfig_lock(h, &h->cachelock);
+	h->ifcache.valid = 0;
+	attrcache_clear(&h->attrcache);
+	ifconfig_unlock(h, &h->cachelock);
+}
+
+static uint64_t
+attrcache_now(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+static int
+attrcache_fresh(const struct ifconfig_attrcache *ac,
+    const struct attrcache_entry *e, const int attr, const unsigned int gen,
+    const uint64_t now)
+{
+
+	return ((e->valid & (1 << attr)) != 0 && e->gen == gen &&
+	    (ac->ttl_ns == 0 || now - e->time_ns[attr] < ac->ttl_ns));
+}
+
+static struct attrcache_entry *
+attrcache_find(const struct ifconfig_attrcache *ac, const char *name)
+{
+	struct attrcache_entry *e;
+	size_t slot;
+
+	if (ac->count == 0) {
+		return (NULL);
+	}
+	for (slot = cache_hashname(name, strlen(name)) & ac->mask;
+	    ac->byname[slot] != 0; slot = (slot + 1) & ac->mask) {
+		e = &ac->entries[ac->byname[slot] - 1];
+		if (strcmp(e->name, name) == 0) {
+			return (e);
+		}
+	}
+	return (NULL);
+}
+
+static void
+attrcache_insert(struct ifconfig_attrcache *ac, const unsigned int pos)
+{
+	size_t slot;
+
+	slot = cache_hashname(ac->entries[pos].name,
+	    strlen(ac->entries[pos].name)) & ac->mask;
+	while (ac->byname[slot] != 0) {
+		slot = (slot + 1) & ac->mask;
+	}
+	ac->byname[slot] = pos + 1;
+}
+
+/*
+ * Makes room for one more entry. Entries without a fresh value are
+ * dropped first, so interfaces that come and go don't pile up; the table
+ * only grows if that leaves it more than half full.
+ */
+static int
+attrcache_reserve(struct ifconfig_attrcache *ac, const unsigned int gen,
+    const uint64_t now)
+{
+	struct attrcache_entry *entries, *e;
+	unsigned int *byname;
+	size_t n, size;
+	int attr, error;
+
+	if (ac->count < ac->size) {
+		return (0);
+	}
+
+	n = 0;
+	for (size_t i = 0; i < ac->count; i++) {
+		e = &ac->entries[i];
+		for (attr = 0; attr < ATTR_MAX; attr++) {
+			if (attrcache_fresh(ac, e, attr, gen, now)) {
+				break;
+			}
+		}
+		if (attr == ATTR_MAX) {
+			free(e->descr);
+			continue;
+		}
+		ac->entries[n++] = *e;
+	}
+	ac->count = n;
+
+	/*
+	 * The entries kept have moved, so they are indexed again even if
+	 * the table can't grow: in the old table, which still has room.
+	 */
+	error = 0;
+	byname = NULL;
+	if (ac->size == 0 || n > ac->size / 2) {
+		size = (ac->size == 0) ? 64 : ac->size * 2;
+		entries = reallocarray(ac->entries, size, sizeof(*entries));
+		if (entries != NULL) {
+			ac->entries = entries;
+			byname = calloc(size * 2, sizeof(*byname));
+		}
+		if (byname != NULL) {
+			free(ac->byname);
+			ac->byname = byname;
+			ac->size = size;
+			ac->mask = size * 2 - 1;
+		} else {
+			error = -1;
+		}
+	}
+	if (byname == NULL && ac->size != 0) {
+		memset(ac->byname, 0, (ac->mask + 1) * sizeof(*ac->byname));
+	}
+	for (size_t i = 0; i < ac->count; i++) {
+		attrcache_insert(ac, i);
+	}
+	return (error);
+}
+
+/* Entry for name in generation gen, created if needed. */
+static struct attrcache_entry *
+attrcache_entry(struct ifconfig_attrcache *ac, const char *name,
+    const unsigned int gen, const uint64_t now)
+{
+	struct attrcache_entry *e;
+
+	if ((e = attrcache_find(ac, name)) == NULL) {
+		if (attrcache_reserve(ac, gen, now) != 0) {
+			return (NULL);
+		}
+		e = &ac->entries[ac->count];
+		memset(e, 0, sizeof(*e));
+		(void)strlcpy(e->name, name, sizeof(e->name));
+		e->gen = gen;
+		attrcache_insert(ac, ac->count++);
+	}
+	if (e->gen != gen) {
+		e->valid = 0;
+		e->gen = gen;
+	}
+	return (e);
+}
+
+static int
+attrcache_attr(const unsigned long request)
+{
+
+	switch (request) {
+	case SIOCGIFMTU:
+	case SIOCSIFMTU:
+		return (ATTR_MTU);
+	case SIOCGIFMETRIC:
+	case SIOCSIFMETRIC:
+		return (ATTR_METRIC);
+	case SIOCGIFCAP:
+	case SIOCSIFCAP:
+		return (ATTR_CAP);
+	case SIOCGIFDESCR:
+	case SIOCSIFDESCR:
+		return (ATTR_DESCR);
+	}
+	return (-1);
+}
+
+/* Same contract as the backends' SIOCGIFDESCR. */
+static void
+attrcache_getdescr(const struct attrcache_entry *e, struct ifconfig_req *req)
+{
+	size_t len;
+
+	if (e->descr == NULL) {
+		if (req->ifcr_buffer.length > 0) {
+			((char *)req->ifcr_buffer.buffer)[0] = '\0';
+		}
+		return;
+	}
+	len = strlen(e->descr) + 1;
+	if (len > req->ifcr_buffer.length) {
+		req->ifcr_buffer.buffer = NULL;
+		req->ifcr_buffer.length = len;
+		return;
+	}
+	memcpy(req->ifcr_buffer.buffer, e->descr, len);
+}
+
+int
+ifconfig_attrcache_get(ifconfig_handle_t *h, const unsigned long request,
+    struct ifconfig_req *req, unsigned int *gen)
+{
+	struct ifconfig_attrcache *ac;
+	struct attrcache_entry *e;
+	uint64_t now;
+	int attr;
+
+	ac = &h->attrcache;
+	*gen = __atomic_load_n(&ac->gen, __ATOMIC_ACQUIRE);
+	if (request != SIOCGIFMTU && request != SIOCGIFMETRIC &&
+	    request != SIOCGIFCAP && request != SIOCGIFDESCR) {
+		return (-1);
+	}
+	attr = attrcache_attr(request);
+	now = (ac->ttl_ns != 0) ? attrcache_now() : 0;
+
+	ifconfig_lock(h, &h->cachelock);
+	if ((e = attrcache_find(ac, req->ifcr_name)) == NULL ||
+	    !attrcache_fresh(ac, e, attr, *gen, now)) {
+		ifconfig_unlock(h, &h->cachelock);
+		return (-1);
+	}
+	switch (attr) {
+	case ATTR_MTU:
+		req->ifcr_mtu = e->mtu;
+		break;
+	case ATTR_METRIC:
+		req->ifcr_metric = e->metric;
+		break;
+	case ATTR_CAP:
+		req->ifcr_curcap = e->cap.curcap;
+		req->ifcr_reqcap = e->cap.reqcap;
+		break;
+	case ATTR_DESCR:
+		attrcache_getdescr(e, req);
+		break;
+	}
+	ifconfig_unlock(h, &h->cachelock);
+	return (0);
+}
+
+static void
+attrcache_invalidate(struct ifconfig_attrcache *ac, const char *name,
+    const int attr)
+{
+	struct attrcache_entry *e;
+
+	if ((e = attrcache_find(ac, name)) != NULL) {
+		e->valid &= (attr < 0) ? 0 : ~(1 << attr);
+	}
+}
+
+/*
+ * Reads are kept only if nothing was announced since they were made.
+ * Writes are kept regardless: they are the newest value, and a change
+ * racing with them is announced after it. Capabilities are dropped
+ * rather than written through, as drivers may adjust the bits asked for.
+ */
+void
+ifconfig_attrcache_put(ifconfig_handle_t *h, const unsigned long request,
+    const struct ifconfig_req *req, const int error, const unsigned int gen)
+{
+	struct ifconfig_attrcache *ac;
+	struct attrcache_entry *e;
+	const char *buf;
+	unsigned int cur;
+	uint64_t now;
+	int attr, write;
+
+	ac = &h->attrcache;
+	attr = attrcache_attr(request);
+	if (attr < 0 && request != SIOCSIFNAME && request != SIOCIFDESTROY &&
+	    request != SIOCIFCREATE2 && request != SIOCSETVLAN &&
+	    request != SIOCSDRVSPEC) {
+		return;
+	}
+	write = (request == SIOCSIFMTU || request == SIOCSIFMETRIC ||
+	    request == SIOCSIFDESCR);
+
+	ifconfig_lock(h, &h->cachelock);
+	switch (request) {
+	case SIOCSIFNAME:
+		attrcache_invalidate(ac, req->ifcr_newname, -1);
+		/* FALLTHROUGH */
+	case SIOCIFDESTROY:
+	case SIOCIFCREATE2:
+	case SIOCSETVLAN:
+	case SIOCSDRVSPEC:
+		/* A Linux bridge takes the smallest MTU of its members. */
+		attrcache_invalidate(ac, req->ifcr_name, -1);
+		goto out;
+	case SIOCSIFCAP:
+		attrcache_invalidate(ac, req->ifcr_name, attr);
+		goto out;
+	}
+
+	cur = __atomic_load_n(&ac->gen, __ATOMIC_ACQUIRE);
+	if (error != 0 || (!write && gen != cur)) {
+		attrcache_invalidate(ac, req->ifcr_name, attr);
+		goto out;
+	}
+	/* The buffer was too small, or there was none to hold a value. */
+	if (attr == ATTR_DESCR && !write && (req->ifcr_buffer.buffer == NULL ||
+	    req->ifcr_buffer.length == 0)) {
+		goto out;
+	}
+
+	now = attrcache_now();
+	if ((e = attrcache_entry(ac, req->ifcr_name, cur, now)) == NULL) {
+		goto out;
+	}
+	switch (attr) {
+	case ATTR_MTU:
+		e->mtu = req->ifcr_mtu;
+		break;
+	case ATTR_METRIC:
+		e->metric = req->ifcr_metric;
+		break;
+	case ATTR_CAP:
+		e->cap.curcap = req->ifcr_curcap;
+		e->cap.reqcap = req->ifcr_reqcap;
+		break;
+	case ATTR_DESCR:
+		free(e->descr);
+		e->descr = NULL;
+		buf = req->ifcr_buffer.buffer;
+		if (req->ifcr_buffer.length > 0 && buf[0] != '\0' &&
+		    (e->descr = strndup(buf,
+		    req->ifcr_buffer.length - 1)) == NULL) {
+			goto out;
+		}
+		break;
+	}
+	e->valid |= 1 << attr;
+	e->time_ns[attr] = now;
+
+out:
+	ifconfig_unlock(h, &h->cachelock);
+}
+
+void
+ifconfig_attrcache_drop(ifconfig_handle_t *h, const char *name)
+{
+
+	ifconfig_lock(h, &h->cachelock);
+	attrcache_invalidate(&h->attrcache, name, -1);
+	ifconfig_unlock(h, &h->cachelock);
+}
+
+static int
+attrcache_linkev(ifconfig_handle_t *h __unused,
+    enum ifconfig_linkev_type type __unused,
+    const struct ifconfig_link *link __unused, void *udata)
+{
+
+	(void)__atomic_add_fetch((unsigned int *)udata, 1, __ATOMIC_RELEASE);
+	return (0);
+}
+
+/*
+ * Waits for notifications. If they can't be read any more, the
+ * generation is bumped for good measure and the cache stays disabled.
+ */
+static void *
+attrcache_main(void *arg)
+{
+	struct ifconfig_attrcache *ac;
+	struct pollfd pfd[2];
+
+	ac = arg;
+	pfd[0].fd = ac->fd;
+	pfd[0].events = POLLIN;
+	pfd[1].fd = ac->stopfd[0];
+	pfd[1].events = POLLIN;
+	for (;;) {
+		if (poll(pfd, 2, -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		if (pfd[1].revents != 0) {
+			return (NULL);
+		}
+		if (pfd[0].revents != 0 && ac->nh->backend->linkev_read(ac->nh,
+		    ac->fd, attrcache_linkev, &ac->gen) != 0) {
+			break;
+		}
+	}
+	__atomic_store_n(&ac->enabled, 0, __ATOMIC_RELEASE);
+	(void)__atomic_add_fetch(&ac->gen, 1, __ATOMIC_RELEASE);
+	return (NULL);
+}
+
+int
+ifconfig_attrcache_enable(ifconfig_handle_t *h, const unsigned int ttl_ms,
+    const int flags)
+{
+	struct ifconfig_attrcache *ac;
+	int error;
+
+	ac = &h->attrcache;
+	if (ac->enabled || ac->notify ||
+	    (ttl_ms == 0 && !(flags & IFCONFIG_ATTRCACHE_NOTIFY))) {
+		ifconfig_errstate(h)->errtype = OTHER;
+		ifconfig_errstate(h)->errcode = EINVAL;
+		return (-1);
+	}
+	ac->ttl_ns = (uint64_t)ttl_ms * 1000000;
+
+	if (flags & IFCONFIG_ATTRCACHE_NOTIFY) {
+		if (h->backend->linkev_open == NULL) {
+			ifconfig_errstate(h)->errtype = OTHER;
+			ifconfig_errstate(h)->errcode = EOPNOTSUPP;
+			return (-1);
+		}
+		/* A handle of its own, as the thread runs unlocked. */
+		if ((ac->nh = ifconfig_open()) == NULL) {
+			ifconfig_errstate(h)->errtype = OTHER;
+			ifconfig_errstate(h)->errcode = ENOMEM;
+			return (-1);
+		}
+		ac->nh->backend = h->backend;
+		ac->nh->backend_data = h->backend_data;
+		if (h->backend->linkev_open(ac->nh, &ac->fd) != 0) {
+			*ifconfig_errstate(h) = *ifconfig_errstate(ac->nh);
+			attrcache_fini(ac);
+			return (-1);
+		}
+		if (pipe(ac->stopfd) != 0) {
+			ac->stopfd[0] = ac->stopfd[1] = -1;
+			error = errno;
+			goto fail;
+		}
+		if ((error = pthread_create(&ac->thread, NULL, attrcache_main,
+		    ac)) != 0) {
+			goto fail;
+		}
+		ac->notify = 1;
+	}
+	ac->enabled = 1;
+	return (0);
+
+fail:
+	attrcache_fini(ac);
+	ifconfig_errstate(h)->errtype = OTHER;
+	ifconfig_errstate(h)->errcode = error;
+	return (-1);
+}
+
+void
+ifconfig_attrcache_disable(ifconfig_handle_t *h)
+{
+
+	attrcache_fini(&h->attrcache);
+}
+
+int
+ifconfig_nametoindex(ifconfig_handle_t *h, const char *name,
+    unsigned int *ifindex)
+{
+	struct ifcache_entry *e;
+
+	ifconfig_lock(h, &h->cachelock);
+	if (cache_sync(h) != 0) {
+		ifconfig_unlock(h, &h->cachelock);
+		/* No cache; ask libc. */
+		if ((*ifindex = if_nametoindex(name)) != 0) {
+			return (0);
+		}
+		goto fail;
+	}
+
+	if ((e = cache_findname(&h->ifcache, name, strlen(name))) != NULL) {
+		*ifindex = e->index;
+		ifconfig_unlock(h, &h->cachelock);
+		return (0);
+	}
+	ifconfig_unlock(h, &h->cachelock);
+	errno = ENOENT;
+
+fail:
+	ifconfig_errstate(h)->errtype = OTHER;
+	ifconfig_errstate(h)->errcode = (errno != 0) ? errno : ENOENT;
+	return (-1);
+}
+
+int
+ifconfig_indextoname(ifconfig_handle_t *h, const unsigned int ifindex,
+    char *name)
+{
+	struct ifcache_entry *e;
+
+	ifconfig_lock(h, &h->cachelock);
+	if (cache_sync(h) != 0) {
+		ifconfig_unlock(h, &h->cachelock);
+		if (if_indextoname(ifindex, name) != NULL) {
+			return (0);
+		}
+		goto fail;
+	}
+
+	if ((e = cache_findindex(&h->ifcache, ifindex)) != NULL) {
+		memcpy(name, e->name, IFNAMSIZ);
+		ifconfig_unlock(h, &h->cachelock);
+		return (0);
+	}
+	ifconfig_unlock(h, &h->cachelock);
+	errno = ENXIO;
+
+fail:
+	ifconfig_errstate(h)->errtype = OTHER;
+	ifconfig_errstate(h)->errcode = (errno != 0) ? errno : ENXIO;
+	return (-1);
+}
+
+int
+ifconfig_freename(ifconfig_handle_t *h, const char *kind, unsigned int *unit,
+    char *name)
+{
+	char probe[IFNAMSIZ];
+	int cached;
+
+	ifconfig_lock(h, &h->cachelock);
+	cached = (cache_sync(h) == 0);
+	for (;; (*unit)++) {
+		if (snprintf(name, IFNAMSIZ, "%s%u", kind, *unit) >= IFNAMSIZ ||
+		    snprintf(probe, sizeof(probe), "%s%s", name,
+		    strcmp(kind, "epair") == 0 ? "a" : "") >= IFNAMSIZ) {
+			ifconfig_unlock(h, &h->cachelock);
+			ifconfig_errstate(h)->errtype = OTHER;
+			ifconfig_errstate(h)->errcode = ENAMETOOLONG;
+			return (-1);
+		}
+		if (cached ? cache_findname(&h->ifcache, probe,
+		    strlen(probe)) == NULL : if_nametoindex(probe) == 0) {
+			break;
+		}
+	}
+	(*unit)++;
+	ifconfig_unlock(h, &h->cachelock);
+	return (0);
+}
+
+int
+ifconfig_counters_names(ifconfig_handle_t *h, struct ifconfig_counters *c)
+{
+	struct ifconfig_ifcounters *ifc;
+	struct ifcache_entry *e;
+	size_t n;
+	int cached;
+
+	for (n = 0; n < c->count && c->ifaces[n].name[0] != '\0'; n++) {
+		;
+	}
+	if (n == c->count) {
+		return (0);
+	}
+
+	ifconfig_lock(h, &h->cachelock);
+	cached = (cache_sync(h) == 0);
+	n = 0;
+	for (size_t i = 0; i < c->count; i++) {
+		ifc = &c->ifaces[i];
+		if (ifc->name[0] == '\0') {
+			if (cached) {
+				if ((e = cache_findindex(&h->ifcache,
+				    ifc->index)) == NULL) {
+					continue;
+				}
+				memcpy(ifc->name, e->name, IFNAMSIZ);
+			} else if (if_indextoname(ifc->index,
+			    ifc->name) == NULL) {
+				continue;
+			}
+		}
+		if (n != i) {
+			c->ifaces[n] = *ifc;
+		}
+		n++;
+	}
+	c->count = n;
+	ifconfig_unlock(h, &h->cachelock);
+	return (0);
+}
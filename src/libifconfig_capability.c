@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2016-2017, Marie Helene Kvello-Aune
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * thislist of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+
+#include <sys/types.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include "libifconfig.h"
+#include "libifconfig_internal.h"
+
+/*
+ * FreeBSD's IFCAP_* values, under the names ifconfig(8) uses. Entries for
+ * single bits come first, so the name of a bit is its first match.
+ */
+static const struct {
+	const char *name;
+	int mask;
+} captab[] = {
+	{ "rxcsum", 0x00000001 },
+	{ "txcsum", 0x00000002 },
+	{ "netcons", 0x00000004 },
+	{ "vlanmtu", 0x00000008 },
+	{ "vlanhwtag", 0x00000010 },
+	{ "jumbomtu", 0x00000020 },
+	{ "polling", 0x00000040 },
+	{ "vlanhwcsum", 0x00000080 },
+	{ "tso4", 0x00000100 },
+	{ "tso6", 0x00000200 },
+	{ "lro", 0x00000400 },
+	{ "wol_ucast", 0x00000800 },
+	{ "wol_mcast", 0x00001000 },
+	{ "wol_magic", 0x00002000 },
+	{ "toe4", 0x00004000 },
+	{ "toe6", 0x00008000 },
+	{ "vlanhwfilter", 0x00010000 },
+	{ "nv", 0x00020000 },
+	{ "vlanhwtso", 0x00040000 },
+	{ "linkstate", 0x00080000 },
+	{ "netmap", 0x00100000 },
+	{ "rxcsum6", 0x00200000 },
+	{ "txcsum6", 0x00400000 },
+	{ "hwstats", 0x00800000 },
+	{ "txrtlmt", 0x01000000 },
+	{ "hwrxtstmp", 0x02000000 },
+	{ "mextpg", 0x04000000 },
+	{ "txtls4", 0x08000000 },
+	{ "txtls6", 0x10000000 },
+	{ "vxlanhwcsum", 0x20000000 },
+	{ "vxlanhwtso", 0x40000000 },
+	{ "txtlsrtlmt", (int)0x80000000U },
+	{ "tso", 0x00000300 },
+	{ "wol", 0x00003800 },
+	{ "toe", 0x0000c000 },
+	{ "txtls", 0x18000000 },
+};
+
+#define NCAPTAB    (sizeof(captab) / sizeof(captab[0]))
+
+static int
+capability_lookup(const char *name, const size_t len)
+{
+
+	for (size_t i = 0; i < NCAPTAB; i++) {
+		if (strncmp(captab[i].name, name, len) == 0 &&
+		    captab[i].name[len] == '\0') {
+			return (captab[i].mask);
+		}
+	}
+	return (0);
+}
+
+int
+ifconfig_capability_mask(const char *name)
+{
+
+	return (capability_lookup(name, strlen(name)));
+}
+
+const char *
+ifconfig_capability_name(const int bit)
+{
+
+	for (size_t i = 0; i < NCAPTAB; i++) {
+		if (captab[i].mask == bit) {
+			return (captab[i].name);
+		}
+	}
+	return (NULL);
+}
+
+int
+ifconfig_capabilities_parse(const char *str, int *set, int *clear)
+{
+	const char *end;
+	size_t len;
+	int neg, mask, s, c;
+
+	s = c = 0;
+	for (; *str != '\0'; str = (*end == ',') ? end + 1 : end) {
+		end = str + strcspn(str, ",");
+		neg = (*str == '-');
+		len = end - str - neg;
+		if (len == 0) {
+			continue;
+		}
+		if ((mask = capability_lookup(str + neg, len)) == 0) {
+			errno = EINVAL;
+			return (-1);
+		}
+		if (neg) {
+			c |= mask;
+			s &= ~mask;
+		} else {
+			s |= mask;
+			c &= ~mask;
+		}
+	}
+	*set = s;
+	*clear = c;
+	return (0);
+}
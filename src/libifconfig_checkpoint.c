@@ -0,0 +1,861 @@
+/*
+ * Copyright (c) 2016-2017, Marie Helene Kvello-Aune
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * thislist of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <net/if.h>
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libifconfig.h"
+#include "libifconfig_internal.h"
+
+/*
+ * File layout: a header, count fixed-size records, then a string table
+ * of NUL-terminated descriptions. Records of VLANs follow the others, so
+ * parents are restored first. Both ends of a pair (veth, epair) are
+ * recorded with CKPT_PEER and name each other.
+ */
+#define CKPT_MAGIC      0x4b434649    /* "IFCK", as read on little-endian */
+#define CKPT_VERSION    1
+#define CKPT_NOSTR      UINT32_MAX
+
+#define CKPT_HASCAP     0x1
+#define CKPT_VLAN       0x2
+#define CKPT_PEER       0x4
+
+struct ckpt_header {
+	uint32_t magic;
+	uint16_t version;
+	/** sizeof(struct ckpt_record) of the writer. */
+	uint16_t recsize;
+	uint32_t count;
+	uint32_t strtablen;
+};
+
+struct ckpt_record {
+	char name[IFNAMSIZ];
+	char kind[IFNAMSIZ];
+	/** The VLAN's parent, or with CKPT_PEER the other end of the pair. */
+	char parent[IFNAMSIZ];
+	int32_t mtu;
+	int32_t curcap;
+	/** Offset of the description in the string table, or CKPT_NOSTR. */
+	uint32_t descr;
+	uint16_t vlantag;
+	uint16_t flags;
+};
+
+/* A record being saved, with what only the save needs. */
+struct ckpt_iface {
+	struct ckpt_record rec;
+	unsigned int index;
+	unsigned int parent;
+	int has_vlan;
+	int has_descr;
+	/** Equal for the two ends of a pair, 0 if not one. */
+	uint64_t pairkey;
+	/** Set if no cloner makes it, so it isn't saved. */
+	int skip;
+};
+
+struct ckpt_save {
+	struct ckpt_iface *ifaces;
+	size_t count;
+	size_t size;
+	char *strtab;
+	size_t strtablen;
+	size_t strtabsize;
+	/** System's cloner names, IFNAMSIZ bytes each, once read. */
+	char *cloners;
+	size_t ncloners;
+	int hascloners;
+};
+
+static void
+ckpt_err(ifconfig_handle_t *h, const int errcode)
+{
+
+	ifconfig_errstate(h)->errtype = OTHER;
+	ifconfig_errstate(h)->errcode = errcode;
+}
+
+/* Appends a description to the string table, setting rec->descr. */
+static int
+ckpt_addstr(struct ckpt_save *s, struct ckpt_record *rec, const char *str,
+    size_t len)
+{
+	size_t newsize;
+	char *tmp;
+
+	if (s->strtablen + len + 1 > s->strtabsize) {
+		newsize = (s->strtabsize == 0) ? 4096 : s->strtabsize * 2;
+		while (newsize < s->strtablen + len + 1) {
+			newsize *= 2;
+		}
+		if (newsize >= CKPT_NOSTR) {
+			return (-1);
+		}
+		if ((tmp = realloc(s->strtab, newsize)) == NULL) {
+			return (-1);
+		}
+		s->strtab = tmp;
+		s->strtabsize = newsize;
+	}
+
+	rec->descr = s->strtablen;
+	memcpy(s->strtab + s->strtablen, str, len);
+	s->strtab[s->strtablen + len] = '\0';
+	s->strtablen += len + 1;
+	return (0);
+}
+
+static int
+ckpt_add_link(ifconfig_handle_t *h, const struct ifconfig_link *link,
+    void *udata)
+{
+	struct ckpt_save *s;
+	struct ckpt_iface *iface, *tmp;
+
+	s = udata;
+	if ((link->has_kind && link->kind == NULL) ||
+	    link->namelen >= IFNAMSIZ || link->kindlen >= IFNAMSIZ) {
+		return (0);
+	}
+	if (s->count == s->size) {
+		tmp = reallocarray(s->ifaces, s->size == 0 ? 64 : s->size * 2,
+		    sizeof(*s->ifaces));
+		if (tmp == NULL) {
+			goto nomem;
+		}
+		s->ifaces = tmp;
+		s->size = (s->size == 0) ? 64 : s->size * 2;
+	}
+
+	iface = &s->ifaces[s->count];
+	memset(iface, 0, sizeof(*iface));
+	memcpy(iface->rec.name, link->name, link->namelen);
+	if (link->has_kind) {
+		memcpy(iface->rec.kind, link->kind, link->kindlen);
+	}
+	iface->rec.mtu = link->mtu;
+	iface->rec.descr = CKPT_NOSTR;
+	iface->index = link->index;
+	iface->parent = link->parent;
+	iface->has_vlan = link->has_vlan;
+	if (link->has_vlan) {
+		iface->rec.vlantag = link->vlantag;
+	}
+	iface->has_descr = link->has_description;
+	if (link->has_description && link->description != NULL &&
+	    ckpt_addstr(s, &iface->rec, link->description,
+	    link->descriptionlen) != 0) {
+		goto nomem;
+	}
+	s->count++;
+	return (0);
+
+nomem:
+	ckpt_err(h, ENOMEM);
+	return (-1);
+}
+
+/*
+ * Reads the system's cloner names, for a backend whose dump doesn't tell
+ * cloned interfaces apart.
+ */
+static int
+ckpt_cloners(ifconfig_handle_t *h, struct ckpt_save *s)
+{
+	struct ifconfig_req req;
+	size_t len;
+	char *tmp;
+
+	len = 0;
+	for (;;) {
+		memset(&req, 0, sizeof(req));
+		req.ifcr_buffer.buffer = s->cloners;
+		req.ifcr_buffer.length = len;
+		if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCIFGCLONERS,
+		    &req) != 0) {
+			return (-1);
+		}
+		if (req.ifcr_buffer.length <= len) {
+			break;
+		}
+		/* A cloner came along; read them all again. */
+		len = req.ifcr_buffer.length;
+		if ((tmp = realloc(s->cloners, len)) == NULL) {
+			ckpt_err(h, ENOMEM);
+			return (-1);
+		}
+		s->cloners = tmp;
+	}
+	s->ncloners = req.ifcr_buffer.length / IFNAMSIZ;
+	s->hascloners = 1;
+	return (0);
+}
+
+static int
+ckpt_clonable(const struct ckpt_save *s, const char *kind)
+{
+
+	for (size_t i = 0; i < s->ncloners; i++) {
+		if (strncmp(s->cloners + i * IFNAMSIZ, kind, IFNAMSIZ) == 0) {
+			return (1);
+		}
+	}
+	return (0);
+}
+
+/*
+ * Completes a record with what the dump didn't carry: the kind and VLAN
+ * where the backend's dump lacks them, the VLAN parent's name, the
+ * capabilities, and the description. Without a kind from the dump, an
+ * interface whose driver isn't a cloner, like em0, is marked skip.
+ */
+static int
+ckpt_gather(ifconfig_handle_t *h, struct ckpt_save *s,
+    struct ckpt_iface *iface)
+{
+	struct ckpt_record *rec;
+	struct ifconfig_capabilities cap;
+	struct ifconfig_req req;
+	const char *descr;
+	char buf[128], *str;
+	size_t len;
+	int error;
+
+	rec = &iface->rec;
+	if (rec->kind[0] == '\0') {
+		if (ifconfig_get_drivername(h, iface->index, buf,
+		    sizeof(buf)) != 0) {
+			return (-1);
+		}
+		len = strlen(buf);
+		while (len > 0 && isdigit((unsigned char)buf[len - 1])) {
+			len--;
+		}
+		/* Both ends of an epair have the driver's unit. */
+		if (len == strlen("epair") && memcmp(buf, "epair", len) == 0 &&
+		    buf[len] != '\0') {
+			iface->pairkey = (uint64_t)2 << 32 |
+			    strtoul(buf + len, NULL, 10);
+		}
+		buf[len] = '\0';
+		(void)strlcpy(rec->kind, buf, sizeof(rec->kind));
+		if (!s->hascloners && ckpt_cloners(h, s) != 0) {
+			return (-1);
+		}
+		if (!ckpt_clonable(s, rec->kind)) {
+			iface->skip = 1;
+			return (0);
+		}
+	} else if (strcmp(rec->kind, "veth") == 0 && iface->parent != 0) {
+		/* A veth's parent is its peer. */
+		iface->pairkey = (uint64_t)1 << 32 |
+		    (iface->index < iface->parent ? iface->index :
+		    iface->parent);
+	}
+
+	if (!iface->has_vlan && strcmp(rec->kind, "vlan") == 0) {
+		memset(&req, 0, sizeof(req));
+		(void)strlcpy(req.ifcr_name, rec->name, sizeof(req.ifcr_name));
+		if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCGETVLAN, &req) != 0) {
+			return (-1);
+		}
+		rec->vlantag = req.ifcr_vlantag;
+		memcpy(rec->parent, req.ifcr_vlanparent,
+		    sizeof(rec->parent));
+	} else if (rec->vlantag != 0 && ifconfig_indextoname(h,
+	    iface->parent, rec->parent) != 0) {
+		return (-1);
+	}
+	if (rec->vlantag != 0) {
+		rec->flags |= CKPT_VLAN;
+	}
+
+	if (ifconfig_get_capability(h, rec->name, &cap) == 0) {
+		rec->curcap = cap.curcap;
+		rec->flags |= CKPT_HASCAP;
+	}
+
+	if (iface->has_descr) {
+		return (0);
+	}
+	if (ifconfig_read_description(h, rec->name, buf, sizeof(buf), &str,
+	    &descr) != 0) {
+		return (-1);
+	}
+	if (descr == NULL) {
+		return (0);
+	}
+	error = ckpt_addstr(s, rec, descr, strlen(descr));
+	free(str);
+	if (error != 0) {
+		ckpt_err(h, ENOMEM);
+		return (-1);
+	}
+	return (0);
+}
+
+static int
+ckpt_cmppair(const void *a, const void *b)
+{
+	const struct ckpt_iface *x, *y;
+
+	x = *(struct ckpt_iface *const *)a;
+	y = *(struct ckpt_iface *const *)b;
+	return (x->pairkey < y->pairkey ? -1 : x->pairkey > y->pairkey);
+}
+
+/*
+ * Makes the two ends of each pair name each other, so a restore creates
+ * the pair once. A veth whose peer is in another namespace, or wasn't
+ * saved, stays a plain record.
+ */
+static int
+ckpt_pair(ifconfig_handle_t *h, struct ckpt_save *s)
+{
+	struct ckpt_iface **ends, *a, *b;
+	size_t n;
+
+	n = 0;
+	for (size_t i = 0; i < s->count; i++) {
+		n += (s->ifaces[i].pairkey != 0);
+	}
+	if (n < 2) {
+		return (0);
+	}
+	if ((ends = calloc(n, sizeof(*ends))) == NULL) {
+		ckpt_err(h, ENOMEM);
+		return (-1);
+	}
+	n = 0;
+	for (size_t i = 0; i < s->count; i++) {
+		if (s->ifaces[i].pairkey != 0) {
+			ends[n++] = &s->ifaces[i];
+		}
+	}
+	qsort(ends, n, sizeof(*ends), ckpt_cmppair);
+
+	for (size_t i = 0; i < n; i++) {
+		a = ends[i];
+		for (size_t j = i + 1; !(a->rec.flags & CKPT_PEER) && j < n &&
+		    ends[j]->pairkey == a->pairkey; j++) {
+			b = ends[j];
+			if ((b->rec.flags & CKPT_PEER) ||
+			    (strcmp(a->rec.kind, "veth") == 0 &&
+			    (a->parent != b->index || b->parent != a->index))) {
+				continue;
+			}
+			memcpy(a->rec.parent, b->rec.name,
+			    sizeof(a->rec.parent));
+			memcpy(b->rec.parent, a->rec.name,
+			    sizeof(b->rec.parent));
+			a->rec.flags |= CKPT_PEER;
+			b->rec.flags |= CKPT_PEER;
+		}
+	}
+	free(ends);
+	return (0);
+}
+
+/* Writes the file under a temporary name and renames it into place. */
+static int
+ckpt_write(ifconfig_handle_t *h, const char *path, const struct ckpt_save *s)
+{
+	struct ckpt_header *hdr;
+	struct ckpt_record *rec;
+	char *buf, *tmp, *p;
+	size_t len;
+	ssize_t n;
+	int fd, vlan;
+
+	len = sizeof(*hdr) + s->count * sizeof(*rec) + s->strtablen;
+	buf = malloc(len);
+	tmp = malloc(strlen(path) + sizeof(".XXXXXX"));
+	if (buf == NULL || tmp == NULL) {
+		free(buf);
+		free(tmp);
+		ckpt_err(h, ENOMEM);
+		return (-1);
+	}
+
+	hdr = (struct ckpt_header *)buf;
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->magic = CKPT_MAGIC;
+	hdr->version = CKPT_VERSION;
+	hdr->recsize = sizeof(*rec);
+	hdr->count = s->count;
+	hdr->strtablen = s->strtablen;
+	rec = (struct ckpt_record *)(hdr + 1);
+	for (vlan = 0; vlan <= CKPT_VLAN; vlan += CKPT_VLAN) {
+		for (size_t i = 0; i < s->count; i++) {
+			if ((s->ifaces[i].rec.flags & CKPT_VLAN) == vlan) {
+				*rec++ = s->ifaces[i].rec;
+			}
+		}
+	}
+	if (s->strtablen > 0) {
+		memcpy(rec, s->strtab, s->strtablen);
+	}
+
+	(void)sprintf(tmp, "%s.XXXXXX", path);
+	if ((fd = mkstemp(tmp)) == -1) {
+		goto fail;
+	}
+	for (p = buf; p < buf + len; p += n) {
+		n = write(fd, p, buf + len - p);
+		if (n < 0 && errno != EINTR) {
+			goto failfd;
+		}
+		if (n < 0) {
+			n = 0;
+		}
+	}
+	if (fsync(fd) != 0 || close(fd) != 0) {
+		fd = -1;
+		goto failfd;
+	}
+	if (rename(tmp, path) != 0) {
+		fd = -1;
+		goto failfd;
+	}
+	free(tmp);
+	free(buf);
+	return (0);
+
+failfd:
+	ckpt_err(h, errno);
+	if (fd != -1) {
+		(void)close(fd);
+	}
+	(void)unlink(tmp);
+	free(tmp);
+	free(buf);
+	return (-1);
+
+fail:
+	ckpt_err(h, errno);
+	free(tmp);
+	free(buf);
+	return (-1);
+}
+
+int
+ifconfig_checkpoint_save(ifconfig_handle_t *h, const char *path)
+{
+	struct ckpt_save s;
+	size_t n;
+	int error;
+
+	memset(&s, 0, sizeof(s));
+	error = ifconfig_iflist(h, ckpt_add_link, &s);
+	n = 0;
+	for (size_t i = 0; error == 0 && i < s.count; i++) {
+		error = ckpt_gather(h, &s, &s.ifaces[i]);
+		if (!s.ifaces[i].skip) {
+			s.ifaces[n++] = s.ifaces[i];
+		}
+	}
+	s.count = n;
+	if (error == 0) {
+		error = ckpt_pair(h, &s);
+	}
+	if (error == 0 && s.count >= UINT32_MAX) {
+		ckpt_err(h, EFBIG);
+		error = -1;
+	}
+	if (error == 0) {
+		error = ckpt_write(h, path, &s);
+	}
+	free(s.ifaces);
+	free(s.strtab);
+	free(s.cloners);
+	return (error);
+}
+
+/* Checks that a mapped file is a checkpoint this library can read. */
+static int
+ckpt_check(const void *map, const size_t len)
+{
+	const struct ckpt_header *hdr;
+	const struct ckpt_record *rec;
+	const char *strtab;
+
+	hdr = map;
+	if (len < sizeof(*hdr) || hdr->magic != CKPT_MAGIC ||
+	    hdr->version != CKPT_VERSION || hdr->recsize != sizeof(*rec) ||
+	    (len - sizeof(*hdr)) / sizeof(*rec) < hdr->count ||
+	    len - sizeof(*hdr) - hdr->count * sizeof(*rec) != hdr->strtablen) {
+		return (-1);
+	}
+	rec = (const struct ckpt_record *)(hdr + 1);
+	strtab = (const char *)(rec + hdr->count);
+	if (hdr->strtablen > 0 && strtab[hdr->strtablen - 1] != '\0') {
+		return (-1);
+	}
+	for (uint32_t i = 0; i < hdr->count; i++, rec++) {
+		if (memchr(rec->name, '\0', IFNAMSIZ) == NULL ||
+		    memchr(rec->kind, '\0', IFNAMSIZ) == NULL ||
+		    memchr(rec->parent, '\0', IFNAMSIZ) == NULL ||
+		    rec->name[0] == '\0' || (rec->descr != CKPT_NOSTR &&
+		    rec->descr >= hdr->strtablen)) {
+			return (-1);
+		}
+	}
+	return (0);
+}
+
+static int
+ckpt_cmpname(const void *a, const void *b)
+{
+
+	return (strcmp((*(const struct ckpt_record *const *)a)->name,
+	    (*(const struct ckpt_record *const *)b)->name));
+}
+
+/*
+ * Checks that names are unique and that the ends of every pair name each
+ * other, which ckpt_create() relies on to create a pair once.
+ */
+static int
+ckpt_checkpeers(ifconfig_handle_t *h, const struct ckpt_record *recs,
+    const uint32_t count)
+{
+	const struct ckpt_record **byname, **found, *rec, *peer, *keyp;
+	struct ckpt_record key;
+	int error;
+
+	if ((byname = calloc(count + 1, sizeof(*byname))) == NULL) {
+		ckpt_err(h, ENOMEM);
+		return (-1);
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		byname[i] = &recs[i];
+	}
+	qsort(byname, count, sizeof(*byname), ckpt_cmpname);
+
+	error = 0;
+	for (uint32_t i = 1; error == 0 && i < count; i++) {
+		error = (strcmp(byname[i - 1]->name, byname[i]->name) == 0);
+	}
+	for (uint32_t i = 0; error == 0 && i < count; i++) {
+		rec = &recs[i];
+		if (!(rec->flags & CKPT_PEER)) {
+			continue;
+		}
+		memcpy(key.name, rec->parent, sizeof(key.name));
+		keyp = &key;
+		found = bsearch(&keyp, byname, count, sizeof(*byname),
+		    ckpt_cmpname);
+		peer = (found == NULL) ? NULL : *found;
+		error = ((rec->flags & CKPT_VLAN) || peer == NULL ||
+		    peer == rec || !(peer->flags & CKPT_PEER) ||
+		    strcmp(peer->parent, rec->name) != 0 ||
+		    strcmp(peer->kind, rec->kind) != 0);
+	}
+	free(byname);
+	if (error != 0) {
+		ckpt_err(h, EINVAL);
+		return (-1);
+	}
+	return (0);
+}
+
+/* Whether name is kind followed by a unit number. */
+static int
+ckpt_isunit(const char *name, const char *kind)
+{
+	size_t len;
+
+	len = strlen(name);
+	if (len == 0 || !isdigit((unsigned char)name[len - 1])) {
+		return (0);
+	}
+	while (len > 0 && isdigit((unsigned char)name[len - 1])) {
+		len--;
+	}
+	return (len == strlen(kind) && memcmp(name, kind, len) == 0);
+}
+
+/*
+ * Whether rec can be created under its own name, and for a pair its
+ * peer under the peer's. Otherwise it's created by kind, taking the name
+ * the kernel picks, and renamed.
+ */
+static int
+ckpt_byname(const struct ckpt_record *rec)
+{
+	char name[IFNAMSIZ + 8];
+
+	if (rec->flags & CKPT_VLAN) {
+		(void)snprintf(name, sizeof(name), "%s.%u", rec->parent,
+		    rec->vlantag);
+		return (strcmp(name, rec->name) == 0 ||
+		    ckpt_isunit(rec->name, "vlan"));
+	}
+	if (rec->flags & CKPT_PEER) {
+		return (ckpt_isunit(rec->name, rec->kind) &&
+		    ckpt_isunit(rec->parent, rec->kind));
+	}
+	return (ckpt_isunit(rec->name, rec->kind));
+}
+
+/*
+ * Creates the interfaces of the records whose CKPT_VLAN flag is vlan and
+ * that don't exist, then renames those that had to be created under
+ * another name. Those created under their own name go first, so their
+ * names are taken when free ones are picked for the others. A pair is
+ * created by the end whose name sorts first, and its other end gets the
+ * next operation, which takes the peer's name once the pair exists; a
+ * pair of which one end is left isn't recreated. The first failure is
+ * kept in *first.
+ */
+static void
+ckpt_create(ifconfig_handle_t *h, const struct ckpt_record *recs,
+    const size_t count, const int vlan, struct ifconfig_batchop *ops,
+    size_t *which, struct errstate *first, int *failed)
+{
+	const struct ckpt_record *rec;
+	struct ifconfig_batchop *op;
+	const char *name;
+	unsigned int index, unit;
+	size_t n, start;
+	int byname, peer;
+
+	n = 0;
+	unit = 0;
+	for (int pass = 1; pass >= 0; pass--) {
+		start = n;
+		for (size_t i = 0; i < count; i++) {
+			rec = &recs[i];
+			if ((rec->flags & CKPT_VLAN) != vlan ||
+			    (byname = ckpt_byname(rec)) != pass ||
+			    ifconfig_nametoindex(h, rec->name, &index) == 0) {
+				continue;
+			}
+			peer = (rec->flags & CKPT_PEER) != 0;
+			if (peer && (strcmp(rec->name, rec->parent) > 0 ||
+			    ifconfig_nametoindex(h, rec->parent,
+			    &index) == 0)) {
+				continue;
+			}
+			op = &ops[n];
+			which[n++] = i;
+			memset(op, 0, sizeof(*op));
+			op->request = SIOCIFCREATE2;
+			op->status = IFCONFIG_BATCH_PENDING;
+			if (byname) {
+				memcpy(op->req.ifcr_name, rec->name,
+				    sizeof(op->req.ifcr_name));
+				if (peer) {
+					memcpy(op->req.ifcr_peer, rec->parent,
+					    sizeof(op->req.ifcr_peer));
+				}
+			} else if (ifconfig_freename(h,
+			    vlan ? "vlan" : rec->kind, &unit,
+			    op->req.ifcr_name) != 0 ||
+			    (peer && ifconfig_freename(h, rec->kind, &unit,
+			    op->req.ifcr_peer) != 0)) {
+				op->status = IFCONFIG_BATCH_FAILED;
+				op->error = *ifconfig_errstate(h);
+			}
+			if (vlan) {
+				memcpy(op->req.ifcr_vlanparent,
+				    rec->parent,
+				    sizeof(op->req.ifcr_vlanparent));
+				op->req.ifcr_vlantag = rec->vlantag;
+			}
+			if (peer) {
+				which[n] = i;
+				memset(&ops[n], 0, sizeof(ops[n]));
+				ops[n].request = SIOCIFCREATE2;
+				ops[n++].status = IFCONFIG_BATCH_DONE;
+			}
+		}
+		ifconfig_batch_run(h, ops + start, n - start);
+
+		for (size_t i = start + 1; i < n; i++) {
+			if (which[i] != which[i - 1]) {
+				continue;
+			}
+			ops[i].status = ops[i - 1].status;
+			ops[i].error = ops[i - 1].error;
+			memcpy(ops[i].req.ifcr_name, ops[i - 1].req.ifcr_peer,
+			    sizeof(ops[i].req.ifcr_name));
+		}
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		op = &ops[i];
+		rec = &recs[which[i]];
+		name = (i > 0 && which[i] == which[i - 1]) ? rec->parent :
+		    rec->name;
+		if (op->status != IFCONFIG_BATCH_DONE ||
+		    strcmp(op->req.ifcr_name, name) == 0) {
+			continue;
+		}
+		op->request = SIOCSIFNAME;
+		op->status = IFCONFIG_BATCH_PENDING;
+		memcpy(op->req.ifcr_newname, name,
+		    sizeof(op->req.ifcr_newname));
+	}
+	ifconfig_batch_run(h, ops, n);
+
+	for (size_t i = 0; i < n && !*failed; i++) {
+		if (ops[i].status == IFCONFIG_BATCH_FAILED) {
+			*first = ops[i].error;
+			*failed = 1;
+		}
+	}
+}
+
+/* Gives every record its saved attributes, through the reconciler. */
+static int
+ckpt_apply(ifconfig_handle_t *h, const struct ckpt_record *recs,
+    const size_t count, const char *strtab)
+{
+	const struct ckpt_record *rec;
+	ifconfig_reconcile_t *r;
+	int error;
+
+	if ((r = ifconfig_reconcile_new(h)) == NULL) {
+		return (-1);
+	}
+	error = 0;
+	for (size_t i = 0; error == 0 && i < count; i++) {
+		rec = &recs[i];
+		error = ifconfig_reconcile_set_mtu(r, rec->name, rec->mtu);
+		if (error == 0) {
+			error = ifconfig_reconcile_set_description(r,
+			    rec->name, rec->descr == CKPT_NOSTR ? "" :
+			    strtab + rec->descr);
+		}
+		if (error == 0 && (rec->flags & CKPT_HASCAP)) {
+			error = ifconfig_reconcile_set_capabilities(r,
+			    rec->name, rec->curcap, ~rec->curcap);
+		}
+		if (error == 0 && (rec->flags & CKPT_VLAN)) {
+			error = ifconfig_reconcile_set_vlan(r, rec->name,
+			    rec->parent, rec->vlantag);
+		}
+	}
+	if (error == 0) {
+		error = ifconfig_reconcile_run(r, 0);
+	}
+	ifconfig_reconcile_free(r);
+	return (error);
+}
+
+int
+ifconfig_checkpoint_restore(ifconfig_handle_t *h, const char *path)
+{
+	const struct ckpt_header *hdr;
+	const struct ckpt_record *recs;
+	struct ifconfig_batchop *ops;
+	struct errstate first;
+	struct stat sb;
+	size_t *which;
+	void *map;
+	int fd, failed;
+
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) == -1) {
+		ckpt_err(h, errno);
+		return (-1);
+	}
+	if (fstat(fd, &sb) != 0) {
+		ckpt_err(h, errno);
+		(void)close(fd);
+		return (-1);
+	}
+	if (sb.st_size < (off_t)sizeof(*hdr)) {
+		ckpt_err(h, EINVAL);
+		(void)close(fd);
+		return (-1);
+	}
+	map = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	(void)close(fd);
+	if (map == MAP_FAILED) {
+		ckpt_err(h, errno);
+		return (-1);
+	}
+	if (ckpt_check(map, sb.st_size) != 0) {
+		(void)munmap(map, sb.st_size);
+		ckpt_err(h, EINVAL);
+		return (-1);
+	}
+
+	hdr = map;
+	recs = (const struct ckpt_record *)(hdr + 1);
+	if (ckpt_checkpeers(h, recs, hdr->count) != 0) {
+		(void)munmap(map, sb.st_size);
+		return (-1);
+	}
+
+	/* A pair takes two operations, one for each end. */
+	ops = calloc(2 * (size_t)hdr->count + 1, sizeof(*ops));
+	which = calloc(2 * (size_t)hdr->count + 1, sizeof(*which));
+	if (ops == NULL || which == NULL) {
+		free(ops);
+		free(which);
+		(void)munmap(map, sb.st_size);
+		ckpt_err(h, ENOMEM);
+		return (-1);
+	}
+
+	failed = 0;
+	ckpt_create(h, recs, hdr->count, 0, ops, which, &first, &failed);
+	ckpt_create(h, recs, hdr->count, CKPT_VLAN, ops, which, &first,
+	    &failed);
+	free(ops);
+	free(which);
+	if (ckpt_apply(h, recs, hdr->count,
+	    (const char *)(recs + hdr->count)) != 0 && !failed) {
+		first = *ifconfig_errstate(h);
+		failed = 1;
+	}
+	(void)munmap(map, sb.st_size);
+
+	if (failed) {
+		*ifconfig_errstate(h) = first;
+		return (-1);
+	}
+	return (0);
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2016-2017, Marie Helene Kvello-Aune
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * thislist of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+
+#include <sys/types.h>
+
+#include <net/if.h>
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libifconfig.h"
+#include "libifconfig_internal.h"
+
+ifconfig_counters_t *
+ifconfig_counters_new(void)
+{
+
+	return (calloc(1, sizeof(struct ifconfig_counters)));
+}
+
+void
+ifconfig_counters_free(ifconfig_counters_t *c)
+{
+
+	if (c == NULL) {
+		return;
+	}
+	free(c->ifaces);
+	free(c->buf);
+	free(c);
+}
+
+struct ifconfig_ifcounters *
+ifconfig_counters_next(ifconfig_handle_t *h, struct ifconfig_counters *c)
+{
+	struct ifconfig_ifcounters *ifc;
+
+	if (c->count == c->size) {
+		size_t newsize = (c->size == 0) ? 64 : c->size * 2;
+
+		ifc = reallocarray(c->ifaces, newsize, sizeof(*ifc));
+		if (ifc == NULL) {
+			ifconfig_errstate(h)->errtype = OTHER;
+			ifconfig_errstate(h)->errcode = ENOMEM;
+			return (NULL);
+		}
+		c->ifaces = ifc;
+		c->size = newsize;
+	}
+	ifc = &c->ifaces[c->count++];
+	memset(ifc, 0, sizeof(*ifc));
+	return (ifc);
+}
+
+int
+ifconfig_counters_read(ifconfig_handle_t *h, ifconfig_counters_t *c)
+{
+	uint64_t start;
+
+	c->count = 0;
+	start = ifconfig_stats_start();
+	if (ifconfig_stats_record(h, IFCONFIG_STAT_COUNTERS, start,
+	    h->backend->counters(h, c)) != 0) {
+		c->count = 0;
+		return (-1);
+	}
+	return (ifconfig_counters_names(h, c));
+}
+
+size_t
+ifconfig_counters_count(const ifconfig_counters_t *c)
+{
+
+	return (c->count);
+}
+
+const struct ifconfig_ifcounters *
+ifconfig_counters_at(const ifconfig_counters_t *c, size_t i)
+{
+
+	if (i >= c->count) {
+		return (NULL);
+	}
+	return (&c->ifaces[i]);
+}
+
+const struct ifconfig_ifcounters *
+ifconfig_counters_find(const ifconfig_counters_t *c, const char *name)
+{
+
+	for (size_t i = 0; i < c->count; i++) {
+		if (strcmp(c->ifaces[i].name, name) == 0) {
+			return (&c->ifaces[i]);
+		}
+	}
+	return (NULL);
+}
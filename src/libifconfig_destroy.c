@@ -0,0 +1,376 @@
+/*
+ * Copyright (c) 2016-2017, Marie Helene Kvello-Aune
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * thislist of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+
+/*
+ * Bulk interface destruction. SIOCIFDESTROY can block in the kernel for
+ * a long time, so the work is spread over threads, each with a handle of
+ * its own. Interfaces are grouped into levels: level 0 has nothing in the
+ * list stacked on it, level 1 only things of level 0, and so on. A level
+ * is started once the one below it has finished.
+ */
+
+#include <sys/types.h>
+
+#include <net/if.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libifconfig.h"
+#include "libifconfig_internal.h"
+
+#define DESTROY_THREADS_MAX    64
+
+struct destroy_item {
+	const char *name;
+	/* Position in the caller's list. */
+	size_t pos;
+	/* From the interface list; 0 if the interface wasn't in it. */
+	unsigned int index;
+	unsigned int parent;
+	unsigned int level;
+	/* Number of items, in level order, that must finish first. */
+	size_t wait;
+	struct errstate error;
+};
+
+struct destroy_ctx {
+	/* In level order once the work starts. */
+	struct destroy_item *items;
+	size_t n;
+	/* Lookup tables, sorted by name and by index. */
+	struct destroy_item **byname;
+	struct destroy_item **byindex;
+	size_t nindex;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	/* Next item to hand out, and number of items done. */
+	size_t next;
+	size_t finished;
+};
+
+struct destroy_worker {
+	struct destroy_ctx *ctx;
+	ifconfig_handle_t *h;
+	pthread_t thread;
+};
+
+static int
+destroy_cmpname(const void *a, const void *b)
+{
+	const struct destroy_item *x = *(struct destroy_item *const *)a;
+	const struct destroy_item *y = *(struct destroy_item *const *)b;
+
+	return (strcmp(x->name, y->name));
+}
+
+static int
+destroy_cmpindex(const void *a, const void *b)
+{
+	const struct destroy_item *x = *(struct destroy_item *const *)a;
+	const struct destroy_item *y = *(struct destroy_item *const *)b;
+
+	return ((x->index > y->index) - (x->index < y->index));
+}
+
+static int
+destroy_cmplevel(const void *a, const void *b)
+{
+	const struct destroy_item *x = a, *y = b;
+
+	if (x->level != y->level) {
+		return ((x->level > y->level) - (x->level < y->level));
+	}
+	return ((x->pos > y->pos) - (x->pos < y->pos));
+}
+
+static int
+destroy_addlink(ifconfig_handle_t *h __unused,
+    const struct ifconfig_link *link, void *udata)
+{
+	struct destroy_ctx *ctx;
+	struct destroy_item *item;
+	size_t lo, hi, mid;
+	int cmp;
+
+	ctx = udata;
+	lo = 0;
+	hi = ctx->n;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		cmp = strncmp(ctx->byname[mid]->name, link->name,
+		    link->namelen);
+		if (cmp == 0 && ctx->byname[mid]->name[link->namelen] != '\0') {
+			cmp = 1;
+		}
+		if (cmp == 0) {
+			item = ctx->byname[mid];
+			item->index = link->index;
+			item->parent = link->parent;
+			ctx->byindex[ctx->nindex++] = item;
+			break;
+		}
+		if (cmp < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return (0);
+}
+
+static struct destroy_item *
+destroy_byindex(struct destroy_ctx *ctx, const unsigned int index)
+{
+	struct destroy_item key, *keyp, **found;
+
+	key.index = index;
+	keyp = &key;
+	found = bsearch(&keyp, ctx->byindex, ctx->nindex,
+	    sizeof(*ctx->byindex), destroy_cmpindex);
+	return (found == NULL ? NULL : *found);
+}
+
+/*
+ * Raises the level of everything an item is stacked on. Chains are
+ * followed for at most n steps, which also ends cycles such as a pair of
+ * veth peers pointing at each other.
+ */
+static void
+destroy_levels(struct destroy_ctx *ctx)
+{
+	struct destroy_item *item, *up;
+	unsigned int depth;
+
+	qsort(ctx->byindex, ctx->nindex, sizeof(*ctx->byindex),
+	    destroy_cmpindex);
+	for (size_t i = 0; i < ctx->nindex; i++) {
+		item = ctx->byindex[i];
+		up = item;
+		for (depth = 1; depth <= ctx->n && up->parent != 0; depth++) {
+			up = destroy_byindex(ctx, up->parent);
+			if (up == NULL || up == item) {
+				break;
+			}
+			if (up->level < depth) {
+				up->level = depth;
+			}
+		}
+	}
+
+	qsort(ctx->items, ctx->n, sizeof(*ctx->items), destroy_cmplevel);
+	for (size_t i = 0; i < ctx->n; i++) {
+		ctx->items[i].wait = (i > 0 &&
+		    ctx->items[i].level == ctx->items[i - 1].level) ?
+		    ctx->items[i - 1].wait : i;
+	}
+}
+
+static void *
+destroy_work(void *arg)
+{
+	struct destroy_worker *w;
+	struct destroy_ctx *ctx;
+	struct destroy_item *item;
+
+	w = arg;
+	ctx = w->ctx;
+	(void)pthread_mutex_lock(&ctx->lock);
+	for (;;) {
+		while (ctx->next < ctx->n &&
+		    ctx->finished < ctx->items[ctx->next].wait) {
+			(void)pthread_cond_wait(&ctx->cond, &ctx->lock);
+		}
+		if (ctx->next == ctx->n) {
+			break;
+		}
+		item = &ctx->items[ctx->next++];
+		(void)pthread_mutex_unlock(&ctx->lock);
+
+		if (ifconfig_destroy_interface(w->h, item->name) != 0) {
+			item->error = *ifconfig_errstate(w->h);
+		}
+
+		(void)pthread_mutex_lock(&ctx->lock);
+		ctx->finished++;
+		if (ctx->next < ctx->n &&
+		    ctx->finished == ctx->items[ctx->next].wait) {
+			(void)pthread_cond_broadcast(&ctx->cond);
+		}
+	}
+	(void)pthread_mutex_unlock(&ctx->lock);
+	return (NULL);
+}
+
+static unsigned int
+destroy_nthreads(unsigned int nthreads, const size_t n)
+{
+	long ncpu;
+
+	if (nthreads == 0) {
+		ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = (ncpu > 0) ? ncpu : 1;
+	}
+	if (nthreads > DESTROY_THREADS_MAX) {
+		nthreads = DESTROY_THREADS_MAX;
+	}
+	if (nthreads > n) {
+		nthreads = n;
+	}
+	return (nthreads);
+}
+
+/*
+ * Worker 0 is the calling thread and uses h. The others get handles of
+ * their own from ifconfig_open_worker(). Workers that can't be started
+ * just leave more work for the rest.
+ */
+static void
+destroy_run(ifconfig_handle_t *h, struct destroy_ctx *ctx,
+    const unsigned int nthreads)
+{
+	struct destroy_worker self, *w;
+	unsigned int i, started;
+
+	if ((w = calloc(nthreads, sizeof(*w))) == NULL) {
+		memset(&self, 0, sizeof(self));
+		self.ctx = ctx;
+		self.h = h;
+		(void)destroy_work(&self);
+		return;
+	}
+
+	started = 1;
+	for (i = 1; i < nthreads; i++) {
+		if ((w[started].h = ifconfig_open_worker(h)) == NULL) {
+			break;
+		}
+		w[started].ctx = ctx;
+		if (pthread_create(&w[started].thread, NULL, destroy_work,
+		    &w[started]) != 0) {
+			ifconfig_close(w[started].h);
+			break;
+		}
+		started++;
+	}
+
+	w[0].ctx = ctx;
+	w[0].h = h;
+	(void)destroy_work(&w[0]);
+
+	for (i = 1; i < started; i++) {
+		(void)pthread_join(w[i].thread, NULL);
+		ifconfig_stats_merge(h, w[i].h);
+		ifconfig_close(w[i].h);
+	}
+	free(w);
+}
+
+int
+ifconfig_destroy_interfaces(ifconfig_handle_t *h, const char *const *names,
+    const size_t n, unsigned int nthreads, int *errors)
+{
+	struct destroy_ctx ctx;
+	struct destroy_item *item, *first;
+	size_t i;
+
+	if (n == 0) {
+		return (0);
+	}
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.n = n;
+	ctx.items = calloc(n, sizeof(*ctx.items));
+	ctx.byname = calloc(n, sizeof(*ctx.byname));
+	ctx.byindex = calloc(n, sizeof(*ctx.byindex));
+	if (ctx.items == NULL || ctx.byname == NULL || ctx.byindex == NULL) {
+		free(ctx.items);
+		free(ctx.byname);
+		free(ctx.byindex);
+		ifconfig_errstate(h)->errtype = OTHER;
+		ifconfig_errstate(h)->errcode = ENOMEM;
+		return (-1);
+	}
+	for (i = 0; i < n; i++) {
+		ctx.items[i].name = names[i];
+		ctx.items[i].pos = i;
+		ctx.byname[i] = &ctx.items[i];
+	}
+	qsort(ctx.byname, n, sizeof(*ctx.byname), destroy_cmpname);
+
+	/*
+	 * Without the list, nothing is known about stacking and everything
+	 * is destroyed at once; the outcome is still reported per name.
+	 */
+	if (ifconfig_iflist(h, destroy_addlink, &ctx) != 0) {
+		for (i = 0; i < n; i++) {
+			ctx.items[i].index = 0;
+		}
+		ctx.nindex = 0;
+	}
+	destroy_levels(&ctx);
+	free(ctx.byname);
+	free(ctx.byindex);
+
+	(void)pthread_mutex_init(&ctx.lock, NULL);
+	(void)pthread_cond_init(&ctx.cond, NULL);
+	destroy_run(h, &ctx, destroy_nthreads(nthreads, n));
+	(void)pthread_cond_destroy(&ctx.cond);
+	(void)pthread_mutex_destroy(&ctx.lock);
+
+	first = NULL;
+	for (i = 0; i < n; i++) {
+		item = &ctx.items[i];
+		/*
+		 * Gone already although it existed: taken along by something
+		 * destroyed before it, like the other end of an epair.
+		 */
+		if (item->index != 0 && (item->error.errcode == ENXIO ||
+		    item->error.errcode == ENODEV)) {
+			memset(&item->error, 0, sizeof(item->error));
+		}
+		if (errors != NULL) {
+			errors[item->pos] = item->error.errcode;
+		}
+		ifconfig_attrcache_drop(h, item->name);
+		if (item->error.errcode != 0 &&
+		    (first == NULL || item->pos < first->pos)) {
+			first = item;
+		}
+	}
+	if (first != NULL) {
+		*ifconfig_errstate(h) = first->error;
+	}
+	free(ctx.items);
+	return (first == NULL ? 0 : -1);
+}
@@ -0,0 +1,762 @@
+/*
+ * Copyright (c) 2016-2017, Marie Helene Kvello-Aune
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * thislist of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * FreeBSD backend. Requests map directly onto ioctl(2) on a cached socket,
+ * the interface list comes from the NET_RT_IFLIST sysctl.
+ */
+
+#if !defined(__linux__)
+
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/sysctl.h>
+
+#include <net/if.h>
+#include <net/if_dl.h>
+#include <net/if_mib.h>
+#include <net/route.h>
+#include <netinet/in.h>
+#include <netinet/in_var.h>
+#include <netinet6/in6_var.h>
+#include <netinet6/nd6.h>
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libifconfig.h"
+#include "libifconfig_internal.h"
+
+static void
+freebsd_prefixmask(void *mask, const size_t len, unsigned int prefixlen)
+{
+	u_char *p;
+
+	p = mask;
+	memset(p, 0, len);
+	for (; prefixlen >= 8; prefixlen -= 8) {
+		*p++ = 0xff;
+	}
+	if (prefixlen > 0) {
+		*p = (u_char)(0xff00 >> prefixlen);
+	}
+}
+
+/*
+ * The address requests each take their own structure instead of a
+ * struct ifreq. New addresses never expire.
+ */
+static int
+freebsd_addr_ioctl(ifconfig_handle_t *h, const int s, unsigned long request,
+    const struct ifconfig_req *req)
+{
+	struct in_aliasreq ifra;
+	struct in6_aliasreq ifra6;
+	struct in6_ifreq ifr6;
+	struct ifreq ifr;
+	struct sockaddr_in *sin;
+	void *arg;
+
+	switch (request) {
+	case SIOCAIFADDR:
+		memset(&ifra, 0, sizeof(ifra));
+		(void)strlcpy(ifra.ifra_name, req->ifcr_name,
+		    sizeof(ifra.ifra_name));
+		ifra.ifra_addr.sin_len = sizeof(ifra.ifra_addr);
+		ifra.ifra_addr.sin_family = AF_INET;
+		ifra.ifra_addr.sin_addr = req->ifcr_addr.addr.in;
+		ifra.ifra_mask.sin_len = sizeof(ifra.ifra_mask);
+		ifra.ifra_mask.sin_family = AF_INET;
+		freebsd_prefixmask(&ifra.ifra_mask.sin_addr,
+		    sizeof(ifra.ifra_mask.sin_addr), req->ifcr_addr.prefixlen);
+		arg = &ifra;
+		break;
+	case SIOCDIFADDR:
+		memset(&ifr, 0, sizeof(ifr));
+		(void)strlcpy(ifr.ifr_name, req->ifcr_name,
+		    sizeof(ifr.ifr_name));
+		sin = (struct sockaddr_in *)(void *)&ifr.ifr_addr;
+		sin->sin_len = sizeof(*sin);
+		sin->sin_family = AF_INET;
+		sin->sin_addr = req->ifcr_addr.addr.in;
+		arg = &ifr;
+		break;
+	case SIOCAIFADDR_IN6:
+		memset(&ifra6, 0, sizeof(ifra6));
+		(void)strlcpy(ifra6.ifra_name, req->ifcr_name,
+		    sizeof(ifra6.ifra_name));
+		ifra6.ifra_addr.sin6_len = sizeof(ifra6.ifra_addr);
+		ifra6.ifra_addr.sin6_family = AF_INET6;
+		ifra6.ifra_addr.sin6_addr = req->ifcr_addr.addr.in6;
+		ifra6.ifra_prefixmask.sin6_len = sizeof(ifra6.ifra_prefixmask);
+		ifra6.ifra_prefixmask.sin6_family = AF_INET6;
+		freebsd_prefixmask(&ifra6.ifra_prefixmask.sin6_addr,
+		    sizeof(ifra6.ifra_prefixmask.sin6_addr),
+		    req->ifcr_addr.prefixlen);
+		ifra6.ifra_lifetime.ia6t_vltime = ND6_INFINITE_LIFETIME;
+		ifra6.ifra_lifetime.ia6t_pltime = ND6_INFINITE_LIFETIME;
+		arg = &ifra6;
+		break;
+	default:
+		memset(&ifr6, 0, sizeof(ifr6));
+		(void)strlcpy(ifr6.ifr_name, req->ifcr_name,
+		    sizeof(ifr6.ifr_name));
+		ifr6.ifr_addr.sin6_len = sizeof(ifr6.ifr_addr);
+		ifr6.ifr_addr.sin6_family = AF_INET6;
+		ifr6.ifr_addr.sin6_addr = req->ifcr_addr.addr.in6;
+		arg = &ifr6;
+		break;
+	}
+
+	if (ioctl(s, request, arg) != 0) {
+		ifconfig_ioctlerr(h, request);
+		return (-1);
+	}
+	return (0);
+}
+
+/*
+ * if_bridge(4) requests. BRDGGIFS reads the member list into a stack
+ * buffer, and only asks for its size and allocates when that fills up.
+ */
+static int
+freebsd_bridge_ioctl(ifconfig_handle_t *h, int s, unsigned long request,
+    struct ifconfig_req *req)
+{
+	struct ifdrv ifd;
+	struct ifbreq breq, stackreqs[64], *reqs;
+	struct ifbifconf bifc;
+	size_t count, len, max;
+
+	memset(&ifd, 0, sizeof(ifd));
+	(void)strlcpy(ifd.ifd_name, req->ifcr_name, sizeof(ifd.ifd_name));
+	ifd.ifd_cmd = req->ifcr_drvcmd;
+
+	if (req->ifcr_drvcmd != BRDGGIFS) {
+		memset(&breq, 0, sizeof(breq));
+		(void)strlcpy(breq.ifbr_ifsname, req->ifcr_member,
+		    sizeof(breq.ifbr_ifsname));
+		ifd.ifd_len = sizeof(breq);
+		ifd.ifd_data = &breq;
+		if (ioctl(s, request, &ifd) != 0) {
+			ifconfig_ioctlerr(h, request);
+			return (-1);
+		}
+		return (0);
+	}
+
+	memset(&bifc, 0, sizeof(bifc));
+	ifd.ifd_len = sizeof(bifc);
+	ifd.ifd_data = &bifc;
+	reqs = stackreqs;
+	len = sizeof(stackreqs);
+	for (;;) {
+		bifc.ifbic_len = len;
+		bifc.ifbic_req = reqs;
+		if (ioctl(s, request, &ifd) != 0) {
+			goto fail;
+		}
+		/* A full buffer may have cut the list short. */
+		if (bifc.ifbic_len < len) {
+			break;
+		}
+		if (reqs != stackreqs) {
+			free(reqs);
+			reqs = stackreqs;
+		}
+		/* A length of 0 asks for the size of the whole list. */
+		bifc.ifbic_len = 0;
+		if (ioctl(s, request, &ifd) != 0) {
+			goto fail;
+		}
+		len = bifc.ifbic_len + sizeof(*reqs);
+		if ((reqs = malloc(len)) == NULL) {
+			goto fail;
+		}
+	}
+
+	count = bifc.ifbic_len / sizeof(*reqs);
+	max = req->ifcr_buffer.length / IFNAMSIZ;
+	for (size_t i = 0; i < count && i < max; i++) {
+		(void)strlcpy((char *)req->ifcr_buffer.buffer + i * IFNAMSIZ,
+		    reqs[i].ifbr_ifsname, IFNAMSIZ);
+	}
+	req->ifcr_buffer.length = count * IFNAMSIZ;
+	if (reqs != stackreqs) {
+		free(reqs);
+	}
+	return (0);
+
+fail:
+	ifconfig_ioctlerr(h, request);
+	if (reqs != stackreqs) {
+		free(reqs);
+	}
+	return (-1);
+}
+
+/* Reads as many cloner names as fit, and how much room all of them need. */
+static int
+freebsd_cloners(ifconfig_handle_t *h, int s, struct ifconfig_req *req)
+{
+	struct if_clonereq ifcr;
+
+	memset(&ifcr, 0, sizeof(ifcr));
+	ifcr.ifcr_count = (int)(req->ifcr_buffer.length / IFNAMSIZ);
+	ifcr.ifcr_buffer = req->ifcr_buffer.buffer;
+	if (ioctl(s, SIOCIFGCLONERS, &ifcr) != 0) {
+		ifconfig_ioctlerr(h, SIOCIFGCLONERS);
+		return (-1);
+	}
+	req->ifcr_buffer.length = (size_t)ifcr.ifcr_total * IFNAMSIZ;
+	return (0);
+}
+
+static int
+freebsd_ioctl(ifconfig_handle_t *h, const int addressfamily,
+    unsigned long request, struct ifconfig_req *req)
+{
+	struct ifreq ifr;
+	struct vlanreq params;
+	size_t len;
+	int s;
+
+	if (ifconfig_socket(h, addressfamily, &s) != 0) {
+		return (-1);
+	}
+
+	switch (request) {
+	case SIOCAIFADDR:
+	case SIOCDIFADDR:
+	case SIOCAIFADDR_IN6:
+	case SIOCDIFADDR_IN6:
+		return (freebsd_addr_ioctl(h, s, request, req));
+	case SIOCSDRVSPEC:
+	case SIOCGDRVSPEC:
+		return (freebsd_bridge_ioctl(h, s, request, req));
+	case SIOCIFGCLONERS:
+		return (freebsd_cloners(h, s, req));
+	}
+
+	memset(&ifr, 0, sizeof(ifr));
+	(void)strlcpy(ifr.ifr_name, req->ifcr_name, sizeof(ifr.ifr_name));
+
+	switch (request) {
+	case SIOCSIFMTU:
+		ifr.ifr_mtu = req->ifcr_mtu;
+		break;
+	case SIOCSIFMETRIC:
+		ifr.ifr_metric = req->ifcr_metric;
+		break;
+	case SIOCGIFDESCR:
+	case SIOCSIFDESCR:
+		ifr.ifr_buffer.buffer = req->ifcr_buffer.buffer;
+		ifr.ifr_buffer.length = req->ifcr_buffer.length;
+		break;
+	case SIOCSIFNAME:
+		ifr.ifr_data = req->ifcr_newname;
+		break;
+	case SIOCSIFCAP:
+		ifr.ifr_reqcap = req->ifcr_reqcap;
+		break;
+	case SIOCIFCREATE2:
+		if (req->ifcr_vlanparent[0] == '\0') {
+			break;
+		}
+		/* FALLTHROUGH */
+	case SIOCSETVLAN:
+	case SIOCGETVLAN:
+		memset(&params, 0, sizeof(params));
+		params.vlr_tag = req->ifcr_vlantag;
+		(void)strlcpy(params.vlr_parent, req->ifcr_vlanparent,
+		    sizeof(params.vlr_parent));
+		ifr.ifr_data = (caddr_t)&params;
+		break;
+	}
+
+	if (ioctl(s, request, &ifr) != 0) {
+		ifconfig_ioctlerr(h, request);
+		return (-1);
+	}
+
+	switch (request) {
+	case SIOCGIFMTU:
+		req->ifcr_mtu = ifr.ifr_mtu;
+		break;
+	case SIOCGIFMETRIC:
+		req->ifcr_metric = ifr.ifr_metric;
+		break;
+	case SIOCGIFDESCR:
+		req->ifcr_buffer.buffer = ifr.ifr_buffer.buffer;
+		req->ifcr_buffer.length = ifr.ifr_buffer.length;
+		break;
+	case SIOCGIFCAP:
+		req->ifcr_curcap = ifr.ifr_curcap;
+		req->ifcr_reqcap = ifr.ifr_reqcap;
+		break;
+	case SIOCIFCREATE2:
+		(void)strlcpy(req->ifcr_name, ifr.ifr_name,
+		    sizeof(req->ifcr_name));
+		/* An epair is named after its a end; the b end is its peer. */
+		len = strlen(ifr.ifr_name);
+		if (strncmp(ifr.ifr_name, "epair", strlen("epair")) == 0 &&
+		    ifr.ifr_name[len - 1] == 'a') {
+			memcpy(req->ifcr_peer, ifr.ifr_name, len + 1);
+			req->ifcr_peer[len - 1] = 'b';
+		}
+		break;
+	case SIOCGETVLAN:
+		req->ifcr_vlantag = params.vlr_tag;
+		(void)strlcpy(req->ifcr_vlanparent, params.vlr_parent,
+		    sizeof(req->ifcr_vlanparent));
+		break;
+	}
+	return (0);
+}
+
+/*
+ * Fetches NET_RT_IFLIST in one go, for all interfaces or only ifindex.
+ * The list may grow between the size probe and the actual read, in which
+ * case sysctl fails with ENOMEM and we try again.
+ */
+static int
+freebsd_fetch_iflist(ifconfig_handle_t *h, const unsigned int ifindex,
+    char **buf, size_t *len)
+{
+	int mib[6];
+
+	mib[0] = CTL_NET;
+	mib[1] = PF_ROUTE;
+	mib[2] = 0;
+	mib[3] = 0;
+	mib[4] = NET_RT_IFLIST;
+	mib[5] = ifindex;
+
+	*buf = NULL;
+	for (;;) {
+		if (sysctl(mib, 6, NULL, len, NULL, 0) < 0) {
+			goto fail;
+		}
+		if ((*buf = reallocf(*buf, *len)) == NULL) {
+			goto fail;
+		}
+		if (sysctl(mib, 6, *buf, len, NULL, 0) == 0) {
+			return (0);
+		}
+		if (errno != ENOMEM) {
+			goto fail;
+		}
+	}
+
+fail:
+	free(*buf);
+	*buf = NULL;
+	ifconfig_errstate(h)->errtype = OTHER;
+	ifconfig_errstate(h)->errcode = errno;
+	return (-1);
+}
+
+static int
+freebsd_iflist(ifconfig_handle_t *h, ifconfig_iflist_cb_t *cb, void *udata)
+{
+	struct ifconfig_link link;
+	struct if_msghdr *ifm;
+	struct sockaddr_dl *sdl;
+	char *buf, *next;
+	size_t len;
+	int error;
+
+	if (freebsd_fetch_iflist(h, 0, &buf, &len) != 0) {
+		return (-1);
+	}
+
+	error = 0;
+	memset(&link, 0, sizeof(link));
+	for (next = buf; next < buf + len; next += ifm->ifm_msglen) {
+		ifm = (struct if_msghdr *)(void *)next;
+		if (ifm->ifm_type != RTM_IFINFO) {
+			continue;
+		}
+		if ((ifm->ifm_addrs & RTA_IFP) == 0) {
+			continue;
+		}
+
+		/* RTA_IFP is the first address, so it directly follows. */
+		sdl = (struct sockaddr_dl *)(void *)(ifm + 1);
+		link.index = ifm->ifm_index;
+		link.flags = ifm->ifm_flags;
+		link.mtu = ifm->ifm_data.ifi_mtu;
+		link.metric = ifm->ifm_data.ifi_metric;
+		link.name = sdl->sdl_data;
+		link.namelen = sdl->sdl_nlen;
+		if ((error = cb(h, &link, udata)) != 0) {
+			break;
+		}
+	}
+
+	free(buf);
+	return (error);
+}
+
+/*
+ * Reads NET_RT_IFLIST into the buffer kept in c, which is only grown when
+ * the list no longer fits. Asking for AF_LINK addresses leaves out all
+ * addresses but the link-level one, which is part of RTM_IFINFO anyway,
+ * so a steady-state read is a single sysctl.
+ */
+static int
+freebsd_fetch_counters(ifconfig_handle_t *h, struct ifconfig_counters *c,
+    size_t *len)
+{
+	int mib[6];
+	void *buf;
+
+	mib[0] = CTL_NET;
+	mib[1] = PF_ROUTE;
+	mib[2] = 0;
+	mib[3] = AF_LINK;
+	mib[4] = NET_RT_IFLIST;
+	mib[5] = 0;
+
+	for (;;) {
+		*len = c->buflen;
+		if (c->buf != NULL &&
+		    sysctl(mib, 6, c->buf, len, NULL, 0) == 0) {
+			return (0);
+		}
+		if (c->buf != NULL && errno != ENOMEM) {
+			break;
+		}
+		if (sysctl(mib, 6, NULL, len, NULL, 0) < 0) {
+			break;
+		}
+		/* Leave room for interfaces that come along. */
+		*len += *len / 4;
+		if ((buf = realloc(c->buf, *len)) == NULL) {
+			break;
+		}
+		c->buf = buf;
+		c->buflen = *len;
+	}
+
+	ifconfig_errstate(h)->errtype = OTHER;
+	ifconfig_errstate(h)->errcode = errno;
+	return (-1);
+}
+
+static int
+freebsd_counters(ifconfig_handle_t *h, struct ifconfig_counters *c)
+{
+	struct ifconfig_ifcounters *ifc;
+	struct if_msghdr *ifm;
+	struct sockaddr_dl *sdl;
+	char *next;
+	size_t len;
+
+	if (freebsd_fetch_counters(h, c, &len) != 0) {
+		return (-1);
+	}
+
+	for (next = c->buf; next < (char *)c->buf + len;
+	    next += ifm->ifm_msglen) {
+		ifm = (struct if_msghdr *)(void *)next;
+		if (ifm->ifm_type != RTM_IFINFO ||
+		    (ifm->ifm_addrs & RTA_IFP) == 0) {
+			continue;
+		}
+		if ((ifc = ifconfig_counters_next(h, c)) == NULL) {
+			return (-1);
+		}
+		sdl = (struct sockaddr_dl *)(void *)(ifm + 1);
+		ifc->index = ifm->ifm_index;
+		memcpy(ifc->name, sdl->sdl_data, sdl->sdl_nlen < IFNAMSIZ ?
+		    sdl->sdl_nlen : IFNAMSIZ - 1);
+		ifc->ipackets = ifm->ifm_data.ifi_ipackets;
+		ifc->ierrors = ifm->ifm_data.ifi_ierrors;
+		ifc->iqdrops = ifm->ifm_data.ifi_iqdrops;
+		ifc->ibytes = ifm->ifm_data.ifi_ibytes;
+		ifc->imcasts = ifm->ifm_data.ifi_imcasts;
+		ifc->opackets = ifm->ifm_data.ifi_opackets;
+		ifc->oerrors = ifm->ifm_data.ifi_oerrors;
+		ifc->oqdrops = ifm->ifm_data.ifi_oqdrops;
+		ifc->obytes = ifm->ifm_data.ifi_obytes;
+		ifc->omcasts = ifm->ifm_data.ifi_omcasts;
+		ifc->collisions = ifm->ifm_data.ifi_collisions;
+		ifc->noproto = ifm->ifm_data.ifi_noproto;
+	}
+	return (0);
+}
+
+/*
+ * Netmasks in routing messages are cut short after the last non-zero
+ * byte, so only the bytes present are counted.
+ */
+static unsigned int
+freebsd_prefixlen(const struct sockaddr *mask, const size_t off,
+    const size_t len)
+{
+	const u_char *p;
+	unsigned int prefixlen;
+	u_char b;
+
+	if (mask == NULL) {
+		return (len * 8);
+	}
+	p = (const u_char *)mask + off;
+	prefixlen = 0;
+	for (size_t i = 0; i < len && off + i < mask->sa_len; i++) {
+		for (b = p[i]; b & 0x80; b <<= 1) {
+			prefixlen++;
+		}
+		if (p[i] != 0xff) {
+			break;
+		}
+	}
+	return (prefixlen);
+}
+
+static int
+freebsd_toaddr(const struct sockaddr *sa, const struct sockaddr *mask,
+    struct ifconfig_addr *addr)
+{
+	const struct sockaddr_in *sin;
+	const struct sockaddr_in6 *sin6;
+
+	if (sa == NULL) {
+		return (-1);
+	}
+	memset(addr, 0, sizeof(*addr));
+	switch (sa->sa_family) {
+	case AF_INET:
+		sin = (const struct sockaddr_in *)(const void *)sa;
+		addr->family = AF_INET;
+		addr->addr.in = sin->sin_addr;
+		addr->prefixlen = freebsd_prefixlen(mask,
+		    offsetof(struct sockaddr_in, sin_addr),
+		    sizeof(sin->sin_addr));
+		return (0);
+	case AF_INET6:
+		sin6 = (const struct sockaddr_in6 *)(const void *)sa;
+		addr->family = AF_INET6;
+		addr->addr.in6 = sin6->sin6_addr;
+		/* Link-local addresses may carry the embedded scope. */
+		if (IN6_IS_ADDR_LINKLOCAL(&addr->addr.in6)) {
+			addr->addr.in6.s6_addr[2] = 0;
+			addr->addr.in6.s6_addr[3] = 0;
+		}
+		addr->prefixlen = freebsd_prefixlen(mask,
+		    offsetof(struct sockaddr_in6, sin6_addr),
+		    sizeof(sin6->sin6_addr));
+		return (0);
+	default:
+		return (-1);
+	}
+}
+
+static int
+freebsd_addrlist(ifconfig_handle_t *h, const unsigned int ifindex,
+    ifconfig_addrlist_cb_t *cb, void *udata)
+{
+	struct ifconfig_addr addr;
+	struct ifa_msghdr *ifam;
+	struct sockaddr *sa, *sas[RTAX_MAX];
+	char *buf, *next, *p;
+	size_t len;
+	int error;
+
+	if (freebsd_fetch_iflist(h, ifindex, &buf, &len) != 0) {
+		return (-1);
+	}
+
+	error = 0;
+	for (next = buf; next < buf + len; next += ifam->ifam_msglen) {
+		ifam = (struct ifa_msghdr *)(void *)next;
+		if (ifam->ifam_type != RTM_NEWADDR) {
+			continue;
+		}
+
+		/* Addresses follow in RTA_* bit order, each padded. */
+		memset(sas, 0, sizeof(sas));
+		p = (char *)(ifam + 1);
+		for (int i = 0; i < RTAX_MAX; i++) {
+			if ((ifam->ifam_addrs & (1 << i)) == 0) {
+				continue;
+			}
+			sa = (struct sockaddr *)(void *)p;
+			sas[i] = sa;
+			p += SA_SIZE(sa);
+		}
+		if (freebsd_toaddr(sas[RTAX_IFA], sas[RTAX_NETMASK],
+		    &addr) != 0) {
+			continue;
+		}
+		if ((error = cb(h, &addr, udata)) != 0) {
+			break;
+		}
+	}
+
+	free(buf);
+	return (error);
+}
+
+static int
+freebsd_linkev_open(ifconfig_handle_t *h, int *fd)
+{
+
+	*fd = socket(PF_ROUTE, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC,
+	    AF_UNSPEC);
+	if (*fd == -1) {
+		ifconfig_errstate(h)->errtype = SOCKET;
+		ifconfig_errstate(h)->errcode = errno;
+		return (-1);
+	}
+#ifdef SO_RERROR
+	/* Report overflows as ENOBUFS instead of silently dropping. */
+	(void)setsockopt(*fd, SOL_SOCKET, SO_RERROR, &(int){ 1 },
+	    sizeof(int));
+#endif
+	return (0);
+}
+
+static int
+freebsd_linkev_read(ifconfig_handle_t *h, const int fd,
+    ifconfig_linkev_cb_t *cb, void *udata)
+{
+	char buf[8192];
+	struct ifconfig_link link;
+	struct rt_msghdr *rtm;
+	struct if_msghdr *ifm;
+	struct if_announcemsghdr *ifan;
+	enum ifconfig_linkev_type type;
+	ssize_t len;
+	char *next;
+	int error;
+
+	for (;;) {
+		len = recv(fd, buf, sizeof(buf), 0);
+		if (len < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				return (0);
+			}
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == ENOBUFS) {
+				memset(&link, 0, sizeof(link));
+				if ((error = cb(h, IFCONFIG_LINKEV_LOST, &link,
+				    udata)) != 0) {
+					return (error);
+				}
+				continue;
+			}
+			ifconfig_errstate(h)->errtype = SOCKET;
+			ifconfig_errstate(h)->errcode = errno;
+			return (-1);
+		}
+
+		for (next = buf; next + sizeof(*rtm) <= buf + len;
+		    next += rtm->rtm_msglen) {
+			rtm = (struct rt_msghdr *)(void *)next;
+			if (rtm->rtm_msglen == 0) {
+				break;
+			}
+			memset(&link, 0, sizeof(link));
+			switch (rtm->rtm_type) {
+			case RTM_IFANNOUNCE:
+				ifan = (struct if_announcemsghdr *)(void *)rtm;
+				link.index = ifan->ifan_index;
+				link.name = ifan->ifan_name;
+				link.namelen = strnlen(ifan->ifan_name,
+				    sizeof(ifan->ifan_name));
+				link.announce = 1;
+				type = (ifan->ifan_what == IFAN_ARRIVAL) ?
+				    IFCONFIG_LINKEV_NEW : IFCONFIG_LINKEV_DEL;
+				break;
+			case RTM_IFINFO:
+				/* Carries no name. */
+				ifm = (struct if_msghdr *)(void *)rtm;
+				link.index = ifm->ifm_index;
+				link.flags = ifm->ifm_flags;
+				link.mtu = ifm->ifm_data.ifi_mtu;
+				link.metric = ifm->ifm_data.ifi_metric;
+				type = IFCONFIG_LINKEV_NEW;
+				break;
+			default:
+				continue;
+			}
+			if ((error = cb(h, type, &link, udata)) != 0) {
+				return (error);
+			}
+		}
+	}
+}
+
+static int
+freebsd_drivername(ifconfig_handle_t *h, const unsigned int ifindex,
+    char *buf, size_t len)
+{
+	int name[6];
+
+	name[0] = CTL_NET;
+	name[1] = PF_LINK;
+	name[2] = NETLINK_GENERIC;
+	name[3] = IFMIB_IFDATA;
+	name[4] = ifindex;
+	name[5] = IFDATA_DRIVERNAME;
+
+	if (sysctl(name, 6, buf, &len, 0, 0) < 0) {
+		if (errno == ENOMEM) {
+			errno = ERANGE;
+		}
+		goto fail;
+	}
+
+	return (0);
+
+fail:
+	ifconfig_errstate(h)->errtype = OTHER;
+	ifconfig_errstate(h)->errcode = (errno != 0) ? errno : ENOENT;
+	return (-1);
+}
+
+const struct ifconfig_backend ifconfig_backend_freebsd = {
+	.name = "freebsd",
+	.ioctl = freebsd_ioctl,
+	.iflist = freebsd_iflist,
+	.addrlist = freebsd_addrlist,
+	.counters = freebsd_counters,
+	.drivername = freebsd_drivername,
+	.linkev_open = freebsd_linkev_open,
+	.linkev_read = freebsd_linkev_read,
+};
+
+#endif /* !__linux__ */
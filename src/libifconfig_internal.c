@@ -26,13 +26,18 @@
  * $FreeBSD$
  */
 
+#include <sys/types.h>
 #include <sys/ioctl.h>
+#include <sys/socket.h>
 
 #include <net/if.h>
 
 #include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "libifconfig.h" // Needed for ifconfig_errstate
@@ -40,51 +45,311 @@
 
 int
 ifconfig_ioctlwrap(ifconfig_handle_t *h, const int addressfamily,
-    unsigned long request, struct ifreq *ifr)
+    unsigned long request, struct ifconfig_req *req)
 {
-	int s;
+	uint64_t start;
+	unsigned int gen;
+	int cached, error;
 
-	if (ifconfig_socket(h, addressfamily, &s) != 0) {
-		return (-1);
+	cached = __atomic_load_n(&h->attrcache.enabled, __ATOMIC_ACQUIRE);
+	if (cached && ifconfig_attrcache_get(h, request, req, &gen) == 0) {
+		return (0);
+	}
+	start = ifconfig_stats_start();
+	error = ifconfig_stats_record(h, request, start,
+	    h->backend->ioctl(h, addressfamily, request, req));
+	if (cached) {
+		ifconfig_attrcache_put(h, request, req, error, gen);
+	}
+	return (error);
+}
+
+int
+ifconfig_iflist(ifconfig_handle_t *h, ifconfig_iflist_cb_t *cb, void *udata)
+{
+	uint64_t start;
+
+	start = ifconfig_stats_start();
+	return (ifconfig_stats_record(h, IFCONFIG_STAT_IFLIST, start,
+	    h->backend->iflist(h, cb, udata)));
+}
+
+int
+ifconfig_addrlist(ifconfig_handle_t *h, const unsigned int ifindex,
+    ifconfig_addrlist_cb_t *cb, void *udata)
+{
+	uint64_t start;
+
+	start = ifconfig_stats_start();
+	return (ifconfig_stats_record(h, IFCONFIG_STAT_ADDRLIST, start,
+	    h->backend->addrlist(h, ifindex, cb, udata)));
+}
+
+int
+ifconfig_addrreq(ifconfig_handle_t *h, const char *name,
+    const struct ifconfig_addr *addr, const int add,
+    struct ifconfig_req *req, unsigned long *request)
+{
+
+	switch (addr->family) {
+	case AF_INET:
+		if (addr->prefixlen > 32) {
+			goto inval;
+		}
+		*request = add ? SIOCAIFADDR : SIOCDIFADDR;
+		break;
+	case AF_INET6:
+		if (addr->prefixlen > 128) {
+			goto inval;
+		}
+		*request = add ? SIOCAIFADDR_IN6 : SIOCDIFADDR_IN6;
+		break;
+	default:
+		goto inval;
+	}
+
+	memset(req, 0, sizeof(*req));
+	(void)strlcpy(req->ifcr_name, name, sizeof(req->ifcr_name));
+	req->ifcr_addr = *addr;
+	return (0);
+
+inval:
+	ifconfig_errstate(h)->errtype = OTHER;
+	ifconfig_errstate(h)->errcode = EINVAL;
+	return (-1);
+}
+
+void
+ifconfig_ioctlerr(ifconfig_handle_t *h, unsigned long request)
+{
+
+	ifconfig_errstate(h)->errtype = IOCTL;
+	ifconfig_errstate(h)->ioctl_request = request;
+	ifconfig_errstate(h)->errcode = errno;
+}
+
+ifconfig_handle_t *
+ifconfig_open_worker(ifconfig_handle_t *h)
+{
+	ifconfig_handle_t *wh;
+
+	if ((wh = ifconfig_open()) == NULL) {
+		return (NULL);
+	}
+	wh->backend = h->backend;
+	wh->backend_data = h->backend_data;
+	return (wh);
+}
+
+__thread struct errstate ifconfig_tls_error;
+
+unsigned int ifconfig_seq;
+
+/* Idle private sockets kept for the next handle; more are closed. */
+#define SOCKPOOL_IDLE_MAX	16
+
+/*
+ * Sockets shared by every handle in the process. Sockets used for
+ * ioctls carry no state from one request to the next, so a single one
+ * per address family serves all handles. Private sockets (see
+ * ifconfig_backend.private_af) are lent to one handle at a time.
+ *
+ * Each live handle holds a reference, and the library holds one until
+ * it is unloaded. Whoever drops the last one closes the sockets.
+ */
+static struct {
+	pthread_mutex_t lock;
+	unsigned int refs;
+	int sockets[AF_MAX + 1];
+	int idle[SOCKPOOL_IDLE_MAX];
+	size_t nidle;
+} sockpool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.refs = 1,
+	.sockets = { [0 ... AF_MAX] = -1 },
+};
+
+static int
+sockpool_create(ifconfig_handle_t *h, const int addressfamily)
+{
+	uint64_t start;
+	int fd;
+
+	start = ifconfig_stats_start();
+	fd = socket(addressfamily, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (fd == -1) {
+		ifconfig_errstate(h)->errtype = SOCKET;
+		ifconfig_errstate(h)->errcode = errno;
+	}
+	(void)ifconfig_stats_record(h, IFCONFIG_STAT_SOCKET, start,
+	    fd == -1 ? -1 : 0);
+	return (fd);
+}
+
+static void
+sockpool_giveback(int fd)
+{
+
+	(void)pthread_mutex_lock(&sockpool.lock);
+	if (sockpool.nidle < SOCKPOOL_IDLE_MAX) {
+		sockpool.idle[sockpool.nidle++] = fd;
+		fd = -1;
+	}
+	(void)pthread_mutex_unlock(&sockpool.lock);
+	if (fd != -1) {
+		(void)close(fd);
 	}
+}
+
+static int
+sockpool_borrow(ifconfig_handle_t *h, const int addressfamily, int *s)
+{
+	int expected, fd;
 
-	if (ioctl(s, request, ifr) != 0) {
-		h->error.errtype = IOCTL;
-		h->error.ioctl_request = request;
-		h->error.errcode = errno;
+	fd = __atomic_load_n(&h->privsock, __ATOMIC_ACQUIRE);
+	if (fd != -1) {
+		*s = fd;
+		return (0);
+	}
+
+	(void)pthread_mutex_lock(&sockpool.lock);
+	if (sockpool.nidle > 0) {
+		fd = sockpool.idle[--sockpool.nidle];
+	}
+	(void)pthread_mutex_unlock(&sockpool.lock);
+	if (fd == -1 && (fd = sockpool_create(h, addressfamily)) == -1) {
 		return (-1);
 	}
 
+	/* Threads sharing the handle may race; the loser gives its back. */
+	expected = -1;
+	if (!__atomic_compare_exchange_n(&h->privsock, &expected, fd, 0,
+	    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		sockpool_giveback(fd);
+		fd = expected;
+	}
+
+	*s = fd;
 	return (0);
 }
 
+static void
+sockpool_close(void)
+{
+
+	for (int i = 0; i <= AF_MAX; i++) {
+		if (sockpool.sockets[i] != -1) {
+			(void)close(sockpool.sockets[i]);
+			sockpool.sockets[i] = -1;
+		}
+	}
+	while (sockpool.nidle > 0) {
+		(void)close(sockpool.idle[--sockpool.nidle]);
+	}
+}
+
+/*
+ * A child shares the parent's idle private sockets, and would read
+ * replies meant for the parent. Handles opened before the fork are
+ * equally shared; that was always the case.
+ */
+static void
+sockpool_atfork_child(void)
+{
+
+	(void)pthread_mutex_init(&sockpool.lock, NULL);
+	while (sockpool.nidle > 0) {
+		(void)close(sockpool.idle[--sockpool.nidle]);
+	}
+}
+
+static void __attribute__((constructor))
+sockpool_init(void)
+{
+
+	(void)pthread_atfork(NULL, NULL, sockpool_atfork_child);
+}
+
+static void __attribute__((destructor))
+sockpool_fini(void)
+{
+
+	if (__atomic_sub_fetch(&sockpool.refs, 1, __ATOMIC_ACQ_REL) == 0) {
+		sockpool_close();
+	}
+}
+
+void
+ifconfig_sockpool_ref(void)
+{
+
+	(void)__atomic_add_fetch(&sockpool.refs, 1, __ATOMIC_RELAXED);
+}
+
+void
+ifconfig_sockpool_unref(ifconfig_handle_t *h)
+{
+
+	if (h->privsock != -1) {
+		sockpool_giveback(h->privsock);
+		h->privsock = -1;
+	}
+	if (__atomic_sub_fetch(&sockpool.refs, 1, __ATOMIC_ACQ_REL) == 0) {
+		sockpool_close();
+	}
+}
+
 /*
  * Function to get socket for the specified address family.
- * If the socket doesn't already exist, attempt to create it.
+ * If the pool doesn't have one yet, attempt to create it. Threads may
+ * race here; the loser closes its socket and uses the winner's, so no
+ * lock is needed.
  */
 int
 ifconfig_socket(ifconfig_handle_t *h, const int addressfamily, int *s)
 {
+	int expected, fd;
 
 	if (addressfamily > AF_MAX) {
-		h->error.errtype = SOCKET;
-		h->error.errcode = EINVAL;
+		ifconfig_errstate(h)->errtype = SOCKET;
+		ifconfig_errstate(h)->errcode = EINVAL;
 		return (-1);
 	}
+	if (addressfamily != AF_UNSPEC &&
+	    addressfamily == h->backend->private_af) {
+		return (sockpool_borrow(h, addressfamily, s));
+	}
 
-	if (h->sockets[addressfamily] != -1) {
-		*s = h->sockets[addressfamily];
+	fd = __atomic_load_n(&sockpool.sockets[addressfamily],
+	    __ATOMIC_ACQUIRE);
+	if (fd != -1) {
+		*s = fd;
 		return (0);
 	}
 
 	/* We don't have a socket of that type available. Create one. */
-	h->sockets[addressfamily] = socket(addressfamily, SOCK_DGRAM, 0);
-	if (h->sockets[addressfamily] == -1) {
-		h->error.errtype = SOCKET;
-		h->error.errcode = errno;
+	if ((fd = sockpool_create(h, addressfamily)) == -1) {
 		return (-1);
 	}
 
-	*s = h->sockets[addressfamily];
+	expected = -1;
+	if (!__atomic_compare_exchange_n(&sockpool.sockets[addressfamily],
+	    &expected, fd, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		(void)close(fd);
+		fd = expected;
+	}
+
+	*s = fd;
 	return (0);
 }
+
+int
+ifconfig_get_drivername(ifconfig_handle_t *h, const unsigned int ifindex,
+    char *buf, size_t len)
+{
+	uint64_t start;
+
+	start = ifconfig_stats_start();
+	return (ifconfig_stats_record(h, IFCONFIG_STAT_DRIVERNAME, start,
+	    h->backend->drivername(h, ifindex, buf, len)));
+}
@@ -28,8 +28,69 @@
 
 #pragma once
 
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <net/if.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
 #include "libifconfig.h"
 
+/* Build with -DIFCONFIG_STATS=0 to compile the statistics out. */
+#ifndef IFCONFIG_STATS
+#define IFCONFIG_STATS	1
+#endif
+
+/** Distinct request codes a handle keeps statistics for. Power of 2. */
+#define IFCONFIG_STATS_MAX	32
+
+#if defined(__linux__)
+#include <sys/ioctl.h>
+
+/* glibc lacks these BSD extensions; see libifconfig_linux.c. */
+#define strlcpy		ifconfig_strlcpy
+#define reallocf	ifconfig_reallocf
+size_t ifconfig_strlcpy(char *dst, const char *src, size_t size);
+void *ifconfig_reallocf(void *ptr, size_t size);
+
+#ifndef __unused
+#define __unused	__attribute__((__unused__))
+#endif
+
+/*
+ * Request codes that only exist on FreeBSD. The Linux backend translates
+ * them into rtnetlink messages, so they keep their FreeBSD definitions
+ * purely to stay distinct from the native SIOC* codes.
+ */
+#define SIOCSIFCAP	_IOW('i', 30, struct ifreq)
+#define SIOCGIFCAP	_IOWR('i', 31, struct ifreq)
+#define SIOCSIFDESCR	_IOW('i', 41, struct ifreq)
+#define SIOCGIFDESCR	_IOWR('i', 42, struct ifreq)
+#define SIOCSETVLAN	_IOW('i', 57, struct ifreq)
+#define SIOCGETVLAN	_IOWR('i', 58, struct ifreq)
+#define SIOCIFGCLONERS	_IOWR('i', 120, struct ifreq)
+#define SIOCIFDESTROY	_IOW('i', 121, struct ifreq)
+#define SIOCSDRVSPEC	_IOW('i', 123, struct ifreq)
+#define SIOCGDRVSPEC	_IOWR('i', 123, struct ifreq)
+#define SIOCIFCREATE2	_IOWR('i', 124, struct ifreq)
+#define SIOCAIFADDR	_IOW('i', 43, struct ifreq)
+#define SIOCAIFADDR_IN6	_IOW('i', 27, struct ifreq)
+#define SIOCDIFADDR_IN6	_IOW('i', 25, struct ifreq)
+
+/* if_bridge(4) commands for SIOC[GS]DRVSPEC, as in net/if_bridgevar.h. */
+#define BRDGADD		0
+#define BRDGDEL		1
+#define BRDGGIFS	6
+#else
+#include <net/ethernet.h>
+#include <net/if_bridgevar.h>
+#include <net/if_vlan_var.h>
+#include <netinet/in.h>
+#include <netinet6/in6_var.h>
+#endif
 
 struct errstate {
 	/**
@@ -49,11 +110,435 @@ struct errstate {
 	int errcode;
 };
 
+/**
+ * Backend-neutral request block. It carries the parts of FreeBSD's
+ * struct ifreq (and struct vlanreq) that the library uses, so the public
+ * functions can be written once and each backend translates the request
+ * code and this block into whatever its kernel interface needs.
+ */
+struct ifconfig_req {
+	/** Interface the request applies to. Updated by SIOCIFCREATE2. */
+	char ifcr_name[IFNAMSIZ];
+	/**
+	 * Index of ifcr_name if the caller knows it, or 0. Backends that
+	 * address interfaces by index use it instead of looking it up.
+	 */
+	unsigned int ifcr_index;
+	int ifcr_mtu;
+	int ifcr_metric;
+	int ifcr_curcap;
+	int ifcr_reqcap;
+
+	/**
+	 * Description buffer, same semantics as FreeBSD's ifr_buffer. For
+	 * SIOCIFGCLONERS it takes the cloner names, IFNAMSIZ bytes each,
+	 * and length is set to what all of them need.
+	 */
+	struct {
+		size_t length;
+		void *buffer;
+	} ifcr_buffer;
+
+	/** New name for SIOCSIFNAME. */
+	char ifcr_newname[IFNAMSIZ];
+
+	/**
+	 * VLAN parameters for SIOCSETVLAN, and SIOCIFCREATE2 if set. Filled
+	 * in by SIOCGETVLAN.
+	 */
+	char ifcr_vlanparent[IFNAMSIZ];
+	unsigned short ifcr_vlantag;
+
+	/**
+	 * Other end of a pair that SIOCIFCREATE2 creates: the name to give
+	 * a veth's peer on Linux, where a free one is picked and filled in
+	 * if it's empty, and filled in for an epair on FreeBSD.
+	 */
+	char ifcr_peer[IFNAMSIZ];
+
+	/**
+	 * if_bridge(4) command for SIOCSDRVSPEC and SIOCGDRVSPEC, and the
+	 * member BRDGADD and BRDGDEL apply to. BRDGGIFS stores the member
+	 * names in ifcr_buffer, IFNAMSIZ bytes apart, as many as fit, and
+	 * sets its length to the size needed for all of them.
+	 */
+	unsigned long ifcr_drvcmd;
+	char ifcr_member[IFNAMSIZ];
+
+	/** Address for SIOCAIFADDR, SIOCDIFADDR and their _IN6 versions. */
+	struct ifconfig_addr ifcr_addr;
+};
+
+/**
+ * One interface as reported by the backend's interface list dump.
+ * Pointers are only valid for the duration of the callback.
+ */
+struct ifconfig_link {
+	unsigned int index;
+	int flags;
+	int mtu;
+	int metric;
+	const char *name;
+	size_t namelen;
+
+	/**
+	 * Set for a notification that only announces the interface, like
+	 * FreeBSD's RTM_IFANNOUNCE: flags, mtu and metric are then unknown.
+	 */
+	int announce;
+
+	/**
+	 * Index of the interface this one is stacked on (a VLAN's parent,
+	 * a veth's peer), or 0 if none or the backend doesn't say.
+	 */
+	unsigned int parent;
+
+	/**
+	 * Index of the bridge this interface is a member of, or 0 if none
+	 * or the backend doesn't say.
+	 */
+	unsigned int master;
+
+	/**
+	 * Set if the dump tells VLANs apart. vlantag is then the tag of a
+	 * VLAN, whose parent is in parent, and 0 for any other interface.
+	 */
+	int has_vlan;
+	unsigned short vlantag;
+
+	/**
+	 * Set if the dump tells cloned interfaces apart. kind is then the
+	 * cloner ("bridge", "vlan") of one, and NULL for any other.
+	 */
+	int has_kind;
+	const char *kind;
+	size_t kindlen;
+
+	/**
+	 * Set if the dump carries descriptions. description is then NULL
+	 * for interfaces without one.
+	 */
+	int has_description;
+	const char *description;
+	size_t descriptionlen;
+};
+
+/**
+ * Contents of an ifconfig_counters_t. Backends append entries with
+ * ifconfig_counters_next() and may keep their raw dump in buf, so both
+ * are reused from one read to the next.
+ */
+struct ifconfig_counters {
+	struct ifconfig_ifcounters *ifaces;
+	size_t count;
+	size_t size;
+	void *buf;
+	size_t buflen;
+};
+
+/** Kinds of link notification a backend decodes. */
+enum ifconfig_linkev_type {
+	/** Link appeared or changed. name is NULL if the kernel didn't say. */
+	IFCONFIG_LINKEV_NEW,
+	IFCONFIG_LINKEV_DEL,
+	/** Notifications were dropped; any cached state is suspect. */
+	IFCONFIG_LINKEV_LOST
+};
+
+typedef int ifconfig_linkev_cb_t(ifconfig_handle_t *h,
+    enum ifconfig_linkev_type type, const struct ifconfig_link *link,
+    void *udata);
+
+/** One queued operation of an ifconfig_batch_t. */
+struct ifconfig_batchop {
+	unsigned long request;
+	struct ifconfig_req req;
+	ifconfig_batch_status status;
+
+	/** Why the operation failed. Valid if status is FAILED. */
+	struct errstate error;
+
+	/** Sequence number, for backends that match replies to requests. */
+	unsigned int seq;
+};
+
+typedef int ifconfig_iflist_cb_t(ifconfig_handle_t *h,
+    const struct ifconfig_link *link, void *udata);
+
+typedef int ifconfig_addrlist_cb_t(ifconfig_handle_t *h,
+    const struct ifconfig_addr *addr, void *udata);
+
+/**
+ * Operations a kernel interface must provide. Every function populates
+ * the handle's error state on failure and returns -1.
+ */
+struct ifconfig_backend {
+	const char *name;
+
+	/**
+	 * Address family whose sockets queue replies for the next reader,
+	 * so that each handle needs one of its own, or AF_UNSPEC.
+	 */
+	int private_af;
+
+	/** Perform <paramref name="request"> (a SIOC* code) on req. */
+	int (*ioctl)(ifconfig_handle_t *h, const int addressfamily,
+	    unsigned long request, struct ifconfig_req *req);
+
+	/** Call cb once for every interface, using a single dump. */
+	int (*iflist)(ifconfig_handle_t *h, ifconfig_iflist_cb_t *cb,
+	    void *udata);
+
+	/** Call cb once for every IPv4 and IPv6 address of an interface. */
+	int (*addrlist)(ifconfig_handle_t *h, const unsigned int ifindex,
+	    ifconfig_addrlist_cb_t *cb, void *udata);
+
+	/**
+	 * Append the counters of every interface to c, using a single dump.
+	 * c is empty on entry. Names may be left empty, to be filled in from
+	 * the name cache.
+	 */
+	int (*counters)(ifconfig_handle_t *h, struct ifconfig_counters *c);
+
+	/**
+	 * Original (driver) name of an interface into buf. Fails with
+	 * errtype OTHER and ERANGE if it doesn't fit into len bytes.
+	 */
+	int (*drivername)(ifconfig_handle_t *h, const unsigned int ifindex,
+	    char *buf, size_t len);
+
+	/**
+	 * Run the PENDING operations in order, pipelined where possible,
+	 * and set each one's status and error. Optional; without it the
+	 * operations are passed to ioctl one at a time.
+	 */
+	int (*submit)(ifconfig_handle_t *h, struct ifconfig_batchop *ops,
+	    const size_t nops);
+
+	/** Open a non-blocking socket that receives link notifications. */
+	int (*linkev_open)(ifconfig_handle_t *h, int *fd);
+
+	/** Decode every notification queued on fd, without blocking. */
+	int (*linkev_read)(ifconfig_handle_t *h, const int fd,
+	    ifconfig_linkev_cb_t *cb, void *udata);
+};
+
+extern const struct ifconfig_backend ifconfig_backend_freebsd;
+extern const struct ifconfig_backend ifconfig_backend_linux;
+extern const struct ifconfig_backend ifconfig_backend_sim;
+
+#if defined(__linux__)
+#define IFCONFIG_DEFAULT_BACKEND	(&ifconfig_backend_linux)
+#else
+#define IFCONFIG_DEFAULT_BACKEND	(&ifconfig_backend_freebsd)
+#endif
+
+struct ifcache_entry {
+	unsigned int index;
+	char name[IFNAMSIZ];
+};
+
+/**
+ * Name <-> index cache. It's filled from one interface list dump and
+ * dropped when a link notification says an interface came, went or was
+ * renamed.
+ */
+struct ifconfig_ifcache {
+	/** Notification socket, -1 until the cache is first used. */
+	int fd;
+	/** Set while the tables match the kernel's interface list. */
+	int valid;
+	/** Set if notifications are unavailable; lookups bypass the cache. */
+	int disabled;
+
+	struct ifcache_entry *entries;
+	size_t count;
+	size_t size;
+
+	/** Open addressing tables of entry position + 1, 0 if empty. */
+	unsigned int *byname;
+	unsigned int *byindex;
+	size_t mask;
+};
+
+/** Attributes the attribute cache holds, as bit numbers of valid. */
+enum attrcache_attr {
+	ATTR_MTU,
+	ATTR_METRIC,
+	ATTR_CAP,
+	ATTR_DESCR,
+	ATTR_MAX
+};
+
+struct attrcache_entry {
+	char name[IFNAMSIZ];
+	/** Generation the values were read in; older ones are all stale. */
+	unsigned int gen;
+	/** Bit (1 << ATTR_*) for every value held. */
+	int valid;
+	/** When each value was read, for the TTL. */
+	uint64_t time_ns[ATTR_MAX];
+	int mtu;
+	int metric;
+	struct ifconfig_capabilities cap;
+	/** NULL if the interface has no description. */
+	char *descr;
+};
+
+/**
+ * Values of the attribute getters, by interface name. Served by
+ * ifconfig_ioctlwrap() instead of a request while fresh: younger than the
+ * TTL, and read in the current generation. With notifications on, a
+ * thread waits for them on a private handle and bumps the generation.
+ */
+struct ifconfig_attrcache {
+	int enabled;
+	/** 0 for no limit. */
+	uint64_t ttl_ns;
+	/** Only changed atomically; the thread runs unlocked. */
+	unsigned int gen;
+
+	struct attrcache_entry *entries;
+	size_t count;
+	size_t size;
+	/** Open addressing table of entry position + 1, 0 if empty. */
+	unsigned int *byname;
+	size_t mask;
+
+	/** Notification thread, if running. */
+	int notify;
+	pthread_t thread;
+	ifconfig_handle_t *nh;
+	int fd;
+	/** Written to stop the thread. */
+	int stopfd[2];
+};
+
 struct ifconfig_handle {
+	/** Error state unless the handle is shared; see ifconfig_errstate(). */
 	struct errstate error;
-	int sockets[AF_MAX + 1];
+	const struct ifconfig_backend *backend;
+	/** Backend private state, such as the simulator's interface table. */
+	void *backend_data;
+	struct ifconfig_ifcache ifcache;
+	struct ifconfig_attrcache attrcache;
+
+	/** Set for handles from ifconfig_open_shared(). */
+	int shared;
+	/** Serializes request/reply exchanges on a shared handle. */
+	pthread_mutex_t lock;
+	/** Serializes use of the ifcache and attrcache on a shared handle. */
+	pthread_mutex_t cachelock;
+
+	/**
+	 * Socket of the backend's private_af, borrowed from the process
+	 * socket pool on first use and returned on close. -1 until then.
+	 */
+	int privsock;
+
+#if IFCONFIG_STATS
+	/**
+	 * Open addressing table by request code, request 0 if free. Slots
+	 * are claimed and counters updated atomically.
+	 */
+	struct ifconfig_stat stats[IFCONFIG_STATS_MAX];
+#endif
 };
 
+/**
+ * Error state of the calling thread on a shared handle. One per thread,
+ * like errno, so a thread's last error survives calls on other handles.
+ */
+extern __thread struct errstate ifconfig_tls_error;
+
+/** Where errors on <paramref name="h"> are recorded by this thread. */
+static inline struct errstate *
+ifconfig_errstate(ifconfig_handle_t *h)
+{
+
+	return (h->shared ? &ifconfig_tls_error : &h->error);
+}
+
+static inline void
+ifconfig_lock(ifconfig_handle_t *h, pthread_mutex_t *lock)
+{
+
+	if (h->shared) {
+		(void)pthread_mutex_lock(lock);
+	}
+}
+
+static inline void
+ifconfig_unlock(ifconfig_handle_t *h, pthread_mutex_t *lock)
+{
+
+	if (h->shared) {
+		(void)pthread_mutex_unlock(lock);
+	}
+}
+
+extern unsigned int ifconfig_seq;
+
+/**
+ * Next request sequence number; safe to call from several threads. The
+ * counter is process-wide, as pooled sockets may still hold replies to
+ * requests made through an earlier handle.
+ */
+static inline unsigned int
+ifconfig_nextseq(ifconfig_handle_t *h __unused)
+{
+
+	return (__atomic_add_fetch(&ifconfig_seq, 1, __ATOMIC_RELAXED));
+}
+
+/**
+ * Capabilities to request so that those in set are on and those in clear
+ * are off, leaving the rest as they are. Only supported ones are kept.
+ */
+static inline int
+ifconfig_capmerge(const struct ifconfig_capabilities *cap, const int set,
+    const int clear)
+{
+
+	return (((cap->curcap | set) & ~clear) & cap->reqcap);
+}
+
+/** Timestamp for ifconfig_stats_record(); free if statistics are off. */
+static inline uint64_t
+ifconfig_stats_start(void)
+{
+#if IFCONFIG_STATS
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+#else
+	return (0);
+#endif
+}
+
+void ifconfig_stats_add(ifconfig_handle_t *h, const unsigned long request,
+    const uint64_t start, const int error);
+
+/** Adds the statistics of handle from to those of h. */
+void ifconfig_stats_merge(ifconfig_handle_t *h, ifconfig_handle_t *from);
+
+/**
+ * Accounts a call of <paramref name="request"> that began at start and
+ * returned error, and passes error on.
+ */
+static inline int
+ifconfig_stats_record(ifconfig_handle_t *h __unused,
+    const unsigned long request __unused, const uint64_t start __unused,
+    const int error)
+{
+
+#if IFCONFIG_STATS
+	ifconfig_stats_add(h, request, start, error);
+#endif
+	return (error);
+}
+
 /**
  * Retrieves socket for address family <paramref name="addressfamily"> from
  * cache, or creates it if it doesn't already exist.
@@ -75,6 +560,131 @@ struct ifconfig_handle {
  */
 int ifconfig_socket(ifconfig_handle_t *h, const int addressfamily, int *s);
 
-/** Function to wrap ioctl() and automatically populate ifconfig_errstate when appropriate.*/
+/** Calls cb for every interface, from one dump of the backend. */
+int ifconfig_iflist(ifconfig_handle_t *h, ifconfig_iflist_cb_t *cb,
+    void *udata);
+
+/** Calls cb for every address of the interface with index ifindex. */
+int ifconfig_addrlist(ifconfig_handle_t *h, const unsigned int ifindex,
+    ifconfig_addrlist_cb_t *cb, void *udata);
+
+/**
+ * Fills in the names a backend left empty in c from the name cache, or
+ * from libc if the cache is unavailable. Entries for interfaces that have
+ * gone since the backend's dump are removed.
+ */
+int ifconfig_counters_names(ifconfig_handle_t *h,
+    struct ifconfig_counters *c);
+
+/**
+ * Returns a zeroed entry at the end of c, growing it if needed. Fails
+ * with errtype OTHER and ENOMEM.
+ */
+struct ifconfig_ifcounters *ifconfig_counters_next(ifconfig_handle_t *h,
+    struct ifconfig_counters *c);
+
+/**
+ * Runs the PENDING operations in ops, through the backend's submit hook if
+ * it has one, and sets each one's status. Also used by the asynchronous
+ * interface, on its workers' handles.
+ */
+void ifconfig_batch_run(ifconfig_handle_t *h, struct ifconfig_batchop *ops,
+    size_t nops);
+
+/**
+ * Fills in req and the request code that adds (or removes, if add is 0)
+ * addr on interface name. Fails with errtype OTHER and EINVAL for an
+ * address that isn't IPv4 or IPv6 or has too long a prefix.
+ */
+int ifconfig_addrreq(ifconfig_handle_t *h, const char *name,
+    const struct ifconfig_addr *addr, const int add,
+    struct ifconfig_req *req, unsigned long *request);
+
+/** Takes a reference on the process socket pool for a new handle. */
+void ifconfig_sockpool_ref(void);
+
+/** Returns the handle's private socket and drops its pool reference. */
+void ifconfig_sockpool_unref(ifconfig_handle_t *h);
+
+/**
+ * Passes a request down to the handle's backend. The backend populates
+ * the error state, with errtype IOCTL and the request code, on failure.
+ */
 int ifconfig_ioctlwrap(ifconfig_handle_t *h, const int addressfamily,
-    unsigned long request, struct ifreq *ifr);
+    unsigned long request, struct ifconfig_req *req);
+
+/** Records an IOCTL error for <paramref name="request"> with errno. */
+void ifconfig_ioctlerr(ifconfig_handle_t *h, unsigned long request);
+
+/**
+ * Reads the description of name whole: into buf if it fits into len
+ * bytes, or else into *alloc, which the caller frees. *descr is set to
+ * the one holding it, or to NULL if the interface has none, which
+ * FreeBSD reports as ENOMSG.
+ */
+int ifconfig_read_description(ifconfig_handle_t *h, const char *name,
+    char *buf, size_t len, char **alloc, const char **descr);
+
+/**
+ * Opens a handle on h's backend for a worker thread that makes requests
+ * while h does, so that replies on private sockets can't cross. It has
+ * an attribute cache of its own, if any: results the caller reports
+ * through h go into h's cache with ifconfig_attrcache_put() or _drop().
+ * @return The handle, or NULL if out of memory.
+ */
+ifconfig_handle_t *ifconfig_open_worker(ifconfig_handle_t *h);
+
+/** Large enough for the driver name from any backend. */
+#define IFCONFIG_DRIVERNAMSIZ	32
+
+/**
+ * Retrieves the driver (original) name of the interface with index
+ * <paramref name="ifindex"> into buf.
+ */
+int ifconfig_get_drivername(ifconfig_handle_t *h, const unsigned int ifindex,
+    char *buf, size_t len);
+
+/**
+ * Translates an interface name to its index through the handle's cache.
+ * Sets errtype OTHER and errcode ENOENT if there's no such interface.
+ */
+int ifconfig_nametoindex(ifconfig_handle_t *h, const char *name,
+    unsigned int *ifindex);
+
+/** Inverse of ifconfig_nametoindex(). name must hold IFNAMSIZ bytes. */
+int ifconfig_indextoname(ifconfig_handle_t *h, const unsigned int ifindex,
+    char *name);
+
+/**
+ * Finds the first unit from *unit on that makes kind<unit> a name no
+ * interface has, probing an epair by its 'a' end, and leaves *unit one
+ * past it. The name goes into name, which must hold IFNAMSIZ bytes.
+ * Sets errtype OTHER and errcode ENAMETOOLONG if it doesn't fit.
+ */
+int ifconfig_freename(ifconfig_handle_t *h, const char *kind,
+    unsigned int *unit, char *name);
+
+/** Initializes the cache of a new handle. */
+void ifconfig_cache_init(ifconfig_handle_t *h);
+
+/** Releases the caches' memory, notification sockets and thread. */
+void ifconfig_cache_fini(ifconfig_handle_t *h);
+
+/**
+ * Serves request from the attribute cache if it holds a fresh value.
+ * Returns 0 if it did. Otherwise sets gen to pass to the
+ * ifconfig_attrcache_put() after the request.
+ */
+int ifconfig_attrcache_get(ifconfig_handle_t *h, const unsigned long request,
+    struct ifconfig_req *req, unsigned int *gen);
+
+/**
+ * Updates the attribute cache with the outcome of a request: the value
+ * read or written, or an invalidation. Values read are only kept if no
+ * change was announced since gen.
+ */
+void ifconfig_attrcache_put(ifconfig_handle_t *h, const unsigned long request,
+    const struct ifconfig_req *req, const int error, const unsigned int gen);
+
+/** Forgets every cached value of interface name. */
+void ifconfig_attrcache_drop(ifconfig_handle_t *h, const char *name);
@@ -0,0 +1,1664 @@
+/*
+ * Copyright (c) 2016-2017, Marie Helene Kvello-Aune
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * thislist of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * Linux backend. Requests are translated into rtnetlink messages on a
+ * cached AF_NETLINK socket, the interface list comes from one RTM_GETLINK
+ * dump. Descriptions map onto the interface alias (IFLA_IFALIAS).
+ */
+
+#if defined(__linux__)
+
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+#include <linux/ethtool.h>
+#include <linux/if_link.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/sockios.h>
+#include <linux/veth.h>
+
+#include <net/if.h>
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libifconfig.h"
+#include "libifconfig_internal.h"
+
+/*
+ * The kernel never builds dump messages larger than 32k, so a receive
+ * buffer of that size can't be truncated.
+ */
+#define NL_RECVSIZE	32768
+
+/*
+ * Most messages a batch has in flight. Every ack is a separate skb, and
+ * once the socket's receive buffer overruns the kernel starts dropping
+ * them; 64 stays well below the default rmem_max even for failure acks,
+ * which echo the request.
+ */
+#define NL_PIPELINE_MAX	64
+
+/* IFALIASZ from <linux/if.h>, which clashes with <net/if.h>. */
+#define NL_ALIASSIZE	256
+
+struct nl_linkreq {
+	struct nlmsghdr nh;
+	struct ifinfomsg ifi;
+	char attrs[512];
+};
+
+struct nl_addrreq {
+	struct nlmsghdr nh;
+	struct ifaddrmsg ifa;
+	char attrs[64];
+};
+
+/** Any request a batch may queue. */
+union nl_req {
+	struct nlmsghdr nh;
+	struct nl_linkreq link;
+	struct nl_addrreq addr;
+};
+
+typedef int nl_reply_cb_t(ifconfig_handle_t *h, struct nlmsghdr *nh,
+    void *udata);
+
+size_t
+ifconfig_strlcpy(char *dst, const char *src, size_t size)
+{
+	size_t len;
+
+	len = strlen(src);
+	if (size != 0) {
+		size_t n = (len >= size) ? size - 1 : len;
+
+		memcpy(dst, src, n);
+		dst[n] = '\0';
+	}
+	return (len);
+}
+
+void *
+ifconfig_reallocf(void *ptr, size_t size)
+{
+	void *nptr;
+
+	nptr = realloc(ptr, size);
+	if (nptr == NULL && size != 0) {
+		free(ptr);
+	}
+	return (nptr);
+}
+
+static struct rtattr *
+nl_addattr(struct nlmsghdr *nh, size_t maxlen, int type, const void *data,
+    size_t len)
+{
+	struct rtattr *rta;
+
+	if (NLMSG_ALIGN(nh->nlmsg_len) + RTA_SPACE(len) > maxlen) {
+		errno = EMSGSIZE;
+		return (NULL);
+	}
+	rta = (struct rtattr *)(void *)((char *)nh +
+	    NLMSG_ALIGN(nh->nlmsg_len));
+	rta->rta_type = type;
+	rta->rta_len = RTA_LENGTH(len);
+	if (len > 0) {
+		memcpy(RTA_DATA(rta), data, len);
+	}
+	nh->nlmsg_len = NLMSG_ALIGN(nh->nlmsg_len) + RTA_SPACE(len);
+	return (rta);
+}
+
+static void
+nl_endnest(struct nlmsghdr *nh, struct rtattr *nest)
+{
+
+	nest->rta_len = (char *)nh + nh->nlmsg_len - (char *)nest;
+}
+
+static void
+nl_initreq(struct nl_linkreq *lreq, const int type, const int flags)
+{
+
+	memset(lreq, 0, sizeof(*lreq));
+	lreq->nh.nlmsg_len = NLMSG_LENGTH(sizeof(lreq->ifi));
+	lreq->nh.nlmsg_type = type;
+	lreq->nh.nlmsg_flags = NLM_F_REQUEST | flags;
+	lreq->ifi.ifi_family = AF_UNSPEC;
+}
+
+static int
+nl_exchange(ifconfig_handle_t *h, unsigned long request, struct nlmsghdr *req,
+    nl_reply_cb_t *cb, void *udata)
+{
+	char buf[NL_RECVSIZE];
+	struct nlmsghdr *nh;
+	struct nlmsgerr *nlerr;
+	ssize_t len;
+	int s, error;
+
+	if (ifconfig_socket(h, AF_NETLINK, &s) != 0) {
+		return (-1);
+	}
+
+	req->nlmsg_seq = ifconfig_nextseq(h);
+	if ((req->nlmsg_flags & NLM_F_DUMP) != NLM_F_DUMP) {
+		req->nlmsg_flags |= NLM_F_ACK;
+	}
+	if (send(s, req, req->nlmsg_len, 0) < 0) {
+		goto fail;
+	}
+
+	error = 0;
+	for (;;) {
+		len = recv(s, buf, sizeof(buf), 0);
+		if (len < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			goto fail;
+		}
+
+		for (nh = (struct nlmsghdr *)(void *)buf; NLMSG_OK(nh, len);
+		    nh = NLMSG_NEXT(nh, len)) {
+			/* Stale replies to an earlier, interrupted request. */
+			if (nh->nlmsg_seq != req->nlmsg_seq) {
+				continue;
+			}
+			if (nh->nlmsg_type == NLMSG_DONE) {
+				return (error);
+			}
+			if (nh->nlmsg_type == NLMSG_ERROR) {
+				nlerr = NLMSG_DATA(nh);
+				if (nlerr->error == 0) {
+					return (error);
+				}
+				errno = -nlerr->error;
+				goto fail;
+			}
+			if (error == 0 && cb != NULL) {
+				error = cb(h, nh, udata);
+			}
+		}
+	}
+
+fail:
+	ifconfig_ioctlerr(h, request);
+	return (-1);
+}
+
+/*
+ * Sends one request and feeds every reply to cb until the kernel
+ * acknowledges it or finishes the dump. Kernel errors are recorded as
+ * failures of <paramref name="request">. Threads sharing the handle take
+ * turns, or they would read each other's replies.
+ */
+static int
+nl_talk(ifconfig_handle_t *h, unsigned long request, struct nlmsghdr *req,
+    nl_reply_cb_t *cb, void *udata)
+{
+	int error;
+
+	ifconfig_lock(h, &h->lock);
+	error = nl_exchange(h, request, req, cb, udata);
+	ifconfig_unlock(h, &h->lock);
+	return (error);
+}
+
+static int
+nl_nametoindex(ifconfig_handle_t *h, unsigned long request, const char *name)
+{
+	struct ifreq ifr;
+	int s;
+
+	if (ifconfig_socket(h, AF_LOCAL, &s) != 0) {
+		return (-1);
+	}
+
+	memset(&ifr, 0, sizeof(ifr));
+	(void)strlcpy(ifr.ifr_name, name, sizeof(ifr.ifr_name));
+	if (ioctl(s, SIOCGIFINDEX, &ifr) != 0) {
+		ifconfig_ioctlerr(h, request);
+		return (-1);
+	}
+	return (ifr.ifr_ifindex);
+}
+
+/* Picks the kind and VLAN tag, if any, out of a link's IFLA_LINKINFO. */
+static void
+nl_parselinkinfo(struct rtattr *info, struct ifconfig_link *link)
+{
+	struct rtattr *rta, *data;
+	int len, datalen, isvlan;
+
+	isvlan = 0;
+	data = NULL;
+	len = RTA_PAYLOAD(info);
+	for (rta = RTA_DATA(info); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		switch (rta->rta_type) {
+		case IFLA_INFO_KIND:
+			link->kind = RTA_DATA(rta);
+			link->kindlen = strnlen(link->kind, RTA_PAYLOAD(rta));
+			isvlan = link->kindlen == 4 &&
+			    memcmp(link->kind, "vlan", 4) == 0;
+			break;
+		case IFLA_INFO_DATA:
+			data = rta;
+			break;
+		}
+	}
+	if (!isvlan || data == NULL) {
+		return;
+	}
+
+	datalen = RTA_PAYLOAD(data);
+	for (rta = RTA_DATA(data); RTA_OK(rta, datalen);
+	    rta = RTA_NEXT(rta, datalen)) {
+		if (rta->rta_type == IFLA_VLAN_ID &&
+		    RTA_PAYLOAD(rta) >= sizeof(link->vlantag)) {
+			memcpy(&link->vlantag, RTA_DATA(rta),
+			    sizeof(link->vlantag));
+		}
+	}
+}
+
+/* Parses an RTM_{NEW,DEL}LINK message into a backend-neutral record. */
+static int
+nl_parselink(struct nlmsghdr *nh, struct ifconfig_link *link)
+{
+	struct ifinfomsg *ifi;
+	struct rtattr *rta;
+	int len;
+
+	if (nh->nlmsg_type != RTM_NEWLINK && nh->nlmsg_type != RTM_DELLINK) {
+		return (-1);
+	}
+
+	ifi = NLMSG_DATA(nh);
+	memset(link, 0, sizeof(*link));
+	link->index = ifi->ifi_index;
+	link->flags = ifi->ifi_flags;
+	link->has_vlan = 1;
+	link->has_kind = 1;
+	link->has_description = 1;
+
+	len = IFLA_PAYLOAD(nh);
+	for (rta = IFLA_RTA(ifi); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		switch (rta->rta_type) {
+		case IFLA_IFNAME:
+			link->name = RTA_DATA(rta);
+			link->namelen = strnlen(link->name, RTA_PAYLOAD(rta));
+			break;
+		case IFLA_MTU:
+			memcpy(&link->mtu, RTA_DATA(rta), sizeof(link->mtu));
+			break;
+		case IFLA_LINK:
+			memcpy(&link->parent, RTA_DATA(rta),
+			    sizeof(link->parent));
+			break;
+		case IFLA_MASTER:
+			memcpy(&link->master, RTA_DATA(rta),
+			    sizeof(link->master));
+			break;
+		case IFLA_IFALIAS:
+			link->description = RTA_DATA(rta);
+			link->descriptionlen = strnlen(link->description,
+			    RTA_PAYLOAD(rta));
+			if (link->descriptionlen == 0) {
+				link->description = NULL;
+			}
+			break;
+		case IFLA_LINKINFO:
+			nl_parselinkinfo(rta, link);
+			break;
+		}
+	}
+	return (link->name == NULL ? -1 : 0);
+}
+
+/*
+ * Names the link a request is for: by index if the caller knows it, which
+ * the caller has put into ifi_index, or else by name.
+ */
+static int
+nl_addlinkname(struct nl_linkreq *lreq, const struct ifconfig_req *req)
+{
+
+	if (req->ifcr_index != 0) {
+		return (0);
+	}
+	if (nl_addattr(&lreq->nh, sizeof(*lreq), IFLA_IFNAME, req->ifcr_name,
+	    strlen(req->ifcr_name) + 1) == NULL) {
+		return (-1);
+	}
+	return (0);
+}
+
+static int
+nl_getlink_cb(ifconfig_handle_t *h __unused, struct nlmsghdr *nh, void *udata)
+{
+	struct ifconfig_req *req;
+	struct ifconfig_link link;
+
+	req = udata;
+	if (nl_parselink(nh, &link) != 0) {
+		return (0);
+	}
+
+	req->ifcr_mtu = link.mtu;
+	if (req->ifcr_buffer.buffer == NULL) {
+		return (0);
+	}
+	if (link.descriptionlen + 1 > req->ifcr_buffer.length) {
+		/* Same contract as SIOCGIFDESCR: report the needed size. */
+		req->ifcr_buffer.buffer = NULL;
+		req->ifcr_buffer.length = link.descriptionlen + 1;
+		return (0);
+	}
+	if (link.descriptionlen > 0) {
+		memcpy(req->ifcr_buffer.buffer, link.description,
+		    link.descriptionlen);
+	}
+	((char *)req->ifcr_buffer.buffer)[link.descriptionlen] = '\0';
+	return (0);
+}
+
+/*
+ * Fetches the link req names and hands it to cb, which is nl_getlink_cb
+ * for the getters.
+ */
+static int
+nl_getlink(ifconfig_handle_t *h, unsigned long request,
+    struct ifconfig_req *req, nl_reply_cb_t *cb, void *udata)
+{
+	struct nl_linkreq lreq;
+	unsigned int mask;
+
+	nl_initreq(&lreq, RTM_GETLINK, 0);
+	lreq.ifi.ifi_index = req->ifcr_index;
+	mask = RTEXT_FILTER_SKIP_STATS;
+	if (nl_addattr(&lreq.nh, sizeof(lreq), IFLA_EXT_MASK, &mask,
+	    sizeof(mask)) == NULL ||
+	    nl_addlinkname(&lreq, req) != 0) {
+		ifconfig_ioctlerr(h, request);
+		return (-1);
+	}
+	return (nl_talk(h, request, &lreq.nh, cb, udata));
+}
+
+/*
+ * Builds an RTM_NEWLINK that creates a VLAN interface called name on top
+ * of the parent, which has index parent.
+ */
+static int
+nl_vlanreq(ifconfig_handle_t *h, unsigned long request,
+    struct ifconfig_req *req, const char *name, unsigned int parent,
+    struct nl_linkreq *lreq)
+{
+	struct rtattr *linkinfo, *data;
+
+	nl_initreq(lreq, RTM_NEWLINK, NLM_F_CREATE | NLM_F_EXCL);
+	if (nl_addattr(&lreq->nh, sizeof(*lreq), IFLA_IFNAME, name,
+	    strlen(name) + 1) == NULL ||
+	    nl_addattr(&lreq->nh, sizeof(*lreq), IFLA_LINK, &parent,
+	    sizeof(parent)) == NULL ||
+	    (linkinfo = nl_addattr(&lreq->nh, sizeof(*lreq), IFLA_LINKINFO,
+	    NULL, 0)) == NULL ||
+	    nl_addattr(&lreq->nh, sizeof(*lreq), IFLA_INFO_KIND, "vlan",
+	    sizeof("vlan")) == NULL ||
+	    (data = nl_addattr(&lreq->nh, sizeof(*lreq), IFLA_INFO_DATA,
+	    NULL, 0)) == NULL ||
+	    nl_addattr(&lreq->nh, sizeof(*lreq), IFLA_VLAN_ID,
+	    &req->ifcr_vlantag, sizeof(req->ifcr_vlantag)) == NULL) {
+		ifconfig_ioctlerr(h, request);
+		return (-1);
+	}
+	nl_endnest(&lreq->nh, data);
+	nl_endnest(&lreq->nh, linkinfo);
+	return (0);
+}
+
+static int
+nl_createreq(ifconfig_handle_t *h, unsigned long request,
+    struct ifconfig_req *req, const char *kind, const char *name,
+    struct nl_linkreq *lreq)
+{
+	struct ifinfomsg peer;
+	struct rtattr *linkinfo, *data, *info;
+	int parent;
+
+	if (req->ifcr_vlanparent[0] != '\0') {
+		parent = nl_nametoindex(h, request, req->ifcr_vlanparent);
+		if (parent < 0) {
+			return (-1);
+		}
+		return (nl_vlanreq(h, request, req, name, parent, lreq));
+	}
+
+	nl_initreq(lreq, RTM_NEWLINK, NLM_F_CREATE | NLM_F_EXCL);
+	if (nl_addattr(&lreq->nh, sizeof(*lreq), IFLA_IFNAME, name,
+	    strlen(name) + 1) == NULL ||
+	    (linkinfo = nl_addattr(&lreq->nh, sizeof(*lreq), IFLA_LINKINFO,
+	    NULL, 0)) == NULL ||
+	    nl_addattr(&lreq->nh, sizeof(*lreq), IFLA_INFO_KIND, kind,
+	    strlen(kind) + 1) == NULL) {
+		ifconfig_ioctlerr(h, request);
+		return (-1);
+	}
+	if (req->ifcr_peer[0] != '\0') {
+		memset(&peer, 0, sizeof(peer));
+		if ((data = nl_addattr(&lreq->nh, sizeof(*lreq),
+		    IFLA_INFO_DATA, NULL, 0)) == NULL ||
+		    (info = nl_addattr(&lreq->nh, sizeof(*lreq),
+		    VETH_INFO_PEER, &peer, sizeof(peer))) == NULL ||
+		    nl_addattr(&lreq->nh, sizeof(*lreq), IFLA_IFNAME,
+		    req->ifcr_peer, strlen(req->ifcr_peer) + 1) == NULL) {
+			ifconfig_ioctlerr(h, request);
+			return (-1);
+		}
+		nl_endnest(&lreq->nh, info);
+		nl_endnest(&lreq->nh, data);
+	}
+	nl_endnest(&lreq->nh, linkinfo);
+	return (0);
+}
+
+/*
+ * SIOCIFCREATE2 semantics: the link kind is the name without its unit
+ * number, and a name without a unit ("bridge") gets the first free one,
+ * found through the name cache. A veth without a peer name gets a free
+ * one too, since the kernel would register its "veth%d" first, possibly
+ * under the name requested. req->ifcr_name and, for a veth,
+ * req->ifcr_peer are updated with the names actually created.
+ */
+static int
+nl_create(ifconfig_handle_t *h, unsigned long request,
+    struct ifconfig_req *req)
+{
+	struct nl_linkreq lreq;
+	struct errstate error;
+	char kind[IFNAMSIZ], name[IFNAMSIZ];
+	size_t len;
+	unsigned int index, unit;
+	int hasunit, peer;
+
+	(void)strlcpy(kind, req->ifcr_name, sizeof(kind));
+	len = strlen(kind);
+	while (len > 0 && isdigit((unsigned char)kind[len - 1])) {
+		len--;
+	}
+	kind[len] = '\0';
+	if (req->ifcr_vlanparent[0] == '\0' && strchr(kind, '.') != NULL) {
+		errno = EINVAL;
+		ifconfig_ioctlerr(h, request);
+		return (-1);
+	}
+	hasunit = (len != strlen(req->ifcr_name));
+	peer = (req->ifcr_vlanparent[0] == '\0' &&
+	    req->ifcr_peer[0] == '\0' && strcmp(kind, "veth") == 0);
+
+	/*
+	 * Another process may take a name between the lookup and the
+	 * request, in which case the next free one is tried.
+	 */
+	unit = 0;
+	for (;;) {
+		if (hasunit) {
+			(void)strlcpy(name, req->ifcr_name, sizeof(name));
+		} else if (ifconfig_freename(h, kind, &unit, name) != 0) {
+			return (-1);
+		}
+		if (peer) {
+			do {
+				if (ifconfig_freename(h, kind, &unit,
+				    req->ifcr_peer) != 0) {
+					return (-1);
+				}
+			} while (strcmp(req->ifcr_peer, name) == 0);
+		}
+		if (nl_createreq(h, request, req, kind, name, &lreq) != 0) {
+			return (-1);
+		}
+		if (nl_talk(h, request, &lreq.nh, NULL, NULL) == 0) {
+			(void)strlcpy(req->ifcr_name, name,
+			    sizeof(req->ifcr_name));
+			return (0);
+		}
+		if (ifconfig_errstate(h)->errcode != EEXIST) {
+			break;
+		}
+		if (hasunit) {
+			/* Only a taken peer name is worth another try. */
+			error = *ifconfig_errstate(h);
+			if (!peer ||
+			    ifconfig_nametoindex(h, name, &index) == 0) {
+				*ifconfig_errstate(h) = error;
+				break;
+			}
+		}
+	}
+	if (peer) {
+		req->ifcr_peer[0] = '\0';
+	}
+	return (-1);
+}
+
+/* Flags a recreated VLAN takes over from the one it replaces. */
+#define NL_VLANFLAGS	(IFF_UP | IFF_NOARP | IFF_PROMISC | IFF_ALLMULTI)
+
+/* What a recreated VLAN takes over from the one it replaces. */
+struct nl_vlanstate {
+	int isvlan;
+	unsigned int parent;
+	unsigned short tag;
+	unsigned int master;
+	int flags;
+	int mtu;
+	char descr[NL_ALIASSIZE];
+};
+
+static int
+nl_vlanstate_cb(ifconfig_handle_t *h __unused, struct nlmsghdr *nh,
+    void *udata)
+{
+	struct nl_vlanstate *st;
+	struct ifconfig_link link;
+	size_t len;
+
+	st = udata;
+	if (nl_parselink(nh, &link) != 0) {
+		return (0);
+	}
+
+	st->isvlan = (link.kindlen == strlen("vlan") &&
+	    memcmp(link.kind, "vlan", link.kindlen) == 0);
+	st->parent = link.parent;
+	st->tag = link.vlantag;
+	st->master = link.master;
+	st->flags = link.flags & NL_VLANFLAGS;
+	st->mtu = link.mtu;
+	len = link.descriptionlen < sizeof(st->descr) ?
+	    link.descriptionlen : sizeof(st->descr) - 1;
+	if (len > 0) {
+		memcpy(st->descr, link.description, len);
+	}
+	st->descr[len] = '\0';
+	return (0);
+}
+
+static int
+nl_dellink(ifconfig_handle_t *h, unsigned long request, const char *name)
+{
+	struct nl_linkreq lreq;
+
+	nl_initreq(&lreq, RTM_DELLINK, 0);
+	if (nl_addattr(&lreq.nh, sizeof(lreq), IFLA_IFNAME, name,
+	    strlen(name) + 1) == NULL) {
+		ifconfig_ioctlerr(h, request);
+		return (-1);
+	}
+	return (nl_talk(h, request, &lreq.nh, NULL, NULL));
+}
+
+/*
+ * Creates the VLAN name with the given tag on the parent with index
+ * parent, and gives it the MTU, flags, bridge and alias in st.
+ */
+static int
+nl_vlanmake(ifconfig_handle_t *h, unsigned long request, const char *name,
+    unsigned int parent, unsigned short tag, const struct nl_vlanstate *st)
+{
+	struct ifconfig_req vreq;
+	struct nl_linkreq lreq;
+
+	memset(&vreq, 0, sizeof(vreq));
+	vreq.ifcr_vlantag = tag;
+	if (nl_vlanreq(h, request, &vreq, name, parent, &lreq) != 0) {
+		return (-1);
+	}
+	if (nl_addattr(&lreq.nh, sizeof(lreq), IFLA_MTU, &st->mtu,
+	    sizeof(st->mtu)) == NULL) {
+		ifconfig_ioctlerr(h, request);
+		return (-1);
+	}
+	if (nl_talk(h, request, &lreq.nh, NULL, NULL) != 0) {
+		return (-1);
+	}
+
+	if (st->flags == 0 && st->master == 0 && st->descr[0] == '\0') {
+		return (0);
+	}
+	nl_initreq(&lreq, RTM_NEWLINK, 0);
+	lreq.ifi.ifi_flags = st->flags;
+	lreq.ifi.ifi_change = NL_VLANFLAGS;
+	if (nl_addattr(&lreq.nh, sizeof(lreq), IFLA_IFNAME, name,
+	    strlen(name) + 1) == NULL ||
+	    (st->master != 0 && nl_addattr(&lreq.nh, sizeof(lreq),
+	    IFLA_MASTER, &st->master, sizeof(st->master)) == NULL) ||
+	    (st->descr[0] != '\0' && nl_addattr(&lreq.nh, sizeof(lreq),
+	    IFLA_IFALIAS, st->descr, strlen(st->descr)) == NULL)) {
+		ifconfig_ioctlerr(h, request);
+		return (-1);
+	}
+	return (nl_talk(h, request, &lreq.nh, NULL, NULL));
+}
+
+/*
+ * Linux can't move an existing VLAN to another tag or parent, so the
+ * interface is recreated under the same name, which gives it a new index
+ * and drops its addresses. Its MTU, flags, bridge and alias are carried
+ * over, and if the new VLAN can't be set up the old one is put back.
+ */
+static int
+nl_setvlan(ifconfig_handle_t *h, unsigned long request,
+    struct ifconfig_req *req)
+{
+	struct nl_vlanstate st;
+	struct errstate error;
+	int parent;
+
+	if ((parent = nl_nametoindex(h, request, req->ifcr_vlanparent)) < 0) {
+		return (-1);
+	}
+
+	memset(&st, 0, sizeof(st));
+	if (nl_getlink(h, request, req, nl_vlanstate_cb, &st) != 0) {
+		return (-1);
+	}
+	if (!st.isvlan) {
+		errno = EINVAL;
+		ifconfig_ioctlerr(h, request);
+		return (-1);
+	}
+
+	if (nl_dellink(h, request, req->ifcr_name) != 0) {
+		return (-1);
+	}
+	if (nl_vlanmake(h, request, req->ifcr_name, parent, req->ifcr_vlantag,
+	    &st) == 0) {
+		return (0);
+	}
+
+	/* Put the old VLAN back, but report why the new one failed. */
+	error = *ifconfig_errstate(h);
+	(void)nl_dellink(h, request, req->ifcr_name);
+	(void)nl_vlanmake(h, request, req->ifcr_name, st.parent, st.tag, &st);
+	*ifconfig_errstate(h) = error;
+	return (-1);
+}
+
+/* Metric has no rtnetlink attribute; Linux only knows the ioctls. */
+static int
+linux_metric(ifconfig_handle_t *h, unsigned long request,
+    struct ifconfig_req *req)
+{
+	struct ifreq ifr;
+	int s;
+
+	if (ifconfig_socket(h, AF_LOCAL, &s) != 0) {
+		return (-1);
+	}
+
+	memset(&ifr, 0, sizeof(ifr));
+	(void)strlcpy(ifr.ifr_name, req->ifcr_name, sizeof(ifr.ifr_name));
+	ifr.ifr_metric = req->ifcr_metric;
+	if (ioctl(s, request, &ifr) != 0) {
+		ifconfig_ioctlerr(h, request);
+		return (-1);
+	}
+	req->ifcr_metric = ifr.ifr_metric;
+	return (0);
+}
+
+/*
+ * Builds an RTM_NEWADDR or RTM_DELADDR for the address in req, on the
+ * interface with index ifindex. Like SIOCAIFADDR, adding an address the
+ * interface already has replaces it.
+ */
+static int
+nl_addrreq(ifconfig_handle_t *h, unsigned long request,
+    const struct ifconfig_req *req, const unsigned int ifindex,
+    struct nl_addrreq *areq)
+{
+	const struct ifconfig_addr *addr;
+	size_t len;
+	int add;
+
+	addr = &req->ifcr_addr;
+	add = (request == SIOCAIFADDR || request == SIOCAIFADDR_IN6);
+	len = (addr->family == AF_INET6) ? sizeof(addr->addr.in6) :
+	    sizeof(addr->addr.in);
+
+	memset(areq, 0, sizeof(*areq));
+	areq->nh.nlmsg_len = NLMSG_LENGTH(sizeof(areq->ifa));
+	areq->nh.nlmsg_type = add ? RTM_NEWADDR : RTM_DELADDR;
+	areq->nh.nlmsg_flags = NLM_F_REQUEST |
+	    (add ? NLM_F_CREATE | NLM_F_REPLACE : 0);
+	areq->ifa.ifa_family = addr->family;
+	areq->ifa.ifa_prefixlen = addr->prefixlen;
+	areq->ifa.ifa_index = ifindex;
+
+	/*
+	 * Without IFA_ADDRESS an IPv4 address is deleted whatever its
+	 * prefix, as SIOCDIFADDR does. IPv6 always needs it.
+	 */
+	if (nl_addattr(&areq->nh, sizeof(*areq), IFA_LOCAL, &addr->addr,
+	    len) == NULL ||
+	    ((add || addr->family == AF_INET6) &&
+	    nl_addattr(&areq->nh, sizeof(*areq), IFA_ADDRESS, &addr->addr,
+	    len) == NULL)) {
+		ifconfig_ioctlerr(h, request);
+		return (-1);
+	}
+	return (0);
+}
+
+/*
+ * Builds the single rtnetlink message for requests that need exactly one,
+ * which are the ones a batch can pipeline.
+ */
+static int
+nl_setreq(ifconfig_handle_t *h, unsigned long request,
+    struct ifconfig_req *req, struct nl_linkreq *lreq)
+{
+	unsigned int ifindex;
+	int index;
+
+	switch (request) {
+	case SIOCSIFMTU:
+	case SIOCSIFDESCR:
+	case SIOCIFDESTROY:
+		nl_initreq(lreq, request == SIOCIFDESTROY ? RTM_DELLINK :
+		    RTM_NEWLINK, 0);
+		lreq->ifi.ifi_index = req->ifcr_index;
+		if (nl_addlinkname(lreq, req) != 0) {
+			break;
+		}
+		if (request == SIOCSIFMTU &&
+		    nl_addattr(&lreq->nh, sizeof(*lreq), IFLA_MTU,
+		    &req->ifcr_mtu, sizeof(req->ifcr_mtu)) == NULL) {
+			break;
+		}
+		/* An empty alias removes it. */
+		if (request == SIOCSIFDESCR &&
+		    nl_addattr(&lreq->nh, sizeof(*lreq), IFLA_IFALIAS,
+		    req->ifcr_buffer.buffer, req->ifcr_buffer.length == 0 ?
+		    0 : strnlen(req->ifcr_buffer.buffer,
+		    req->ifcr_buffer.length)) == NULL) {
+			break;
+		}
+		return (0);
+	case SIOCSIFNAME:
+		/* IFLA_IFNAME is the new name, so address the link by index. */
+		if ((ifindex = req->ifcr_index) == 0) {
+			if ((index = nl_nametoindex(h, request,
+			    req->ifcr_name)) < 0) {
+				return (-1);
+			}
+			ifindex = index;
+		}
+		nl_initreq(lreq, RTM_NEWLINK, 0);
+		lreq->ifi.ifi_index = ifindex;
+		if (nl_addattr(&lreq->nh, sizeof(*lreq), IFLA_IFNAME,
+		    req->ifcr_newname, strlen(req->ifcr_newname) + 1) == NULL) {
+			break;
+		}
+		return (0);
+	default:
+		/* Capabilities live in ethtool features, not rtnetlink. */
+		errno = EOPNOTSUPP;
+		break;
+	}
+
+	ifconfig_ioctlerr(h, request);
+	return (-1);
+}
+
+struct nl_master_arg {
+	unsigned int index;
+	unsigned int master;
+};
+
+static int
+nl_master_cb(ifconfig_handle_t *h __unused, struct nlmsghdr *nh,
+    void *udata)
+{
+	struct nl_master_arg *arg;
+	struct ifconfig_link link;
+
+	arg = udata;
+	if (nl_parselink(nh, &link) != 0) {
+		return (0);
+	}
+	arg->index = link.index;
+	arg->master = link.master;
+	return (0);
+}
+
+/*
+ * Checks BRDGADD and BRDGDEL against the member's current master, with
+ * if_bridge(4)'s errors. Linux would otherwise move a member between
+ * bridges, and detach it from any master, a bond or VRF included.
+ */
+static int
+nl_bridgecheck(ifconfig_handle_t *h, unsigned long request,
+    const struct ifconfig_req *req, unsigned int bridge)
+{
+	struct ifconfig_req mreq;
+	struct nl_master_arg arg;
+
+	memset(&mreq, 0, sizeof(mreq));
+	(void)strlcpy(mreq.ifcr_name, req->ifcr_member,
+	    sizeof(mreq.ifcr_name));
+	arg.index = 0;
+	arg.master = 0;
+	if (nl_getlink(h, request, &mreq, nl_master_cb, &arg) != 0) {
+		if (ifconfig_errstate(h)->errcode == ENODEV) {
+			ifconfig_errstate(h)->errcode = ENOENT;
+		}
+		return (-1);
+	}
+
+	errno = 0;
+	if (req->ifcr_drvcmd == BRDGADD) {
+		if (arg.index == bridge) {
+			errno = EINVAL;
+		} else if (arg.master == bridge) {
+			errno = EEXIST;
+		} else if (arg.master != 0) {
+			errno = EBUSY;
+		}
+	} else if (arg.master != bridge) {
+		errno = ENOENT;
+	}
+	if (errno != 0) {
+		ifconfig_ioctlerr(h, request);
+		return (-1);
+	}
+	return (0);
+}
+
+/*
+ * Builds the RTM_NEWLINK for BRDGADD and BRDGDEL on the bridge with index
+ * bridge: the member's master becomes the bridge, or none.
+ */
+static int
+nl_bridgereq(ifconfig_handle_t *h, unsigned long request,
+    const struct ifconfig_req *req, unsigned int bridge,
+    struct nl_linkreq *lreq)
+{
+	unsigned int master;
+
+	if (req->ifcr_drvcmd != BRDGADD && req->ifcr_drvcmd != BRDGDEL) {
+		errno = EOPNOTSUPP;
+		ifconfig_ioctlerr(h, request);
+		return (-1);
+	}
+	if (nl_bridgecheck(h, request, req, bridge) != 0) {
+		return (-1);
+	}
+
+	master = (req->ifcr_drvcmd == BRDGADD) ? bridge : 0;
+	nl_initreq(lreq, RTM_NEWLINK, 0);
+	if (nl_addattr(&lreq->nh, sizeof(*lreq), IFLA_IFNAME,
+	    req->ifcr_member, strlen(req->ifcr_member) + 1) == NULL ||
+	    nl_addattr(&lreq->nh, sizeof(*lreq), IFLA_MASTER, &master,
+	    sizeof(master)) == NULL) {
+		ifconfig_ioctlerr(h, request);
+		return (-1);
+	}
+	return (0);
+}
+
+struct nl_members_arg {
+	struct ifconfig_req *req;
+	unsigned int master;
+	size_t count;
+};
+
+static int
+nl_members_cb(ifconfig_handle_t *h __unused, struct nlmsghdr *nh,
+    void *udata)
+{
+	struct nl_members_arg *arg;
+	struct ifconfig_link link;
+	char *name;
+
+	arg = udata;
+	if (nl_parselink(nh, &link) != 0 || link.master != arg->master ||
+	    link.namelen >= IFNAMSIZ) {
+		return (0);
+	}
+	if ((arg->count + 1) * IFNAMSIZ <= arg->req->ifcr_buffer.length) {
+		name = (char *)arg->req->ifcr_buffer.buffer +
+		    arg->count * IFNAMSIZ;
+		memcpy(name, link.name, link.namelen);
+		name[link.namelen] = '\0';
+	}
+	arg->count++;
+	return (0);
+}
+
+/*
+ * BRDGGIFS: the links whose master is the bridge. Since Linux 4.15 the
+ * dump itself is filtered on IFLA_MASTER; older kernels return every
+ * link and the callback picks the members out.
+ */
+static int
+nl_members(ifconfig_handle_t *h, unsigned long request,
+    struct ifconfig_req *req)
+{
+	struct nl_linkreq lreq;
+	struct nl_members_arg arg;
+	unsigned int mask;
+	int index;
+
+	if (req->ifcr_drvcmd != BRDGGIFS) {
+		errno = EOPNOTSUPP;
+		ifconfig_ioctlerr(h, request);
+		return (-1);
+	}
+	if ((index = req->ifcr_index) == 0 &&
+	    (index = nl_nametoindex(h, request, req->ifcr_name)) < 0) {
+		return (-1);
+	}
+
+	nl_initreq(&lreq, RTM_GETLINK, NLM_F_DUMP);
+	mask = RTEXT_FILTER_SKIP_STATS;
+	arg.req = req;
+	arg.master = index;
+	arg.count = 0;
+	if (nl_addattr(&lreq.nh, sizeof(lreq), IFLA_EXT_MASK, &mask,
+	    sizeof(mask)) == NULL ||
+	    nl_addattr(&lreq.nh, sizeof(lreq), IFLA_MASTER, &arg.master,
+	    sizeof(arg.master)) == NULL) {
+		ifconfig_ioctlerr(h, request);
+		return (-1);
+	}
+	if (nl_talk(h, request, &lreq.nh, nl_members_cb, &arg) != 0) {
+		return (-1);
+	}
+	req->ifcr_buffer.length = arg.count * IFNAMSIZ;
+	return (0);
+}
+
+static int
+linux_ioctl(ifconfig_handle_t *h, const int addressfamily __unused,
+    unsigned long request, struct ifconfig_req *req)
+{
+	union nl_req nreq;
+	int index;
+
+	switch (request) {
+	case SIOCGIFMTU:
+	case SIOCGIFDESCR:
+		return (nl_getlink(h, request, req, nl_getlink_cb, req));
+	case SIOCGIFMETRIC:
+	case SIOCSIFMETRIC:
+		return (linux_metric(h, request, req));
+	case SIOCIFCREATE2:
+		return (nl_create(h, request, req));
+	case SIOCSETVLAN:
+		return (nl_setvlan(h, request, req));
+	case SIOCSDRVSPEC:
+		if ((index = req->ifcr_index) == 0 &&
+		    (index = nl_nametoindex(h, request, req->ifcr_name)) < 0) {
+			return (-1);
+		}
+		if (nl_bridgereq(h, request, req, index, &nreq.link) != 0) {
+			return (-1);
+		}
+		return (nl_talk(h, request, &nreq.nh, NULL, NULL));
+	case SIOCGDRVSPEC:
+		return (nl_members(h, request, req));
+	case SIOCAIFADDR:
+	case SIOCDIFADDR:
+	case SIOCAIFADDR_IN6:
+	case SIOCDIFADDR_IN6:
+		if ((index = req->ifcr_index) == 0 &&
+		    (index = nl_nametoindex(h, request, req->ifcr_name)) < 0) {
+			return (-1);
+		}
+		if (nl_addrreq(h, request, req, index, &nreq.addr) != 0) {
+			return (-1);
+		}
+		return (nl_talk(h, request, &nreq.nh, NULL, NULL));
+	}
+
+	if (nl_setreq(h, request, req, &nreq.link) != 0) {
+		return (-1);
+	}
+	return (nl_talk(h, request, &nreq.nh, NULL, NULL));
+}
+
+static void
+nl_opfail(struct ifconfig_batchop *op, const int errcode)
+{
+
+	op->status = IFCONFIG_BATCH_FAILED;
+	op->error.errtype = IOCTL;
+	op->error.ioctl_request = op->request;
+	op->error.errcode = errcode;
+}
+
+static void
+nl_flush_locked(ifconfig_handle_t *h, char *buf, size_t *buflen,
+    struct ifconfig_batchop *ops, size_t first, size_t last)
+{
+	char rbuf[NL_RECVSIZE];
+	struct nlmsghdr *nh, *lastnh;
+	struct nlmsgerr *nlerr;
+	ssize_t len;
+	size_t i;
+	unsigned int lastseq;
+	int done, s;
+
+	if (*buflen == 0) {
+		return;
+	}
+
+	/*
+	 * Only the last message asks for an ack. Failures are reported
+	 * regardless, so once it arrives every earlier message without an
+	 * error succeeded.
+	 */
+	len = *buflen;
+	lastnh = NULL;
+	for (nh = (struct nlmsghdr *)(void *)buf; NLMSG_OK(nh, len);
+	    nh = NLMSG_NEXT(nh, len)) {
+		lastnh = nh;
+	}
+	lastnh->nlmsg_flags |= NLM_F_ACK;
+	lastseq = lastnh->nlmsg_seq;
+
+	if (ifconfig_socket(h, AF_NETLINK, &s) != 0 ||
+	    send(s, buf, *buflen, 0) < 0) {
+		goto fail;
+	}
+
+	i = first;
+	done = 0;
+	while (!done) {
+		len = recv(s, rbuf, sizeof(rbuf), 0);
+		if (len < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			goto fail;
+		}
+
+		for (nh = (struct nlmsghdr *)(void *)rbuf; NLMSG_OK(nh, len);
+		    nh = NLMSG_NEXT(nh, len)) {
+			if (nh->nlmsg_type != NLMSG_ERROR) {
+				continue;
+			}
+			/* Replies come in order; the cursor only advances. */
+			while (i < last && ops[i].seq != nh->nlmsg_seq) {
+				i++;
+			}
+			if (i == last) {
+				i = first;
+				continue;
+			}
+			nlerr = NLMSG_DATA(nh);
+			if (nlerr->error != 0) {
+				nl_opfail(&ops[i], -nlerr->error);
+				ops[i].seq = 0;
+			}
+			if (nh->nlmsg_seq == lastseq) {
+				done = 1;
+			}
+		}
+	}
+
+	for (i = first; i < last; i++) {
+		if (ops[i].status == IFCONFIG_BATCH_PENDING &&
+		    ops[i].seq != 0) {
+			ops[i].status = IFCONFIG_BATCH_DONE;
+			ops[i].seq = 0;
+		}
+	}
+	*buflen = 0;
+	return;
+
+fail:
+	for (i = first; i < last; i++) {
+		if (ops[i].status == IFCONFIG_BATCH_PENDING &&
+		    ops[i].seq != 0) {
+			nl_opfail(&ops[i], errno);
+			ops[i].seq = 0;
+		}
+	}
+	*buflen = 0;
+}
+
+/*
+ * Sends every message queued in buf as one datagram and collects the
+ * replies. The kernel processes the messages in order and carries on
+ * after one failed.
+ */
+static void
+nl_flush(ifconfig_handle_t *h, char *buf, size_t *buflen,
+    struct ifconfig_batchop *ops, size_t first, size_t last)
+{
+
+	ifconfig_lock(h, &h->lock);
+	nl_flush_locked(h, buf, buflen, ops, first, last);
+	ifconfig_unlock(h, &h->lock);
+}
+
+/* A name with a unit number is created as is, in a single message. */
+static int
+nl_hasunit(const char *name)
+{
+	size_t len;
+
+	len = strlen(name);
+	return (len > 0 && isdigit((unsigned char)name[len - 1]));
+}
+
+/* Messages linux_submit() has queued but not sent yet. */
+struct nl_pipeline {
+	char buf[NL_PIPELINE_MAX * sizeof(union nl_req)];
+	size_t buflen;
+	/* First operation that may be queued, and how many are. */
+	size_t first;
+	size_t queued;
+	/* Interface last looked up, index -1 if none. */
+	char name[IFNAMSIZ];
+	int index;
+};
+
+/* Sends the queue, which holds nothing from operation next on. */
+static void
+nl_pipeline_flush(ifconfig_handle_t *h, struct nl_pipeline *p,
+    struct ifconfig_batchop *ops, const size_t next)
+{
+
+	nl_flush(h, p->buf, &p->buflen, ops, p->first, next);
+	p->first = next;
+	p->queued = 0;
+}
+
+/*
+ * Index of an interface that operation i refers to. The last one looked
+ * up is remembered, which serves runs of operations on one interface.
+ * For any other, the queue is drained first, as it may be about to
+ * create or rename the interface.
+ */
+static int
+nl_pipeline_index(ifconfig_handle_t *h, struct nl_pipeline *p,
+    struct ifconfig_batchop *ops, const size_t i, const char *name)
+{
+
+	if (p->index >= 0 && strcmp(p->name, name) == 0) {
+		return (p->index);
+	}
+	nl_pipeline_flush(h, p, ops, i);
+	(void)strlcpy(p->name, name, sizeof(p->name));
+	p->index = nl_nametoindex(h, ops[i].request, name);
+	return (p->index);
+}
+
+/*
+ * Pipelines runs of single-message requests. Anything else, and a rename
+ * (its index lookup must see the effect of earlier operations), first
+ * drains what is queued. Operations that change which index a name
+ * refers to forget the remembered lookup.
+ */
+static int
+linux_submit(ifconfig_handle_t *h, struct ifconfig_batchop *ops,
+    const size_t nops)
+{
+	struct nl_pipeline p;
+	union nl_req nreq;
+	struct ifconfig_batchop *op;
+	int error, index;
+
+	p.buflen = 0;
+	p.first = 0;
+	p.queued = 0;
+	p.index = -1;
+	for (size_t i = 0; i < nops; i++) {
+		op = &ops[i];
+		op->seq = 0;
+		if (op->status != IFCONFIG_BATCH_PENDING) {
+			continue;
+		}
+
+		switch (op->request) {
+		case SIOCSIFMTU:
+		case SIOCSIFDESCR:
+			error = nl_setreq(h, op->request, &op->req, &nreq.link);
+			break;
+		case SIOCIFDESTROY:
+			p.index = -1;
+			error = nl_setreq(h, op->request, &op->req, &nreq.link);
+			break;
+		case SIOCSIFNAME:
+			nl_pipeline_flush(h, &p, ops, i);
+			p.index = -1;
+			error = nl_setreq(h, op->request, &op->req, &nreq.link);
+			break;
+		case SIOCAIFADDR:
+		case SIOCDIFADDR:
+		case SIOCAIFADDR_IN6:
+		case SIOCDIFADDR_IN6:
+			index = nl_pipeline_index(h, &p, ops, i,
+			    op->req.ifcr_name);
+			error = (index < 0) ? -1 : nl_addrreq(h, op->request,
+			    &op->req, index, &nreq.addr);
+			break;
+		case SIOCSDRVSPEC:
+			/* The member's master is read once the queue is in. */
+			index = nl_pipeline_index(h, &p, ops, i,
+			    op->req.ifcr_name);
+			nl_pipeline_flush(h, &p, ops, i);
+			error = (index < 0) ? -1 : nl_bridgereq(h, op->request,
+			    &op->req, index, &nreq.link);
+			break;
+		case SIOCIFCREATE2:
+			if (op->req.ifcr_vlanparent[0] != '\0' &&
+			    nl_hasunit(op->req.ifcr_name)) {
+				index = nl_pipeline_index(h, &p, ops, i,
+				    op->req.ifcr_vlanparent);
+				error = (index < 0) ? -1 : nl_vlanreq(h,
+				    op->request, &op->req, op->req.ifcr_name,
+				    index, &nreq.link);
+				break;
+			}
+			/* FALLTHROUGH */
+		default:
+			nl_pipeline_flush(h, &p, ops, i);
+			p.first = i + 1;
+			p.index = -1;
+			if (linux_ioctl(h, AF_LOCAL, op->request,
+			    &op->req) == 0) {
+				op->status = IFCONFIG_BATCH_DONE;
+			} else {
+				op->status = IFCONFIG_BATCH_FAILED;
+				op->error = *ifconfig_errstate(h);
+			}
+			continue;
+		}
+
+		if (error != 0) {
+			op->status = IFCONFIG_BATCH_FAILED;
+			op->error = *ifconfig_errstate(h);
+			continue;
+		}
+		if (p.queued == NL_PIPELINE_MAX) {
+			nl_pipeline_flush(h, &p, ops, i);
+		}
+		p.queued++;
+		nreq.nh.nlmsg_seq = op->seq = ifconfig_nextseq(h);
+		memcpy(p.buf + p.buflen, &nreq, nreq.nh.nlmsg_len);
+		p.buflen += NLMSG_ALIGN(nreq.nh.nlmsg_len);
+	}
+	nl_pipeline_flush(h, &p, ops, nops);
+	return (0);
+}
+
+struct nl_iflist_arg {
+	ifconfig_iflist_cb_t *cb;
+	void *udata;
+};
+
+static int
+nl_iflist_cb(ifconfig_handle_t *h, struct nlmsghdr *nh, void *udata)
+{
+	struct nl_iflist_arg *arg;
+	struct ifconfig_link link;
+
+	arg = udata;
+	if (nl_parselink(nh, &link) != 0) {
+		return (0);
+	}
+	return (arg->cb(h, &link, arg->udata));
+}
+
+static int
+linux_iflist(ifconfig_handle_t *h, ifconfig_iflist_cb_t *cb, void *udata)
+{
+	struct nl_linkreq lreq;
+	struct nl_iflist_arg arg;
+	unsigned int mask;
+
+	nl_initreq(&lreq, RTM_GETLINK, NLM_F_DUMP);
+	mask = RTEXT_FILTER_SKIP_STATS;
+	(void)nl_addattr(&lreq.nh, sizeof(lreq), IFLA_EXT_MASK, &mask,
+	    sizeof(mask));
+
+	arg.cb = cb;
+	arg.udata = udata;
+	if (nl_talk(h, 0, &lreq.nh, nl_iflist_cb, &arg) != 0) {
+		/* A failed dump isn't an ioctl, like the sysctl on FreeBSD. */
+		if (ifconfig_errstate(h)->errtype == IOCTL) {
+			ifconfig_errstate(h)->errtype = OTHER;
+		}
+		return (-1);
+	}
+	return (0);
+}
+
+static int
+nl_counters_cb(ifconfig_handle_t *h, struct nlmsghdr *nh, void *udata)
+{
+	struct rtnl_link_stats64 st;
+	struct ifconfig_ifcounters *ifc;
+	struct if_stats_msg *ifsm;
+	struct rtattr *rta;
+	size_t len;
+	int alen;
+
+	if (nh->nlmsg_type != RTM_NEWSTATS) {
+		return (0);
+	}
+	ifsm = NLMSG_DATA(nh);
+	if ((ifc = ifconfig_counters_next(h, udata)) == NULL) {
+		return (-1);
+	}
+	ifc->index = ifsm->ifindex;
+
+	alen = nh->nlmsg_len - NLMSG_LENGTH(sizeof(*ifsm));
+	for (rta = (struct rtattr *)(void *)((char *)ifsm +
+	    NLMSG_ALIGN(sizeof(*ifsm))); RTA_OK(rta, alen);
+	    rta = RTA_NEXT(rta, alen)) {
+		if (rta->rta_type != IFLA_STATS_LINK_64) {
+			continue;
+		}
+		/* Older kernels send fewer fields; payloads aren't aligned. */
+		memset(&st, 0, sizeof(st));
+		len = RTA_PAYLOAD(rta);
+		memcpy(&st, RTA_DATA(rta), len < sizeof(st) ? len : sizeof(st));
+		ifc->ipackets = st.rx_packets;
+		ifc->ierrors = st.rx_errors;
+		ifc->iqdrops = st.rx_dropped;
+		ifc->ibytes = st.rx_bytes;
+		ifc->imcasts = st.multicast;
+		ifc->opackets = st.tx_packets;
+		ifc->oerrors = st.tx_errors;
+		ifc->oqdrops = st.tx_dropped;
+		ifc->obytes = st.tx_bytes;
+		ifc->collisions = st.collisions;
+		ifc->noproto = st.rx_nohandler;
+	}
+	return (0);
+}
+
+/*
+ * One RTM_GETSTATS dump of the 64-bit link statistics. At about 250 bytes
+ * an interface it is a fraction of an RTM_GETLINK dump, but carries no
+ * names; ifconfig_counters_read() takes those from the name cache.
+ */
+static int
+linux_counters(ifconfig_handle_t *h, struct ifconfig_counters *c)
+{
+	struct {
+		struct nlmsghdr nh;
+		struct if_stats_msg ifsm;
+	} sreq;
+
+	memset(&sreq, 0, sizeof(sreq));
+	sreq.nh.nlmsg_len = NLMSG_LENGTH(sizeof(sreq.ifsm));
+	sreq.nh.nlmsg_type = RTM_GETSTATS;
+	sreq.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	sreq.ifsm.family = AF_UNSPEC;
+	sreq.ifsm.filter_mask = IFLA_STATS_FILTER_BIT(IFLA_STATS_LINK_64);
+	if (nl_talk(h, 0, &sreq.nh, nl_counters_cb, c) != 0) {
+		if (ifconfig_errstate(h)->errtype == IOCTL) {
+			ifconfig_errstate(h)->errtype = OTHER;
+		}
+		return (-1);
+	}
+	return (0);
+}
+
+struct nl_addrlist_arg {
+	unsigned int ifindex;
+	ifconfig_addrlist_cb_t *cb;
+	void *udata;
+};
+
+static int
+nl_addrlist_cb(ifconfig_handle_t *h, struct nlmsghdr *nh, void *udata)
+{
+	struct nl_addrlist_arg *arg;
+	struct ifconfig_addr addr;
+	struct ifaddrmsg *ifa;
+	struct rtattr *rta, *local, *address;
+	size_t alen;
+	int len;
+
+	arg = udata;
+	if (nh->nlmsg_type != RTM_NEWADDR) {
+		return (0);
+	}
+	ifa = NLMSG_DATA(nh);
+	if (ifa->ifa_index != arg->ifindex) {
+		return (0);
+	}
+	switch (ifa->ifa_family) {
+	case AF_INET:
+		alen = sizeof(addr.addr.in);
+		break;
+	case AF_INET6:
+		alen = sizeof(addr.addr.in6);
+		break;
+	default:
+		return (0);
+	}
+
+	local = address = NULL;
+	len = IFA_PAYLOAD(nh);
+	for (rta = IFA_RTA(ifa); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		if (rta->rta_type == IFA_LOCAL) {
+			local = rta;
+		} else if (rta->rta_type == IFA_ADDRESS) {
+			address = rta;
+		}
+	}
+	/* On point-to-point links IFA_ADDRESS is the peer. */
+	if (local != NULL) {
+		address = local;
+	}
+	if (address == NULL || RTA_PAYLOAD(address) != alen) {
+		return (0);
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.family = ifa->ifa_family;
+	addr.prefixlen = ifa->ifa_prefixlen;
+	memcpy(&addr.addr, RTA_DATA(address), alen);
+	return (arg->cb(h, &addr, arg->udata));
+}
+
+/*
+ * Dumps all addresses. Kernels without strict checking ignore the index
+ * in the request, so the replies are filtered here as well.
+ */
+static int
+linux_addrlist(ifconfig_handle_t *h, const unsigned int ifindex,
+    ifconfig_addrlist_cb_t *cb, void *udata)
+{
+	struct nl_addrreq areq;
+	struct nl_addrlist_arg arg;
+
+	memset(&areq, 0, sizeof(areq));
+	areq.nh.nlmsg_len = NLMSG_LENGTH(sizeof(areq.ifa));
+	areq.nh.nlmsg_type = RTM_GETADDR;
+	areq.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	areq.ifa.ifa_family = AF_UNSPEC;
+	areq.ifa.ifa_index = ifindex;
+
+	arg.ifindex = ifindex;
+	arg.cb = cb;
+	arg.udata = udata;
+	if (nl_talk(h, 0, &areq.nh, nl_addrlist_cb, &arg) != 0) {
+		if (ifconfig_errstate(h)->errtype == IOCTL) {
+			ifconfig_errstate(h)->errtype = OTHER;
+		}
+		return (-1);
+	}
+	return (0);
+}
+
+static int
+linux_linkev_open(ifconfig_handle_t *h, int *fd)
+{
+	struct sockaddr_nl snl;
+
+	*fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC,
+	    NETLINK_ROUTE);
+	if (*fd == -1) {
+		goto fail;
+	}
+
+	memset(&snl, 0, sizeof(snl));
+	snl.nl_family = AF_NETLINK;
+	snl.nl_groups = RTMGRP_LINK;
+	if (bind(*fd, (struct sockaddr *)&snl, sizeof(snl)) != 0) {
+		(void)close(*fd);
+		*fd = -1;
+		goto fail;
+	}
+	return (0);
+
+fail:
+	ifconfig_errstate(h)->errtype = SOCKET;
+	ifconfig_errstate(h)->errcode = errno;
+	return (-1);
+}
+
+static int
+linux_linkev_read(ifconfig_handle_t *h, const int fd,
+    ifconfig_linkev_cb_t *cb, void *udata)
+{
+	char buf[NL_RECVSIZE];
+	struct ifconfig_link link;
+	struct nlmsghdr *nh;
+	ssize_t len;
+	int error;
+
+	for (;;) {
+		len = recv(fd, buf, sizeof(buf), 0);
+		if (len < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				return (0);
+			}
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == ENOBUFS) {
+				memset(&link, 0, sizeof(link));
+				if ((error = cb(h, IFCONFIG_LINKEV_LOST, &link,
+				    udata)) != 0) {
+					return (error);
+				}
+				continue;
+			}
+			ifconfig_errstate(h)->errtype = SOCKET;
+			ifconfig_errstate(h)->errcode = errno;
+			return (-1);
+		}
+
+		for (nh = (struct nlmsghdr *)(void *)buf; NLMSG_OK(nh, len);
+		    nh = NLMSG_NEXT(nh, len)) {
+			if (nl_parselink(nh, &link) != 0) {
+				continue;
+			}
+			if ((error = cb(h, nh->nlmsg_type == RTM_NEWLINK ?
+			    IFCONFIG_LINKEV_NEW : IFCONFIG_LINKEV_DEL, &link,
+			    udata)) != 0) {
+				return (error);
+			}
+		}
+	}
+}
+
+/* The closest Linux has to a driver name is what ethtool reports. */
+static int
+linux_drivername(ifconfig_handle_t *h, const unsigned int ifindex,
+    char *buf, size_t len)
+{
+	struct ethtool_drvinfo drvinfo;
+	struct ifreq ifr;
+	int s;
+
+	if (ifconfig_socket(h, AF_LOCAL, &s) != 0) {
+		return (-1);
+	}
+
+	memset(&ifr, 0, sizeof(ifr));
+	if (ifconfig_indextoname(h, ifindex, ifr.ifr_name) != 0) {
+		return (-1);
+	}
+	memset(&drvinfo, 0, sizeof(drvinfo));
+	drvinfo.cmd = ETHTOOL_GDRVINFO;
+	ifr.ifr_data = (void *)&drvinfo;
+	if (ioctl(s, SIOCETHTOOL, &ifr) != 0) {
+		goto fail;
+	}
+
+	drvinfo.driver[sizeof(drvinfo.driver) - 1] = '\0';
+	if (strlcpy(buf, drvinfo.driver, len) >= len) {
+		errno = ERANGE;
+		goto fail;
+	}
+	return (0);
+
+fail:
+	ifconfig_errstate(h)->errtype = OTHER;
+	ifconfig_errstate(h)->errcode = (errno != 0) ? errno : ENOENT;
+	return (-1);
+}
+
+const struct ifconfig_backend ifconfig_backend_linux = {
+	.name = "linux",
+	.private_af = AF_NETLINK,
+	.ioctl = linux_ioctl,
+	.iflist = linux_iflist,
+	.addrlist = linux_addrlist,
+	.counters = linux_counters,
+	.drivername = linux_drivername,
+	.submit = linux_submit,
+	.linkev_open = linux_linkev_open,
+	.linkev_read = linux_linkev_read,
+};
+
+#endif /* __linux__ */
@@ -0,0 +1,453 @@
+/*
+ * Copyright (c) 2016-2017, Marie Helene Kvello-Aune
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * thislist of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+
+#include <sys/types.h>
+
+#include <net/if.h>
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libifconfig.h"
+#include "libifconfig_internal.h"
+
+/* Staging buffer of ifconfig_metrics_write_fd(). */
+#define METRICS_FDBUFSIZE    65536
+
+/* Everything in a sample line except the escaped label values. */
+#define METRICS_LINEFIXED    160
+
+enum metrics_kind {
+	METRICS_INFO,
+	METRICS_MTU,
+	METRICS_METRIC,
+	METRICS_OPTIONS,
+	METRICS_CAPABILITIES,
+	METRICS_COUNTER
+};
+
+struct metrics_family {
+	enum metrics_kind kind;
+	/* Sample name, with the suffix OpenMetrics wants for the type. */
+	const char *name;
+	size_t namelen;
+	/* HELP and TYPE lines. */
+	const char *header;
+	/* Field of struct ifconfig_ifcounters, for METRICS_COUNTER. */
+	size_t offset;
+};
+
+#define SNAPFAMILY(kind, fam, type, help)				\
+	{ kind, fam, sizeof(fam) - 1,					\
+	  "# HELP " fam " " help "\n# TYPE " fam " " type "\n", 0 }
+#define COUNTERFAMILY(fam, field, help)					\
+	{ METRICS_COUNTER, fam "_total", sizeof(fam "_total") - 1,	\
+	  "# HELP " fam " " help "\n# TYPE " fam " counter\n",		\
+	  offsetof(struct ifconfig_ifcounters, field) }
+
+static const struct metrics_family families[] = {
+	{ METRICS_INFO, "ifconfig_interface_info",
+	  sizeof("ifconfig_interface_info") - 1,
+	  "# HELP ifconfig_interface Interface labels.\n"
+	  "# TYPE ifconfig_interface info\n", 0 },
+	SNAPFAMILY(METRICS_MTU, "ifconfig_interface_mtu", "gauge",
+	    "Maximum transmission unit in bytes."),
+	SNAPFAMILY(METRICS_METRIC, "ifconfig_interface_metric", "gauge",
+	    "Routing metric."),
+	SNAPFAMILY(METRICS_OPTIONS, "ifconfig_interface_options", "gauge",
+	    "Enabled capabilities, as a bit mask."),
+	SNAPFAMILY(METRICS_CAPABILITIES, "ifconfig_interface_capabilities",
+	    "gauge", "Supported capabilities, as a bit mask."),
+	COUNTERFAMILY("ifconfig_interface_receive_packets", ipackets,
+	    "Packets received."),
+	COUNTERFAMILY("ifconfig_interface_receive_errors", ierrors,
+	    "Input errors."),
+	COUNTERFAMILY("ifconfig_interface_receive_drops", iqdrops,
+	    "Packets dropped on input."),
+	COUNTERFAMILY("ifconfig_interface_receive_bytes", ibytes,
+	    "Bytes received."),
+	COUNTERFAMILY("ifconfig_interface_receive_multicast", imcasts,
+	    "Multicast packets received."),
+	COUNTERFAMILY("ifconfig_interface_transmit_packets", opackets,
+	    "Packets sent."),
+	COUNTERFAMILY("ifconfig_interface_transmit_errors", oerrors,
+	    "Output errors."),
+	COUNTERFAMILY("ifconfig_interface_transmit_drops", oqdrops,
+	    "Packets dropped on output."),
+	COUNTERFAMILY("ifconfig_interface_transmit_bytes", obytes,
+	    "Bytes sent."),
+	COUNTERFAMILY("ifconfig_interface_transmit_multicast", omcasts,
+	    "Multicast packets sent."),
+	COUNTERFAMILY("ifconfig_interface_collisions", collisions,
+	    "Collisions on the medium."),
+	COUNTERFAMILY("ifconfig_interface_unknown_protocol", noproto,
+	    "Packets received for a protocol the system doesn't handle."),
+};
+
+#define NFAMILIES    (sizeof(families) / sizeof(families[0]))
+
+/* Two digits at a time. */
+static const char digits[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233"
+    "34353637383940414243444546474849505152535455565758596061626364656667"
+    "6869707172737475767778798081828384858687888990919293949596979899";
+
+struct ifconfig_metrics {
+	const ifconfig_snapshot_t *snap;
+	const ifconfig_counters_t *counters;
+
+	/* Cursor: next family, and its next row; row 0 is the header. */
+	size_t family;
+	size_t row;
+	int eof;
+
+	/* A line that didn't fit, and how much of it was written. */
+	char *line;
+	size_t linesize;
+	size_t linelen;
+	size_t lineoff;
+
+	/* Staging buffer of write_fd(), allocated on first use. */
+	char *out;
+	size_t outlen;
+	size_t outoff;
+};
+
+static char *
+metrics_uint(char *p, uint64_t v)
+{
+	char tmp[20], *t;
+
+	t = tmp + sizeof(tmp);
+	while (v >= 100) {
+		t -= 2;
+		memcpy(t, digits + (v % 100) * 2, 2);
+		v /= 100;
+	}
+	if (v >= 10) {
+		t -= 2;
+		memcpy(t, digits + v * 2, 2);
+	} else {
+		*--t = '0' + v;
+	}
+	memcpy(p, t, tmp + sizeof(tmp) - t);
+	return (p + (tmp + sizeof(tmp) - t));
+}
+
+static char *
+metrics_int(char *p, const int v)
+{
+
+	if (v < 0) {
+		*p++ = '-';
+		return (metrics_uint(p, -(uint64_t)v));
+	}
+	return (metrics_uint(p, v));
+}
+
+/* Label values escape backslash, double quote and line feed. */
+static char *
+metrics_escape(char *p, const char *s)
+{
+
+	for (; *s != '\0'; s++) {
+		switch (*s) {
+		case '\\':
+		case '"':
+			*p++ = '\\';
+			*p++ = *s;
+			break;
+		case '\n':
+			*p++ = '\\';
+			*p++ = 'n';
+			break;
+		default:
+			*p++ = *s;
+			break;
+		}
+	}
+	return (p);
+}
+
+static char *
+metrics_append(char *p, const char *s, const size_t len)
+{
+
+	memcpy(p, s, len);
+	return (p + len);
+}
+
+#define APPEND(p, lit)    metrics_append((p), (lit), sizeof(lit) - 1)
+
+static char *
+metrics_labels(char *p, const char *name, const char *description)
+{
+
+	p = APPEND(p, "{interface=\"");
+	p = metrics_escape(p, name);
+	if (description != NULL) {
+		p = APPEND(p, "\",description=\"");
+		p = metrics_escape(p, description);
+	}
+	return (APPEND(p, "\"} "));
+}
+
+/* Sample line of row i of a snapshot family, or NULL to skip the row. */
+static char *
+metrics_snapline(char *p, const struct metrics_family *f,
+    const ifconfig_snapshot_iface_t *iface)
+{
+	struct ifconfig_capabilities cap;
+	const char *descr;
+	int v;
+
+	descr = NULL;
+	switch (f->kind) {
+	case METRICS_INFO:
+		descr = ifconfig_snapshot_iface_description(iface);
+		v = 1;
+		break;
+	case METRICS_MTU:
+		v = ifconfig_snapshot_iface_mtu(iface);
+		break;
+	case METRICS_METRIC:
+		v = ifconfig_snapshot_iface_metric(iface);
+		break;
+	case METRICS_OPTIONS:
+	case METRICS_CAPABILITIES:
+		if (ifconfig_snapshot_iface_capability(iface, &cap) != 0) {
+			return (NULL);
+		}
+		v = (f->kind == METRICS_OPTIONS) ? cap.curcap : cap.reqcap;
+		break;
+	default:
+		return (NULL);
+	}
+
+	p = metrics_append(p, f->name, f->namelen);
+	p = metrics_labels(p, ifconfig_snapshot_iface_name(iface), descr);
+	if (f->kind == METRICS_OPTIONS || f->kind == METRICS_CAPABILITIES) {
+		p = metrics_uint(p, (unsigned int)v);
+	} else {
+		p = metrics_int(p, v);
+	}
+	*p++ = '\n';
+	return (p);
+}
+
+static char *
+metrics_counterline(char *p, const struct metrics_family *f,
+    const struct ifconfig_ifcounters *ifc)
+{
+	uint64_t v;
+
+	memcpy(&v, (const char *)ifc + f->offset, sizeof(v));
+	p = metrics_append(p, f->name, f->namelen);
+	p = metrics_labels(p, ifc->name, NULL);
+	p = metrics_uint(p, v);
+	*p++ = '\n';
+	return (p);
+}
+
+/*
+ * Formats the line at the cursor into p, which has room for linesize
+ * bytes, and advances the cursor. Returns the length, or 0 at the end.
+ */
+static size_t
+metrics_line(struct ifconfig_metrics *m, char *p)
+{
+	const struct metrics_family *f;
+	size_t rows;
+	char *end;
+
+	for (; m->family < NFAMILIES; m->family++, m->row = 0) {
+		f = &families[m->family];
+		if (f->kind == METRICS_COUNTER) {
+			rows = (m->counters == NULL) ? 0 : m->counters->count;
+		} else {
+			rows = (m->snap == NULL) ? 0 :
+			    ifconfig_snapshot_count(m->snap);
+		}
+		if (rows == 0) {
+			continue;
+		}
+		if (m->row == 0) {
+			m->row++;
+			return (metrics_append(p, f->header,
+			    strlen(f->header)) - p);
+		}
+		while (m->row <= rows) {
+			if (f->kind == METRICS_COUNTER) {
+				end = metrics_counterline(p, f,
+				    &m->counters->ifaces[m->row - 1]);
+			} else {
+				end = metrics_snapline(p, f,
+				    ifconfig_snapshot_at(m->snap, m->row - 1));
+			}
+			m->row++;
+			if (end != NULL) {
+				return (end - p);
+			}
+		}
+	}
+	if (!m->eof) {
+		m->eof = 1;
+		return (APPEND(p, "# EOF\n") - p);
+	}
+	return (0);
+}
+
+ifconfig_metrics_t *
+ifconfig_metrics_new(void)
+{
+
+	return (calloc(1, sizeof(struct ifconfig_metrics)));
+}
+
+void
+ifconfig_metrics_free(ifconfig_metrics_t *m)
+{
+
+	if (m == NULL) {
+		return;
+	}
+	free(m->line);
+	free(m->out);
+	free(m);
+}
+
+int
+ifconfig_metrics_begin(ifconfig_metrics_t *m, const ifconfig_snapshot_t *snap,
+    const ifconfig_counters_t *counters)
+{
+	const char *descr;
+	size_t len, maxdescr;
+	char *tmp;
+
+	/* Longest line: every character of a label value escaped. */
+	maxdescr = 0;
+	for (size_t i = 0; snap != NULL && i < ifconfig_snapshot_count(snap);
+	    i++) {
+		descr = ifconfig_snapshot_iface_description(
+		    ifconfig_snapshot_at(snap, i));
+		if (descr != NULL && (len = strlen(descr)) > maxdescr) {
+			maxdescr = len;
+		}
+	}
+	len = METRICS_LINEFIXED + 2 * IFNAMSIZ + 2 * maxdescr;
+	for (size_t i = 0; i < NFAMILIES; i++) {
+		if (strlen(families[i].header) > len) {
+			len = strlen(families[i].header);
+		}
+	}
+	if (len > m->linesize) {
+		if ((tmp = realloc(m->line, len)) == NULL) {
+			return (-1);
+		}
+		m->line = tmp;
+		m->linesize = len;
+	}
+
+	m->snap = snap;
+	m->counters = counters;
+	m->family = 0;
+	m->row = 0;
+	m->eof = 0;
+	m->linelen = m->lineoff = 0;
+	m->outlen = m->outoff = 0;
+	return (0);
+}
+
+size_t
+ifconfig_metrics_write(ifconfig_metrics_t *m, char *buf, const size_t len)
+{
+	size_t n, l, c;
+
+	n = 0;
+	/* The rest of a line that didn't fit last time. */
+	if (m->lineoff < m->linelen) {
+		c = m->linelen - m->lineoff;
+		c = (c < len) ? c : len;
+		memcpy(buf, m->line + m->lineoff, c);
+		m->lineoff += c;
+		n = c;
+	}
+
+	while (n < len && m->lineoff == m->linelen) {
+		if (len - n >= m->linesize) {
+			/* Room for any line: format in place. */
+			if ((l = metrics_line(m, buf + n)) == 0) {
+				break;
+			}
+			n += l;
+			continue;
+		}
+		if ((l = metrics_line(m, m->line)) == 0) {
+			break;
+		}
+		c = (l < len - n) ? l : len - n;
+		memcpy(buf + n, m->line, c);
+		m->linelen = l;
+		m->lineoff = c;
+		n += c;
+	}
+	return (n);
+}
+
+int
+ifconfig_metrics_write_fd(ifconfig_metrics_t *m, const int fd)
+{
+	ssize_t r;
+
+	if (m->out == NULL && (m->out = malloc(METRICS_FDBUFSIZE)) == NULL) {
+		return (-1);
+	}
+	for (;;) {
+		if (m->outoff == m->outlen) {
+			m->outlen = ifconfig_metrics_write(m, m->out,
+			    METRICS_FDBUFSIZE);
+			m->outoff = 0;
+			if (m->outlen == 0) {
+				return (0);
+			}
+		}
+		r = write(fd, m->out + m->outoff, m->outlen - m->outoff);
+		if (r < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return (-1);
+		}
+		m->outoff += r;
+	}
+}
@@ -0,0 +1,809 @@
+/*
+ * Copyright (c) 2016-2017, Marie Helene Kvello-Aune
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * thislist of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+
+#include <sys/types.h>
+
+#include <net/if.h>
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libifconfig.h"
+#include "libifconfig_internal.h"
+
+#define NOSTR    ((size_t)-1)
+
+/* Attributes an interface has a desired value for. */
+#define WANT_MTU      0x1
+#define WANT_CAP      0x2
+#define WANT_DESCR    0x4
+#define WANT_VLAN     0x8
+
+/*
+ * Steps of the plan, in the order they are applied. A VLAN's MTU can't
+ * exceed its parent's, so VLANs are lowered before and raised after the
+ * interfaces they may be stacked on.
+ */
+enum {
+	STEP_VLAN,
+	STEP_MTU_LOWER,
+	STEP_MTU,
+	STEP_MTU_RAISE,
+	STEP_CAP,
+	STEP_DESCR,
+	STEP_COUNT
+};
+
+struct strtab {
+	char *buf;
+	size_t len;
+	size_t size;
+};
+
+struct reconcile_iface {
+	char name[IFNAMSIZ];
+	/** Order of creation, so duplicates merge in the order of calls. */
+	size_t seq;
+
+	/* Desired state. */
+	int want;
+	int mtu;
+	int capset;
+	int capclear;
+	size_t descr;
+	char vlanparent[IFNAMSIZ];
+	unsigned short vlantag;
+
+	/* Current state, from the last run. */
+	int found;
+	int failed;
+	unsigned int index;
+	int curmtu;
+	struct ifconfig_capabilities cap;
+	int has_descr;
+	size_t curdescr;
+	int has_vlan;
+	unsigned int curparent;
+	char curparentname[IFNAMSIZ];
+	unsigned short curtag;
+};
+
+struct ifconfig_reconcile {
+	ifconfig_handle_t *h;
+	struct reconcile_iface *ifaces;
+	size_t count;
+	size_t size;
+	size_t seq;
+	/** Set while ifaces is sorted by name without duplicates. */
+	int sorted;
+
+	/** Desired descriptions, and those read by the last run. */
+	struct strtab want;
+	struct strtab cur;
+
+	/** The plan, and the operation of each change. */
+	struct ifconfig_change *changes;
+	struct ifconfig_batchop *ops;
+	size_t *owner;
+	size_t nchanges;
+	size_t maxchanges;
+	/** Where each step starts in the plan. */
+	size_t step[STEP_COUNT + 1];
+};
+
+static void
+reconcile_nomem(ifconfig_handle_t *h)
+{
+
+	ifconfig_errstate(h)->errtype = OTHER;
+	ifconfig_errstate(h)->errcode = ENOMEM;
+}
+
+/* Appends a string to t. Returns its offset, or NOSTR without memory. */
+static size_t
+strtab_add(struct strtab *t, const char *str, size_t len)
+{
+	size_t off, newsize;
+	char *tmp;
+
+	if (t->len + len + 1 > t->size) {
+		newsize = (t->size == 0) ? 256 : t->size * 2;
+		while (newsize < t->len + len + 1) {
+			newsize *= 2;
+		}
+		tmp = realloc(t->buf, newsize);
+		if (tmp == NULL) {
+			return (NOSTR);
+		}
+		t->buf = tmp;
+		t->size = newsize;
+	}
+
+	off = t->len;
+	memcpy(t->buf + off, str, len);
+	t->buf[off + len] = '\0';
+	t->len += len + 1;
+	return (off);
+}
+
+static const char *
+strtab_get(const struct strtab *t, size_t off)
+{
+
+	return (off == NOSTR ? NULL : t->buf + off);
+}
+
+ifconfig_reconcile_t *
+ifconfig_reconcile_new(ifconfig_handle_t *h)
+{
+	struct ifconfig_reconcile *r;
+
+	r = calloc(1, sizeof(*r));
+	if (r == NULL) {
+		reconcile_nomem(h);
+		return (NULL);
+	}
+	r->h = h;
+	r->sorted = 1;
+	return (r);
+}
+
+void
+ifconfig_reconcile_free(ifconfig_reconcile_t *r)
+{
+
+	if (r == NULL) {
+		return;
+	}
+	free(r->ifaces);
+	free(r->want.buf);
+	free(r->cur.buf);
+	free(r->changes);
+	free(r->ops);
+	free(r->owner);
+	free(r);
+}
+
+void
+ifconfig_reconcile_clear(ifconfig_reconcile_t *r)
+{
+
+	r->count = 0;
+	r->seq = 0;
+	r->sorted = 1;
+	r->want.len = 0;
+	r->cur.len = 0;
+	r->nchanges = 0;
+	memset(r->step, 0, sizeof(r->step));
+}
+
+/*
+ * Returns the entry to record desired state for name in. Calls for one
+ * interface usually come together, so only the last entry is looked at;
+ * other duplicates are merged by the next run.
+ */
+static struct reconcile_iface *
+reconcile_iface(struct ifconfig_reconcile *r, const char *name)
+{
+	struct reconcile_iface *iface, *tmp;
+	int cmp;
+
+	cmp = 1;
+	if (r->count > 0) {
+		iface = &r->ifaces[r->count - 1];
+		cmp = strcmp(name, iface->name);
+		if (cmp == 0) {
+			return (iface);
+		}
+	}
+	if (strlen(name) >= IFNAMSIZ) {
+		ifconfig_errstate(r->h)->errtype = OTHER;
+		ifconfig_errstate(r->h)->errcode = ENAMETOOLONG;
+		return (NULL);
+	}
+
+	if (r->count == r->size) {
+		tmp = reallocarray(r->ifaces, r->size == 0 ? 64 : r->size * 2,
+		    sizeof(*r->ifaces));
+		if (tmp == NULL) {
+			reconcile_nomem(r->h);
+			return (NULL);
+		}
+		r->ifaces = tmp;
+		r->size = (r->size == 0) ? 64 : r->size * 2;
+	}
+
+	iface = &r->ifaces[r->count++];
+	memset(iface, 0, sizeof(*iface));
+	(void)strlcpy(iface->name, name, sizeof(iface->name));
+	iface->seq = r->seq++;
+	iface->descr = NOSTR;
+	if (cmp < 0) {
+		r->sorted = 0;
+	}
+	return (iface);
+}
+
+/* Adds the capability changes set and clear after those in iface. */
+static void
+reconcile_mergecap(struct reconcile_iface *iface, const int set,
+    const int clear)
+{
+
+	iface->capset = (iface->capset & ~clear) | set;
+	iface->capclear = (iface->capclear & ~set) | clear;
+	iface->want |= WANT_CAP;
+}
+
+int
+ifconfig_reconcile_set_mtu(ifconfig_reconcile_t *r, const char *name,
+    const int mtu)
+{
+	struct reconcile_iface *iface;
+
+	if ((iface = reconcile_iface(r, name)) == NULL) {
+		return (-1);
+	}
+	iface->mtu = mtu;
+	iface->want |= WANT_MTU;
+	return (0);
+}
+
+int
+ifconfig_reconcile_set_description(ifconfig_reconcile_t *r,
+    const char *name, const char *description)
+{
+	struct reconcile_iface *iface;
+	size_t off;
+
+	if ((iface = reconcile_iface(r, name)) == NULL) {
+		return (-1);
+	}
+	off = NOSTR;
+	if (description != NULL && description[0] != '\0') {
+		off = strtab_add(&r->want, description, strlen(description));
+		if (off == NOSTR) {
+			reconcile_nomem(r->h);
+			return (-1);
+		}
+	}
+	iface->descr = off;
+	iface->want |= WANT_DESCR;
+	return (0);
+}
+
+int
+ifconfig_reconcile_set_capabilities(ifconfig_reconcile_t *r,
+    const char *name, const int set, const int clear)
+{
+	struct reconcile_iface *iface;
+
+	if ((iface = reconcile_iface(r, name)) == NULL) {
+		return (-1);
+	}
+	reconcile_mergecap(iface, set, clear);
+	return (0);
+}
+
+int
+ifconfig_reconcile_set_vlan(ifconfig_reconcile_t *r, const char *name,
+    const char *vlandev, const unsigned short vlantag)
+{
+	struct reconcile_iface *iface;
+
+	if (strlen(vlandev) >= IFNAMSIZ) {
+		ifconfig_errstate(r->h)->errtype = OTHER;
+		ifconfig_errstate(r->h)->errcode = ENAMETOOLONG;
+		return (-1);
+	}
+	if ((iface = reconcile_iface(r, name)) == NULL) {
+		return (-1);
+	}
+	(void)strlcpy(iface->vlanparent, vlandev, sizeof(iface->vlanparent));
+	iface->vlantag = vlantag;
+	iface->want |= WANT_VLAN;
+	return (0);
+}
+
+static int
+reconcile_namecmp(const void *a, const void *b)
+{
+	const struct reconcile_iface *ia = a, *ib = b;
+
+	return (strcmp(ia->name, ib->name));
+}
+
+static int
+reconcile_cmp(const void *a, const void *b)
+{
+	const struct reconcile_iface *ia = a, *ib = b;
+	int cmp;
+
+	if ((cmp = reconcile_namecmp(a, b)) != 0) {
+		return (cmp);
+	}
+	return (ia->seq < ib->seq ? -1 : ia->seq > ib->seq);
+}
+
+/* Sorts the entries by name and merges those for the same interface. */
+static void
+reconcile_sort(struct ifconfig_reconcile *r)
+{
+	struct reconcile_iface *dst, *src;
+	size_t n;
+
+	if (r->sorted) {
+		return;
+	}
+	qsort(r->ifaces, r->count, sizeof(*r->ifaces), reconcile_cmp);
+
+	n = 0;
+	for (size_t i = 0; i < r->count; i++) {
+		src = &r->ifaces[i];
+		if (n == 0 || strcmp(src->name, r->ifaces[n - 1].name) != 0) {
+			r->ifaces[n++] = *src;
+			continue;
+		}
+		dst = &r->ifaces[n - 1];
+		if (src->want & WANT_MTU) {
+			dst->mtu = src->mtu;
+		}
+		if (src->want & WANT_CAP) {
+			reconcile_mergecap(dst, src->capset, src->capclear);
+		}
+		if (src->want & WANT_DESCR) {
+			dst->descr = src->descr;
+		}
+		if (src->want & WANT_VLAN) {
+			memcpy(dst->vlanparent, src->vlanparent,
+			    sizeof(dst->vlanparent));
+			dst->vlantag = src->vlantag;
+		}
+		dst->want |= src->want;
+	}
+	r->count = n;
+	r->sorted = 1;
+}
+
+static int
+reconcile_link(ifconfig_handle_t *h, const struct ifconfig_link *link,
+    void *udata)
+{
+	struct ifconfig_reconcile *r;
+	struct reconcile_iface key, *iface;
+
+	r = udata;
+	if (link->namelen >= sizeof(key.name)) {
+		return (0);
+	}
+	memcpy(key.name, link->name, link->namelen);
+	key.name[link->namelen] = '\0';
+	iface = bsearch(&key, r->ifaces, r->count, sizeof(*r->ifaces),
+	    reconcile_namecmp);
+	if (iface == NULL) {
+		return (0);
+	}
+
+	iface->found = 1;
+	iface->index = link->index;
+	iface->curmtu = link->mtu;
+	iface->has_vlan = link->has_vlan;
+	iface->curparent = link->parent;
+	iface->curtag = link->vlantag;
+	iface->has_descr = link->has_description;
+	if (link->has_description && link->description != NULL &&
+	    (iface->want & WANT_DESCR)) {
+		iface->curdescr = strtab_add(&r->cur, link->description,
+		    link->descriptionlen);
+		if (iface->curdescr == NOSTR) {
+			reconcile_nomem(h);
+			return (-1);
+		}
+	}
+	return (0);
+}
+
+/*
+ * Reads what the dump didn't tell about iface: its capabilities, and its
+ * description or VLAN where the backend's dump lacks them. A failure is
+ * left in the error state.
+ */
+static int
+reconcile_read(struct ifconfig_reconcile *r, struct reconcile_iface *iface,
+    const int want)
+{
+	ifconfig_handle_t *h;
+	struct ifconfig_req req;
+	const char *descr;
+	char buf[128], *str;
+
+	h = r->h;
+	switch (want) {
+	case WANT_CAP:
+		return (ifconfig_get_capability(h, iface->name, &iface->cap));
+	case WANT_VLAN:
+		if (iface->has_vlan) {
+			if (iface->curtag == 0) {
+				iface->curparentname[0] = '\0';
+				return (0);
+			}
+			return (ifconfig_indextoname(h, iface->curparent,
+			    iface->curparentname));
+		}
+		memset(&req, 0, sizeof(req));
+		(void)strlcpy(req.ifcr_name, iface->name,
+		    sizeof(req.ifcr_name));
+		if (ifconfig_ioctlwrap(h, AF_LOCAL, SIOCGETVLAN, &req) != 0) {
+			return (-1);
+		}
+		iface->curtag = req.ifcr_vlantag;
+		memcpy(iface->curparentname, req.ifcr_vlanparent,
+		    sizeof(iface->curparentname));
+		return (0);
+	case WANT_DESCR:
+		if (iface->has_descr) {
+			return (0);
+		}
+		if (ifconfig_read_description(h, iface->name, buf,
+		    sizeof(buf), &str, &descr) != 0) {
+			return (-1);
+		}
+		if (descr == NULL) {
+			return (0);
+		}
+		iface->curdescr = strtab_add(&r->cur, descr, strlen(descr));
+		free(str);
+		if (iface->curdescr == NOSTR) {
+			reconcile_nomem(h);
+			return (-1);
+		}
+		return (0);
+	}
+	return (0);
+}
+
+/* Appends a change to the plan, with the operation that makes it. */
+static struct ifconfig_batchop *
+reconcile_plan(struct ifconfig_reconcile *r, struct reconcile_iface *iface,
+    const ifconfig_change_attr attr, const unsigned long request)
+{
+	struct ifconfig_change *c;
+	struct ifconfig_batchop *op;
+
+	c = &r->changes[r->nchanges];
+	memset(c, 0, sizeof(*c));
+	c->name = iface->name;
+	c->attr = attr;
+	op = &r->ops[r->nchanges];
+	memset(op, 0, sizeof(*op));
+	op->request = request;
+	op->status = IFCONFIG_BATCH_PENDING;
+	(void)strlcpy(op->req.ifcr_name, iface->name,
+	    sizeof(op->req.ifcr_name));
+	op->req.ifcr_index = iface->index;
+	r->owner[r->nchanges] = iface - r->ifaces;
+	r->nchanges++;
+	return (op);
+}
+
+/* Marks the last change planned as failed with the handle's error. */
+static void
+reconcile_planfail(struct ifconfig_reconcile *r, const int errcode)
+{
+	struct ifconfig_batchop *op;
+
+	op = &r->ops[r->nchanges - 1];
+	op->status = IFCONFIG_BATCH_FAILED;
+	if (errcode != 0) {
+		op->error.errtype = OTHER;
+		op->error.errcode = errcode;
+	} else {
+		op->error = *ifconfig_errstate(r->h);
+	}
+	r->changes[r->nchanges - 1].errcode = op->error.errcode;
+}
+
+/* Whether iface is a VLAN once the plan has been applied. */
+static int
+reconcile_stacked(const struct reconcile_iface *iface)
+{
+
+	if (iface->want & WANT_VLAN) {
+		return (iface->vlantag != 0);
+	}
+	return (iface->curtag != 0);
+}
+
+/* Plans the changes of one step for iface. */
+static int
+reconcile_step(struct ifconfig_reconcile *r, struct reconcile_iface *iface,
+    const int step)
+{
+	struct ifconfig_batchop *op;
+	struct ifconfig_change *c;
+	const char *cur, *want;
+	int want_attr, reqcap, failed;
+
+	switch (step) {
+	case STEP_VLAN:
+		want_attr = WANT_VLAN;
+		break;
+	case STEP_MTU_LOWER:
+	case STEP_MTU_RAISE:
+		if (!iface->found || !reconcile_stacked(iface) ||
+		    (step == STEP_MTU_LOWER) != (iface->mtu < iface->curmtu)) {
+			return (0);
+		}
+		/* FALLTHROUGH */
+	case STEP_MTU:
+		if (step == STEP_MTU && iface->found &&
+		    reconcile_stacked(iface)) {
+			return (0);
+		}
+		want_attr = WANT_MTU;
+		break;
+	case STEP_CAP:
+		want_attr = WANT_CAP;
+		break;
+	default:
+		want_attr = WANT_DESCR;
+		break;
+	}
+	if (!(iface->want & want_attr)) {
+		return (0);
+	}
+
+	/* A change whose current value can't be read is planned failed. */
+	failed = iface->found &&
+	    (want_attr == WANT_MTU ? 0 : reconcile_read(r, iface, want_attr));
+	switch (want_attr) {
+	case WANT_VLAN:
+		if (iface->found && !failed &&
+		    iface->curtag == iface->vlantag &&
+		    strcmp(iface->curparentname, iface->vlanparent) == 0) {
+			return (0);
+		}
+		op = reconcile_plan(r, iface, IFCONFIG_CHANGE_VLAN,
+		    SIOCSETVLAN);
+		memcpy(op->req.ifcr_vlanparent, iface->vlanparent,
+		    sizeof(op->req.ifcr_vlanparent));
+		op->req.ifcr_vlantag = iface->vlantag;
+		c = &r->changes[r->nchanges - 1];
+		c->from = iface->curtag;
+		c->to = iface->vlantag;
+		c->from_str = iface->curparentname[0] != '\0' ?
+		    iface->curparentname : NULL;
+		c->to_str = iface->vlanparent[0] != '\0' ?
+		    iface->vlanparent : NULL;
+		/*
+		 * Linux recreates a retagged VLAN under a new index, so
+		 * the changes planned after this one go by name.
+		 */
+		iface->index = 0;
+		break;
+	case WANT_MTU:
+		if (iface->found && iface->curmtu == iface->mtu) {
+			return (0);
+		}
+		op = reconcile_plan(r, iface, IFCONFIG_CHANGE_MTU, SIOCSIFMTU);
+		op->req.ifcr_mtu = iface->mtu;
+		r->changes[r->nchanges - 1].from = iface->curmtu;
+		r->changes[r->nchanges - 1].to = iface->mtu;
+		break;
+	case WANT_CAP:
+		if (!iface->found || failed) {
+			reqcap = 0;
+		} else if ((reqcap = ifconfig_capmerge(&iface->cap,
+		    iface->capset, iface->capclear)) == iface->cap.curcap) {
+			return (0);
+		}
+		op = reconcile_plan(r, iface, IFCONFIG_CHANGE_CAPABILITIES,
+		    SIOCSIFCAP);
+		op->req.ifcr_reqcap = reqcap;
+		r->changes[r->nchanges - 1].from = iface->cap.curcap;
+		r->changes[r->nchanges - 1].to = reqcap;
+		break;
+	default:
+		if (iface->found && !failed) {
+			cur = strtab_get(&r->cur, iface->curdescr);
+			want = strtab_get(&r->want, iface->descr);
+			if (cur == want || (cur != NULL && want != NULL &&
+			    strcmp(cur, want) == 0)) {
+				return (0);
+			}
+		}
+		op = reconcile_plan(r, iface, IFCONFIG_CHANGE_DESCRIPTION,
+		    SIOCSIFDESCR);
+		/* Only read by SIOCSIFDESCR; r->want doesn't move any more. */
+		if (iface->descr != NOSTR) {
+			op->req.ifcr_buffer.buffer = (void *)(uintptr_t)
+			    strtab_get(&r->want, iface->descr);
+			op->req.ifcr_buffer.length =
+			    strlen(op->req.ifcr_buffer.buffer) + 1;
+		}
+		break;
+	}
+
+	if (!iface->found) {
+		reconcile_planfail(r, ENXIO);
+	} else if (failed) {
+		reconcile_planfail(r, 0);
+		if (ifconfig_errstate(r->h)->errcode == ENOMEM) {
+			return (-1);
+		}
+	}
+	return (0);
+}
+
+/*
+ * Reads the current state of the interfaces with desired state and plans
+ * the changes, step by step.
+ */
+static int
+reconcile_build(struct ifconfig_reconcile *r)
+{
+	struct ifconfig_change *changes;
+	struct ifconfig_batchop *ops;
+	size_t *owner, max;
+
+	/* At most one change per attribute; MTUs are in one step only. */
+	max = r->count * 4;
+	if (max > r->maxchanges) {
+		changes = reallocarray(r->changes, max, sizeof(*changes));
+		if (changes != NULL) {
+			r->changes = changes;
+		}
+		ops = reallocarray(r->ops, max, sizeof(*ops));
+		if (ops != NULL) {
+			r->ops = ops;
+		}
+		owner = reallocarray(r->owner, max, sizeof(*owner));
+		if (owner != NULL) {
+			r->owner = owner;
+		}
+		if (changes == NULL || ops == NULL || owner == NULL) {
+			reconcile_nomem(r->h);
+			return (-1);
+		}
+		r->maxchanges = max;
+	}
+
+	for (size_t i = 0; i < r->count; i++) {
+		r->ifaces[i].found = 0;
+		r->ifaces[i].failed = 0;
+		r->ifaces[i].curtag = 0;
+		r->ifaces[i].curparentname[0] = '\0';
+		r->ifaces[i].curdescr = NOSTR;
+		memset(&r->ifaces[i].cap, 0, sizeof(r->ifaces[i].cap));
+	}
+	if (ifconfig_iflist(r->h, reconcile_link, r) != 0) {
+		return (-1);
+	}
+
+	for (int step = 0; step < STEP_COUNT; step++) {
+		r->step[step] = r->nchanges;
+		for (size_t i = 0; i < r->count; i++) {
+			if (reconcile_step(r, &r->ifaces[i], step) != 0) {
+				return (-1);
+			}
+		}
+	}
+	r->step[STEP_COUNT] = r->nchanges;
+	return (0);
+}
+
+/*
+ * Applies the plan one step at a time. Changes of an interface that had
+ * a failure in an earlier step are cancelled.
+ */
+static void
+reconcile_apply(struct ifconfig_reconcile *r)
+{
+	struct reconcile_iface *iface;
+	struct ifconfig_batchop *op;
+	size_t i;
+
+	for (int step = 0; step < STEP_COUNT; step++) {
+		for (i = r->step[step]; i < r->step[step + 1]; i++) {
+			op = &r->ops[i];
+			if (op->status == IFCONFIG_BATCH_PENDING &&
+			    r->ifaces[r->owner[i]].failed) {
+				op->status = IFCONFIG_BATCH_FAILED;
+				op->error.errtype = OTHER;
+				op->error.errcode = ECANCELED;
+			}
+		}
+		ifconfig_batch_run(r->h, &r->ops[r->step[step]],
+		    r->step[step + 1] - r->step[step]);
+		for (i = r->step[step]; i < r->step[step + 1]; i++) {
+			op = &r->ops[i];
+			iface = &r->ifaces[r->owner[i]];
+			if (op->status == IFCONFIG_BATCH_FAILED) {
+				r->changes[i].errcode = op->error.errcode;
+				iface->failed = 1;
+			}
+		}
+	}
+}
+
+int
+ifconfig_reconcile_run(ifconfig_reconcile_t *r, const int flags)
+{
+
+	r->nchanges = 0;
+	r->cur.len = 0;
+	memset(r->step, 0, sizeof(r->step));
+	reconcile_sort(r);
+	if (reconcile_build(r) != 0) {
+		r->nchanges = 0;
+		memset(r->step, 0, sizeof(r->step));
+		return (-1);
+	}
+
+	/* Strings are only pointed at now that the tables don't move. */
+	for (size_t i = 0; i < r->nchanges; i++) {
+		if (r->changes[i].attr == IFCONFIG_CHANGE_DESCRIPTION) {
+			r->changes[i].from_str = strtab_get(&r->cur,
+			    r->ifaces[r->owner[i]].curdescr);
+			r->changes[i].to_str = strtab_get(&r->want,
+			    r->ifaces[r->owner[i]].descr);
+		}
+	}
+
+	if (!(flags & IFCONFIG_RECONCILE_DRYRUN)) {
+		reconcile_apply(r);
+	}
+
+	for (size_t i = 0; i < r->nchanges; i++) {
+		if (r->ops[i].status == IFCONFIG_BATCH_FAILED) {
+			*ifconfig_errstate(r->h) = r->ops[i].error;
+			return (-1);
+		}
+	}
+	return (0);
+}
+
+size_t
+ifconfig_reconcile_count(const ifconfig_reconcile_t *r)
+{
+
+	return (r->nchanges);
+}
+
+const struct ifconfig_change *
+ifconfig_reconcile_change(const ifconfig_reconcile_t *r, size_t i)
+{
+
+	if (i >= r->nchanges) {
+		return (NULL);
+	}
+	return (&r->changes[i]);
+}
@@ -0,0 +1,577 @@
+/*
+ * Copyright (c) 2016-2017, Marie Helene Kvello-Aune
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * thislist of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+
+#include <sys/types.h>
+
+#include <net/if.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "libifconfig.h"
+#include "libifconfig_internal.h"
+
+#define NOPOS    ((size_t)-1)
+
+struct ifconfig_sample {
+	uint64_t seq;
+	uint64_t interval_ns;
+	/** CLOCK_MONOTONIC time of the read. */
+	uint64_t time_ns;
+	size_t count;
+	size_t size;
+	unsigned int *indexes;
+	char (*names)[IFNAMSIZ];
+	uint64_t *counters[IFCONFIG_COUNTER_MAX];
+	double *rates[IFCONFIG_COUNTER_MAX];
+};
+
+struct ifconfig_sampler {
+	ifconfig_handle_t *h;
+	unsigned int interval_ms;
+	ifconfig_counters_t *raw;
+
+	/*
+	 * samples[pub] is the one readers get, the other one is written
+	 * by the sampler, but only while no reader holds it.
+	 */
+	struct ifconfig_sample samples[2];
+	unsigned int pub;
+	unsigned int readers[2];
+	uint64_t failures;
+
+	/** Position + 1 in samples[pub] of each interface, by index. */
+	unsigned int *map;
+	size_t mask;
+
+	/** Per interface of the sample being made: its position in
+	 * samples[pub], or NOPOS, and the previous value of one counter. */
+	size_t *prevpos;
+	uint64_t *prev;
+	size_t scratchsize;
+
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int stop;
+};
+
+static const size_t counter_offsets[IFCONFIG_COUNTER_MAX] = {
+	[IFCONFIG_COUNTER_IPACKETS] =
+	    offsetof(struct ifconfig_ifcounters, ipackets),
+	[IFCONFIG_COUNTER_IERRORS] =
+	    offsetof(struct ifconfig_ifcounters, ierrors),
+	[IFCONFIG_COUNTER_IQDROPS] =
+	    offsetof(struct ifconfig_ifcounters, iqdrops),
+	[IFCONFIG_COUNTER_IBYTES] =
+	    offsetof(struct ifconfig_ifcounters, ibytes),
+	[IFCONFIG_COUNTER_IMCASTS] =
+	    offsetof(struct ifconfig_ifcounters, imcasts),
+	[IFCONFIG_COUNTER_OPACKETS] =
+	    offsetof(struct ifconfig_ifcounters, opackets),
+	[IFCONFIG_COUNTER_OERRORS] =
+	    offsetof(struct ifconfig_ifcounters, oerrors),
+	[IFCONFIG_COUNTER_OQDROPS] =
+	    offsetof(struct ifconfig_ifcounters, oqdrops),
+	[IFCONFIG_COUNTER_OBYTES] =
+	    offsetof(struct ifconfig_ifcounters, obytes),
+	[IFCONFIG_COUNTER_OMCASTS] =
+	    offsetof(struct ifconfig_ifcounters, omcasts),
+	[IFCONFIG_COUNTER_COLLISIONS] =
+	    offsetof(struct ifconfig_ifcounters, collisions),
+	[IFCONFIG_COUNTER_NOPROTO] =
+	    offsetof(struct ifconfig_ifcounters, noproto),
+};
+
+static uint64_t
+sampler_now(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+static int
+sample_reserve(struct ifconfig_sample *smp, const size_t n)
+{
+	void *p;
+	size_t size;
+
+	if (n <= smp->size) {
+		return (0);
+	}
+	size = (smp->size == 0) ? 64 : smp->size;
+	while (size < n) {
+		size *= 2;
+	}
+
+	if ((p = reallocarray(smp->indexes, size, sizeof(*smp->indexes))) ==
+	    NULL) {
+		return (-1);
+	}
+	smp->indexes = p;
+	if ((p = reallocarray(smp->names, size, sizeof(*smp->names))) ==
+	    NULL) {
+		return (-1);
+	}
+	smp->names = p;
+	for (int c = 0; c < IFCONFIG_COUNTER_MAX; c++) {
+		if ((p = reallocarray(smp->counters[c], size,
+		    sizeof(*smp->counters[c]))) == NULL) {
+			return (-1);
+		}
+		smp->counters[c] = p;
+		if ((p = reallocarray(smp->rates[c], size,
+		    sizeof(*smp->rates[c]))) == NULL) {
+			return (-1);
+		}
+		smp->rates[c] = p;
+	}
+	smp->size = size;
+	return (0);
+}
+
+static void
+sample_free(struct ifconfig_sample *smp)
+{
+
+	free(smp->indexes);
+	free(smp->names);
+	for (int c = 0; c < IFCONFIG_COUNTER_MAX; c++) {
+		free(smp->counters[c]);
+		free(smp->rates[c]);
+	}
+}
+
+/* Scratch arrays and a map with room for n interfaces, half full at most. */
+static int
+sampler_reserve(struct ifconfig_sampler *s, const size_t n)
+{
+	void *p;
+	size_t size;
+
+	if (s->map != NULL && n <= s->scratchsize) {
+		return (0);
+	}
+	size = (s->scratchsize == 0) ? 64 : s->scratchsize;
+	while (size < n) {
+		size *= 2;
+	}
+
+	if ((p = reallocarray(s->prevpos, size, sizeof(*s->prevpos))) ==
+	    NULL) {
+		return (-1);
+	}
+	s->prevpos = p;
+	if ((p = reallocarray(s->prev, size, sizeof(*s->prev))) == NULL) {
+		return (-1);
+	}
+	s->prev = p;
+	/* The map describes samples[pub] and is rebuilt before publishing. */
+	if ((p = calloc(size * 2, sizeof(*s->map))) == NULL) {
+		return (-1);
+	}
+	free(s->map);
+	s->map = p;
+	s->mask = size * 2 - 1;
+	s->scratchsize = size;
+	return (0);
+}
+
+static size_t
+sampler_hash(const unsigned int ifindex)
+{
+
+	return ((uint32_t)ifindex * 2654435761u);
+}
+
+static size_t
+sampler_find(const struct ifconfig_sampler *s,
+    const struct ifconfig_sample *smp, const unsigned int ifindex)
+{
+	size_t slot;
+
+	for (slot = sampler_hash(ifindex) & s->mask; s->map[slot] != 0;
+	    slot = (slot + 1) & s->mask) {
+		if (smp->indexes[s->map[slot] - 1] == ifindex) {
+			return (s->map[slot] - 1);
+		}
+	}
+	return (NOPOS);
+}
+
+static void
+sampler_map(struct ifconfig_sampler *s, const struct ifconfig_sample *smp)
+{
+	size_t slot;
+
+	memset(s->map, 0, (s->mask + 1) * sizeof(*s->map));
+	for (size_t i = 0; i < smp->count; i++) {
+		slot = sampler_hash(smp->indexes[i]) & s->mask;
+		while (s->map[slot] != 0) {
+			slot = (slot + 1) & s->mask;
+		}
+		s->map[slot] = i + 1;
+	}
+}
+
+/*
+ * The loops below work on whole arrays, without branches or aliasing, so
+ * that compilers can vectorize them.
+ */
+
+/*
+ * One pass over the rows: they are far larger than one column, so
+ * reading them once per counter would cost more than everything else.
+ */
+static void
+sampler_transpose(struct ifconfig_sample *smp,
+    const struct ifconfig_ifcounters *src, const size_t n)
+{
+	const char *row;
+
+	for (size_t i = 0; i < n; i++) {
+		row = (const char *)&src[i];
+		for (int c = 0; c < IFCONFIG_COUNTER_MAX; c++) {
+			smp->counters[c][i] = *(const uint64_t *)(const void *)
+			    (row + counter_offsets[c]);
+		}
+	}
+}
+
+/* Interfaces that are new get their current value, so they rate 0. */
+static void
+sampler_gather(uint64_t *restrict prev, const uint64_t *restrict old,
+    const uint64_t *restrict cur, const size_t *restrict pos, const size_t n)
+{
+
+	for (size_t i = 0; i < n; i++) {
+		prev[i] = (pos[i] != NOPOS) ? old[pos[i]] : cur[i];
+	}
+}
+
+/*
+ * Converts through the exponent bias, (2^84 + hi * 2^32) - (2^84 + 2^52)
+ * + (2^52 + lo), because without AVX-512 there's no vector instruction
+ * for uint64_t to double and the plain cast stays scalar. The 64-bit
+ * compares need SSE4.2, so x86 only vectorizes this with -march set.
+ */
+static void
+sampler_rates(double *restrict rate, const uint64_t *restrict cur,
+    const uint64_t *restrict prev, const double scale, const size_t n)
+{
+	union {
+		uint64_t u;
+		double d;
+	} hi, lo;
+	uint64_t d;
+
+	for (size_t i = 0; i < n; i++) {
+		d = (cur[i] >= prev[i]) ? cur[i] - prev[i] :
+		    (prev[i] <= UINT32_MAX) ?
+		    cur[i] - prev[i] + ((uint64_t)1 << 32) : cur[i];
+		hi.u = (d >> 32) | 0x4530000000000000;
+		lo.u = (d & 0xffffffff) | 0x4330000000000000;
+		rate[i] = ((hi.d - 19342813118337666422669312.0) + lo.d) *
+		    scale;
+	}
+}
+
+/* One round. Only the sampler thread changes pub. */
+static void
+sampler_take(struct ifconfig_sampler *s)
+{
+	struct ifconfig_sample *old, *smp;
+	struct ifconfig_counters *raw;
+	const uint64_t *prev;
+	unsigned int spare;
+	uint64_t now;
+	double scale;
+	size_t n;
+	int stable;
+
+	spare = 1 - s->pub;
+	if (__atomic_load_n(&s->readers[spare], __ATOMIC_SEQ_CST) != 0) {
+		return;
+	}
+	old = &s->samples[s->pub];
+	smp = &s->samples[spare];
+
+	raw = s->raw;
+	if (ifconfig_counters_read(s->h, raw) != 0) {
+		goto fail;
+	}
+	now = sampler_now();
+	n = raw->count;
+	if (sample_reserve(smp, n) != 0) {
+		goto fail;
+	}
+	if (s->map == NULL || n > s->scratchsize) {
+		if (sampler_reserve(s, n) != 0) {
+			goto fail;
+		}
+		sampler_map(s, old);
+	}
+
+	/* Usually every interface is where it was in the previous sample. */
+	stable = (old->count == n);
+	for (size_t i = 0; i < n; i++) {
+		smp->indexes[i] = raw->ifaces[i].index;
+		memcpy(smp->names[i], raw->ifaces[i].name, IFNAMSIZ);
+		s->prevpos[i] = (i < old->count &&
+		    old->indexes[i] == smp->indexes[i]) ? i :
+		    sampler_find(s, old, smp->indexes[i]);
+		stable &= (s->prevpos[i] == i);
+	}
+	scale = (old->seq == 0) ? 0 : 1e9 / (double)(now - old->time_ns);
+	sampler_transpose(smp, raw->ifaces, n);
+	for (int c = 0; c < IFCONFIG_COUNTER_MAX; c++) {
+		prev = old->counters[c];
+		if (!stable) {
+			sampler_gather(s->prev, prev, smp->counters[c],
+			    s->prevpos, n);
+			prev = s->prev;
+		}
+		sampler_rates(smp->rates[c], smp->counters[c], prev, scale, n);
+	}
+	smp->count = n;
+	smp->seq = old->seq + 1;
+	smp->interval_ns = (old->seq == 0) ? 0 : now - old->time_ns;
+	smp->time_ns = now;
+
+	sampler_map(s, smp);
+	__atomic_store_n(&s->pub, spare, __ATOMIC_SEQ_CST);
+	return;
+
+fail:
+	(void)__atomic_add_fetch(&s->failures, 1, __ATOMIC_RELAXED);
+}
+
+static void *
+sampler_main(void *arg)
+{
+	struct ifconfig_sampler *s;
+	struct timespec deadline;
+	uint64_t next, now;
+
+	s = arg;
+	next = sampler_now();
+	(void)pthread_mutex_lock(&s->lock);
+	while (!s->stop) {
+		(void)pthread_mutex_unlock(&s->lock);
+		sampler_take(s);
+
+		/* Rounds missed while stalled are skipped, not caught up. */
+		next += (uint64_t)s->interval_ms * 1000000;
+		now = sampler_now();
+		if (next < now) {
+			next = now;
+		}
+		deadline.tv_sec = next / 1000000000;
+		deadline.tv_nsec = next % 1000000000;
+
+		(void)pthread_mutex_lock(&s->lock);
+		while (!s->stop && pthread_cond_timedwait(&s->cond, &s->lock,
+		    &deadline) != ETIMEDOUT) {
+			;
+		}
+	}
+	(void)pthread_mutex_unlock(&s->lock);
+	return (NULL);
+}
+
+static void
+sampler_free(struct ifconfig_sampler *s)
+{
+
+	ifconfig_close(s->h);
+	ifconfig_counters_free(s->raw);
+	sample_free(&s->samples[0]);
+	sample_free(&s->samples[1]);
+	free(s->map);
+	free(s->prevpos);
+	free(s->prev);
+	free(s);
+}
+
+int
+ifconfig_sampler_start(ifconfig_handle_t *h, const unsigned int interval_ms,
+    ifconfig_sampler_t **sp)
+{
+	struct ifconfig_sampler *s;
+	pthread_condattr_t attr;
+	int error;
+
+	if (interval_ms == 0) {
+		ifconfig_close(h);
+		errno = EINVAL;
+		return (-1);
+	}
+	if ((s = calloc(1, sizeof(*s))) == NULL) {
+		ifconfig_close(h);
+		return (-1);
+	}
+	s->h = h;
+	s->interval_ms = interval_ms;
+	if ((s->raw = ifconfig_counters_new()) == NULL) {
+		sampler_free(s);
+		return (-1);
+	}
+
+	/* Deadlines are on the monotonic clock. */
+	(void)pthread_mutex_init(&s->lock, NULL);
+	(void)pthread_condattr_init(&attr);
+	(void)pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	(void)pthread_cond_init(&s->cond, &attr);
+	(void)pthread_condattr_destroy(&attr);
+
+	if ((error = pthread_create(&s->thread, NULL, sampler_main, s)) != 0) {
+		(void)pthread_cond_destroy(&s->cond);
+		(void)pthread_mutex_destroy(&s->lock);
+		sampler_free(s);
+		errno = error;
+		return (-1);
+	}
+	*sp = s;
+	return (0);
+}
+
+void
+ifconfig_sampler_stop(ifconfig_sampler_t *s)
+{
+
+	if (s == NULL) {
+		return;
+	}
+	(void)pthread_mutex_lock(&s->lock);
+	s->stop = 1;
+	(void)pthread_cond_signal(&s->cond);
+	(void)pthread_mutex_unlock(&s->lock);
+	(void)pthread_join(s->thread, NULL);
+	(void)pthread_cond_destroy(&s->cond);
+	(void)pthread_mutex_destroy(&s->lock);
+	sampler_free(s);
+}
+
+uint64_t
+ifconfig_sampler_failures(const ifconfig_sampler_t *s)
+{
+
+	return (__atomic_load_n(&s->failures, __ATOMIC_RELAXED));
+}
+
+/*
+ * A reader announces itself on the sample it found published, then checks
+ * that it still is. The sampler only writes a sample nobody announced
+ * on, and publishes it after writing, so a reader that passes the check
+ * sees a complete sample that stays untouched until released.
+ */
+const ifconfig_sample_t *
+ifconfig_sampler_acquire(ifconfig_sampler_t *s)
+{
+	unsigned int i;
+
+	for (;;) {
+		i = __atomic_load_n(&s->pub, __ATOMIC_SEQ_CST);
+		(void)__atomic_add_fetch(&s->readers[i], 1, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&s->pub, __ATOMIC_SEQ_CST) == i) {
+			return (&s->samples[i]);
+		}
+		(void)__atomic_sub_fetch(&s->readers[i], 1, __ATOMIC_SEQ_CST);
+	}
+}
+
+void
+ifconfig_sampler_release(ifconfig_sampler_t *s,
+    const ifconfig_sample_t *sample)
+{
+
+	(void)__atomic_sub_fetch(&s->readers[sample - s->samples], 1,
+	    __ATOMIC_SEQ_CST);
+}
+
+uint64_t
+ifconfig_sample_seq(const ifconfig_sample_t *sample)
+{
+
+	return (sample->seq);
+}
+
+uint64_t
+ifconfig_sample_interval_ns(const ifconfig_sample_t *sample)
+{
+
+	return (sample->interval_ns);
+}
+
+size_t
+ifconfig_sample_count(const ifconfig_sample_t *sample)
+{
+
+	return (sample->count);
+}
+
+const unsigned int *
+ifconfig_sample_indexes(const ifconfig_sample_t *sample)
+{
+
+	return (sample->indexes);
+}
+
+const char *
+ifconfig_sample_name(const ifconfig_sample_t *sample, size_t i)
+{
+
+	if (i >= sample->count) {
+		return (NULL);
+	}
+	return (sample->names[i]);
+}
+
+const uint64_t *
+ifconfig_sample_counters(const ifconfig_sample_t *sample,
+    const enum ifconfig_counter counter)
+{
+
+	return (sample->counters[counter]);
+}
+
+const double *
+ifconfig_sample_rates(const ifconfig_sample_t *sample,
+    const enum ifconfig_counter counter)
+{
+
+	return (sample->rates[counter]);
+}
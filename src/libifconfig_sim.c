@@ -0,0 +1,1258 @@
+/*
+ * Copyright (c) 2016-2017, Marie Helene Kvello-Aune
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * thislist of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+
+/*
+ * Simulated kernel. Keeps an interface table in memory and serves the
+ * request codes the library uses, so the library's own costs can be
+ * measured, and its behaviour tested, at any scale and on any platform.
+ *
+ * Interfaces live in an array by index - 1; indexes aren't reused. Names
+ * are found through an open addressing table with backward shift
+ * deletion. Link notifications are queued in memory for each listener,
+ * whose descriptor is one end of a socket pair that the simulator writes
+ * a byte to when the queue becomes non-empty.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <net/if.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libifconfig.h"
+#include "libifconfig_internal.h"
+
+/* Capabilities every simulated interface supports. */
+#define SIM_CAPS		0x00ffffff
+#define SIM_DESCR_MAXLEN	1024
+#define SIM_MTU_MIN		72
+#define SIM_MTU_MAX		65535
+#define SIM_FAULTS_MAX		16
+/* Notifications queued per listener before it is told they were lost. */
+#define SIM_QUEUE_MAX		65536
+/* Latencies from here on are slept instead of spun. */
+#define SIM_SLEEP_NS		50000
+
+struct sim_iface {
+	/** 0 once destroyed. */
+	unsigned int index;
+	char name[IFNAMSIZ];
+	/** Cloner the interface was created with; reported as driver name. */
+	char kind[IFNAMSIZ];
+	int flags;
+	int mtu;
+	int metric;
+	int curcap;
+	char *descr;
+	unsigned int vlanparent;
+	unsigned short vlantag;
+	/** Number of VLANs on this interface. */
+	unsigned int nvlans;
+	/** Index of the bridge this interface is a member of, or 0. */
+	unsigned int master;
+	/** Number of members of this bridge. */
+	unsigned int nmembers;
+	struct ifconfig_addr *addrs;
+	size_t naddrs;
+	size_t addrsize;
+	/** Set by ifconfig_sim_set_counters(); index and name unused. */
+	struct ifconfig_ifcounters counters;
+};
+
+struct sim_fault {
+	unsigned long request;
+	int errcode;
+	unsigned int every;
+	unsigned int count;
+};
+
+struct sim_event {
+	enum ifconfig_linkev_type type;
+	unsigned int index;
+	int flags;
+	int mtu;
+	int metric;
+	char name[IFNAMSIZ];
+};
+
+struct sim_listener {
+	/** Descriptor handed out by linkev_open, and the end we write to. */
+	int rfd;
+	int wfd;
+	struct sim_event *queue;
+	size_t head;
+	size_t count;
+	size_t size;
+	int lost;
+};
+
+/* Next unit number to try for a cloner. */
+struct sim_unit {
+	char kind[IFNAMSIZ];
+	unsigned int next;
+};
+
+struct ifconfig_sim {
+	pthread_mutex_t lock;
+
+	struct sim_iface *ifaces;
+	size_t nifaces;
+	size_t size;
+	size_t live;
+
+	/** Index of the interface, 0 if free. */
+	unsigned int *byname;
+	size_t mask;
+
+	struct sim_unit *units;
+	size_t nunits;
+
+	struct sim_listener *listeners;
+	size_t nlisteners;
+
+	uint64_t latency_ns;
+	struct sim_fault faults[SIM_FAULTS_MAX];
+	size_t nfaults;
+};
+
+static size_t
+sim_hashname(const char *name)
+{
+	uint32_t hash;
+
+	/* FNV-1a */
+	hash = 2166136261u;
+	for (; *name != '\0'; name++) {
+		hash ^= (unsigned char)*name;
+		hash *= 16777619u;
+	}
+	return (hash);
+}
+
+static struct sim_iface *
+sim_byindex(ifconfig_sim_t *sim, const unsigned int ifindex)
+{
+
+	if (ifindex == 0 || ifindex > sim->nifaces ||
+	    sim->ifaces[ifindex - 1].index == 0) {
+		return (NULL);
+	}
+	return (&sim->ifaces[ifindex - 1]);
+}
+
+static size_t
+sim_nameslot(ifconfig_sim_t *sim, const char *name)
+{
+	size_t slot;
+
+	for (slot = sim_hashname(name) & sim->mask; sim->byname[slot] != 0;
+	    slot = (slot + 1) & sim->mask) {
+		if (strcmp(sim->ifaces[sim->byname[slot] - 1].name,
+		    name) == 0) {
+			break;
+		}
+	}
+	return (slot);
+}
+
+static struct sim_iface *
+sim_byname(ifconfig_sim_t *sim, const char *name)
+{
+	unsigned int ifindex;
+
+	if (sim->live == 0) {
+		return (NULL);
+	}
+	ifindex = sim->byname[sim_nameslot(sim, name)];
+	return (ifindex == 0 ? NULL : &sim->ifaces[ifindex - 1]);
+}
+
+static void
+sim_hashinsert(ifconfig_sim_t *sim, const struct sim_iface *iface)
+{
+
+	sim->byname[sim_nameslot(sim, iface->name)] = iface->index;
+}
+
+static void
+sim_hashremove(ifconfig_sim_t *sim, const char *name)
+{
+	size_t i, j, k;
+
+	i = sim_nameslot(sim, name);
+	for (j = i;;) {
+		j = (j + 1) & sim->mask;
+		if (sim->byname[j] == 0) {
+			break;
+		}
+		k = sim_hashname(sim->ifaces[sim->byname[j] - 1].name) &
+		    sim->mask;
+		/* Leave entries whose home slot lies in (i, j]. */
+		if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j)) {
+			continue;
+		}
+		sim->byname[i] = sim->byname[j];
+		i = j;
+	}
+	sim->byname[i] = 0;
+}
+
+/* Keeps the name table at most half full. */
+static int
+sim_grow(ifconfig_sim_t *sim)
+{
+	struct sim_iface *ifaces;
+	unsigned int *byname;
+	size_t tabsize;
+
+	if (sim->nifaces == sim->size) {
+		ifaces = reallocarray(sim->ifaces, sim->size * 2,
+		    sizeof(*ifaces));
+		if (ifaces == NULL) {
+			return (-1);
+		}
+		sim->ifaces = ifaces;
+		sim->size *= 2;
+	}
+
+	if ((sim->live + 1) * 2 <= sim->mask + 1) {
+		return (0);
+	}
+	tabsize = (sim->mask + 1) * 2;
+	if ((byname = calloc(tabsize, sizeof(*byname))) == NULL) {
+		return (-1);
+	}
+	free(sim->byname);
+	sim->byname = byname;
+	sim->mask = tabsize - 1;
+	for (size_t i = 0; i < sim->nifaces; i++) {
+		if (sim->ifaces[i].index != 0) {
+			sim_hashinsert(sim, &sim->ifaces[i]);
+		}
+	}
+	return (0);
+}
+
+static void
+sim_listener_free(struct sim_listener *l)
+{
+
+	(void)close(l->wfd);
+	free(l->queue);
+}
+
+/*
+ * Queues a notification for every listener. Listeners whose descriptor
+ * was closed are found here, by the failing wakeup, and dropped.
+ */
+static void
+sim_notify(ifconfig_sim_t *sim, const enum ifconfig_linkev_type type,
+    const struct sim_iface *iface)
+{
+	struct sim_listener *l;
+	struct sim_event *ev, *queue;
+	size_t i, size;
+
+	for (i = 0; i < sim->nlisteners;) {
+		l = &sim->listeners[i];
+		if (l->count == 0 && send(l->wfd, "", 1,
+		    MSG_DONTWAIT | MSG_NOSIGNAL) < 0 && errno != EAGAIN &&
+		    errno != EWOULDBLOCK) {
+			sim_listener_free(l);
+			*l = sim->listeners[--sim->nlisteners];
+			continue;
+		}
+		i++;
+
+		if (l->lost) {
+			continue;
+		}
+		if (l->count == l->size) {
+			size = (l->size == 0) ? 64 : l->size * 2;
+			queue = (size > SIM_QUEUE_MAX) ? NULL :
+			    malloc(size * sizeof(*queue));
+			if (queue == NULL) {
+				l->lost = 1;
+				l->count = 0;
+				continue;
+			}
+			for (size_t j = 0; j < l->count; j++) {
+				queue[j] = l->queue[(l->head + j) % l->size];
+			}
+			free(l->queue);
+			l->queue = queue;
+			l->head = 0;
+			l->size = size;
+		}
+
+		ev = &l->queue[(l->head + l->count++) % l->size];
+		ev->type = type;
+		ev->index = iface->index;
+		ev->flags = iface->flags;
+		ev->mtu = iface->mtu;
+		ev->metric = iface->metric;
+		memcpy(ev->name, iface->name, sizeof(ev->name));
+	}
+}
+
+/*
+ * Applies the configured latency, without holding the lock so that
+ * requests from several threads overlap. Waits of SIM_SLEEP_NS and up
+ * sleep, like a kernel blocking; shorter ones spin, as sleeping can't hit
+ * microsecond targets.
+ */
+static void
+sim_delay(ifconfig_sim_t *sim)
+{
+	struct timespec ts;
+	uint64_t latency, until;
+
+	latency = __atomic_load_n(&sim->latency_ns, __ATOMIC_RELAXED);
+	if (latency == 0) {
+		return;
+	}
+	if (latency >= SIM_SLEEP_NS) {
+		ts.tv_sec = latency / 1000000000;
+		ts.tv_nsec = latency % 1000000000;
+		while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+			continue;
+		}
+		return;
+	}
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	until = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec + latency;
+	do {
+		(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	} while ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec < until);
+}
+
+/*
+ * Applies the first fault rule whose turn it is. Returns the error to fail
+ * with, or 0.
+ */
+static int
+sim_enter(ifconfig_sim_t *sim, const unsigned long request)
+{
+	struct sim_fault *f;
+
+	for (size_t i = 0; i < sim->nfaults; i++) {
+		f = &sim->faults[i];
+		if ((f->request == 0 || f->request == request) &&
+		    ++f->count % f->every == 0) {
+			return (f->errcode);
+		}
+	}
+	return (0);
+}
+
+static unsigned int
+sim_unit(ifconfig_sim_t *sim, const char *kind)
+{
+	struct sim_unit *units;
+
+	for (size_t i = 0; i < sim->nunits; i++) {
+		if (strcmp(sim->units[i].kind, kind) == 0) {
+			return (sim->units[i].next);
+		}
+	}
+	units = reallocarray(sim->units, sim->nunits + 1, sizeof(*units));
+	if (units == NULL) {
+		return (0);
+	}
+	sim->units = units;
+	(void)strlcpy(units[sim->nunits].kind, kind, IFNAMSIZ);
+	units[sim->nunits].next = 0;
+	sim->nunits++;
+	return (0);
+}
+
+static void
+sim_setunit(ifconfig_sim_t *sim, const char *kind, const unsigned int unit)
+{
+
+	for (size_t i = 0; i < sim->nunits; i++) {
+		if (strcmp(sim->units[i].kind, kind) == 0) {
+			if (unit >= sim->units[i].next) {
+				sim->units[i].next = unit + 1;
+			}
+			return;
+		}
+	}
+}
+
+/*
+ * Adds an interface. A name without a unit number, like "bridge", gets
+ * the lowest unit above those handed out so far.
+ */
+static int
+sim_create(ifconfig_sim_t *sim, char *name, const int isvlan)
+{
+	char kind[IFNAMSIZ], tmp[IFNAMSIZ + 16];
+	struct sim_iface *iface;
+	size_t len;
+	unsigned int unit;
+
+	len = strlen(name);
+	while (len > 0 && name[len - 1] >= '0' && name[len - 1] <= '9') {
+		len--;
+	}
+	if (len == 0) {
+		return (EINVAL);
+	}
+	memcpy(kind, name, len);
+	kind[len] = '\0';
+
+	if (name[len] == '\0') {
+		for (unit = sim_unit(sim, kind);; unit++) {
+			(void)snprintf(tmp, sizeof(tmp), "%s%u", kind, unit);
+			if (strlen(tmp) >= IFNAMSIZ) {
+				return (ENOSPC);
+			}
+			if (sim_byname(sim, tmp) == NULL) {
+				break;
+			}
+		}
+		memcpy(name, tmp, IFNAMSIZ);
+		sim_setunit(sim, kind, unit);
+	} else if (sim_byname(sim, name) != NULL) {
+		return (EEXIST);
+	} else {
+		(void)sim_unit(sim, kind);
+		sim_setunit(sim, kind, strtoul(name + len, NULL, 10));
+	}
+
+	if (sim_grow(sim) != 0) {
+		return (ENOMEM);
+	}
+	iface = &sim->ifaces[sim->nifaces];
+	memset(iface, 0, sizeof(*iface));
+	iface->index = ++sim->nifaces;
+	(void)strlcpy(iface->name, name, sizeof(iface->name));
+	(void)strlcpy(iface->kind, isvlan ? "vlan" : kind, sizeof(iface->kind));
+	iface->flags = IFF_BROADCAST | IFF_MULTICAST;
+	iface->mtu = 1500;
+	iface->curcap = SIM_CAPS;
+	sim_hashinsert(sim, iface);
+	sim->live++;
+	sim_notify(sim, IFCONFIG_LINKEV_NEW, iface);
+	return (0);
+}
+
+static void
+sim_destroy(ifconfig_sim_t *sim, struct sim_iface *iface)
+{
+
+	sim_notify(sim, IFCONFIG_LINKEV_DEL, iface);
+	sim_hashremove(sim, iface->name);
+	if (iface->vlanparent != 0) {
+		sim->ifaces[iface->vlanparent - 1].nvlans--;
+	}
+	for (size_t i = 0; iface->nvlans > 0 && i < sim->nifaces; i++) {
+		if (sim->ifaces[i].vlanparent == iface->index) {
+			sim->ifaces[i].vlanparent = 0;
+			iface->nvlans--;
+		}
+	}
+	if (iface->master != 0) {
+		sim->ifaces[iface->master - 1].nmembers--;
+	}
+	for (size_t i = 0; iface->nmembers > 0 && i < sim->nifaces; i++) {
+		if (sim->ifaces[i].master == iface->index) {
+			sim->ifaces[i].master = 0;
+			iface->nmembers--;
+		}
+	}
+	free(iface->descr);
+	iface->descr = NULL;
+	free(iface->addrs);
+	iface->addrs = NULL;
+	iface->naddrs = iface->addrsize = 0;
+	iface->index = 0;
+	sim->live--;
+}
+
+static int
+sim_setvlan(ifconfig_sim_t *sim, struct sim_iface *iface,
+    const struct ifconfig_req *req)
+{
+	struct sim_iface *parent;
+
+	if (strcmp(iface->kind, "vlan") != 0 || req->ifcr_vlantag == 0 ||
+	    req->ifcr_vlantag >= 4095) {
+		return (EINVAL);
+	}
+	if ((parent = sim_byname(sim, req->ifcr_vlanparent)) == NULL) {
+		return (ENXIO);
+	}
+	if (iface->vlanparent != 0) {
+		sim->ifaces[iface->vlanparent - 1].nvlans--;
+	}
+	parent->nvlans++;
+	iface->vlanparent = parent->index;
+	iface->vlantag = req->ifcr_vlantag;
+	return (0);
+}
+
+/*
+ * if_bridge(4) requests, with its errors: members are attached to one
+ * bridge at a time, and only to a bridge.
+ */
+static int
+sim_bridge(ifconfig_sim_t *sim, struct sim_iface *iface,
+    unsigned long request, struct ifconfig_req *req)
+{
+	struct sim_iface *member;
+	size_t count, max;
+
+	if (strcmp(iface->kind, "bridge") != 0 ||
+	    (request == SIOCGDRVSPEC) != (req->ifcr_drvcmd == BRDGGIFS)) {
+		return (EINVAL);
+	}
+
+	switch (req->ifcr_drvcmd) {
+	case BRDGADD:
+		if ((member = sim_byname(sim, req->ifcr_member)) == NULL) {
+			return (ENOENT);
+		}
+		if (member == iface) {
+			return (EINVAL);
+		}
+		if (member->master == iface->index) {
+			return (EEXIST);
+		}
+		if (member->master != 0) {
+			return (EBUSY);
+		}
+		member->master = iface->index;
+		iface->nmembers++;
+		break;
+	case BRDGDEL:
+		if ((member = sim_byname(sim, req->ifcr_member)) == NULL ||
+		    member->master != iface->index) {
+			return (ENOENT);
+		}
+		member->master = 0;
+		iface->nmembers--;
+		break;
+	case BRDGGIFS:
+		count = 0;
+		max = req->ifcr_buffer.length / IFNAMSIZ;
+		for (size_t i = 0; count < iface->nmembers &&
+		    i < sim->nifaces; i++) {
+			if (sim->ifaces[i].master != iface->index) {
+				continue;
+			}
+			if (count < max) {
+				memcpy((char *)req->ifcr_buffer.buffer +
+				    count * IFNAMSIZ, sim->ifaces[i].name,
+				    IFNAMSIZ);
+			}
+			count++;
+		}
+		req->ifcr_buffer.length = count * IFNAMSIZ;
+		return (0);
+	default:
+		return (EINVAL);
+	}
+
+	sim_notify(sim, IFCONFIG_LINKEV_NEW, member);
+	return (0);
+}
+
+static int
+sim_getdescr(const struct sim_iface *iface, struct ifconfig_req *req)
+{
+	size_t len;
+
+	if (iface->descr == NULL) {
+		if (req->ifcr_buffer.length > 0) {
+			((char *)req->ifcr_buffer.buffer)[0] = '\0';
+		}
+		return (0);
+	}
+	len = strlen(iface->descr) + 1;
+	if (len > req->ifcr_buffer.length) {
+		/* As FreeBSD: report the size needed. */
+		req->ifcr_buffer.buffer = NULL;
+		req->ifcr_buffer.length = len;
+		return (0);
+	}
+	memcpy(req->ifcr_buffer.buffer, iface->descr, len);
+	return (0);
+}
+
+static int
+sim_setdescr(struct sim_iface *iface, const struct ifconfig_req *req)
+{
+	char *descr;
+
+	if (req->ifcr_buffer.length == 0) {
+		free(iface->descr);
+		iface->descr = NULL;
+		return (0);
+	}
+	if (req->ifcr_buffer.length > SIM_DESCR_MAXLEN) {
+		return (ENAMETOOLONG);
+	}
+	descr = strndup(req->ifcr_buffer.buffer, req->ifcr_buffer.length - 1);
+	if (descr == NULL) {
+		return (ENOMEM);
+	}
+	free(iface->descr);
+	iface->descr = descr;
+	if (descr[0] == '\0') {
+		free(descr);
+		iface->descr = NULL;
+	}
+	return (0);
+}
+
+static int
+sim_setname(ifconfig_sim_t *sim, struct sim_iface *iface,
+    const struct ifconfig_req *req)
+{
+
+	if (req->ifcr_newname[0] == '\0' ||
+	    strnlen(req->ifcr_newname, IFNAMSIZ) == IFNAMSIZ) {
+		return (EINVAL);
+	}
+	if (sim_byname(sim, req->ifcr_newname) != NULL) {
+		return (EEXIST);
+	}
+	sim_hashremove(sim, iface->name);
+	(void)strlcpy(iface->name, req->ifcr_newname, sizeof(iface->name));
+	sim_hashinsert(sim, iface);
+	return (0);
+}
+
+static struct ifconfig_addr *
+sim_findaddr(struct sim_iface *iface, const struct ifconfig_addr *addr)
+{
+	size_t len;
+
+	len = (addr->family == AF_INET) ? sizeof(addr->addr.in) :
+	    sizeof(addr->addr.in6);
+	for (size_t i = 0; i < iface->naddrs; i++) {
+		if (iface->addrs[i].family == addr->family &&
+		    memcmp(&iface->addrs[i].addr, &addr->addr, len) == 0) {
+			return (&iface->addrs[i]);
+		}
+	}
+	return (NULL);
+}
+
+/* As SIOCAIFADDR, adding an address that exists updates its prefix. */
+static int
+sim_addaddr(struct sim_iface *iface, const struct ifconfig_req *req)
+{
+	const struct ifconfig_addr *addr;
+	struct ifconfig_addr *found, *tmp;
+
+	addr = &req->ifcr_addr;
+	if ((found = sim_findaddr(iface, addr)) != NULL) {
+		found->prefixlen = addr->prefixlen;
+		return (0);
+	}
+	if (iface->naddrs == iface->addrsize) {
+		size_t newsize = (iface->addrsize == 0) ? 4 :
+		    iface->addrsize * 2;
+
+		tmp = reallocarray(iface->addrs, newsize, sizeof(*tmp));
+		if (tmp == NULL) {
+			return (ENOMEM);
+		}
+		iface->addrs = tmp;
+		iface->addrsize = newsize;
+	}
+	iface->addrs[iface->naddrs++] = *addr;
+	return (0);
+}
+
+static int
+sim_deladdr(struct sim_iface *iface, const struct ifconfig_req *req)
+{
+	struct ifconfig_addr *found;
+
+	if ((found = sim_findaddr(iface, &req->ifcr_addr)) == NULL) {
+		return (EADDRNOTAVAIL);
+	}
+	*found = iface->addrs[--iface->naddrs];
+	return (0);
+}
+
+static int
+sim_request(ifconfig_sim_t *sim, unsigned long request,
+    struct ifconfig_req *req)
+{
+	struct sim_iface *iface;
+	int error;
+
+	if ((error = sim_enter(sim, request)) != 0) {
+		return (error);
+	}
+
+	if (request == SIOCIFCREATE2) {
+		if (req->ifcr_vlanparent[0] != '\0') {
+			if (sim_byname(sim, req->ifcr_vlanparent) == NULL) {
+				return (ENXIO);
+			}
+			if (req->ifcr_vlantag == 0 ||
+			    req->ifcr_vlantag >= 4095) {
+				return (EINVAL);
+			}
+		}
+		error = sim_create(sim, req->ifcr_name,
+		    req->ifcr_vlanparent[0] != '\0');
+		if (error == 0 && req->ifcr_vlanparent[0] != '\0') {
+			error = sim_setvlan(sim,
+			    sim_byname(sim, req->ifcr_name), req);
+		}
+		return (error);
+	}
+
+	if ((iface = sim_byname(sim, req->ifcr_name)) == NULL) {
+		return (ENXIO);
+	}
+
+	switch (request) {
+	case SIOCGIFMTU:
+		req->ifcr_mtu = iface->mtu;
+		return (0);
+	case SIOCSIFMTU:
+		if (req->ifcr_mtu < SIM_MTU_MIN ||
+		    req->ifcr_mtu > SIM_MTU_MAX) {
+			return (EINVAL);
+		}
+		iface->mtu = req->ifcr_mtu;
+		break;
+	case SIOCGIFMETRIC:
+		req->ifcr_metric = iface->metric;
+		return (0);
+	case SIOCSIFMETRIC:
+		iface->metric = req->ifcr_metric;
+		break;
+	case SIOCGIFCAP:
+		req->ifcr_curcap = iface->curcap;
+		req->ifcr_reqcap = SIM_CAPS;
+		return (0);
+	case SIOCSIFCAP:
+		if ((req->ifcr_reqcap & ~SIM_CAPS) != 0) {
+			return (EINVAL);
+		}
+		iface->curcap = req->ifcr_reqcap;
+		return (0);
+	case SIOCGIFDESCR:
+		return (sim_getdescr(iface, req));
+	case SIOCSIFDESCR:
+		return (sim_setdescr(iface, req));
+	case SIOCSIFNAME:
+		if ((error = sim_setname(sim, iface, req)) != 0) {
+			return (error);
+		}
+		break;
+	case SIOCSETVLAN:
+		return (sim_setvlan(sim, iface, req));
+	case SIOCSDRVSPEC:
+	case SIOCGDRVSPEC:
+		return (sim_bridge(sim, iface, request, req));
+	case SIOCIFDESTROY:
+		sim_destroy(sim, iface);
+		return (0);
+	case SIOCAIFADDR:
+	case SIOCAIFADDR_IN6:
+		return (sim_addaddr(iface, req));
+	case SIOCDIFADDR:
+	case SIOCDIFADDR_IN6:
+		return (sim_deladdr(iface, req));
+	default:
+		return (EOPNOTSUPP);
+	}
+
+	sim_notify(sim, IFCONFIG_LINKEV_NEW, iface);
+	return (0);
+}
+
+static int
+sim_ioctl(ifconfig_handle_t *h, const int addressfamily __unused,
+    unsigned long request, struct ifconfig_req *req)
+{
+	ifconfig_sim_t *sim;
+	int error;
+
+	sim = h->backend_data;
+	sim_delay(sim);
+	(void)pthread_mutex_lock(&sim->lock);
+	error = sim_request(sim, request, req);
+	(void)pthread_mutex_unlock(&sim->lock);
+	if (error != 0) {
+		errno = error;
+		ifconfig_ioctlerr(h, request);
+		return (-1);
+	}
+	return (0);
+}
+
+static void
+sim_tolink(const struct sim_iface *iface, struct ifconfig_link *link)
+{
+
+	memset(link, 0, sizeof(*link));
+	link->index = iface->index;
+	link->flags = iface->flags;
+	link->mtu = iface->mtu;
+	link->metric = iface->metric;
+	link->name = iface->name;
+	link->namelen = strlen(iface->name);
+	link->parent = iface->vlanparent;
+	link->master = iface->master;
+	link->has_vlan = 1;
+	link->vlantag = iface->vlantag;
+	link->has_kind = 1;
+	link->kind = iface->kind;
+	link->kindlen = strlen(iface->kind);
+	link->has_description = 1;
+	link->description = iface->descr;
+	link->descriptionlen = (iface->descr == NULL) ? 0 :
+	    strlen(iface->descr);
+}
+
+/*
+ * The callback runs with the simulator locked, like a kernel dump that
+ * is consistent; it must not make requests.
+ */
+static int
+sim_iflist(ifconfig_handle_t *h, ifconfig_iflist_cb_t *cb, void *udata)
+{
+	struct ifconfig_link link;
+	ifconfig_sim_t *sim;
+	int error;
+
+	sim = h->backend_data;
+	sim_delay(sim);
+	(void)pthread_mutex_lock(&sim->lock);
+	if ((error = sim_enter(sim, IFCONFIG_STAT_IFLIST)) != 0) {
+		(void)pthread_mutex_unlock(&sim->lock);
+		ifconfig_errstate(h)->errtype = OTHER;
+		ifconfig_errstate(h)->errcode = error;
+		return (-1);
+	}
+	for (size_t i = 0; i < sim->nifaces; i++) {
+		if (sim->ifaces[i].index == 0) {
+			continue;
+		}
+		sim_tolink(&sim->ifaces[i], &link);
+		if ((error = cb(h, &link, udata)) != 0) {
+			break;
+		}
+	}
+	(void)pthread_mutex_unlock(&sim->lock);
+	return (error);
+}
+
+static int
+sim_addrlist(ifconfig_handle_t *h, const unsigned int ifindex,
+    ifconfig_addrlist_cb_t *cb, void *udata)
+{
+	struct sim_iface *iface;
+	ifconfig_sim_t *sim;
+	int error;
+
+	sim = h->backend_data;
+	sim_delay(sim);
+	(void)pthread_mutex_lock(&sim->lock);
+	if ((error = sim_enter(sim, IFCONFIG_STAT_ADDRLIST)) == 0 &&
+	    (iface = sim_byindex(sim, ifindex)) == NULL) {
+		error = ENOENT;
+	}
+	if (error != 0) {
+		(void)pthread_mutex_unlock(&sim->lock);
+		ifconfig_errstate(h)->errtype = OTHER;
+		ifconfig_errstate(h)->errcode = error;
+		return (-1);
+	}
+	for (size_t i = 0; i < iface->naddrs; i++) {
+		if ((error = cb(h, &iface->addrs[i], udata)) != 0) {
+			break;
+		}
+	}
+	(void)pthread_mutex_unlock(&sim->lock);
+	return (error);
+}
+
+static int
+sim_counters(ifconfig_handle_t *h, struct ifconfig_counters *c)
+{
+	struct ifconfig_ifcounters *ifc;
+	ifconfig_sim_t *sim;
+	int error;
+
+	sim = h->backend_data;
+	sim_delay(sim);
+	(void)pthread_mutex_lock(&sim->lock);
+	if ((error = sim_enter(sim, IFCONFIG_STAT_COUNTERS)) != 0) {
+		(void)pthread_mutex_unlock(&sim->lock);
+		ifconfig_errstate(h)->errtype = OTHER;
+		ifconfig_errstate(h)->errcode = error;
+		return (-1);
+	}
+	for (size_t i = 0; i < sim->nifaces; i++) {
+		if (sim->ifaces[i].index == 0) {
+			continue;
+		}
+		if ((ifc = ifconfig_counters_next(h, c)) == NULL) {
+			error = -1;
+			break;
+		}
+		*ifc = sim->ifaces[i].counters;
+		ifc->index = sim->ifaces[i].index;
+		memcpy(ifc->name, sim->ifaces[i].name, sizeof(ifc->name));
+	}
+	(void)pthread_mutex_unlock(&sim->lock);
+	return (error);
+}
+
+static int
+sim_drivername(ifconfig_handle_t *h, const unsigned int ifindex,
+    char *buf, size_t len)
+{
+	struct sim_iface *iface;
+	ifconfig_sim_t *sim;
+	int error;
+
+	sim = h->backend_data;
+	sim_delay(sim);
+	(void)pthread_mutex_lock(&sim->lock);
+	if ((error = sim_enter(sim, IFCONFIG_STAT_DRIVERNAME)) == 0) {
+		if ((iface = sim_byindex(sim, ifindex)) == NULL) {
+			error = ENOENT;
+		} else if (strlcpy(buf, iface->kind, len) >= len) {
+			error = ERANGE;
+		}
+	}
+	(void)pthread_mutex_unlock(&sim->lock);
+	if (error != 0) {
+		ifconfig_errstate(h)->errtype = OTHER;
+		ifconfig_errstate(h)->errcode = error;
+		return (-1);
+	}
+	return (0);
+}
+
+static int
+sim_linkev_open(ifconfig_handle_t *h, int *fd)
+{
+	struct sim_listener *l, *listeners;
+	ifconfig_sim_t *sim;
+	int sv[2];
+
+	sim = h->backend_data;
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0,
+	    sv) != 0) {
+		ifconfig_errstate(h)->errtype = SOCKET;
+		ifconfig_errstate(h)->errcode = errno;
+		return (-1);
+	}
+
+	(void)pthread_mutex_lock(&sim->lock);
+	/* A listener with the same descriptor must have been closed. */
+	for (size_t i = 0; i < sim->nlisteners; i++) {
+		if (sim->listeners[i].rfd == sv[0]) {
+			sim_listener_free(&sim->listeners[i]);
+			sim->listeners[i] = sim->listeners[--sim->nlisteners];
+			break;
+		}
+	}
+	listeners = reallocarray(sim->listeners, sim->nlisteners + 1,
+	    sizeof(*listeners));
+	if (listeners == NULL) {
+		(void)pthread_mutex_unlock(&sim->lock);
+		(void)close(sv[0]);
+		(void)close(sv[1]);
+		ifconfig_errstate(h)->errtype = OTHER;
+		ifconfig_errstate(h)->errcode = ENOMEM;
+		return (-1);
+	}
+	sim->listeners = listeners;
+	l = &listeners[sim->nlisteners++];
+	memset(l, 0, sizeof(*l));
+	l->rfd = sv[0];
+	l->wfd = sv[1];
+	(void)pthread_mutex_unlock(&sim->lock);
+
+	*fd = sv[0];
+	return (0);
+}
+
+/*
+ * Takes the oldest notification queued for the listener on fd. Returns 1
+ * if there was one, 0 if not and -1 if fd isn't a listener.
+ */
+static int
+sim_pop(ifconfig_sim_t *sim, const int fd, struct sim_event *ev)
+{
+	struct sim_listener *l;
+	int found;
+
+	found = -1;
+	(void)pthread_mutex_lock(&sim->lock);
+	for (size_t i = 0; i < sim->nlisteners; i++) {
+		l = &sim->listeners[i];
+		if (l->rfd != fd) {
+			continue;
+		}
+		found = 0;
+		if (l->lost) {
+			l->lost = 0;
+			memset(ev, 0, sizeof(*ev));
+			ev->type = IFCONFIG_LINKEV_LOST;
+			found = 1;
+		} else if (l->count > 0) {
+			*ev = l->queue[l->head];
+			l->head = (l->head + 1) % l->size;
+			l->count--;
+			found = 1;
+		}
+		break;
+	}
+	(void)pthread_mutex_unlock(&sim->lock);
+	return (found);
+}
+
+/* Callbacks run unlocked, as they may make requests of their own. */
+static int
+sim_linkev_read(ifconfig_handle_t *h, const int fd,
+    ifconfig_linkev_cb_t *cb, void *udata)
+{
+	char buf[64];
+	struct ifconfig_link link;
+	struct sim_event ev;
+	int error, found;
+
+	while (recv(fd, buf, sizeof(buf), 0) > 0) {
+		continue;
+	}
+
+	while ((found = sim_pop(h->backend_data, fd, &ev)) > 0) {
+		memset(&link, 0, sizeof(link));
+		link.index = ev.index;
+		link.flags = ev.flags;
+		link.mtu = ev.mtu;
+		link.metric = ev.metric;
+		if (ev.type != IFCONFIG_LINKEV_LOST) {
+			link.name = ev.name;
+			link.namelen = strlen(ev.name);
+		}
+		if ((error = cb(h, ev.type, &link, udata)) != 0) {
+			return (error);
+		}
+	}
+	if (found < 0) {
+		ifconfig_errstate(h)->errtype = SOCKET;
+		ifconfig_errstate(h)->errcode = EBADF;
+		return (-1);
+	}
+	return (0);
+}
+
+const struct ifconfig_backend ifconfig_backend_sim = {
+	.name = "sim",
+	.ioctl = sim_ioctl,
+	.iflist = sim_iflist,
+	.addrlist = sim_addrlist,
+	.counters = sim_counters,
+	.drivername = sim_drivername,
+	.linkev_open = sim_linkev_open,
+	.linkev_read = sim_linkev_read,
+};
+
+ifconfig_sim_t *
+ifconfig_sim_new(void)
+{
+	ifconfig_sim_t *sim;
+	char name[IFNAMSIZ] = "lo0";
+	struct sim_iface *lo;
+
+	if ((sim = calloc(1, sizeof(*sim))) == NULL) {
+		return (NULL);
+	}
+	(void)pthread_mutex_init(&sim->lock, NULL);
+	sim->size = 64;
+	sim->mask = sim->size * 2 - 1;
+	sim->ifaces = calloc(sim->size, sizeof(*sim->ifaces));
+	sim->byname = calloc(sim->mask + 1, sizeof(*sim->byname));
+	if (sim->ifaces == NULL || sim->byname == NULL ||
+	    sim_create(sim, name, 0) != 0) {
+		ifconfig_sim_free(sim);
+		return (NULL);
+	}
+
+	lo = &sim->ifaces[0];
+	lo->flags = IFF_UP | IFF_LOOPBACK | IFF_MULTICAST | IFF_RUNNING;
+	lo->mtu = 16384;
+	return (sim);
+}
+
+void
+ifconfig_sim_free(ifconfig_sim_t *sim)
+{
+
+	if (sim == NULL) {
+		return;
+	}
+	for (size_t i = 0; i < sim->nifaces; i++) {
+		free(sim->ifaces[i].descr);
+		free(sim->ifaces[i].addrs);
+	}
+	for (size_t i = 0; i < sim->nlisteners; i++) {
+		sim_listener_free(&sim->listeners[i]);
+	}
+	(void)pthread_mutex_destroy(&sim->lock);
+	free(sim->ifaces);
+	free(sim->byname);
+	free(sim->units);
+	free(sim->listeners);
+	free(sim);
+}
+
+int
+ifconfig_sim_attach(ifconfig_handle_t *h, ifconfig_sim_t *sim)
+{
+
+	if (h->ifcache.fd != -1 || h->attrcache.enabled ||
+	    h->attrcache.notify) {
+		ifconfig_errstate(h)->errtype = OTHER;
+		ifconfig_errstate(h)->errcode = EBUSY;
+		return (-1);
+	}
+	h->backend = &ifconfig_backend_sim;
+	h->backend_data = sim;
+	return (0);
+}
+
+int
+ifconfig_sim_populate(ifconfig_sim_t *sim, const char *kind, size_t n)
+{
+	char name[IFNAMSIZ];
+	int error;
+
+	error = 0;
+	(void)pthread_mutex_lock(&sim->lock);
+	for (size_t i = 0; i < n && error == 0; i++) {
+		(void)strlcpy(name, kind, sizeof(name));
+		error = sim_create(sim, name, 0);
+	}
+	(void)pthread_mutex_unlock(&sim->lock);
+	if (error != 0) {
+		errno = error;
+		return (-1);
+	}
+	return (0);
+}
+
+size_t
+ifconfig_sim_count(ifconfig_sim_t *sim)
+{
+	size_t count;
+
+	(void)pthread_mutex_lock(&sim->lock);
+	count = sim->live;
+	(void)pthread_mutex_unlock(&sim->lock);
+	return (count);
+}
+
+void
+ifconfig_sim_set_latency(ifconfig_sim_t *sim, const uint64_t ns)
+{
+
+	__atomic_store_n(&sim->latency_ns, ns, __ATOMIC_RELAXED);
+}
+
+int
+ifconfig_sim_set_counters(ifconfig_sim_t *sim, const char *name,
+    const struct ifconfig_ifcounters *counters)
+{
+	struct sim_iface *iface;
+
+	(void)pthread_mutex_lock(&sim->lock);
+	if ((iface = sim_byname(sim, name)) != NULL) {
+		iface->counters = *counters;
+	}
+	(void)pthread_mutex_unlock(&sim->lock);
+	if (iface == NULL) {
+		errno = ENXIO;
+		return (-1);
+	}
+	return (0);
+}
+
+int
+ifconfig_sim_add_fault(ifconfig_sim_t *sim, const unsigned long request,
+    const int errcode, const unsigned int every)
+{
+	int error;
+
+	if (errcode == 0 || every == 0) {
+		errno = EINVAL;
+		return (-1);
+	}
+	error = 0;
+	(void)pthread_mutex_lock(&sim->lock);
+	if (sim->nfaults == SIM_FAULTS_MAX) {
+		error = ENOSPC;
+	} else {
+		sim->faults[sim->nfaults++] = (struct sim_fault){
+			.request = request,
+			.errcode = errcode,
+			.every = every,
+		};
+	}
+	(void)pthread_mutex_unlock(&sim->lock);
+	if (error != 0) {
+		errno = error;
+		return (-1);
+	}
+	return (0);
+}
+
+void
+ifconfig_sim_clear_faults(ifconfig_sim_t *sim)
+{
+
+	(void)pthread_mutex_lock(&sim->lock);
+	sim->nfaults = 0;
+	(void)pthread_mutex_unlock(&sim->lock);
+}
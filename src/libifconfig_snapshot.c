@@ -0,0 +1,349 @@
+/*
+ * Copyright (c) 2016-2017, Marie Helene Kvello-Aune
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * thislist of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#include <sys/types.h>
+
+#include <net/if.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libifconfig.h"
+#include "libifconfig_internal.h"
+
+#define NOSTR    ((size_t)-1)
+
+struct ifconfig_snapshot_iface {
+	unsigned int index;
+	int flags;
+	int mtu;
+	int metric;
+	int has_cap;
+	int has_description;
+	struct ifconfig_capabilities cap;
+
+	/* Offsets into the snapshot string table, or NOSTR. */
+	size_t name;
+	size_t description;
+	size_t orig_name;
+
+	/* Back pointer so accessors only need the entry. */
+	const struct ifconfig_snapshot *snap;
+};
+
+struct ifconfig_snapshot {
+	struct ifconfig_snapshot_iface *ifaces;
+	size_t count;
+	size_t size;
+	char *strtab;
+	size_t strtablen;
+	size_t strtabsize;
+};
+
+/*
+ * Appends a string to the snapshot string table. Returns its offset, or
+ * NOSTR if memory couldn't be allocated.
+ */
+static size_t
+snapshot_addstr(struct ifconfig_snapshot *snap, const char *str, size_t len)
+{
+	size_t off;
+	char *tmp;
+
+	if (snap->strtablen + len + 1 > snap->strtabsize) {
+		size_t newsize = snap->strtabsize * 2;
+
+		while (newsize < snap->strtablen + len + 1) {
+			newsize *= 2;
+		}
+		tmp = realloc(snap->strtab, newsize);
+		if (tmp == NULL) {
+			return (NOSTR);
+		}
+		snap->strtab = tmp;
+		snap->strtabsize = newsize;
+	}
+
+	off = snap->strtablen;
+	memcpy(snap->strtab + off, str, len);
+	snap->strtab[off + len] = '\0';
+	snap->strtablen += len + 1;
+	return (off);
+}
+
+static int
+snapshot_add_link(ifconfig_handle_t *h, const struct ifconfig_link *link,
+    void *udata)
+{
+	struct ifconfig_snapshot *snap;
+	struct ifconfig_snapshot_iface *iface, *tmp;
+
+	snap = udata;
+	if (snap->count == snap->size) {
+		tmp = reallocarray(snap->ifaces, snap->size * 2,
+		    sizeof(*snap->ifaces));
+		if (tmp == NULL) {
+			goto nomem;
+		}
+		snap->ifaces = tmp;
+		snap->size *= 2;
+	}
+
+	iface = &snap->ifaces[snap->count];
+	memset(iface, 0, sizeof(*iface));
+	iface->snap = snap;
+	iface->index = link->index;
+	iface->flags = link->flags;
+	iface->mtu = link->mtu;
+	iface->metric = link->metric;
+	iface->description = NOSTR;
+	iface->orig_name = NOSTR;
+	iface->name = snapshot_addstr(snap, link->name, link->namelen);
+	if (iface->name == NOSTR) {
+		goto nomem;
+	}
+	if (link->description != NULL) {
+		iface->description = snapshot_addstr(snap, link->description,
+		    link->descriptionlen);
+		if (iface->description == NOSTR) {
+			goto nomem;
+		}
+	}
+	iface->has_description = link->has_description;
+	snap->count++;
+	return (0);
+
+nomem:
+	ifconfig_errstate(h)->errtype = OTHER;
+	ifconfig_errstate(h)->errcode = ENOMEM;
+	return (-1);
+}
+
+/*
+ * Collects the attributes that aren't part of the interface list. These
+ * require one request per interface, but avoid the name to index
+ * translation the single-interface getters do.
+ */
+static int
+snapshot_gather_extra(ifconfig_handle_t *h, struct ifconfig_snapshot *snap,
+    const int flags)
+{
+	struct ifconfig_snapshot_iface *iface;
+	const char *descr;
+	char buf[128], *str;
+
+	for (size_t i = 0; i < snap->count; i++) {
+		iface = &snap->ifaces[i];
+
+		if ((flags & IFCONFIG_SNAP_CAPABILITY) &&
+		    ifconfig_get_capability(h, snap->strtab + iface->name,
+		    &iface->cap) == 0) {
+			iface->has_cap = 1;
+		}
+
+		if ((flags & IFCONFIG_SNAP_DESCRIPTION) &&
+		    !iface->has_description) {
+			descr = str = NULL;
+			if (ifconfig_get_description_r(h,
+			    snap->strtab + iface->name, buf,
+			    sizeof(buf)) == 0) {
+				descr = buf;
+			} else if (ifconfig_err_errno(h) == ERANGE &&
+			    ifconfig_get_description(h,
+			    snap->strtab + iface->name, &str) == 0) {
+				descr = str;
+			}
+			if (descr != NULL) {
+				iface->description = snapshot_addstr(snap,
+				    descr, strlen(descr));
+				free(str);
+				if (iface->description == NOSTR) {
+					return (-1);
+				}
+			}
+		}
+
+		if ((flags & IFCONFIG_SNAP_ORIG_NAME) &&
+		    ifconfig_get_drivername(h, iface->index, buf,
+		    sizeof(buf)) == 0) {
+			iface->orig_name = snapshot_addstr(snap, buf,
+			    strlen(buf));
+			if (iface->orig_name == NOSTR) {
+				return (-1);
+			}
+		}
+	}
+	return (0);
+}
+
+int
+ifconfig_snapshot_take(ifconfig_handle_t *h, const int flags,
+    ifconfig_snapshot_t **snapp)
+{
+	struct ifconfig_snapshot *snap;
+
+	snap = calloc(1, sizeof(*snap));
+	if (snap == NULL) {
+		goto nomem;
+	}
+
+	snap->size = 64;
+	snap->ifaces = calloc(snap->size, sizeof(*snap->ifaces));
+	snap->strtabsize = snap->size * IFNAMSIZ;
+	snap->strtab = malloc(snap->strtabsize);
+	if (snap->ifaces == NULL || snap->strtab == NULL) {
+		goto nomem;
+	}
+
+	if (ifconfig_iflist(h, snapshot_add_link, snap) != 0) {
+		ifconfig_snapshot_free(snap);
+		return (-1);
+	}
+
+	if (snapshot_gather_extra(h, snap, flags) != 0) {
+		goto nomem;
+	}
+
+	*snapp = snap;
+	return (0);
+
+nomem:
+	ifconfig_snapshot_free(snap);
+	ifconfig_errstate(h)->errtype = OTHER;
+	ifconfig_errstate(h)->errcode = ENOMEM;
+	return (-1);
+}
+
+void
+ifconfig_snapshot_free(ifconfig_snapshot_t *snap)
+{
+
+	if (snap == NULL) {
+		return;
+	}
+	free(snap->ifaces);
+	free(snap->strtab);
+	free(snap);
+}
+
+size_t
+ifconfig_snapshot_count(const ifconfig_snapshot_t *snap)
+{
+
+	return (snap->count);
+}
+
+const ifconfig_snapshot_iface_t *
+ifconfig_snapshot_at(const ifconfig_snapshot_t *snap, size_t i)
+{
+
+	if (i >= snap->count) {
+		return (NULL);
+	}
+	return (&snap->ifaces[i]);
+}
+
+const ifconfig_snapshot_iface_t *
+ifconfig_snapshot_find(const ifconfig_snapshot_t *snap, const char *name)
+{
+
+	for (size_t i = 0; i < snap->count; i++) {
+		if (strcmp(snap->strtab + snap->ifaces[i].name, name) == 0) {
+			return (&snap->ifaces[i]);
+		}
+	}
+	return (NULL);
+}
+
+const char *
+ifconfig_snapshot_iface_name(const ifconfig_snapshot_iface_t *iface)
+{
+
+	return (iface->snap->strtab + iface->name);
+}
+
+unsigned int
+ifconfig_snapshot_iface_index(const ifconfig_snapshot_iface_t *iface)
+{
+
+	return (iface->index);
+}
+
+int
+ifconfig_snapshot_iface_flags(const ifconfig_snapshot_iface_t *iface)
+{
+
+	return (iface->flags);
+}
+
+int
+ifconfig_snapshot_iface_mtu(const ifconfig_snapshot_iface_t *iface)
+{
+
+	return (iface->mtu);
+}
+
+int
+ifconfig_snapshot_iface_metric(const ifconfig_snapshot_iface_t *iface)
+{
+
+	return (iface->metric);
+}
+
+int
+ifconfig_snapshot_iface_capability(const ifconfig_snapshot_iface_t *iface,
+    struct ifconfig_capabilities *capability)
+{
+
+	if (!iface->has_cap) {
+		return (-1);
+	}
+	*capability = iface->cap;
+	return (0);
+}
+
+const char *
+ifconfig_snapshot_iface_description(const ifconfig_snapshot_iface_t *iface)
+{
+
+	if (iface->description == NOSTR) {
+		return (NULL);
+	}
+	return (iface->snap->strtab + iface->description);
+}
+
+const char *
+ifconfig_snapshot_iface_orig_name(const ifconfig_snapshot_iface_t *iface)
+{
+
+	if (iface->orig_name == NOSTR) {
+		return (NULL);
+	}
+	return (iface->snap->strtab + iface->orig_name);
+}
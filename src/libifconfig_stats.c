@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2016-2017, Marie Helene Kvello-Aune
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * thislist of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+
+#include <sys/types.h>
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "libifconfig.h"
+#include "libifconfig_internal.h"
+
+#if IFCONFIG_STATS
+
+static size_t
+stats_hash(const unsigned long request)
+{
+
+	return ((uint32_t)(request ^ (request >> 16)) * 2654435761u);
+}
+
+/*
+ * Finds or claims the slot of a request code. Returns NULL if the table
+ * is full; such requests go uncounted.
+ */
+static struct ifconfig_stat *
+stats_slot(ifconfig_handle_t *h, const unsigned long request)
+{
+	struct ifconfig_stat *st;
+	unsigned long expected;
+	size_t slot;
+
+	slot = stats_hash(request) & (IFCONFIG_STATS_MAX - 1);
+	for (size_t i = 0; i < IFCONFIG_STATS_MAX; i++) {
+		st = &h->stats[(slot + i) & (IFCONFIG_STATS_MAX - 1)];
+		expected = __atomic_load_n(&st->request, __ATOMIC_ACQUIRE);
+		if (expected == 0 && __atomic_compare_exchange_n(&st->request,
+		    &expected, request, 0, __ATOMIC_ACQ_REL,
+		    __ATOMIC_ACQUIRE)) {
+			return (st);
+		}
+		if (expected == request) {
+			return (st);
+		}
+	}
+	return (NULL);
+}
+
+void
+ifconfig_stats_add(ifconfig_handle_t *h, const unsigned long request,
+    const uint64_t start, const int error)
+{
+	struct ifconfig_stat *st;
+	uint64_t elapsed, max;
+
+	elapsed = ifconfig_stats_start() - start;
+	if ((st = stats_slot(h, request)) == NULL) {
+		return;
+	}
+
+	(void)__atomic_add_fetch(&st->calls, 1, __ATOMIC_RELAXED);
+	if (error != 0) {
+		(void)__atomic_add_fetch(&st->errors, 1, __ATOMIC_RELAXED);
+	}
+	(void)__atomic_add_fetch(&st->total_ns, elapsed, __ATOMIC_RELAXED);
+	max = __atomic_load_n(&st->max_ns, __ATOMIC_RELAXED);
+	while (elapsed > max && !__atomic_compare_exchange_n(&st->max_ns,
+	    &max, elapsed, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+		continue;
+	}
+}
+
+void
+ifconfig_stats_merge(ifconfig_handle_t *h, ifconfig_handle_t *from)
+{
+	struct ifconfig_stat *src, *st;
+	uint64_t max;
+
+	for (size_t i = 0; i < IFCONFIG_STATS_MAX; i++) {
+		src = &from->stats[i];
+		if (src->request == 0 ||
+		    (st = stats_slot(h, src->request)) == NULL) {
+			continue;
+		}
+		(void)__atomic_add_fetch(&st->calls, src->calls,
+		    __ATOMIC_RELAXED);
+		(void)__atomic_add_fetch(&st->errors, src->errors,
+		    __ATOMIC_RELAXED);
+		(void)__atomic_add_fetch(&st->total_ns, src->total_ns,
+		    __ATOMIC_RELAXED);
+		max = __atomic_load_n(&st->max_ns, __ATOMIC_RELAXED);
+		while (src->max_ns > max && !__atomic_compare_exchange_n(
+		    &st->max_ns, &max, src->max_ns, 1, __ATOMIC_RELAXED,
+		    __ATOMIC_RELAXED)) {
+			continue;
+		}
+	}
+}
+
+int
+ifconfig_stats_get(ifconfig_handle_t *h, struct ifconfig_stat *stats,
+    size_t n)
+{
+	struct ifconfig_stat *st;
+	int count;
+
+	count = 0;
+	for (size_t i = 0; i < IFCONFIG_STATS_MAX; i++) {
+		st = &h->stats[i];
+		if (__atomic_load_n(&st->request, __ATOMIC_ACQUIRE) == 0) {
+			continue;
+		}
+		if ((size_t)count < n) {
+			stats[count].request = st->request;
+			stats[count].calls = __atomic_load_n(&st->calls,
+			    __ATOMIC_RELAXED);
+			stats[count].errors = __atomic_load_n(&st->errors,
+			    __ATOMIC_RELAXED);
+			stats[count].total_ns = __atomic_load_n(&st->total_ns,
+			    __ATOMIC_RELAXED);
+			stats[count].max_ns = __atomic_load_n(&st->max_ns,
+			    __ATOMIC_RELAXED);
+		}
+		count++;
+	}
+	return (count);
+}
+
+/*
+ * Requests in flight on other threads sharing the handle may still be
+ * counted after the reset, or lose their slot.
+ */
+void
+ifconfig_stats_reset(ifconfig_handle_t *h)
+{
+
+	memset(h->stats, 0, sizeof(h->stats));
+}
+
+#else /* !IFCONFIG_STATS */
+
+int
+ifconfig_stats_get(ifconfig_handle_t *h, struct ifconfig_stat *stats __unused,
+    size_t n __unused)
+{
+
+	ifconfig_errstate(h)->errtype = OTHER;
+	ifconfig_errstate(h)->errcode = EOPNOTSUPP;
+	return (-1);
+}
+
+void
+ifconfig_stats_merge(ifconfig_handle_t *h __unused,
+    ifconfig_handle_t *from __unused)
+{
+
+}
+
+void
+ifconfig_stats_reset(ifconfig_handle_t *h __unused)
+{
+
+}
+
+#endif /* IFCONFIG_STATS */
@@ -0,0 +1,403 @@
+/*
+ * Copyright (c) 2016-2017, Marie Helene Kvello-Aune
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * thislist of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#include <sys/types.h>
+
+#include <net/if.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libifconfig.h"
+#include "libifconfig_internal.h"
+
+/* Last known state of an interface. */
+struct watch_iface {
+	unsigned int index;
+	int mtu;
+	int flags;
+	char name[IFNAMSIZ];
+
+	/* Changes not yet delivered, and the name before them. */
+	int pending;
+	char oldname[IFNAMSIZ];
+	/* Seen by the current resynchronization. */
+	int seen;
+};
+
+struct ifconfig_watch {
+	ifconfig_handle_t *h;
+	int fd;
+
+	/* Sorted by index; interfaces mostly arrive with increasing ones. */
+	struct watch_iface *ifaces;
+	size_t count;
+	size_t size;
+
+	/* Indexes with pending changes, in the order they first changed. */
+	unsigned int *changed;
+	size_t nchanged;
+	size_t changedsize;
+
+	/* Notifications were dropped; compare against a fresh dump. */
+	int lost;
+	/* Loading the initial state, so nothing counts as a change. */
+	int loading;
+};
+
+/* Position of ifindex, or of where it would be inserted. */
+static size_t
+watch_search(const struct ifconfig_watch *w, const unsigned int ifindex)
+{
+	size_t lo, hi, mid;
+
+	lo = 0;
+	hi = w->count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (w->ifaces[mid].index < ifindex) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return (lo);
+}
+
+static struct watch_iface *
+watch_find(const struct ifconfig_watch *w, const unsigned int ifindex)
+{
+	size_t pos;
+
+	pos = watch_search(w, ifindex);
+	if (pos < w->count && w->ifaces[pos].index == ifindex) {
+		return (&w->ifaces[pos]);
+	}
+	return (NULL);
+}
+
+static struct watch_iface *
+watch_insert(struct ifconfig_watch *w, const unsigned int ifindex)
+{
+	struct watch_iface *ifaces;
+	size_t pos, size;
+
+	if (w->count == w->size) {
+		size = (w->size == 0) ? 64 : w->size * 2;
+		ifaces = reallocarray(w->ifaces, size, sizeof(*ifaces));
+		if (ifaces == NULL) {
+			return (NULL);
+		}
+		w->ifaces = ifaces;
+		w->size = size;
+	}
+
+	pos = watch_search(w, ifindex);
+	memmove(&w->ifaces[pos + 1], &w->ifaces[pos],
+	    (w->count - pos) * sizeof(*w->ifaces));
+	w->count++;
+	memset(&w->ifaces[pos], 0, sizeof(w->ifaces[pos]));
+	w->ifaces[pos].index = ifindex;
+	return (&w->ifaces[pos]);
+}
+
+static void
+watch_remove(struct ifconfig_watch *w, const unsigned int ifindex)
+{
+	size_t pos;
+
+	pos = watch_search(w, ifindex);
+	if (pos < w->count && w->ifaces[pos].index == ifindex) {
+		memmove(&w->ifaces[pos], &w->ifaces[pos + 1],
+		    (w->count - pos - 1) * sizeof(*w->ifaces));
+		w->count--;
+	}
+}
+
+static int
+watch_mark(struct ifconfig_watch *w, struct watch_iface *iface,
+    const int events)
+{
+	unsigned int *changed;
+	size_t size;
+
+	if (w->loading) {
+		return (0);
+	}
+	if (iface->pending == 0) {
+		if (w->nchanged == w->changedsize) {
+			size = (w->changedsize == 0) ? 16 : w->changedsize * 2;
+			changed = reallocarray(w->changed, size,
+			    sizeof(*changed));
+			if (changed == NULL) {
+				return (-1);
+			}
+			w->changed = changed;
+			w->changedsize = size;
+		}
+		w->changed[w->nchanged++] = iface->index;
+		(void)strlcpy(iface->oldname, iface->name,
+		    sizeof(iface->oldname));
+	}
+	iface->pending |= events;
+	return (0);
+}
+
+/*
+ * Folds one notification into the interface's pending changes. A
+ * departure followed by an arrival under the same index is how FreeBSD
+ * announces a rename, so the two cancel out into a possible rename.
+ */
+static int
+watch_linkev(ifconfig_handle_t *h, enum ifconfig_linkev_type type,
+    const struct ifconfig_link *link, void *udata)
+{
+	struct ifconfig_watch *w;
+	struct watch_iface *iface;
+	int events;
+
+	w = udata;
+	if (type == IFCONFIG_LINKEV_LOST) {
+		w->lost = 1;
+		return (0);
+	}
+
+	iface = watch_find(w, link->index);
+	if (type == IFCONFIG_LINKEV_DEL) {
+		if (iface != NULL && watch_mark(w, iface,
+		    IFCONFIG_EVENT_REMOVE) != 0) {
+			goto nomem;
+		}
+		return (0);
+	}
+
+	events = 0;
+	if (iface == NULL) {
+		if (link->name == NULL) {
+			/* Can't describe it yet; its arrival will follow. */
+			return (0);
+		}
+		if ((iface = watch_insert(w, link->index)) == NULL) {
+			goto nomem;
+		}
+		iface->mtu = link->mtu;
+		iface->flags = link->flags;
+		events = IFCONFIG_EVENT_ADD;
+	} else if (iface->pending & IFCONFIG_EVENT_REMOVE) {
+		iface->pending &= ~IFCONFIG_EVENT_REMOVE;
+	}
+
+	if (link->name != NULL && link->namelen < IFNAMSIZ &&
+	    (strncmp(iface->name, link->name, link->namelen) != 0 ||
+	    iface->name[link->namelen] != '\0')) {
+		if (!(events & IFCONFIG_EVENT_ADD)) {
+			events |= IFCONFIG_EVENT_RENAME;
+		}
+		if (watch_mark(w, iface, events) != 0) {
+			goto nomem;
+		}
+		memcpy(iface->name, link->name, link->namelen);
+		iface->name[link->namelen] = '\0';
+		events = 0;
+	}
+	/* Announcements name the interface, the link state comes apart. */
+	if (!link->announce && iface->mtu != link->mtu) {
+		events |= IFCONFIG_EVENT_MTU;
+		iface->mtu = link->mtu;
+	}
+	if (!link->announce && iface->flags != link->flags) {
+		events |= IFCONFIG_EVENT_FLAGS;
+		iface->flags = link->flags;
+	}
+	iface->seen = 1;
+
+	if (events != 0 && watch_mark(w, iface, events) != 0) {
+		goto nomem;
+	}
+	return (0);
+
+nomem:
+	ifconfig_errstate(h)->errtype = OTHER;
+	ifconfig_errstate(h)->errcode = ENOMEM;
+	return (-1);
+}
+
+static int
+watch_load_link(ifconfig_handle_t *h, const struct ifconfig_link *link,
+    void *udata)
+{
+
+	return (watch_linkev(h, IFCONFIG_LINKEV_NEW, link, udata));
+}
+
+/* Diffs the known state against a fresh dump after an overrun. */
+static int
+watch_resync(struct ifconfig_watch *w)
+{
+
+	w->lost = 0;
+	for (size_t i = 0; i < w->count; i++) {
+		w->ifaces[i].seen = 0;
+	}
+	if (ifconfig_iflist(w->h, watch_load_link, w) != 0) {
+		return (-1);
+	}
+	for (size_t i = 0; i < w->count; i++) {
+		if (!w->ifaces[i].seen &&
+		    watch_mark(w, &w->ifaces[i], IFCONFIG_EVENT_REMOVE) != 0) {
+			ifconfig_errstate(w->h)->errtype = OTHER;
+			ifconfig_errstate(w->h)->errcode = ENOMEM;
+			return (-1);
+		}
+	}
+	return (0);
+}
+
+int
+ifconfig_watch_open(ifconfig_handle_t *h, ifconfig_watch_t **wp)
+{
+	struct ifconfig_watch *w;
+
+	if (h->backend->linkev_open == NULL) {
+		ifconfig_errstate(h)->errtype = OTHER;
+		ifconfig_errstate(h)->errcode = EOPNOTSUPP;
+		return (-1);
+	}
+
+	w = calloc(1, sizeof(*w));
+	if (w == NULL) {
+		ifconfig_errstate(h)->errtype = OTHER;
+		ifconfig_errstate(h)->errcode = ENOMEM;
+		return (-1);
+	}
+	w->h = h;
+
+	/* Subscribe first, so nothing is missed while loading. */
+	if (h->backend->linkev_open(h, &w->fd) != 0) {
+		free(w);
+		return (-1);
+	}
+	w->loading = 1;
+	if (ifconfig_iflist(h, watch_load_link, w) != 0) {
+		ifconfig_watch_close(w);
+		return (-1);
+	}
+	w->loading = 0;
+
+	*wp = w;
+	return (0);
+}
+
+void
+ifconfig_watch_close(ifconfig_watch_t *w)
+{
+
+	if (w == NULL) {
+		return;
+	}
+	(void)close(w->fd);
+	free(w->ifaces);
+	free(w->changed);
+	free(w);
+}
+
+int
+ifconfig_watch_fd(const ifconfig_watch_t *w)
+{
+
+	return (w->fd);
+}
+
+int
+ifconfig_watch_dispatch(ifconfig_watch_t *w, ifconfig_watch_cb_t *cb,
+    void *udata)
+{
+	struct ifconfig_event ev;
+	struct watch_iface *iface;
+	size_t i;
+	int delivered, error;
+
+	if (w->h->backend->linkev_read(w->h, w->fd, watch_linkev, w) != 0 ||
+	    (w->lost && watch_resync(w) != 0)) {
+		return (-1);
+	}
+
+	delivered = 0;
+	error = 0;
+	for (i = 0; i < w->nchanged && error == 0; i++) {
+		if ((iface = watch_find(w, w->changed[i])) == NULL ||
+		    iface->pending == 0) {
+			continue;
+		}
+
+		/* Came and went before anyone could look. */
+		if ((iface->pending & IFCONFIG_EVENT_ADD) &&
+		    (iface->pending & IFCONFIG_EVENT_REMOVE)) {
+			watch_remove(w, iface->index);
+			continue;
+		}
+
+		memset(&ev, 0, sizeof(ev));
+		ev.events = iface->pending;
+		ev.index = iface->index;
+		ev.name = iface->name;
+		ev.mtu = iface->mtu;
+		ev.flags = iface->flags;
+		if (ev.events & IFCONFIG_EVENT_RENAME) {
+			if (strcmp(iface->oldname, iface->name) == 0) {
+				/* Renamed back; nothing to report there. */
+				ev.events &= ~IFCONFIG_EVENT_RENAME;
+			} else {
+				ev.oldname = iface->oldname;
+			}
+		}
+		iface->pending = 0;
+
+		if (ev.events != 0) {
+			error = cb(&ev, udata);
+			delivered++;
+		}
+		if (ev.events & IFCONFIG_EVENT_REMOVE) {
+			watch_remove(w, ev.index);
+		}
+	}
+
+	/* Whatever the callback didn't get to is delivered next time. */
+	if (i > 0) {
+		memmove(w->changed, w->changed + i,
+		    (w->nchanged - i) * sizeof(*w->changed));
+		w->nchanged -= i;
+	}
+
+	if (error != 0) {
+		return (error);
+	}
+	return (delivered);
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2016-2017, Marie Helene Kvello-Aune
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * thislist of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+
+/*
+ * Tests of the C++ interface in libifconfig.hpp, on the simulator: the
+ * Results it returns, and how it grows its buffer and refuses names.
+ *
+ * Usage: hpptest
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <net/if.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <string>
+
+#include "libifconfig.hpp"
+
+#include "check.h"
+
+int failures;
+
+int
+main()
+{
+	ifconfig_sim_t *sim;
+
+	if ((sim = ifconfig_sim_new()) == nullptr) {
+		err(1, "ifconfig_sim_new");
+	}
+	{
+		auto h = ifconfig::Handle::open();
+
+		CHECK(h.has_value() && *h);
+		if (!h || ifconfig_sim_attach(h->get(), sim) != 0 ||
+		    ifconfig_sim_populate(sim, "em", 1) != 0) {
+			errx(1, "setup");
+		}
+
+		CHECK(h->mtu("em0").value_or(-1) == 1500);
+		CHECK(h->set_mtu("em0", 9000).has_value());
+		CHECK(h->mtu("em0").value_or(-1) == 9000);
+		auto missing = h->mtu("em1");
+		CHECK(!missing && missing.error().errcode == ENXIO);
+
+		/* No description is an empty view, not an error. */
+		auto none = h->description("em0");
+		CHECK(none.has_value() && none->empty());
+
+		/* Longer than the buffer's first 256 bytes, twice over. */
+		const std::string descr(600, 'x');
+		CHECK(h->set_description("em0", descr).has_value());
+		auto got = h->description("em0");
+		CHECK(got.has_value() && *got == descr);
+		CHECK(h->description("em0").value_or("") == descr);
+
+		/* A name is refused whole rather than cut to IFNAMSIZ. */
+		const std::string longname(IFNAMSIZ, 'e');
+		auto toolong = h->mtu(longname);
+		CHECK(!toolong && toolong.error().type == OTHER &&
+		    toolong.error().errcode == ENAMETOOLONG);
+		CHECK(!h->set_description(longname, "x"));
+		auto fits = h->mtu(longname.substr(0, IFNAMSIZ - 1));
+		CHECK(!fits && fits.error().errcode == ENXIO);
+	}
+	ifconfig_sim_free(sim);
+	printf("hpp: %s\n", failures == 0 ? "ok" : "FAILED");
+	return (failures == 0 ? 0 : 1);
+}
@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2016-2017, Marie Helene Kvello-Aune
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * thislist of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+
+/*
+ * Regression tests for the Linux backend's interface creation, bridge
+ * members and the checkpoint of veth pairs, against the real kernel. The
+ * program moves itself into a new network namespace (and user namespace,
+ * if unprivileged) and sets up its veth pairs with ip(8). Where that
+ * isn't possible, or on other systems, it skips the tests.
+ *
+ * Usage: nstest
+ */
+
+#if defined(__linux__)
+#define _GNU_SOURCE	/* unshare(2) */
+#endif
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <net/if.h>
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libifconfig.h"
+
+#include "check.h"
+
+int failures;
+
+#if defined(__linux__)
+static int
+writefile(const char *path, const char *data)
+{
+	ssize_t len;
+	int fd;
+
+	if ((fd = open(path, O_WRONLY | O_CLOEXEC)) == -1) {
+		return (-1);
+	}
+	len = write(fd, data, strlen(data));
+	(void)close(fd);
+	return (len == (ssize_t)strlen(data) ? 0 : -1);
+}
+
+/*
+ * Enters a network namespace of our own. An unprivileged user gets a user
+ * namespace too, in which it is root, so ip(8) keeps the capabilities.
+ */
+static int
+enter_netns(void)
+{
+	char map[64];
+	uid_t uid;
+	gid_t gid;
+
+	if (unshare(CLONE_NEWNET) == 0) {
+		return (0);
+	}
+	uid = getuid();
+	gid = getgid();
+	if (unshare(CLONE_NEWUSER | CLONE_NEWNET) != 0) {
+		return (-1);
+	}
+	(void)snprintf(map, sizeof(map), "0 %u 1", (unsigned int)uid);
+	if (writefile("/proc/self/setgroups", "deny") != 0 ||
+	    writefile("/proc/self/uid_map", map) != 0) {
+		return (-1);
+	}
+	(void)snprintf(map, sizeof(map), "0 %u 1", (unsigned int)gid);
+	return (writefile("/proc/self/gid_map", map));
+}
+#endif
+
+static int
+exists(ifconfig_handle_t *h, const char *name)
+{
+	int mtu;
+
+	return (ifconfig_get_mtu(h, name, &mtu) == 0);
+}
+
+/* user-025: the kernel agrees with if_bridge(4) and the simulator. */
+static void
+test_bridge(ifconfig_handle_t *h)
+{
+	const char *members[] = { "vc", "va" };
+	char names[2 * IFNAMSIZ];
+	size_t count;
+	int errors[2];
+
+	CHECK(ifconfig_create_interface_r(h, "bridge0", names, IFNAMSIZ) ==
+	    0);
+	CHECK(ifconfig_create_interface_r(h, "bridge1", names, IFNAMSIZ) ==
+	    0);
+
+	CHECK_ERR(h, ifconfig_bridge_delete_member(h, "bridge0", "va"),
+	    ENOENT);
+	CHECK(ifconfig_bridge_add_member(h, "bridge0", "va") == 0);
+	CHECK_ERR(h, ifconfig_bridge_add_member(h, "bridge0", "va"), EEXIST);
+	CHECK_ERR(h, ifconfig_bridge_add_member(h, "bridge1", "va"), EBUSY);
+	CHECK_ERR(h, ifconfig_bridge_delete_member(h, "bridge1", "va"),
+	    ENOENT);
+	CHECK_ERR(h, ifconfig_bridge_add_member(h, "bridge0", "nope0"),
+	    ENOENT);
+	CHECK(ifconfig_bridge_delete_member(h, "br9", "va") == -1);
+
+	/* Pipelined, each member still checked against what came before. */
+	CHECK_ERR(h, ifconfig_bridge_add_members(h, "bridge1", members, 2,
+	    errors, names, 2, &count), EBUSY);
+	CHECK(errors[0] == 0 && errors[1] == EBUSY);
+	CHECK(count == 1 && strcmp(names, "vc") == 0);
+	CHECK(ifconfig_bridge_get_members(h, "bridge0", names, 2, &count) ==
+	    0 && count == 1 && strcmp(names, "va") == 0);
+
+	CHECK(ifconfig_bridge_delete_member(h, "bridge0", "va") == 0);
+	CHECK(ifconfig_bridge_delete_members(h, "bridge1", members, 1,
+	    NULL) == 0);
+	CHECK(ifconfig_destroy_interface(h, "bridge0") == 0);
+	CHECK(ifconfig_destroy_interface(h, "bridge1") == 0);
+}
+
+/* user-002: names are picked from the name cache, peers included. */
+static void
+test_create(ifconfig_handle_t *h)
+{
+	char name[IFNAMSIZ];
+
+	CHECK(ifconfig_create_interface_r(h, "veth0", name, sizeof(name)) ==
+	    0 && strcmp(name, "veth0") == 0);
+	CHECK(exists(h, "veth1"));
+	CHECK_ERR(h, ifconfig_create_interface_r(h, "veth0", name,
+	    sizeof(name)), EEXIST);
+	CHECK(ifconfig_create_interface_r(h, "veth", name, sizeof(name)) ==
+	    0 && strcmp(name, "veth2") == 0);
+	CHECK(exists(h, "veth3"));
+
+	CHECK(ifconfig_create_interface_r(h, "bridge3", name, sizeof(name)) ==
+	    0);
+	CHECK(ifconfig_create_interface_r(h, "bridge", name, sizeof(name)) ==
+	    0 && strcmp(name, "bridge0") == 0);
+	CHECK(ifconfig_create_interface_r(h, "bridge", name, sizeof(name)) ==
+	    0 && strcmp(name, "bridge1") == 0);
+
+	CHECK(ifconfig_destroy_interface(h, "veth0") == 0);
+	CHECK(ifconfig_destroy_interface(h, "veth2") == 0);
+	CHECK(!exists(h, "veth1") && !exists(h, "veth3"));
+	CHECK(ifconfig_destroy_interface(h, "bridge0") == 0);
+	CHECK(ifconfig_destroy_interface(h, "bridge1") == 0);
+	CHECK(ifconfig_destroy_interface(h, "bridge3") == 0);
+}
+
+/* user-024: a pair is saved as one, and comes back as one. */
+static void
+test_checkpoint_pair(ifconfig_handle_t *h)
+{
+	char path[] = "/tmp/nstest.XXXXXX";
+	char descr[16];
+	int fd, mtu;
+
+	if ((fd = mkstemp(path)) == -1) {
+		err(1, "mkstemp");
+	}
+	(void)close(fd);
+
+	CHECK(ifconfig_set_mtu(h, "vb", 1400) == 0);
+	CHECK(ifconfig_set_description(h, "va", "left") == 0);
+	CHECK(ifconfig_checkpoint_save(h, path) == 0);
+
+	/* Either end takes the other along. */
+	CHECK(ifconfig_destroy_interface(h, "va") == 0);
+	CHECK(ifconfig_destroy_interface(h, "vd") == 0);
+	CHECK(!exists(h, "vb") && !exists(h, "vc"));
+
+	CHECK(ifconfig_checkpoint_restore(h, path) == 0);
+	CHECK(exists(h, "va") && exists(h, "vb"));
+	CHECK(exists(h, "vc") && exists(h, "vd"));
+	CHECK(ifconfig_get_mtu(h, "vb", &mtu) == 0 && mtu == 1400);
+	CHECK(ifconfig_get_description_r(h, "va", descr, sizeof(descr)) ==
+	    0 && strcmp(descr, "left") == 0);
+	CHECK(!exists(h, "veth0"));
+
+	CHECK(ifconfig_checkpoint_restore(h, path) == 0);
+	(void)unlink(path);
+}
+
+int
+main(void)
+{
+	ifconfig_handle_t *h;
+	int before;
+
+#if defined(__linux__)
+	if (enter_netns() != 0 ||
+	    system("ip link add va type veth peer name vb && "
+	    "ip link add vc type veth peer name vd") != 0) {
+		printf("nstest: skipped, no network namespace with veth\n");
+		return (0);
+	}
+#else
+	printf("nstest: skipped, Linux only\n");
+	return (0);
+#endif
+
+	if ((h = ifconfig_open()) == NULL) {
+		err(1, "ifconfig_open");
+	}
+	before = failures;
+	test_bridge(h);
+	printf("bridge: %s\n", failures == before ? "ok" : "FAILED");
+	before = failures;
+	test_create(h);
+	printf("create: %s\n", failures == before ? "ok" : "FAILED");
+	before = failures;
+	test_checkpoint_pair(h);
+	printf("checkpoint_pair: %s\n", failures == before ? "ok" : "FAILED");
+	ifconfig_close(h);
+	return (failures == 0 ? 0 : 1);
+}
@@ -0,0 +1,854 @@
+/*
+ * Copyright (c) 2016-2017, Marie Helene Kvello-Aune
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * thislist of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation and/or
+ * other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+
+/*
+ * Regression tests for the bulk, asynchronous, reconcile, checkpoint and
+ * bridge functions, run against the simulated kernel. Every test starts
+ * from a fresh simulator, so the results don't depend on the machine.
+ * The program is built against the source tree, whose internal header
+ * has the FreeBSD request codes that faults are injected by.
+ *
+ * Usage: simtest [test ...]
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <net/if.h>
+
+#include <err.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libifconfig.h"
+#include "libifconfig_internal.h"	/* SIOC* codes for faults on Linux */
+
+#include "check.h"
+
+int failures;
+
+static ifconfig_sim_t *sim;
+
+/* A handle on a new simulator with n interfaces of kind and n2 of kind2. */
+static ifconfig_handle_t *
+setup(const char *kind, const size_t n, const char *kind2, const size_t n2)
+{
+	ifconfig_handle_t *h;
+
+	if ((sim = ifconfig_sim_new()) == NULL ||
+	    (h = ifconfig_open()) == NULL) {
+		err(1, "setup");
+	}
+	if (ifconfig_sim_attach(h, sim) != 0 ||
+	    (kind != NULL && ifconfig_sim_populate(sim, kind, n) != 0) ||
+	    (kind2 != NULL && ifconfig_sim_populate(sim, kind2, n2) != 0)) {
+		errx(1, "setup");
+	}
+	return (h);
+}
+
+static void
+teardown(ifconfig_handle_t *h)
+{
+
+	ifconfig_close(h);
+	ifconfig_sim_free(sim);
+	sim = NULL;
+}
+
+static int
+exists(ifconfig_handle_t *h, const char *name)
+{
+	int mtu;
+
+	return (ifconfig_get_mtu(h, name, &mtu) == 0);
+}
+
+static int
+mtu_of(ifconfig_handle_t *h, const char *name)
+{
+	int mtu;
+
+	return (ifconfig_get_mtu(h, name, &mtu) == 0 ? mtu : -1);
+}
+
+/* Whether name's description is descr, or it has none if descr is NULL. */
+static int
+descr_is(ifconfig_handle_t *h, const char *name, const char *descr)
+{
+	char buf[64];
+
+	if (ifconfig_get_description_r(h, name, buf, sizeof(buf)) != 0) {
+		return (descr == NULL && ifconfig_err_errtype(h) == OTHER &&
+		    ifconfig_err_errno(h) == 0);
+	}
+	return (descr != NULL && strcmp(buf, descr) == 0);
+}
+
+/* user-004: changes made through another handle reach the name cache. */
+static void
+test_namecache(void)
+{
+	ifconfig_handle_t *h, *h2;
+	unsigned int index, index2;
+	char name[IFNAMSIZ];
+
+	h = setup("em", 2, NULL, 0);
+	if ((h2 = ifconfig_open()) == NULL ||
+	    ifconfig_sim_attach(h2, sim) != 0) {
+		errx(1, "test_namecache");
+	}
+	CHECK(ifconfig_nametoindex(h, "em1", &index) == 0);
+	CHECK(ifconfig_indextoname(h, index, name) == 0 &&
+	    strcmp(name, "em1") == 0);
+
+	CHECK(ifconfig_set_name(h2, "em1", "wan0") == 0);
+	CHECK_ERR(h, ifconfig_nametoindex(h, "em1", &index2), ENOENT);
+	CHECK(ifconfig_nametoindex(h, "wan0", &index2) == 0 &&
+	    index2 == index);
+	CHECK(ifconfig_indextoname(h, index, name) == 0 &&
+	    strcmp(name, "wan0") == 0);
+
+	CHECK(ifconfig_destroy_interface(h2, "wan0") == 0);
+	CHECK_ERR(h, ifconfig_nametoindex(h, "wan0", &index2), ENOENT);
+	CHECK_ERR(h, ifconfig_indextoname(h, index, name), ENXIO);
+	CHECK(ifconfig_nametoindex(h, "em0", &index2) == 0);
+
+	ifconfig_close(h2);
+	teardown(h);
+}
+
+/* Events of one dispatch, with the strings copied. */
+struct events {
+	size_t count;
+	struct {
+		int events;
+		int mtu;
+		char name[IFNAMSIZ];
+		char oldname[IFNAMSIZ];
+	} ev[8];
+};
+
+static int
+collect_event(const struct ifconfig_event *event, void *udata)
+{
+	struct events *evs;
+
+	evs = udata;
+	if (evs->count == sizeof(evs->ev) / sizeof(evs->ev[0])) {
+		return (-1);
+	}
+	evs->ev[evs->count].events = event->events;
+	evs->ev[evs->count].mtu = event->mtu;
+	(void)strlcpy(evs->ev[evs->count].name, event->name, IFNAMSIZ);
+	(void)strlcpy(evs->ev[evs->count].oldname,
+	    event->oldname != NULL ? event->oldname : "", IFNAMSIZ);
+	evs->count++;
+	return (0);
+}
+
+static int
+dispatch(ifconfig_watch_t *w, struct events *evs)
+{
+
+	memset(evs, 0, sizeof(*evs));
+	return (ifconfig_watch_dispatch(w, collect_event, evs));
+}
+
+/* user-005 */
+static void
+test_watch(void)
+{
+	struct events evs;
+	ifconfig_watch_t *w;
+	ifconfig_handle_t *h;
+	char name[IFNAMSIZ];
+
+	h = setup("em", 2, NULL, 0);
+	CHECK(ifconfig_watch_open(h, &w) == 0);
+	CHECK(dispatch(w, &evs) == 0);
+
+	/* Gone before anyone looked, and renamed back: nothing to report. */
+	CHECK(ifconfig_create_interface_r(h, "tap", name, sizeof(name)) ==
+	    0);
+	CHECK(ifconfig_destroy_interface(h, name) == 0);
+	CHECK(ifconfig_set_name(h, "em0", "x0") == 0);
+	CHECK(ifconfig_set_name(h, "x0", "em0") == 0);
+	CHECK(dispatch(w, &evs) == 0);
+
+	/* All changes to one interface come as one event. */
+	CHECK(ifconfig_set_name(h, "em1", "a1") == 0);
+	CHECK(ifconfig_set_name(h, "a1", "lan0") == 0);
+	CHECK(ifconfig_set_mtu(h, "lan0", 9000) == 0);
+	CHECK(dispatch(w, &evs) == 1);
+	CHECK(evs.ev[0].events == (IFCONFIG_EVENT_RENAME |
+	    IFCONFIG_EVENT_MTU));
+	CHECK(strcmp(evs.ev[0].name, "lan0") == 0 &&
+	    strcmp(evs.ev[0].oldname, "em1") == 0 && evs.ev[0].mtu == 9000);
+
+	/*
+	 * More notifications than the simulator queues are dropped, like
+	 * ENOBUFS on a netlink socket, and the watcher compares against a
+	 * fresh dump instead.
+	 */
+	for (int i = 0; i < 70000; i++) {
+		CHECK(ifconfig_set_mtu(h, "em0", 1400 + i % 2) == 0);
+	}
+	CHECK(ifconfig_set_mtu(h, "em0", 4000) == 0);
+	CHECK(ifconfig_destroy_interface(h, "lan0") == 0);
+	CHECK(ifconfig_create_interface_r(h, "tap", name, sizeof(name)) ==
+	    0);
+	CHECK(dispatch(w, &evs) == 3);
+	for (size_t i = 0; i < evs.count; i++) {
+		if (strcmp(evs.ev[i].name, "em0") == 0) {
+			CHECK(evs.ev[i].events == IFCONFIG_EVENT_MTU &&
+			    evs.ev[i].mtu == 4000);
+		} else if (strcmp(evs.ev[i].name, "lan0") == 0) {
+			CHECK(evs.ev[i].events == IFCONFIG_EVENT_REMOVE);
+		} else {
+			CHECK(strcmp(evs.ev[i].name, name) == 0 &&
+			    evs.ev[i].events == IFCONFIG_EVENT_ADD);
+		}
+	}
+	CHECK(dispatch(w, &evs) == 0);
+
+	ifconfig_watch_close(w);
+	teardown(h);
+}
+
+/* user-012 */
+static void
+test_create_vlans(void)
+{
+	const struct ifconfig_vlan_range ranges[] = {
+		{ 10, 19 }, { 100, 100 }
+	};
+	ifconfig_handle_t *h;
+	char *names;
+	size_t count;
+
+	h = setup("ix", 1, NULL, 0);
+	CHECK(ifconfig_create_vlans(h, "ix0", ranges, 2, 1400, "trunk",
+	    &names, &count) == 0);
+	CHECK(count == 11);
+	CHECK(strcmp(names, "ix0.10") == 0);
+	CHECK(strcmp(names + 10 * IFNAMSIZ, "ix0.100") == 0);
+	free(names);
+	CHECK(mtu_of(h, "ix0.15") == 1400);
+	CHECK(descr_is(h, "ix0.19", "trunk"));
+	CHECK(ifconfig_sim_count(sim) == 13);
+
+	/* A failed create rolls the whole set back. */
+	CHECK(ifconfig_sim_add_fault(sim, SIOCIFCREATE2, EIO, 5) == 0);
+	CHECK_ERR(h, ifconfig_create_vlans(h, "ix0",
+	    &(struct ifconfig_vlan_range){ 200, 219 }, 1, 0, NULL, NULL,
+	    &count), EIO);
+	CHECK(ifconfig_sim_count(sim) == 13);
+	CHECK(!exists(h, "ix0.200"));
+	teardown(h);
+}
+
+/* user-013 */
+static void
+test_destroy_interfaces(void)
+{
+	const char *names[] = { "ix0", "bridge0", "ix0.10", "nope0",
+	    "bridge1", "ix0.11" };
+	ifconfig_handle_t *h;
+	char vlan[IFNAMSIZ];
+	int errors[6];
+
+	h = setup("ix", 1, "bridge", 2);
+	CHECK(ifconfig_create_interface_vlan_r(h, "ix0.10", vlan, sizeof(vlan),
+	    "ix0", 10) == 0);
+	CHECK(ifconfig_create_interface_vlan_r(h, "ix0.11", vlan, sizeof(vlan),
+	    "ix0", 11) == 0);
+
+	/* Workers talk to the simulator too, VLANs go before their parent. */
+	CHECK_ERR(h, ifconfig_destroy_interfaces(h, names, 6, 4, errors),
+	    ENXIO);
+	CHECK(errors[0] == 0 && errors[1] == 0 && errors[2] == 0);
+	CHECK(errors[3] == ENXIO);
+	CHECK(errors[4] == 0 && errors[5] == 0);
+	CHECK(ifconfig_sim_count(sim) == 1);
+	teardown(h);
+}
+
+/* Reaps completions until n arrived or a second passed without one. */
+static size_t
+reap(ifconfig_async_t *a, struct ifconfig_completion *c, const size_t n)
+{
+	struct pollfd pfd;
+	size_t got;
+
+	pfd.fd = ifconfig_async_fd(a);
+	pfd.events = POLLIN;
+	for (got = 0; got < n; got += ifconfig_async_reap(a, c + got,
+	    n - got)) {
+		if (poll(&pfd, 1, 1000) != 1) {
+			break;
+		}
+	}
+	return (got);
+}
+
+/* Sets the ibytes of name, and leaves the other counters at 0. */
+static void
+set_ibytes(const char *name, const uint64_t ibytes)
+{
+	struct ifconfig_ifcounters c;
+
+	memset(&c, 0, sizeof(c));
+	c.ibytes = ibytes;
+	if (ifconfig_sim_set_counters(sim, name, &c) != 0) {
+		err(1, "ifconfig_sim_set_counters");
+	}
+}
+
+/*
+ * Waits for a sample newer than *cur and moves *cur to *old, releasing
+ * the one *old held. With both held the sampler can't publish another,
+ * so the counters can be changed between two samples.
+ */
+static void
+sampler_step(ifconfig_sampler_t *s, const ifconfig_sample_t **old,
+    const ifconfig_sample_t **cur)
+{
+	const ifconfig_sample_t *smp;
+	uint64_t seq;
+
+	seq = (*cur == NULL) ? 0 : ifconfig_sample_seq(*cur);
+	if (*old != NULL) {
+		ifconfig_sampler_release(s, *old);
+	}
+	for (;;) {
+		smp = ifconfig_sampler_acquire(s);
+		if (ifconfig_sample_seq(smp) > seq) {
+			break;
+		}
+		ifconfig_sampler_release(s, smp);
+		(void)usleep(1000);
+	}
+	*old = *cur;
+	*cur = smp;
+}
+
+/* Increase of ibytes of name in smp, from its rate, or -1 if it's absent. */
+static double
+ibytes_delta(const ifconfig_sample_t *smp, const char *name)
+{
+	const double *rates;
+
+	rates = ifconfig_sample_rates(smp, IFCONFIG_COUNTER_IBYTES);
+	for (size_t i = 0; i < ifconfig_sample_count(smp); i++) {
+		if (strcmp(ifconfig_sample_name(smp, i), name) == 0) {
+			return (rates[i] *
+			    (double)ifconfig_sample_interval_ns(smp) / 1e9);
+		}
+	}
+	return (-1);
+}
+
+static int
+near(const double x, const double y)
+{
+
+	return (x > y - 0.01 && x < y + 0.01);
+}
+
+/* user-016 */
+static void
+test_sampler(void)
+{
+	const ifconfig_sample_t *cur, *old, *smp;
+	ifconfig_sampler_t *s;
+	ifconfig_handle_t *h, *sh;
+	uint64_t seq;
+
+	h = setup("em", 3, NULL, 0);
+	set_ibytes("em0", UINT32_MAX - 5);
+	set_ibytes("em1", (uint64_t)1 << 40);
+	set_ibytes("em2", 1000);
+	if ((sh = ifconfig_open()) == NULL ||
+	    ifconfig_sim_attach(sh, sim) != 0 ||
+	    ifconfig_sampler_start(sh, 5, &s) != 0) {
+		err(1, "ifconfig_sampler_start");
+	}
+	old = cur = NULL;
+	sampler_step(s, &old, &cur);
+	sampler_step(s, &old, &cur);
+
+	/* Holding the two, the sampler skips its rounds. */
+	seq = ifconfig_sample_seq(cur);
+	(void)usleep(30000);
+	smp = ifconfig_sampler_acquire(s);
+	CHECK(smp == cur && ifconfig_sample_seq(smp) == seq);
+	ifconfig_sampler_release(s, smp);
+
+	/* Below 2^32 a counter going back wrapped, above it was reset. */
+	set_ibytes("em0", 10);
+	set_ibytes("em1", 100);
+	set_ibytes("em2", 1500);
+	sampler_step(s, &old, &cur);
+	CHECK(ifconfig_sample_seq(cur) == seq + 1);
+	CHECK(ifconfig_sample_interval_ns(cur) > 0);
+	CHECK(near(ibytes_delta(cur, "em0"), 16));
+	CHECK(near(ibytes_delta(cur, "em1"), 100));
+	CHECK(near(ibytes_delta(cur, "em2"), 500));
+
+	/* Each interface is matched with its own previous value. */
+	CHECK(ifconfig_destroy_interface(h, "em0") == 0);
+	CHECK(ifconfig_sim_populate(sim, "em", 1) == 0);
+	set_ibytes("em3", 7777);
+	set_ibytes("em1", 300);
+	sampler_step(s, &old, &cur);
+	CHECK(ifconfig_sample_count(cur) == 4);	/* lo0 too */
+	CHECK(ibytes_delta(cur, "em0") == -1);
+	CHECK(near(ibytes_delta(cur, "em1"), 200));
+	CHECK(near(ibytes_delta(cur, "em2"), 0));
+	CHECK(near(ibytes_delta(cur, "em3"), 0));
+	CHECK(ifconfig_sample_counters(cur, IFCONFIG_COUNTER_IBYTES)[3] ==
+	    7777 && strcmp(ifconfig_sample_name(cur, 3), "em3") == 0);
+	CHECK(ifconfig_sampler_failures(s) == 0);
+
+	ifconfig_sampler_release(s, old);
+	ifconfig_sampler_release(s, cur);
+	ifconfig_sampler_stop(s);
+	teardown(h);
+}
+
+/* Writes a whole exposition into out, chunk bytes at a time at most. */
+static size_t
+metrics_collect(ifconfig_metrics_t *m, const ifconfig_snapshot_t *snap,
+    const ifconfig_counters_t *c, const size_t chunk, char *out,
+    const size_t size)
+{
+	size_t len, n;
+
+	if (ifconfig_metrics_begin(m, snap, c) != 0) {
+		err(1, "ifconfig_metrics_begin");
+	}
+	len = 0;
+	while (len < size && (n = ifconfig_metrics_write(m, out + len,
+	    chunk < size - len ? chunk : size - len)) > 0) {
+		len += n;
+	}
+	return (len);
+}
+
+/* user-017 */
+static void
+test_metrics(void)
+{
+	static char whole[65536], piece[65536];
+	const size_t chunks[] = { 1, 7 };
+	struct ifconfig_ifcounters ifc;
+	ifconfig_snapshot_t *snap;
+	ifconfig_counters_t *c;
+	ifconfig_metrics_t *m;
+	ifconfig_handle_t *h;
+	size_t len;
+
+	h = setup("em", 3, NULL, 0);
+	memset(&ifc, 0, sizeof(ifc));
+	ifc.ibytes = 12345;
+	CHECK(ifconfig_sim_set_counters(sim, "em0", &ifc) == 0);
+	CHECK(ifconfig_set_description(h, "em1", "say \"hi\" \\o\nbye") ==
+	    0);
+	if (ifconfig_snapshot_take(h, IFCONFIG_SNAP_ALL, &snap) != 0 ||
+	    (c = ifconfig_counters_new()) == NULL ||
+	    ifconfig_counters_read(h, c) != 0 ||
+	    (m = ifconfig_metrics_new()) == NULL) {
+		errx(1, "test_metrics");
+	}
+
+	len = metrics_collect(m, snap, c, sizeof(whole), whole,
+	    sizeof(whole));
+	CHECK(len > 0 && len < sizeof(whole));
+	whole[len] = '\0';
+	CHECK(strstr(whole, "{interface=\"em1\",description="
+	    "\"say \\\"hi\\\" \\\\o\\nbye\"} 1\n") != NULL);
+	CHECK(strstr(whole, "ifconfig_interface_receive_bytes_total"
+	    "{interface=\"em0\"} 12345\n") != NULL);
+	CHECK(len >= 6 && strcmp(whole + len - 6, "# EOF\n") == 0);
+	CHECK(strstr(whole, "# EOF") == whole + len - 6);
+	CHECK(ifconfig_metrics_write(m, piece, sizeof(piece)) == 0);
+
+	/* The cursor resumes lines split anywhere. */
+	for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+		CHECK(metrics_collect(m, snap, c, chunks[i], piece,
+		    sizeof(piece)) == len);
+		CHECK(memcmp(piece, whole, len) == 0);
+	}
+
+	ifconfig_metrics_free(m);
+	ifconfig_counters_free(c);
+	ifconfig_snapshot_free(snap);
+	teardown(h);
+}
+
+/* user-019: reads come from the cache, until the TTL expires. */
+static void
+test_attrcache(void)
+{
+	ifconfig_handle_t *h, *h2;
+	char descr[16];
+	int mtu;
+
+	h = setup("em", 1, NULL, 0);
+	if ((h2 = ifconfig_open()) == NULL ||
+	    ifconfig_sim_attach(h2, sim) != 0) {
+		errx(1, "test_attrcache");
+	}
+	CHECK(ifconfig_attrcache_enable(h, 100, 0) == 0);
+
+	/* With every read failing, a value read is one the cache held. */
+	CHECK(ifconfig_set_mtu(h, "em0", 9000) == 0);
+	CHECK(ifconfig_set_description(h, "em0", "uplink") == 0);
+	CHECK(ifconfig_sim_add_fault(sim, SIOCGIFMTU, EIO, 1) == 0);
+	CHECK(ifconfig_sim_add_fault(sim, SIOCGIFDESCR, EIO, 1) == 0);
+	CHECK(ifconfig_get_mtu(h, "em0", &mtu) == 0 && mtu == 9000);
+	CHECK(ifconfig_get_description_r(h, "em0", descr, sizeof(descr)) ==
+	    0 && strcmp(descr, "uplink") == 0);
+
+	/* Without notifications, a change elsewhere waits for the TTL. */
+	CHECK(ifconfig_set_mtu(h2, "em0", 1400) == 0);
+	CHECK(ifconfig_get_mtu(h, "em0", &mtu) == 0 && mtu == 9000);
+	(void)usleep(150000);
+	CHECK_ERR(h, ifconfig_get_mtu(h, "em0", &mtu), EIO);
+	ifconfig_sim_clear_faults(sim);
+	CHECK(ifconfig_get_mtu(h, "em0", &mtu) == 0 && mtu == 1400);
+
+	ifconfig_close(h2);
+	teardown(h);
+}
+
+/* user-022 */
+static void
+test_async(void)
+{
+	struct ifconfig_completion c[3];
+	ifconfig_async_t *a;
+	ifconfig_handle_t *h;
+	ifconfig_ticket_t t[3];
+
+	h = setup("ix", 1, NULL, 0);
+	CHECK(ifconfig_async_new(h, 2, &a) == 0);
+	CHECK(ifconfig_submit_set_mtu(a, "ix0", 9000, &t[0]) == 0);
+	CHECK(ifconfig_submit_set_mtu(a, "nope0", 9000, &t[1]) == 0);
+	CHECK(ifconfig_submit_create_interface(a, "bridge", &t[2]) == 0);
+	CHECK(ifconfig_async_inflight(a) == 3);
+	CHECK(reap(a, c, 3) == 3);
+	for (size_t i = 0; i < 3; i++) {
+		if (c[i].ticket == t[0]) {
+			CHECK(c[i].error == 0);
+		} else if (c[i].ticket == t[1]) {
+			CHECK(c[i].error == -1 && c[i].errcode == ENXIO);
+		} else {
+			CHECK(c[i].ticket == t[2]);
+			CHECK(c[i].error == 0);
+			CHECK(strcmp(c[i].name, "bridge0") == 0);
+		}
+	}
+	CHECK(ifconfig_async_inflight(a) == 0);
+	ifconfig_async_free(a);
+	CHECK(mtu_of(h, "ix0") == 9000);
+	CHECK(exists(h, "bridge0"));
+	teardown(h);
+}
+
+/* user-023 */
+static void
+test_reconcile(void)
+{
+	const struct ifconfig_change *c;
+	ifconfig_reconcile_t *r;
+	ifconfig_handle_t *h;
+	char vlan[IFNAMSIZ];
+
+	h = setup("ix", 2, "bridge", 1);
+	CHECK(ifconfig_create_interface_vlan_r(h, "vlan0", vlan, sizeof(vlan),
+	    "ix0", 10) == 0);
+	CHECK((r = ifconfig_reconcile_new(h)) != NULL);
+	CHECK(ifconfig_reconcile_set_mtu(r, "ix0", 1500) == 0);
+	CHECK(ifconfig_reconcile_set_mtu(r, "ix1", 9000) == 0);
+	/* A retag, and changes that must follow it. */
+	CHECK(ifconfig_reconcile_set_vlan(r, "vlan0", "ix1", 20) == 0);
+	CHECK(ifconfig_reconcile_set_mtu(r, "vlan0", 1400) == 0);
+	CHECK(ifconfig_reconcile_set_description(r, "vlan0", "storage") == 0);
+
+	CHECK(ifconfig_reconcile_run(r, IFCONFIG_RECONCILE_DRYRUN) == 0);
+	CHECK(ifconfig_reconcile_count(r) == 4);
+	c = ifconfig_reconcile_change(r, 0);
+	CHECK(c != NULL && c->attr == IFCONFIG_CHANGE_VLAN && c->from == 10 &&
+	    c->to == 20 && strcmp(c->from_str, "ix0") == 0);
+	CHECK(mtu_of(h, "ix1") == 1500);
+
+	CHECK(ifconfig_reconcile_run(r, 0) == 0);
+	for (size_t i = 0; i < ifconfig_reconcile_count(r); i++) {
+		CHECK(ifconfig_reconcile_change(r, i)->errcode == 0);
+	}
+	CHECK(mtu_of(h, "ix1") == 9000);
+	CHECK(mtu_of(h, "vlan0") == 1400);
+	CHECK(descr_is(h, "vlan0", "storage"));
+	CHECK(ifconfig_reconcile_run(r, 0) == 0);
+	CHECK(ifconfig_reconcile_count(r) == 0);
+
+	/* FreeBSD's ENOMSG for no description is no description. */
+	ifconfig_reconcile_clear(r);
+	CHECK(ifconfig_sim_add_fault(sim, SIOCGIFDESCR, ENOMSG, 1) == 0);
+	CHECK(ifconfig_reconcile_set_description(r, "bridge0", "x") == 0);
+	CHECK(ifconfig_reconcile_run(r, IFCONFIG_RECONCILE_DRYRUN) == 0);
+	CHECK(ifconfig_reconcile_count(r) == 1);
+	c = ifconfig_reconcile_change(r, 0);
+	CHECK(c != NULL && c->errcode == 0 && c->from_str == NULL);
+	ifconfig_reconcile_free(r);
+	teardown(h);
+}
+
+/* user-024 */
+static void
+test_checkpoint(void)
+{
+	const char *gone[] = { "bridge1", "ix0.11" };
+	ifconfig_handle_t *h;
+	char path[] = "/tmp/simtest.XXXXXX";
+	int fd;
+
+	if ((fd = mkstemp(path)) == -1) {
+		err(1, "mkstemp");
+	}
+	(void)close(fd);
+
+	h = setup("ix", 1, "bridge", 2);
+	CHECK(ifconfig_create_vlans(h, "ix0",
+	    &(struct ifconfig_vlan_range){ 10, 12 }, 1, 1400, "trunk", NULL,
+	    NULL) == 0);
+	CHECK(ifconfig_set_description(h, "bridge1", "uplink") == 0);
+	CHECK(ifconfig_set_mtu(h, "bridge1", 9000) == 0);
+	CHECK(ifconfig_checkpoint_save(h, path) == 0);
+
+	CHECK(ifconfig_destroy_interfaces(h, gone, 2, 1, NULL) == 0);
+	CHECK(ifconfig_set_mtu(h, "ix0.10", 1300) == 0);
+	CHECK(ifconfig_checkpoint_restore(h, path) == 0);
+	CHECK(mtu_of(h, "bridge1") == 9000);
+	CHECK(descr_is(h, "bridge1", "uplink"));
+	CHECK(mtu_of(h, "ix0.11") == 1400);
+	CHECK(descr_is(h, "ix0.11", "trunk"));
+	CHECK(mtu_of(h, "ix0.10") == 1400);
+	CHECK(ifconfig_sim_count(sim) == 7);
+
+	/* A restore with nothing to do creates nothing. */
+	CHECK(ifconfig_checkpoint_restore(h, path) == 0);
+	CHECK(ifconfig_sim_count(sim) == 7);
+
+	/* Interfaces without a description on FreeBSD still save. */
+	CHECK(ifconfig_sim_add_fault(sim, SIOCGIFDESCR, ENOMSG, 1) == 0);
+	CHECK(ifconfig_checkpoint_save(h, path) == 0);
+	teardown(h);
+	(void)unlink(path);
+}
+
+/* The checkpoint file layout, as libifconfig_checkpoint.c writes it. */
+struct ckpt_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t recsize;
+	uint32_t count;
+	uint32_t strtablen;
+};
+
+struct ckpt_record {
+	char name[IFNAMSIZ];
+	char kind[IFNAMSIZ];
+	char parent[IFNAMSIZ];
+	int32_t mtu;
+	int32_t curcap;
+	uint32_t descr;
+	uint16_t vlantag;
+	uint16_t flags;
+};
+
+/* How write_pairs() names the peers. */
+enum {
+	PEER_MISSING,	/* epairNz, which isn't in the file */
+	PEER_SELF,	/* the record itself */
+	PEER_ONESIDED	/* epair1a, which names epair0a back */
+};
+
+/* Writes a checkpoint of 8 epair ends, all flagged as pairs. */
+static void
+write_pairs(const char *path, const int peer)
+{
+	struct ckpt_header hdr;
+	struct ckpt_record rec;
+	FILE *f;
+
+	if ((f = fopen(path, "w")) == NULL) {
+		err(1, "%s", path);
+	}
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = 0x4b434649;
+	hdr.version = 1;
+	hdr.recsize = sizeof(rec);
+	hdr.count = 8;
+	(void)fwrite(&hdr, sizeof(hdr), 1, f);
+	for (unsigned int i = 0; i < hdr.count; i++) {
+		memset(&rec, 0, sizeof(rec));
+		(void)snprintf(rec.name, sizeof(rec.name), "epair%ua", i % 100);
+		(void)strlcpy(rec.kind, "epair", sizeof(rec.kind));
+		switch (peer) {
+		case PEER_MISSING:
+			(void)snprintf(rec.parent, sizeof(rec.parent),
+			    "epair%uz", i % 100);
+			break;
+		case PEER_SELF:
+			memcpy(rec.parent, rec.name, sizeof(rec.parent));
+			break;
+		default:
+			(void)strlcpy(rec.parent, i == 1 ? "epair0a" :
+			    "epair1a", sizeof(rec.parent));
+			break;
+		}
+		rec.mtu = 1500;
+		rec.descr = UINT32_MAX;
+		rec.flags = 0x4;
+		(void)fwrite(&rec, sizeof(rec), 1, f);
+	}
+	if (fclose(f) != 0) {
+		err(1, "%s", path);
+	}
+}
+
+/* user-024: pairs whose ends don't name each other are rejected. */
+static void
+test_checkpoint_malformed(void)
+{
+	ifconfig_handle_t *h;
+	char path[] = "/tmp/simtest.XXXXXX";
+	int fd;
+
+	if ((fd = mkstemp(path)) == -1) {
+		err(1, "mkstemp");
+	}
+	(void)close(fd);
+
+	h = setup(NULL, 0, NULL, 0);
+	for (int peer = PEER_MISSING; peer <= PEER_ONESIDED; peer++) {
+		write_pairs(path, peer);
+		CHECK_ERR(h, ifconfig_checkpoint_restore(h, path), EINVAL);
+		CHECK(ifconfig_sim_count(sim) == 1);
+	}
+	teardown(h);
+	(void)unlink(path);
+}
+
+/* user-025 */
+static void
+test_bridge(void)
+{
+	const char *members[] = { "ix2", "ix0", "nope0", "ix3" };
+	ifconfig_handle_t *h;
+	char names[4 * IFNAMSIZ];
+	size_t count;
+	int errors[4];
+
+	h = setup("bridge", 2, "ix", 4);
+	CHECK(ifconfig_bridge_add_member(h, "bridge0", "ix0") == 0);
+	CHECK_ERR(h, ifconfig_bridge_add_member(h, "bridge0", "ix0"), EEXIST);
+	CHECK_ERR(h, ifconfig_bridge_add_member(h, "bridge1", "ix0"), EBUSY);
+	CHECK_ERR(h, ifconfig_bridge_add_member(h, "bridge0", "bridge0"),
+	    EINVAL);
+	CHECK_ERR(h, ifconfig_bridge_delete_member(h, "bridge1", "ix0"),
+	    ENOENT);
+	CHECK_ERR(h, ifconfig_bridge_delete_member(h, "bridge0", "ix1"),
+	    ENOENT);
+	CHECK_ERR(h, ifconfig_bridge_add_member(h, "bridge9", "ix1"), ENXIO);
+
+	CHECK_ERR(h, ifconfig_bridge_add_members(h, "bridge1", members, 4,
+	    errors, names, 4, &count), EBUSY);
+	CHECK(errors[0] == 0 && errors[1] == EBUSY && errors[2] == ENOENT &&
+	    errors[3] == 0);
+	CHECK(count == 2);
+	CHECK(ifconfig_bridge_get_members(h, "bridge1", names, 1, &count) ==
+	    -1 && ifconfig_err_errno(h) == ERANGE && count == 2);
+
+	CHECK(ifconfig_bridge_delete_member(h, "bridge0", "ix0") == 0);
+	CHECK(ifconfig_bridge_get_members(h, "bridge0", names, 4, &count) ==
+	    0 && count == 0);
+	CHECK(ifconfig_bridge_delete_members(h, "bridge1", members + 3, 1,
+	    NULL) == 0);
+	CHECK(ifconfig_bridge_get_members(h, "bridge1", names, 4, &count) ==
+	    0 && count == 1 && strcmp(names, "ix2") == 0);
+	teardown(h);
+}
+
+static const struct {
+	const char *name;
+	void (*fn)(void);
+} tests[] = {
+	{ "namecache", test_namecache },
+	{ "watch", test_watch },
+	{ "create_vlans", test_create_vlans },
+	{ "destroy_interfaces", test_destroy_interfaces },
+	{ "sampler", test_sampler },
+	{ "metrics", test_metrics },
+	{ "attrcache", test_attrcache },
+	{ "async", test_async },
+	{ "reconcile", test_reconcile },
+	{ "checkpoint", test_checkpoint },
+	{ "checkpoint_malformed", test_checkpoint_malformed },
+	{ "bridge", test_bridge },
+};
+
+int
+main(int argc, char *argv[])
+{
+	int before, run;
+
+	for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+		run = (argc == 1);
+		for (int j = 1; j < argc && !run; j++) {
+			run = (strcmp(argv[j], tests[i].name) == 0);
+		}
+		if (!run) {
+			continue;
+		}
+		before = failures;
+		tests[i].fn();
+		printf("%s: %s\n", tests[i].name,
+		    failures == before ? "ok" : "FAILED");
+	}
+	return (failures == 0 ? 0 : 1);
+}